@@ -0,0 +1,376 @@
+/**
+ * SmartCard-HSM PKCS#11 Module
+ *
+ * Copyright (c) 2016, CardContact Systems GmbH, Minden, Germany
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of CardContact Systems GmbH nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CardContact Systems GmbH BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file securemem.c
+ * @brief Locked memory pool for PINs and other sensitive data
+ *
+ * The pool is a single mapping locked into memory and surrounded by guard
+ * pages. Blocks are carved from the pool in power of two size classes and
+ * recycled through a free list per class, so that steady state operation
+ * does not allocate from the heap or call into the kernel.
+ *
+ * Memory is zeroed when allocated and again when released. Requests that do
+ * not fit into the pool, or that are made while the pool is not initialized,
+ * are served from the heap with the same zero-on-free semantics.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+#include "mutex.h"
+#include "memset_s.h"
+#include "securemem.h"
+
+#define SECURE_HEADER		16			/**< Header size, keeps data 16 byte aligned */
+#define SECURE_MIN_BLOCK	64			/**< Size of the smallest block incl. header */
+#define SECURE_CLASSES		24
+#define SECURE_HEAP			-1			/**< Size class of blocks allocated from the heap */
+
+struct secureBlock {
+	size_t capacity;					/**< Usable bytes following the header */
+	int cls;							/**< Size class or SECURE_HEAP */
+};
+
+static MUTEX lock;
+static int initialized = 0;
+static int outstanding = 0;				/**< Number of blocks allocated from the pool */
+
+static unsigned char *mapping = NULL;	/**< Pool including guard pages */
+static size_t mappingSize = 0;
+static unsigned char *pool = NULL;		/**< First byte after the leading guard page */
+static size_t poolSize = 0;
+static size_t poolUsed = 0;
+
+static struct secureBlock *freeList[SECURE_CLASSES];
+
+
+
+static size_t pageSize()
+{
+#ifdef _WIN32
+	SYSTEM_INFO si;
+
+	GetSystemInfo(&si);
+	return si.dwPageSize;
+#else
+	return sysconf(_SC_PAGESIZE);
+#endif
+}
+
+
+
+/*
+ * Map the pool with a guard page at both ends and lock it into memory
+ */
+static int mapPool(size_t size)
+{
+	size_t page = pageSize();
+#ifdef _WIN32
+	DWORD old;
+#endif
+
+	poolSize = (size + page - 1) & ~(page - 1);
+	mappingSize = poolSize + 2 * page;
+
+#ifdef _WIN32
+	mapping = VirtualAlloc(NULL, mappingSize, MEM_RESERVE | MEM_COMMIT, PAGE_NOACCESS);
+
+	if (mapping == NULL) {
+		return -1;
+	}
+
+	pool = mapping + page;
+
+	if (!VirtualProtect(pool, poolSize, PAGE_READWRITE, &old)) {
+		VirtualFree(mapping, 0, MEM_RELEASE);
+		mapping = NULL;
+		return -1;
+	}
+
+	// Without a larger working set the pool may remain unlocked, which is tolerated
+	VirtualLock(pool, poolSize);
+#else
+	mapping = mmap(NULL, mappingSize, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+	if (mapping == MAP_FAILED) {
+		mapping = NULL;
+		return -1;
+	}
+
+	pool = mapping + page;
+
+	if (mprotect(pool, poolSize, PROT_READ | PROT_WRITE) != 0) {
+		munmap(mapping, mappingSize);
+		mapping = NULL;
+		return -1;
+	}
+
+	// RLIMIT_MEMLOCK may prevent locking, which is tolerated
+	mlock(pool, poolSize);
+
+#ifdef MADV_DONTDUMP
+	madvise(pool, poolSize, MADV_DONTDUMP);
+#endif
+#endif
+
+	poolUsed = 0;
+	return 0;
+}
+
+
+
+static void unmapPool()
+{
+	memset_s(pool, poolSize, 0, poolSize);
+
+#ifdef _WIN32
+	VirtualUnlock(pool, poolSize);
+	VirtualFree(mapping, 0, MEM_RELEASE);
+#else
+	munlock(pool, poolSize);
+	munmap(mapping, mappingSize);
+#endif
+
+	mapping = NULL;
+	pool = NULL;
+	poolSize = 0;
+}
+
+
+
+/**
+ * Create the locked memory pool
+ *
+ * Calling the function while the pool exists has no effect.
+ *
+ * @param size the size of the pool in bytes, rounded up to full pages
+ * @return 0 or -1 if the pool could not be created. Allocations are then served from the heap
+ */
+int secureMemInit(size_t size)
+{
+	if (initialized) {
+		return 0;
+	}
+
+	if (mutex_init(&lock) != 0) {
+		return -1;
+	}
+
+	if (mapPool(size) < 0) {
+		mutex_destroy(&lock);
+		return -1;
+	}
+
+	memset(freeList, 0, sizeof(freeList));
+	outstanding = 0;
+	initialized = 1;
+	return 0;
+}
+
+
+
+/**
+ * Release the pool
+ *
+ * The pool is retained if blocks are still in use.
+ */
+void secureMemTerm()
+{
+	if (!initialized || outstanding) {
+		return;
+	}
+
+	initialized = 0;
+	unmapPool();
+	mutex_destroy(&lock);
+}
+
+
+
+/*
+ * Return the size class for a block with size usable bytes
+ */
+static int sizeClass(size_t size)
+{
+	size_t block = SECURE_MIN_BLOCK;
+	int cls = 0;
+
+	while ((block - SECURE_HEADER < size) && (cls < SECURE_CLASSES - 1)) {
+		block <<= 1;
+		cls++;
+	}
+
+	return block - SECURE_HEADER < size ? SECURE_HEAP : cls;
+}
+
+
+
+/*
+ * Take a block from the free list or carve a new block from the pool
+ */
+static struct secureBlock *allocFromPool(int cls)
+{
+	struct secureBlock *block;
+	size_t blocksize = (size_t)SECURE_MIN_BLOCK << cls;
+
+	mutex_lock(&lock);
+
+	block = freeList[cls];
+
+	if (block != NULL) {
+		memcpy(&freeList[cls], (unsigned char *)block + SECURE_HEADER, sizeof(struct secureBlock *));
+	} else if (poolSize - poolUsed >= blocksize) {
+		block = (struct secureBlock *)(pool + poolUsed);
+		poolUsed += blocksize;
+		block->capacity = blocksize - SECURE_HEADER;
+		block->cls = cls;
+	}
+
+	if (block != NULL) {
+		outstanding++;
+	}
+
+	mutex_unlock(&lock);
+
+	return block;
+}
+
+
+
+/**
+ * Allocate zeroed memory from the locked pool
+ *
+ * @param size the number of bytes
+ * @return the memory or NULL if out of memory
+ */
+void *secureAlloc(size_t size)
+{
+	struct secureBlock *block = NULL;
+	int cls;
+
+	cls = sizeClass(size);
+
+	if (initialized && (cls != SECURE_HEAP)) {
+		block = allocFromPool(cls);
+	}
+
+	if (block == NULL) {
+		block = (struct secureBlock *)malloc(SECURE_HEADER + size);
+
+		if (block == NULL) {
+			return NULL;
+		}
+
+		block->capacity = size;
+		block->cls = SECURE_HEAP;
+	}
+
+	memset((unsigned char *)block + SECURE_HEADER, 0, block->capacity);
+
+	return (unsigned char *)block + SECURE_HEADER;
+}
+
+
+
+/**
+ * Change the size of a block allocated with secureAlloc()
+ *
+ * The content is preserved up to the lesser of the old and new size. The old
+ * block is zeroed if the content needs to be moved.
+ *
+ * @param ptr the block or NULL to allocate a new block
+ * @param size the new size in bytes
+ * @return the memory or NULL if out of memory, in which case ptr remains valid
+ */
+void *secureRealloc(void *ptr, size_t size)
+{
+	struct secureBlock *block;
+	void *p;
+
+	if (ptr == NULL) {
+		return secureAlloc(size);
+	}
+
+	block = (struct secureBlock *)((unsigned char *)ptr - SECURE_HEADER);
+
+	if (size <= block->capacity) {
+		return ptr;
+	}
+
+	p = secureAlloc(size);
+
+	if (p == NULL) {
+		return NULL;
+	}
+
+	memcpy(p, ptr, block->capacity);
+	secureFree(ptr);
+
+	return p;
+}
+
+
+
+/**
+ * Zero and release a block allocated with secureAlloc()
+ *
+ * @param ptr the block or NULL
+ */
+void secureFree(void *ptr)
+{
+	struct secureBlock *block;
+
+	if (ptr == NULL) {
+		return;
+	}
+
+	block = (struct secureBlock *)((unsigned char *)ptr - SECURE_HEADER);
+
+	memset_s(ptr, block->capacity, 0, block->capacity);
+
+	if (block->cls == SECURE_HEAP) {
+		memset_s(block, SECURE_HEADER, 0, SECURE_HEADER);
+		free(block);
+		return;
+	}
+
+	mutex_lock(&lock);
+
+	memcpy(ptr, &freeList[block->cls], sizeof(struct secureBlock *));
+	freeList[block->cls] = block;
+	outstanding--;
+
+	mutex_unlock(&lock);
+}
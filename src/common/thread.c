@@ -0,0 +1,160 @@
+/**
+ * CT-API for CCID Driver
+ *
+ * Copyright (c) 2016, CardContact Systems GmbH, Minden, Germany
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of CardContact Systems GmbH nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CardContact Systems GmbH BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file thread.c
+ * @brief Defines procedures for cross platform thread and condition handling
+ */
+
+#include <stdlib.h>
+
+#include "thread.h"
+
+
+
+/*
+ * On Windows the mutex is a kernel object, so the condition is implemented
+ * with a semaphore counting the waiting threads. cond_signal() and
+ * cond_broadcast() must be called with the mutex locked.
+ */
+int cond_init(COND *cond) {
+#ifdef _WIN32
+	cond->waiters = 0;
+	cond->sema = CreateSemaphore(NULL, 0, 0x7FFFFFFF, NULL);
+	return (cond->sema == 0 ? -1 : 0);
+#else
+	return pthread_cond_init(cond, NULL);
+#endif
+}
+
+
+
+int cond_wait(COND *cond, MUTEX *mutex) {
+#ifdef _WIN32
+	cond->waiters++;
+	if (SignalObjectAndWait(*mutex, cond->sema, INFINITE, FALSE) == WAIT_FAILED)
+		return -1;
+	return (WaitForSingleObject(*mutex, INFINITE) == WAIT_FAILED ? -1 : 0);
+#else
+	return pthread_cond_wait(cond, mutex);
+#endif
+}
+
+
+
+int cond_signal(COND *cond) {
+#ifdef _WIN32
+	if (cond->waiters > 0) {
+		cond->waiters--;
+		return (ReleaseSemaphore(cond->sema, 1, NULL) == 0 ? -1 : 0);
+	}
+	return 0;
+#else
+	return pthread_cond_signal(cond);
+#endif
+}
+
+
+
+int cond_broadcast(COND *cond) {
+#ifdef _WIN32
+	long waiters = cond->waiters;
+
+	if (waiters > 0) {
+		cond->waiters = 0;
+		return (ReleaseSemaphore(cond->sema, waiters, NULL) == 0 ? -1 : 0);
+	}
+	return 0;
+#else
+	return pthread_cond_broadcast(cond);
+#endif
+}
+
+
+
+int cond_destroy(COND *cond) {
+#ifdef _WIN32
+	return (CloseHandle(cond->sema) == 0 ? -1 : 0);
+#else
+	return pthread_cond_destroy(cond);
+#endif
+}
+
+
+
+#ifdef _WIN32
+struct threadStart {
+	thread_func_t func;
+	void *arg;
+};
+
+
+
+static unsigned __stdcall threadMain(void *arg) {
+	struct threadStart start = *(struct threadStart *)arg;
+
+	free(arg);
+	start.func(start.arg);
+	return 0;
+}
+#endif
+
+
+
+int thread_create(THREAD *thread, thread_func_t func, void *arg) {
+#ifdef _WIN32
+	struct threadStart *start;
+
+	start = (struct threadStart *)malloc(sizeof(struct threadStart));
+	if (start == NULL)
+		return -1;
+
+	start->func = func;
+	start->arg = arg;
+
+	*thread = (HANDLE)_beginthreadex(NULL, 0, threadMain, start, 0, NULL);
+	if (*thread == 0) {
+		free(start);
+		return -1;
+	}
+	return 0;
+#else
+	return pthread_create(thread, NULL, func, arg);
+#endif
+}
+
+
+
+int thread_join(THREAD *thread) {
+#ifdef _WIN32
+	if (WaitForSingleObject(*thread, INFINITE) == WAIT_FAILED)
+		return -1;
+	return (CloseHandle(*thread) == 0 ? -1 : 0);
+#else
+	return pthread_join(*thread, NULL);
+#endif
+}
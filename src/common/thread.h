@@ -0,0 +1,60 @@
+/**
+ * CT-API for CCID Driver
+ *
+ * Copyright (c) 2016, CardContact Systems GmbH, Minden, Germany
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of CardContact Systems GmbH nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CardContact Systems GmbH BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file thread.h
+ * @brief Defines procedures for cross platform thread and condition handling
+ */
+
+#ifndef _THREAD_H_
+#define _THREAD_H_
+
+#include "mutex.h"
+
+#ifdef _WIN32
+typedef struct {
+	HANDLE sema;
+	long waiters;
+} COND;
+#define THREAD HANDLE
+#else
+#define COND pthread_cond_t
+#define THREAD pthread_t
+#endif
+
+typedef void *(*thread_func_t)(void *arg);
+
+int cond_init(COND *cond);
+int cond_wait(COND *cond, MUTEX *mutex);
+int cond_signal(COND *cond);
+int cond_broadcast(COND *cond);
+int cond_destroy(COND *cond);
+
+int thread_create(THREAD *thread, thread_func_t func, void *arg);
+int thread_join(THREAD *thread);
+
+#endif
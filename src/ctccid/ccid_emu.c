@@ -0,0 +1,930 @@
+/**
+ * CT-API for CCID Driver
+ *
+ * Copyright (c) 2016, CardContact Systems GmbH, Minden, Germany
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of CardContact Systems GmbH nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CardContact Systems GmbH BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file ccid_emu.c
+ * @brief In-memory emulation of a CCID reader with an inserted card
+ *
+ * The emulator implements the usb_backend_t interface and answers the CCID
+ * messages PC_to_RDR_IccPowerOn, IccPowerOff, GetSlotStatus, SetParameters
+ * and XfrBlock. For TPDU readers the card side of the T=1 protocol is emulated,
+ * including chaining in both directions, S-block handling and error recovery.
+ * Faults and timing can be injected to exercise ccidT1.c without hardware.
+ */
+
+#ifndef WIN32
+#include <unistd.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <common/mutex.h>
+
+#include "ccid_emu.h"
+#include "ccid_usb.h"
+#include "ccidT1.h"
+#include "usb_device.h"
+
+#ifdef DEBUG
+#include "ctccid_debug.h"
+#endif
+
+/**
+ * Maximum size of an extended length command or response APDU
+ */
+#define EMU_MAX_APDU	(4 + 3 + 65536 + 2)
+
+/**
+ * Size of a CCID message header
+ */
+#define CCID_HEADER		10
+
+/**
+ * State of an emulated reader and the inserted card
+ */
+typedef struct ccidEmuDevice {
+	/** Port number                              */
+	unsigned short    pn;
+	/** ICC status reported in bmICCStatus       */
+	int               iccStatus;
+	/** CCID class descriptor                    */
+	unsigned char     descriptor[54];
+
+	/** Pending RDR_to_PC message                */
+	unsigned char     msg[CCID_HEADER + BUFFMAX];
+	/** Length of pending message, 0 if none     */
+	unsigned int      msglen;
+	/** Time extensions to send before pending message */
+	int               pendingTimeExtensions;
+
+	/** Expected N(S) of next host I-block       */
+	int               hostSeq;
+	/** N(S) of next card I-block                */
+	int               cardSeq;
+	/** Maximum INF size for responses           */
+	unsigned char     ifsd;
+	/** Last T=1 block sent for retransmission   */
+	unsigned char     lastBlock[BUFFMAX];
+	/** Length of last block                     */
+	unsigned int      lastBlockLen;
+	/** S(WTX request) sent, waiting for response */
+	int               wtxPending;
+
+	/** Command APDU assembled from chained blocks */
+	unsigned char     apdu[EMU_MAX_APDU];
+	/** Length of assembled command APDU         */
+	unsigned int      apdulen;
+	/** Response APDU                            */
+	unsigned char     resp[EMU_MAX_APDU];
+	/** Length of response APDU                  */
+	unsigned int      resplen;
+	/** Offset of next response fragment         */
+	unsigned int      respofs;
+	/** Response fragments remain to be sent     */
+	int               respPending;
+
+	/** Counter of blocks sent, for EDC errors   */
+	unsigned int      blockCounter;
+	/** Counter of responses, for WTX and sequence errors */
+	unsigned int      responseCounter;
+	/** Next entry in script                     */
+	unsigned int      scriptIndex;
+	/** State of the pseudo random generator     */
+	unsigned long     prng;
+} ccidEmuDevice_t;
+
+
+
+static ccidEmuConfig_t emuConfig;
+static ccidEmuStatistics_t emuStatistics;
+static MUTEX emuMutex;
+static int emuMutexInitialized = 0;
+
+static const unsigned char defaultATR[] = {
+	0x3B,0xFE,0x18,0x00,0x00,0x81,0x31,0xFE,0x45,0x80,0x31,0x81,
+	0x54,0x48,0x53,0x4D,0x31,0x73,0x80,0x21,0x40,0x81,0x07,0xFA
+};
+
+
+
+/*
+ * Add to a statistic counter
+ */
+#define COUNT(field, n) do { \
+	mutex_lock(&emuMutex); \
+	emuStatistics.field += (n); \
+	mutex_unlock(&emuMutex); \
+	} while (0)
+
+
+
+static void delay(unsigned int us)
+{
+	if (us > 0) {
+		usleep(us);
+	}
+}
+
+
+
+/**
+ * Prepare a RDR_to_PC message to be returned with the next read
+ */
+static void setMessage(ccidEmuDevice_t *dev, unsigned char type,
+					   const unsigned char *data, unsigned int len,
+					   unsigned char status, unsigned char error, unsigned char param)
+{
+	unsigned char *msg = dev->msg;
+
+	msg[0] = type;
+	msg[1] = len & 0xFF;
+	msg[2] = (len >> 8) & 0xFF;
+	msg[3] = (len >> 16) & 0xFF;
+	msg[4] = (len >> 24) & 0xFF;
+	msg[5] = 0x00;		/* Slot */
+	msg[6] = 0x00;		/* Sequence */
+	msg[7] = status;
+	msg[8] = error;
+	msg[9] = param;
+
+	if (len > 0) {
+		memcpy(msg + CCID_HEADER, data, len);
+	}
+
+	dev->msglen = CCID_HEADER + len;
+	dev->pendingTimeExtensions = 0;
+}
+
+
+
+/**
+ * Determine Ne from the Le field of a command APDU
+ */
+static unsigned int decodeNe(unsigned char *apdu, unsigned int len)
+{
+	unsigned int lc, ne;
+
+	if (len <= 4) {
+		return 0;
+	}
+
+	if (len == 5) {
+		return apdu[4] ? apdu[4] : 256;
+	}
+
+	if (apdu[4]) {							/* Short Lc */
+		lc = apdu[4];
+		if (len == 6 + lc) {
+			return apdu[5 + lc] ? apdu[5 + lc] : 256;
+		}
+		return 0;
+	}
+
+	if (len == 7) {							/* Extended Le only */
+		ne = (apdu[5] << 8) | apdu[6];
+		return ne ? ne : 65536;
+	}
+
+	lc = (apdu[5] << 8) | apdu[6];
+
+	if (len == 9 + lc) {
+		ne = (apdu[7 + lc] << 8) | apdu[8 + lc];
+		return ne ? ne : 65536;
+	}
+
+	return 0;
+}
+
+
+
+/**
+ * Built-in card that answers GET CHALLENGE and READ BINARY with data and everything else with 9000
+ */
+static void defaultCard(ccidEmuDevice_t *dev, unsigned int lc, unsigned char *cmd, unsigned int *lr, unsigned char *rsp)
+{
+	unsigned int ne, i;
+
+	ne = decodeNe(cmd, lc);
+
+	if (ne > *lr - 2) {
+		ne = *lr - 2;
+	}
+
+	switch(cmd[1]) {
+	case 0x84:			/* GET CHALLENGE */
+		for (i = 0; i < ne; i++) {
+			dev->prng = dev->prng * 1103515245 + 12345;
+			rsp[i] = (unsigned char)(dev->prng >> 16);
+		}
+		break;
+	case 0xB0:			/* READ BINARY */
+	case 0xB1:
+		for (i = 0; i < ne; i++) {
+			rsp[i] = (unsigned char)i;
+		}
+		break;
+	default:
+		ne = 0;
+		break;
+	}
+
+	rsp[ne] = 0x90;
+	rsp[ne + 1] = 0x00;
+	*lr = ne + 2;
+}
+
+
+
+/**
+ * Replay the next entry from the script
+ */
+static void scriptedCard(ccidEmuDevice_t *dev, unsigned int lc, unsigned char *cmd, unsigned int *lr, unsigned char *rsp)
+{
+	const ccidEmuScriptEntry_t *entry;
+
+	entry = emuConfig.script + dev->scriptIndex;
+
+	if ((lc < entry->cmdlen) || memcmp(cmd, entry->cmd, entry->cmdlen) || (entry->rsplen > *lr)) {
+#ifdef DEBUG
+		ctccid_debug("Emulator: Command does not match script entry %d\n", dev->scriptIndex);
+#endif
+		COUNT(scriptMismatches, 1);
+		rsp[0] = 0x6F;
+		rsp[1] = 0x00;
+		*lr = 2;
+		return;
+	}
+
+	memcpy(rsp, entry->rsp, entry->rsplen);
+	*lr = entry->rsplen;
+
+	dev->scriptIndex = (dev->scriptIndex + 1) % emuConfig.scriptLength;
+}
+
+
+
+/**
+ * Process the command APDU assembled in dev->apdu and store the response in dev->resp
+ */
+static void processAPDU(ccidEmuDevice_t *dev)
+{
+	unsigned int lr;
+	int rc;
+
+	COUNT(apdus, 1);
+	delay(emuConfig.processingTime);
+
+	lr = sizeof(dev->resp);
+
+	if (dev->apdulen < 4) {
+		dev->resp[0] = 0x67;
+		dev->resp[1] = 0x00;
+		lr = 2;
+	} else if (emuConfig.card) {
+		rc = (*emuConfig.card)(emuConfig.cardContext, dev->apdulen, dev->apdu, &lr, dev->resp);
+		if ((rc < 0) || (lr < 2)) {
+			dev->resp[0] = 0x6F;
+			dev->resp[1] = 0x00;
+			lr = 2;
+		}
+	} else if (emuConfig.script && emuConfig.scriptLength) {
+		scriptedCard(dev, dev->apdulen, dev->apdu, &lr, dev->resp);
+	} else {
+		defaultCard(dev, dev->apdulen, dev->apdu, &lr, dev->resp);
+	}
+
+	dev->resplen = lr;
+	dev->respofs = 0;
+	dev->apdulen = 0;
+}
+
+
+
+/**
+ * Send a T=1 block to the host, optionally corrupting the EDC
+ */
+static void sendBlock(ccidEmuDevice_t *dev, unsigned char pcb, unsigned char *inf, unsigned int len)
+{
+	unsigned char block[BUFFMAX];
+	unsigned char lrc;
+	unsigned int i;
+
+	block[0] = CODENAD(0, 0);
+	block[1] = pcb;
+	block[2] = (unsigned char)len;
+	if (len > 0) {
+		memcpy(block + 3, inf, len);
+	}
+
+	lrc = 0;
+	for (i = 0; i < len + 3; i++) {
+		lrc ^= block[i];
+	}
+	block[len + 3] = lrc;
+
+	memcpy(dev->lastBlock, block, len + 4);
+	dev->lastBlockLen = len + 4;
+
+	dev->blockCounter++;
+	if (emuConfig.edcErrorInterval && !(dev->blockCounter % emuConfig.edcErrorInterval)) {
+		block[len + 3] ^= 0xFF;
+	}
+
+	COUNT(blocksSent, 1);
+	setMessage(dev, MSG_TYPE_RDR_to_PC_DataBlock, block, len + 4, 0x00, 0x00, 0x00);
+}
+
+
+
+/**
+ * Send the last block again
+ */
+static void resendBlock(ccidEmuDevice_t *dev)
+{
+	unsigned char block[BUFFMAX];
+	unsigned int len;
+
+	len = dev->lastBlockLen;
+	memcpy(block, dev->lastBlock, len);
+
+	COUNT(retransmissions, 1);
+	sendBlock(dev, block[1], block + 3, block[2]);
+}
+
+
+
+/**
+ * Send the next fragment of the response APDU as I-block
+ */
+static void sendResponseBlock(ccidEmuDevice_t *dev)
+{
+	unsigned int len;
+	int more, ns;
+
+	len = dev->resplen - dev->respofs;
+	if (len > dev->ifsd) {
+		len = dev->ifsd;
+	}
+
+	more = (dev->respofs + len) < dev->resplen;
+
+	ns = dev->cardSeq;
+	if (!dev->respofs && emuConfig.sequenceErrorInterval && !(dev->responseCounter % emuConfig.sequenceErrorInterval)) {
+		ns = 1 - ns;
+	}
+
+	sendBlock(dev, CODEIBLOCK(ns, more), dev->resp + dev->respofs, len);
+
+	dev->cardSeq = 1 - dev->cardSeq;
+	dev->respofs += len;
+	dev->respPending = more;
+}
+
+
+
+/**
+ * Emulate the card side of the T=1 protocol for a block received from the host
+ */
+static void processTPDU(ccidEmuDevice_t *dev, unsigned char *block, unsigned int len)
+{
+	unsigned char pcb, lrc, *inf;
+	unsigned int i, inflen;
+
+	COUNT(blocksReceived, 1);
+	delay(emuConfig.byteTime * len);
+
+	lrc = 0;
+	for (i = 0; i < len; i++) {
+		lrc ^= block[i];
+	}
+
+	if ((len < 4) || (block[2] + 4 != len) || lrc) {
+		sendBlock(dev, CODERBLOCK(dev->hostSeq, RERR_EDC), NULL, 0);
+		return;
+	}
+
+	pcb = block[1];
+	inflen = block[2];
+	inf = block + 3;
+
+	if (ISIBLOCK(pcb)) {
+		if (NS(pcb) != dev->hostSeq) {		/* Host repeated a block we acknowledged */
+			resendBlock(dev);
+			return;
+		}
+
+		if (dev->apdulen + inflen > sizeof(dev->apdu)) {
+			sendBlock(dev, CODERBLOCK(dev->hostSeq, RERR_OTHER), NULL, 0);
+			return;
+		}
+
+		memcpy(dev->apdu + dev->apdulen, inf, inflen);
+		dev->apdulen += inflen;
+		dev->hostSeq = 1 - dev->hostSeq;
+		dev->respPending = 0;
+
+		if (MORE(pcb)) {
+			sendBlock(dev, CODERBLOCK(dev->hostSeq, RERR_NONE), NULL, 0);
+			return;
+		}
+
+		processAPDU(dev);
+		dev->responseCounter++;
+
+		if (emuConfig.wtxInterval && !(dev->responseCounter % emuConfig.wtxInterval)) {
+			COUNT(wtxRequests, 1);
+			dev->wtxPending = 1;
+			sendBlock(dev, CODESBLOCK(WTXREQ), &emuConfig.wtxMultiplier, 1);
+			return;
+		}
+
+		sendResponseBlock(dev);
+		return;
+	}
+
+	if (ISRBLOCK(pcb)) {
+		if (!RERR(pcb) && dev->respPending && (NR(pcb) == dev->cardSeq)) {
+			sendResponseBlock(dev);		/* Host acknowledged fragment */
+		} else {
+			resendBlock(dev);
+		}
+		return;
+	}
+
+	switch(SBLOCKFUNC(pcb)) {
+	case RESYNCHREQ:
+		COUNT(resyncs, 1);
+		dev->hostSeq = 0;
+		dev->cardSeq = 0;
+		dev->apdulen = 0;
+		dev->respPending = 0;
+		dev->wtxPending = 0;
+		dev->ifsd = emuConfig.ifsd;
+		sendBlock(dev, CODESBLOCK(RESYNCHRES), NULL, 0);
+		break;
+	case IFSREQ:
+		if (inflen == 1) {
+			dev->ifsd = inf[0];
+		}
+		sendBlock(dev, CODESBLOCK(IFSRES), inf, inflen);
+		break;
+	case ABORTREQ:
+		dev->apdulen = 0;
+		dev->respPending = 0;
+		sendBlock(dev, CODESBLOCK(ABORTRES), NULL, 0);
+		break;
+	case WTXRES:
+		if (dev->wtxPending) {
+			dev->wtxPending = 0;
+			sendResponseBlock(dev);
+		} else {
+			resendBlock(dev);
+		}
+		break;
+	default:
+		sendBlock(dev, CODERBLOCK(dev->hostSeq, RERR_OTHER), NULL, 0);
+		break;
+	}
+}
+
+
+
+/**
+ * Send the next fragment of the response APDU for an APDU level reader
+ */
+static void sendResponseFragment(ccidEmuDevice_t *dev)
+{
+	unsigned int len;
+	unsigned char chain;
+	int first, more;
+
+	len = dev->resplen - dev->respofs;
+	if (len > BUFFMAX) {
+		len = BUFFMAX;
+	}
+
+	first = dev->respofs == 0;
+	more = (dev->respofs + len) < dev->resplen;
+
+	if (first) {
+		chain = more ? 1 : 0;
+	} else {
+		chain = more ? 3 : 2;
+	}
+
+	setMessage(dev, MSG_TYPE_RDR_to_PC_DataBlock, dev->resp + dev->respofs, len, 0x00, 0x00, chain);
+
+	dev->respofs += len;
+	dev->respPending = more;
+}
+
+
+
+/**
+ * Emulate short and extended APDU exchange for a XfrBlock message
+ */
+static void processXfrAPDU(ccidEmuDevice_t *dev, unsigned short level, unsigned char *data, unsigned int len)
+{
+	if (level == 0x10) {
+		if (dev->respPending) {
+			sendResponseFragment(dev);
+		} else {
+			setMessage(dev, MSG_TYPE_RDR_to_PC_DataBlock, NULL, 0, 0x40, ERR_XFR_OVERRUN, 0x00);
+		}
+		return;
+	}
+
+	if ((level == 0) || (level == 1)) {
+		dev->apdulen = 0;
+	}
+
+	if (dev->apdulen + len > sizeof(dev->apdu)) {
+		dev->apdulen = 0;
+		setMessage(dev, MSG_TYPE_RDR_to_PC_DataBlock, NULL, 0, 0x40, ERR_XFR_OVERRUN, 0x00);
+		return;
+	}
+
+	memcpy(dev->apdu + dev->apdulen, data, len);
+	dev->apdulen += len;
+
+	if ((level == 1) || (level == 3)) {
+		setMessage(dev, MSG_TYPE_RDR_to_PC_DataBlock, NULL, 0, 0x00, 0x00, 0x10);
+		return;
+	}
+
+	processAPDU(dev);
+	sendResponseFragment(dev);
+}
+
+
+
+/**
+ * Process a PC_to_RDR message
+ */
+static int processMessage(ccidEmuDevice_t *dev, unsigned char *msg, unsigned int len)
+{
+	unsigned int datalen;
+	unsigned char iccStatus;
+
+	if (len < CCID_HEADER) {
+		return ERR_USB;
+	}
+
+	datalen = msg[1] | (msg[2] << 8) | (msg[3] << 16) | (msg[4] << 24);
+
+	if (datalen != len - CCID_HEADER) {
+		return ERR_USB;
+	}
+
+	iccStatus = (unsigned char)dev->iccStatus;
+
+	switch(msg[0]) {
+	case MSG_TYPE_PC_to_RDR_IccPowerOn:
+		if (dev->iccStatus == NO_ICC_PRESENT) {
+			setMessage(dev, MSG_TYPE_RDR_to_PC_DataBlock, NULL, 0, 0x40 | iccStatus, ERR_ICC_MUTE, 0x00);
+			break;
+		}
+		dev->iccStatus = ICC_PRESENT_AND_ACTIVE;
+		dev->hostSeq = 0;
+		dev->cardSeq = 0;
+		dev->apdulen = 0;
+		dev->respPending = 0;
+		dev->wtxPending = 0;
+		dev->lastBlockLen = 0;
+		dev->ifsd = emuConfig.ifsd;
+		setMessage(dev, MSG_TYPE_RDR_to_PC_DataBlock, emuConfig.atr, emuConfig.atrlen, ICC_PRESENT_AND_ACTIVE, 0x00, 0x00);
+		break;
+
+	case MSG_TYPE_PC_to_RDR_IccPowerOff:
+		if (dev->iccStatus != NO_ICC_PRESENT) {
+			dev->iccStatus = ICC_PRESENT_AND_INACTIVE;
+		}
+		setMessage(dev, MSG_TYPE_RDR_to_PC_SlotStatus, NULL, 0, (unsigned char)dev->iccStatus, 0x00, 0x00);
+		break;
+
+	case MSG_TYPE_PC_to_RDR_GetSlotStatus:
+		setMessage(dev, MSG_TYPE_RDR_to_PC_SlotStatus, NULL, 0, iccStatus, 0x00, 0x00);
+		break;
+
+	case MSG_TYPE_PC_to_RDR_SetParameters:
+		setMessage(dev, MSG_TYPE_RDR_to_PC_Parameters, msg + CCID_HEADER, datalen, iccStatus, 0x00, msg[7]);
+		break;
+
+	case MSG_TYPE_PC_to_RDR_XfrBlock:
+		if (dev->iccStatus != ICC_PRESENT_AND_ACTIVE) {
+			setMessage(dev, MSG_TYPE_RDR_to_PC_DataBlock, NULL, 0, 0x40 | iccStatus, ERR_ICC_MUTE, 0x00);
+			break;
+		}
+		if (emuConfig.apduLevel) {
+			processXfrAPDU(dev, msg[8] | (msg[9] << 8), msg + CCID_HEADER, datalen);
+		} else {
+			processTPDU(dev, msg + CCID_HEADER, datalen);
+		}
+		dev->pendingTimeExtensions = emuConfig.timeExtensions;	/* Only the data block response is extended */
+		break;
+
+	default:
+		setMessage(dev, MSG_TYPE_RDR_to_PC_SlotStatus, NULL, 0, 0x40 | iccStatus, 0x00, 0x00);	/* Command not supported */
+		break;
+	}
+
+	return USB_OK;
+}
+
+
+
+static int emuOpen(unsigned short pn, usb_device_t **device)
+{
+	ccidEmuDevice_t *dev;
+
+	if (pn >= emuConfig.readers) {
+		return ERR_NO_READER;
+	}
+
+	*device = calloc(1, sizeof(usb_device_t));
+	dev = calloc(1, sizeof(ccidEmuDevice_t));
+
+	if (!*device || !dev) {
+		free(*device);
+		free(dev);
+		return ERR_USB;
+	}
+
+	dev->pn = pn;
+	dev->iccStatus = emuConfig.cardAbsent ? NO_ICC_PRESENT : ICC_PRESENT_AND_INACTIVE;
+	dev->ifsd = emuConfig.ifsd;
+	dev->prng = pn + 1;
+
+	dev->descriptor[0] = sizeof(dev->descriptor);	/* bLength */
+	dev->descriptor[1] = 0x21;						/* bDescriptorType */
+	dev->descriptor[42] = emuConfig.apduLevel ? 0x04 : 0x01;	/* dwFeatures: APDU or TPDU level exchange */
+
+	(*device)->privateData = dev;
+
+#ifdef DEBUG
+	ctccid_debug("Emulator: Opened reader at port %d\n", pn);
+#endif
+	return USB_OK;
+}
+
+
+
+static int emuClose(usb_device_t **device)
+{
+	free((*device)->privateData);
+	free(*device);
+	*device = NULL;
+	return USB_OK;
+}
+
+
+
+static int emuListPorts(unsigned short *ports, int *count)
+{
+	int i;
+
+	if (ports) {
+		for (i = 0; (i < *count) && (i < emuConfig.readers); i++) {
+			ports[i] = i;
+		}
+	}
+
+	i = *count;
+	*count = emuConfig.readers;
+
+	return (ports && (i < emuConfig.readers)) ? ERR_NO_READER : USB_OK;
+}
+
+
+
+static void emuGetCCIDDescriptor(usb_device_t *device, unsigned char const **desc, int *length)
+{
+	ccidEmuDevice_t *dev = (ccidEmuDevice_t *)device->privateData;
+
+	if (length)
+		*length = sizeof(dev->descriptor);
+	if (desc)
+		*desc = dev->descriptor;
+}
+
+
+
+static int emuWrite(usb_device_t *device, unsigned int length, unsigned char *buffer)
+{
+	ccidEmuDevice_t *dev = (ccidEmuDevice_t *)device->privateData;
+
+	delay(emuConfig.usbLatency);
+
+	if (dev->pn >= emuConfig.readers) {		/* Reader detached */
+		return ERR_USB;
+	}
+
+	mutex_lock(&emuMutex);
+	emuStatistics.usbTransfers++;
+	emuStatistics.bytesWritten += length;
+	mutex_unlock(&emuMutex);
+
+	dev->msglen = 0;
+	return processMessage(dev, buffer, length);
+}
+
+
+
+static int emuRead(usb_device_t *device, unsigned int *length, unsigned char *buffer)
+{
+	ccidEmuDevice_t *dev = (ccidEmuDevice_t *)device->privateData;
+	unsigned int len;
+
+	delay(emuConfig.usbLatency);
+
+	if ((dev->pn >= emuConfig.readers) || !dev->msglen) {	/* Reader detached or nothing to read, the reader would time out */
+		*length = 0;
+		return ERR_USB;
+	}
+
+	if (dev->pendingTimeExtensions > 0) {
+		dev->pendingTimeExtensions--;
+		if (*length < CCID_HEADER) {
+			*length = 0;
+			return ERR_USB;
+		}
+		memcpy(buffer, dev->msg, CCID_HEADER);
+		memset(buffer + 1, 0, 4);
+		buffer[7] = 0x80 | (dev->msg[7] & ICC_STATUS_MASK);
+		buffer[8] = 0x01;
+		buffer[9] = 0x00;
+		*length = CCID_HEADER;
+		COUNT(timeExtensions, 1);
+		return USB_OK;
+	}
+
+	len = dev->msglen;
+
+	if (len > *length) {
+		*length = 0;
+		return ERR_USB;
+	}
+
+	if (dev->msg[0] == MSG_TYPE_RDR_to_PC_DataBlock) {
+		delay(emuConfig.byteTime * (len - CCID_HEADER));
+	}
+
+	memcpy(buffer, dev->msg, len);
+	*length = len;
+	dev->msglen = 0;
+
+	mutex_lock(&emuMutex);
+	emuStatistics.usbTransfers++;
+	emuStatistics.bytesRead += len;
+	mutex_unlock(&emuMutex);
+
+	return USB_OK;
+}
+
+
+
+static const usb_backend_t emuBackend = {
+	"emulator",
+	emuOpen,
+	emuClose,
+	emuListPorts,
+	emuGetCCIDDescriptor,
+	emuWrite,
+	emuRead
+};
+
+
+
+/**
+ * Install the emulator as USB backend for all readers opened with CT_init() thereafter
+ *
+ * The script and card context referenced by the configuration must remain valid
+ * until all emulated readers are closed.
+ *
+ * @param config Configuration of readers and cards or NULL for defaults
+ * @return 0 on success, -1 on error
+ */
+int ccidEmuEnable(const ccidEmuConfig_t *config)
+{
+	if (!emuMutexInitialized) {
+		if (mutex_init(&emuMutex) != 0) {
+			return -1;
+		}
+		emuMutexInitialized = 1;
+	}
+
+	if (config) {
+		emuConfig = *config;
+	} else {
+		memset(&emuConfig, 0, sizeof(emuConfig));
+	}
+
+	if (emuConfig.readers <= 0) {
+		emuConfig.readers = 1;
+	}
+
+	if (!emuConfig.atr || !emuConfig.atrlen || (emuConfig.atrlen > BUFFMAX)) {
+		emuConfig.atr = defaultATR;
+		emuConfig.atrlen = sizeof(defaultATR);
+	}
+
+	if (!emuConfig.ifsd) {
+		emuConfig.ifsd = 32;
+	}
+
+	if (emuConfig.ifsd > 254) {
+		emuConfig.ifsd = 254;
+	}
+
+	if (!emuConfig.wtxMultiplier) {
+		emuConfig.wtxMultiplier = 1;
+	}
+
+	ccidEmuResetStatistics();
+	USB_SetBackend(&emuBackend);
+	return 0;
+}
+
+
+
+/**
+ * Emulate attaching or detaching readers
+ *
+ * Readers at ports beyond the new number fail all further transfers.
+ *
+ * @param readers Number of attached readers
+ */
+void ccidEmuSetReaders(int readers)
+{
+	emuConfig.readers = readers;
+}
+
+
+
+/**
+ * Restore the libusb backend for readers opened thereafter
+ */
+void ccidEmuDisable()
+{
+	if (USB_GetBackend() == &emuBackend) {
+		USB_SetBackend(NULL);
+	}
+}
+
+
+
+/**
+ * Return the counters collected since the emulator was enabled or reset
+ *
+ * @param stats Structure receiving the counters
+ */
+void ccidEmuGetStatistics(ccidEmuStatistics_t *stats)
+{
+	if (!emuMutexInitialized) {
+		memset(stats, 0, sizeof(*stats));
+		return;
+	}
+	mutex_lock(&emuMutex);
+	*stats = emuStatistics;
+	mutex_unlock(&emuMutex);
+}
+
+
+
+/**
+ * Reset all counters to zero
+ */
+void ccidEmuResetStatistics()
+{
+	if (!emuMutexInitialized) {
+		return;
+	}
+	mutex_lock(&emuMutex);
+	memset(&emuStatistics, 0, sizeof(emuStatistics));
+	mutex_unlock(&emuMutex);
+}
@@ -0,0 +1,154 @@
+/**
+ * CT-API for CCID Driver
+ *
+ * Copyright (c) 2016, CardContact Systems GmbH, Minden, Germany
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of CardContact Systems GmbH nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CardContact Systems GmbH BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file ccid_emu.h
+ * @brief In-memory emulation of a CCID reader with an inserted card
+ */
+
+#ifndef _CCID_EMU_H_
+#define _CCID_EMU_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Card function called by the emulator for each complete command APDU
+ *
+ * @param context Opaque pointer passed in ccidEmuConfig_t.cardContext
+ * @param lc Length of command APDU
+ * @param cmd Command APDU
+ * @param lr Size of response buffer on input, length of response APDU on output
+ * @param rsp Response APDU including SW1/SW2
+ * @return 0 on success, negative value to let the card answer 6F00
+ */
+typedef int (*ccidEmuCardFunc_t) (void *context,
+								  unsigned int lc,
+								  unsigned char *cmd,
+								  unsigned int *lr,
+								  unsigned char *rsp);
+
+/**
+ * Entry of a scripted card session
+ */
+typedef struct ccidEmuScriptEntry {
+	/** Expected command APDU or a prefix thereof */
+	const unsigned char *cmd;
+	/** Length of expected command or prefix   */
+	unsigned int         cmdlen;
+	/** Response APDU including SW1/SW2         */
+	const unsigned char *rsp;
+	/** Length of response APDU                 */
+	unsigned int         rsplen;
+} ccidEmuScriptEntry_t;
+
+/**
+ * Configuration of the emulated readers and cards
+ *
+ * All values default to zero. A zeroed configuration emulates a single
+ * TPDU reader with a SmartCard-HSM like card that answers GET CHALLENGE
+ * and READ BINARY with data and all other commands with 9000.
+ */
+typedef struct ccidEmuConfig {
+	/** Number of emulated readers at port 0 .. n - 1, default 1 */
+	int                  readers;
+	/** Emulate empty slots                                      */
+	int                  cardAbsent;
+	/** ATR returned on power on, default SmartCard-HSM ATR      */
+	const unsigned char *atr;
+	/** Length of ATR                                            */
+	unsigned int         atrlen;
+	/** Emulate a reader with short and extended APDU exchange   */
+	int                  apduLevel;
+	/** Maximum INF field size the card uses for responses, default 32 */
+	unsigned char        ifsd;
+	/** Number of CCID time extension messages before each response */
+	int                  timeExtensions;
+	/** Send S(WTX request) before every n-th response APDU, 0 = never */
+	int                  wtxInterval;
+	/** Multiplier requested in S(WTX request), default 1        */
+	unsigned char        wtxMultiplier;
+	/** Corrupt the EDC of every n-th T=1 block sent by the card, 0 = never */
+	int                  edcErrorInterval;
+	/** Send every n-th response (n > 1) with a wrong N(S), forcing a resynchronisation */
+	int                  sequenceErrorInterval;
+	/** Delay for each USB transfer in microseconds              */
+	unsigned int         usbLatency;
+	/** Transmission time per byte on the card interface in microseconds */
+	unsigned int         byteTime;
+	/** Card processing time per APDU in microseconds            */
+	unsigned int         processingTime;
+	/** Card function processing command APDUs                   */
+	ccidEmuCardFunc_t    card;
+	/** Context passed to the card function                      */
+	void                *cardContext;
+	/** Scripted session replayed if no card function is defined */
+	const ccidEmuScriptEntry_t *script;
+	/** Number of entries in script                              */
+	unsigned int         scriptLength;
+} ccidEmuConfig_t;
+
+/**
+ * Counters collected by the emulator across all emulated readers
+ */
+typedef struct ccidEmuStatistics {
+	/** Number of USB bulk transfers in both directions   */
+	unsigned long usbTransfers;
+	/** Number of bytes written to the readers            */
+	unsigned long bytesWritten;
+	/** Number of bytes read from the readers             */
+	unsigned long bytesRead;
+	/** Number of command APDUs processed by the cards    */
+	unsigned long apdus;
+	/** Number of T=1 blocks received by the cards        */
+	unsigned long blocksReceived;
+	/** Number of T=1 blocks sent by the cards            */
+	unsigned long blocksSent;
+	/** Number of T=1 blocks sent again on request        */
+	unsigned long retransmissions;
+	/** Number of S(WTX request) blocks sent              */
+	unsigned long wtxRequests;
+	/** Number of CCID time extension messages sent       */
+	unsigned long timeExtensions;
+	/** Number of S(RESYNCH request) blocks received      */
+	unsigned long resyncs;
+	/** Number of commands not matching the script        */
+	unsigned long scriptMismatches;
+} ccidEmuStatistics_t;
+
+int ccidEmuEnable(const ccidEmuConfig_t *config);
+void ccidEmuSetReaders(int readers);
+void ccidEmuDisable();
+void ccidEmuGetStatistics(ccidEmuStatistics_t *stats);
+void ccidEmuResetStatistics();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -44,26 +44,164 @@ extern int ccidT1Term (struct scr *ctx);
 static MUTEX globalmutex;
 static int mutexInitialized = 0;
 
-/* Handle up to 8 USB CCID readers */
+/*
+ * Reader contexts indexed by card terminal number. The table grows on demand
+ * and is released when the last reader is closed.
+ */
+static scr_t **readerTable = NULL;
+static int readerTableSize = 0;
+static int numberOfReaders = 0;
+
+
+
+/*
+ * Create the global mutex on first use
+ */
+static int acquireGlobalMutex()
+{
+	if (!mutexInitialized) {
+		if (mutex_init(&globalmutex) != 0) {
+			return -1;
+		}
+	}
+
+	mutexInitialized++;
+	return 0;
+}
+
+
+
+/*
+ * Destroy the global mutex after last use
+ */
+static void releaseGlobalMutex()
+{
+	mutexInitialized--;
+	if (!mutexInitialized) {
+		mutex_destroy(&globalmutex);
+	}
+}
+
 
-scr_t *readerTable[MAX_READER] = { NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL };
 
 /*
  * Locate matching card terminal number in table of active readers.
- *
+ * Must be called with globalmutex locked.
  */
+static scr_t *LookupReader(unsigned short ctn)
+{
+	return ctn < readerTableSize ? readerTable[ctn] : NULL;
+}
+
 
-static int LookupReader(unsigned short ctn)
+
+/*
+ * Locate the reader for ctn and take a reference, so that CT_close()
+ * does not free it while it is in use
+ */
+static scr_t *AcquireReader(unsigned short ctn)
 {
-	int i;
+	scr_t *ctx;
+
+	if (mutex_lock(&globalmutex) != 0) {
+		return NULL;
+	}
+
+	ctx = LookupReader(ctn);
+
+	if (ctx) {
+		ctx->refs++;
+	}
 
-	for (i = 0; i < MAX_READER; i++) {
-		if (readerTable[i] && (readerTable[i]->ctn == ctn)) {
-			return i;
+	mutex_unlock(&globalmutex);
+	return ctx;
+}
+
+
+
+/*
+ * Terminate the protocol, close the device and free the reader context
+ */
+static void FreeReader(scr_t *ctx)
+{
+	if (ctx->t1) {
+		ccidT1Term(ctx);
+	}
+
+	USB_Close(&ctx->device);
+
+	mutex_destroy(&ctx->mutex);
+
+	free(ctx);
+
+	releaseGlobalMutex();
+}
+
+
+
+/*
+ * Drop a reference and free the reader with the last reference
+ */
+static void ReleaseReader(scr_t *ctx)
+{
+	int refs;
+
+	mutex_lock(&globalmutex);
+	refs = --ctx->refs;
+	mutex_unlock(&globalmutex);
+
+	if (!refs) {
+		FreeReader(ctx);
+	}
+}
+
+
+
+/*
+ * Enter reader context for ctn, growing the table as required
+ */
+static int RegisterReader(unsigned short ctn, scr_t *ctx)
+{
+	scr_t **newTable;
+	int newSize;
+
+	if (ctn >= readerTableSize) {
+		newSize = readerTableSize ? readerTableSize : MAX_READER;
+		while (newSize <= ctn) {
+			newSize <<= 1;
 		}
+
+		newTable = (scr_t **)realloc(readerTable, newSize * sizeof(scr_t *));
+
+		if (!newTable) {
+			return ERR_MEMORY;
+		}
+
+		memset(newTable + readerTableSize, 0, (newSize - readerTableSize) * sizeof(scr_t *));
+		readerTable = newTable;
+		readerTableSize = newSize;
 	}
 
-	return -1;
+	readerTable[ctn] = ctx;
+	numberOfReaders++;
+	return OK;
+}
+
+
+
+/*
+ * Remove reader context for ctn and release the table if empty
+ */
+static void UnregisterReader(unsigned short ctn)
+{
+	readerTable[ctn] = NULL;
+	numberOfReaders--;
+
+	if (!numberOfReaders) {
+		free(readerTable);
+		readerTable = NULL;
+		readerTableSize = 0;
+	}
 }
 
 
@@ -78,49 +216,25 @@ static int LookupReader(unsigned short ctn)
  */
 signed char CT_init(unsigned short ctn, unsigned short pn)
 {
-	int rc, indx;
+	int rc;
 	scr_t *ctx;
 
-	if (!mutexInitialized) {
-		if (mutex_init(&globalmutex) != 0) {
-			return ERR_CT;
-		};
+	if (acquireGlobalMutex() != 0) {
+		return ERR_CT;
 	}
 
-	mutexInitialized++;
-	
 	if (mutex_lock(&globalmutex) != 0) {
+		releaseGlobalMutex();
 		return ERR_CT;
 	}
 
-	rc = LookupReader(ctn);
-
-	if (rc < 0) {
-
-		/*
-		 * Determine next free position in reader list
-		 */
-		for (indx = 0; (indx < MAX_READER) && readerTable[indx]; indx++) {
-			;
-		}
-
-		if (indx == MAX_READER) {
-			mutexInitialized--;
-			mutex_unlock(&globalmutex);
-			if (!mutexInitialized) {
-				mutex_destroy(&globalmutex);
-			}
-			return ERR_MEMORY;
-		}
+	if (!LookupReader(ctn)) {
 
 		ctx = (scr_t *)calloc(1, sizeof(scr_t));
 
 		if (!ctx) {
-			mutexInitialized--;
 			mutex_unlock(&globalmutex);
-			if (!mutexInitialized) {
-				mutex_destroy(&globalmutex);
-			}
+			releaseGlobalMutex();
 			return ERR_MEMORY;
 		}
 
@@ -131,33 +245,36 @@ signed char CT_init(unsigned short ctn, unsigned short pn)
 
 		if (rc != USB_OK) {
 			free(ctx);
+			mutex_unlock(&globalmutex);
+			releaseGlobalMutex();
 
 			if (rc == ERR_NO_READER) {
-				mutexInitialized--;
-				mutex_unlock(&globalmutex);
-				if (!mutexInitialized) {
-					mutex_destroy(&globalmutex);
-				}
 				return ERR_CT;
 			} else {
-				mutexInitialized--;
-				mutex_unlock(&globalmutex);
-				if (!mutexInitialized) {
-					mutex_destroy(&globalmutex);
-				}
 				return ERR_HOST; /* USB transmission error */
 			}
 		}
 
 		ctx->ctn = ctn;
 		ctx->pn = pn;
+		ctx->refs = 1;
 
 		if (mutex_init(&ctx->mutex) != 0) {
+			USB_Close(&ctx->device);
 			free(ctx);
+			mutex_unlock(&globalmutex);
+			releaseGlobalMutex();
 			return ERR_CT;
 		}
 
-		readerTable[indx] = ctx;
+		if (RegisterReader(ctn, ctx) != OK) {
+			mutex_destroy(&ctx->mutex);
+			USB_Close(&ctx->device);
+			free(ctx);
+			mutex_unlock(&globalmutex);
+			releaseGlobalMutex();
+			return ERR_MEMORY;
+		}
 	}
 
 	if (mutex_unlock(&globalmutex) != 0) {
@@ -177,49 +294,72 @@ signed char CT_init(unsigned short ctn, unsigned short pn)
  */
 signed char CT_close(unsigned short ctn)
 {
-
-	int rc;
 	scr_t *ctx;
 
-	if (mutex_lock(&globalmutex) != 0) {
+	if (!mutexInitialized) {
 		return ERR_CT;
 	}
 
-	rc = LookupReader(ctn);
-
-	if (rc < 0) {
-		mutex_unlock(&globalmutex);
+	if (mutex_lock(&globalmutex) != 0) {
 		return ERR_CT;
 	}
 
-	ctx = readerTable[rc];
+	ctx = LookupReader(ctn);
 
 	if (!ctx) {
 		mutex_unlock(&globalmutex);
 		return ERR_CT;
 	}
 
-	if (ctx->t1) {
-		ccidT1Term(ctx);
+	/* Further calls no longer find the reader. It is freed by the last pending CT_data */
+	UnregisterReader(ctn);
+
+	if (mutex_unlock(&globalmutex) != 0) {
+		return ERR_CT;
 	}
 
-	USB_Close(&ctx->device);
+	ReleaseReader(ctx);
 
-	mutex_destroy(&ctx->mutex);
+	return OK;
+}
 
-	free(ctx);
-	readerTable[rc] = NULL;
 
-	if (mutex_unlock(&globalmutex) != 0) {
-		return ERR_CT;	
+
+/**
+ * List the port numbers of attached readers
+ *
+ * The list is maintained from hotplug notifications where supported, so calling
+ * CT_init() only for listed ports avoids probing each possible port.
+ *
+ * @param pn Array receiving port numbers or NULL to query the number of ports
+ * @param count Size of array on input, number of attached readers on output
+ * @return Status code \ref OK, \ref ERR_CT, \ref ERR_MEMORY if the array is too small, \ref ERR_HOST
+ */
+signed char CT_list(unsigned short *pn, unsigned short *count)
+{
+	int rc, cnt;
+
+	if (acquireGlobalMutex() != 0) {
+		return ERR_CT;
 	}
 
-	mutexInitialized--;
-	if (!mutexInitialized) {
-		mutex_destroy(&globalmutex);
+	if (mutex_lock(&globalmutex) != 0) {
+		releaseGlobalMutex();
+		return ERR_CT;
 	}
 
-	return OK;
+	cnt = *count;
+	rc = USB_ListPorts(pn, &cnt);
+	*count = cnt;
+
+	mutex_unlock(&globalmutex);
+	releaseGlobalMutex();
+
+	if (rc == ERR_NO_READER) {
+		return ERR_MEMORY;
+	}
+
+	return rc == USB_OK ? OK : ERR_HOST;
 }
 
 
@@ -245,26 +385,26 @@ signed char CT_data(unsigned short ctn, unsigned char *dad, unsigned char *sad,
 	unsigned int ilr;
 	scr_t *ctx;
 
-	rc = LookupReader(ctn);
-
-	if (rc < 0) {
+	if (!mutexInitialized) {
 		return ERR_CT;
 	}
 
-	ctx = readerTable[rc];
+	/* Only wait for this reader, so that a busy reader does not block the others */
+	ctx = AcquireReader(ctn);
 
 	if (!ctx) {
 		return ERR_CT;
 	}
 
-	ilr = (int) *lr; /* Overcome problem with lr size     */
-
-	rc = 0;
-
 	if (mutex_lock(&ctx->mutex) != 0) {
+		ReleaseReader(ctx);
 		return ERR_CT;
 	}
 
+	ilr = (int) *lr; /* Overcome problem with lr size     */
+
+	rc = 0;
+
 	if (*dad == 1) {
 		*sad = 1; /* Source Reader    */
 		*dad = 2; /* Destination Host */
@@ -336,9 +476,11 @@ signed char CT_data(unsigned short ctn, unsigned char *dad, unsigned char *sad,
 	*lr = ilr;
 
 	if (mutex_unlock(&ctx->mutex) != 0) {
-		return ERR_CT;
+		rc = ERR_CT;
 	}
 
+	ReleaseReader(ctx);
+
 	return rc;
 }
 
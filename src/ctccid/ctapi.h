@@ -50,6 +50,11 @@ extern "C" {
 		unsigned short ctn                  /* Number assigned to terminal       */
 	);
 
+	signed char CT_list(
+		unsigned short *pn,                 /* Ports of attached readers         */
+		unsigned short *count               /* Size of pn / number of readers    */
+	);
+
 	signed char CT_data(
 		unsigned short ctn,                /* Number assigned to terminal       */
 		unsigned char  *dad,               /* Destination ADdress               */
@@ -43,7 +43,7 @@
 #include "usb_device.h"
 
 /**
- * Maximum number of readers
+ * Initial size of reader table
  */
 #define MAX_READER  8
 
@@ -79,6 +79,8 @@ struct scr {
 
 	/** Card terminal specific mutex */
 	MUTEX mutex;
+	/** References by the reader table and running CT_data() calls, protected by the global mutex */
+	int refs;
 
 	/** Context structure for USB device */
 	struct usb_device	*device;
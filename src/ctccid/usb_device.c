@@ -37,6 +37,8 @@
 
 #include <libusb-1.0/libusb.h>
 
+#include <common/mutex.h>
+
 #include "usb_device.h"
 
 #ifdef DEBUG
@@ -108,20 +110,230 @@ static libusb_context *context = NULL;
  */
 static int refcnt = 0;
 
+/*
+ * Devices of attached readers indexed by port number. The table is maintained by
+ * hotplug events or, where libusb does not support hotplug, by enumerating the
+ * devices on each call to libusbListPorts().
+ */
+static libusb_device **portTable = NULL;
+static int portTableSize = 0;
+static MUTEX portMutex;
+
+#if defined(LIBUSB_API_VERSION) && (LIBUSB_API_VERSION >= 0x01000102)
+#define HAVE_HOTPLUG
+static int hotplugRegistered = 0;
+static libusb_hotplug_callback_handle hotplugHandle;
+#endif
+
 
 
 /**
- * Open USB device at the specified port and allocate necessary resources
+ * Assign the lowest free port number to the device
  *
- * @param pn Port number
- * @param device Structure holding device specific data
- * @return Status code \ref USB_OK, \ref ERR_NO_READER, \ref ERR_USB
+ * Must be called with portMutex locked.
  */
-int USB_Open(unsigned short pn, usb_device_t **device)
+static int addPort(libusb_device *dev)
+{
+	libusb_device **newTable;
+	int i, newSize;
+
+	for (i = 0; i < portTableSize; i++) {
+		if (portTable[i] == dev) {
+			return i;
+		}
+	}
+
+	for (i = 0; (i < portTableSize) && portTable[i]; i++) {
+		;
+	}
+
+	if (i == portTableSize) {
+		newSize = portTableSize ? portTableSize << 1 : 8;
+		newTable = realloc(portTable, newSize * sizeof(libusb_device *));
+
+		if (!newTable) {
+			return -1;
+		}
+
+		memset(newTable + portTableSize, 0, (newSize - portTableSize) * sizeof(libusb_device *));
+		portTable = newTable;
+		portTableSize = newSize;
+	}
+
+	portTable[i] = libusb_ref_device(dev);
+
+#ifdef DEBUG
+	ctccid_debug("Reader at bus %d address %d assigned to port %d\n", libusb_get_bus_number(dev), libusb_get_device_address(dev), i);
+#endif
+	return i;
+}
+
+
+
+/**
+ * Release the port number of the device
+ *
+ * Must be called with portMutex locked.
+ */
+static void removePort(libusb_device *dev)
+{
+	int i;
+
+	for (i = 0; i < portTableSize; i++) {
+		if (portTable[i] == dev) {
+#ifdef DEBUG
+			ctccid_debug("Reader at port %d removed\n", i);
+#endif
+			libusb_unref_device(portTable[i]);
+			portTable[i] = NULL;
+		}
+	}
+}
+
+
+
+/**
+ * Check if the device is a supported reader
+ */
+static int isReader(libusb_device *dev)
 {
+	struct libusb_device_descriptor desc;
 
-	int rc, cnt, i;
+	if (libusb_get_device_descriptor(dev, &desc) < 0) {
+		return 0;
+	}
+
+#ifdef DEBUG
+	if (desc.idVendor == SCM_VENDOR_ID) {
+		if ((desc.idProduct == SCM_SCR_35XX_DEVICE_ID_1) || (desc.idProduct == SCM_SCR_35XX_DEVICE_ID_2)) {
+			ctccid_debug("Found reader SCR_35XX (%04X:%04X)\n", desc.idVendor, desc.idProduct);
+		}
+
+		if (desc.idProduct == SCM_SCR_3310_DEVICE_ID) {
+			ctccid_debug("Found reader SCR_3310 (%04X:%04X)\n", desc.idVendor, desc.idProduct);
+		}
+	}
+#endif
+
+	return desc.idVendor == SCM_VENDOR_ID;
+}
+
+
+
+#ifdef HAVE_HOTPLUG
+/**
+ * Update port table when a reader is attached or detached
+ */
+static int LIBUSB_CALL hotplugCallback(libusb_context *ctx, libusb_device *dev, libusb_hotplug_event event, void *user_data)
+{
+	mutex_lock(&portMutex);
+
+	if (event == LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED) {
+		if (isReader(dev)) {
+			addPort(dev);
+		}
+	} else {
+		removePort(dev);
+	}
+
+	mutex_unlock(&portMutex);
+	return 0;
+}
+#endif
+
+
+
+/**
+ * Update the port table by enumerating all devices, keeping port numbers of devices still attached
+ */
+static int scanPorts()
+{
 	libusb_device **devs, *dev;
+	int i, j, cnt, found;
+
+	cnt = libusb_get_device_list(context, &devs);
+
+	if (cnt < 0) {
+		return ERR_USB;
+	}
+
+	mutex_lock(&portMutex);
+
+	for (j = 0; j < portTableSize; j++) {
+		if (!portTable[j]) {
+			continue;
+		}
+
+		found = 0;
+		for (i = 0; (dev = devs[i]) != NULL; i++) {
+			if (dev == portTable[j]) {
+				found = 1;
+				break;
+			}
+		}
+
+		if (!found) {
+			removePort(portTable[j]);
+		}
+	}
+
+	for (i = 0; (dev = devs[i]) != NULL; i++) {
+		if (isReader(dev)) {
+			addPort(dev);
+		}
+	}
+
+	mutex_unlock(&portMutex);
+
+	libusb_free_device_list(devs, 1);
+	return USB_OK;
+}
+
+
+
+/**
+ * Bring the port table up-to-date, either by handling pending hotplug events or by enumeration
+ */
+static int updatePorts()
+{
+#ifdef HAVE_HOTPLUG
+	struct timeval tv = { 0, 0 };
+	int rc;
+
+	if (hotplugRegistered) {
+		libusb_handle_events_timeout_completed(context, &tv, NULL);
+		return USB_OK;
+	}
+
+	if (libusb_has_capability(LIBUSB_CAP_HAS_HOTPLUG)) {
+		/* Enumerates attached devices through the callback */
+		rc = libusb_hotplug_register_callback(context,
+				LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED | LIBUSB_HOTPLUG_EVENT_DEVICE_LEFT,
+				LIBUSB_HOTPLUG_ENUMERATE,
+				SCM_VENDOR_ID, LIBUSB_HOTPLUG_MATCH_ANY, LIBUSB_HOTPLUG_MATCH_ANY,
+				hotplugCallback, NULL, &hotplugHandle);
+
+		if (rc == LIBUSB_SUCCESS) {
+			hotplugRegistered = 1;
+			return USB_OK;
+		}
+#ifdef DEBUG
+		ctccid_debug("libusb_hotplug_register_callback failed. rc = %i (%s)\n", rc, libusb_error_to_string(rc));
+#endif
+	}
+#endif
+
+	return scanPorts();
+}
+
+
+
+/**
+ * Create the libusb context if required and increment the reference counter
+ */
+static int acquireContext()
+{
+	int rc;
 
 	/*
 	 * We implement our own context handling to avoid a bug in the default context implementation
@@ -136,173 +348,233 @@ int USB_Open(unsigned short pn, usb_device_t **device)
 #ifdef DEBUG
 			ctccid_debug("libusb_init failed. rc = %i (%s)\n", rc, libusb_error_to_string(rc));
 #endif
+			context = NULL;
 			return ERR_USB;
 		}
-	}
 
-	refcnt++;
+		if (mutex_init(&portMutex) != 0) {
+			libusb_exit(context);
+			context = NULL;
+			return ERR_USB;
+		}
 
 #ifdef DEBUG
-	libusb_set_debug(context, 3);
+		libusb_set_debug(context, 3);
 #endif
+	}
 
-	cnt = libusb_get_device_list(context, &devs);
+	refcnt++;
+	return USB_OK;
+}
 
-	if (cnt < 0) {
-		refcnt--;
-		return ERR_NO_READER;
-	}
 
-	/* Iterate through all devices to find a reader */
-	i = 0;
-	cnt = 0;
 
-	while ((dev = devs[i++]) != NULL ) {
-		struct libusb_device_descriptor desc;
+/**
+ * Decrement the reference counter and release the context and port table if no longer used
+ */
+static void releaseContext()
+{
+	int i;
 
-		rc = libusb_get_device_descriptor(dev, &desc);
+	refcnt--;
 
-		if (rc < 0) {
-			/* error */
-			continue;
+	if (refcnt > 0) {
+		return;
+	}
+
+#ifdef HAVE_HOTPLUG
+	if (hotplugRegistered) {
+		libusb_hotplug_deregister_callback(context, hotplugHandle);
+		hotplugRegistered = 0;
+	}
+#endif
+
+	for (i = 0; i < portTableSize; i++) {
+		if (portTable[i]) {
+			libusb_unref_device(portTable[i]);
 		}
+	}
 
-		if (desc.idVendor == SCM_VENDOR_ID) {
+	free(portTable);
+	portTable = NULL;
+	portTableSize = 0;
 
-#ifdef DEBUG
+	mutex_destroy(&portMutex);
+	libusb_exit(context);
+	context = NULL;
+}
 
-			if ((desc.idProduct == SCM_SCR_35XX_DEVICE_ID_1) || (desc.idProduct == SCM_SCR_35XX_DEVICE_ID_2)) {
-				ctccid_debug("Found reader SCR_35XX (%04X:%04X)\n", desc.idVendor,
-					   desc.idProduct);
-			}
 
-			if (desc.idProduct == SCM_SCR_3310_DEVICE_ID) {
-				ctccid_debug("Found reader SCR_3310 (%04X:%04X)\n", desc.idVendor,
-					   desc.idProduct);
-			}
 
-#endif
+/**
+ * Return the port numbers of all attached readers
+ *
+ * @param ports Array receiving the port numbers or NULL to query the number of ports
+ * @param count Size of array on input, number of ports on output
+ * @return Status code \ref USB_OK, \ref ERR_USB or \ref ERR_NO_READER if the array is too small
+ */
+static int libusbListPorts(unsigned short *ports, int *count)
+{
+	int rc, i, cnt;
 
-			/*
-			 * Found the desired reader?
-			 */
-			if (cnt == pn) {
-#ifdef DEBUG
-				ctccid_debug("Reader index (%i) and requested port number (%i) match.\n", cnt, pn);
-#endif
-				*device = calloc(1, sizeof(usb_device_t));
-				break;
-			} else {
-#ifdef DEBUG
-				ctccid_debug("Reader index (%i) and requested port number (%i) do not match.\n", cnt, pn);
-#endif
+	rc = acquireContext();
+
+	if (rc != USB_OK) {
+		return rc;
+	}
+
+	rc = updatePorts();
+
+	if (rc == USB_OK) {
+		mutex_lock(&portMutex);
+
+		cnt = 0;
+		for (i = 0; i < portTableSize; i++) {
+			if (portTable[i]) {
+				if (ports && (cnt < *count)) {
+					ports[cnt] = i;
+				}
 				cnt++;
 			}
 		}
-	}
 
-	if (dev != NULL ) { /* reader found */
-		rc = libusb_open(dev, &((*device)->handle));
+		mutex_unlock(&portMutex);
 
-		if (rc != LIBUSB_SUCCESS) {
-#ifdef DEBUG
-			ctccid_debug("libusb_open failed. rc = %i (%s)\n", rc, libusb_error_to_string(rc));
-#endif
-			free(*device);
-			libusb_free_device_list(devs, 1);
-			refcnt--;
-			if (refcnt == 0) {
-				libusb_exit(context);
-				context = NULL;
-			}
-			return ERR_USB;
+		if (ports && (cnt > *count)) {
+			rc = ERR_NO_READER;
 		}
 
-		rc = libusb_get_active_config_descriptor(dev, &((*device)->configuration_descriptor));
+		*count = cnt;
+	}
 
-		if (rc != LIBUSB_SUCCESS) {
+	releaseContext();
+	return rc;
+}
+
+
+
+/**
+ * Open USB device at the specified port and allocate necessary resources
+ *
+ * @param pn Port number
+ * @param device Structure holding device specific data
+ * @return Status code \ref USB_OK, \ref ERR_NO_READER, \ref ERR_USB
+ */
+static int libusbOpen(unsigned short pn, usb_device_t **device)
+{
+
+	int rc, i;
+	libusb_device *dev;
+
+	rc = acquireContext();
+
+	if (rc != USB_OK) {
+		return rc;
+	}
+
+	rc = updatePorts();
+
+	if (rc != USB_OK) {
+		releaseContext();
+		return ERR_NO_READER;
+	}
+
+	mutex_lock(&portMutex);
+	dev = (pn < portTableSize) ? portTable[pn] : NULL;
+	if (dev) {
+		libusb_ref_device(dev);
+	}
+	mutex_unlock(&portMutex);
+
+	if (dev == NULL) { /* no reader found */
 #ifdef DEBUG
-			ctccid_debug("libusb_get_active_config_descriptor failed. rc = %i (%s)\n", rc, libusb_error_to_string(rc));
+		ctccid_debug("No reader at port %i\n", pn);
 #endif
-			libusb_close((*device)->handle);
-			free(*device);
-			libusb_free_device_list(devs, 1);
-			refcnt--;
-			if (refcnt == 0) {
-				libusb_exit(context);
-				context = NULL;
-			}
-			return ERR_USB;
-		}
+		releaseContext();
+		return ERR_NO_READER;
+	}
 
-		rc = libusb_claim_interface((*device)->handle, (*device)->configuration_descriptor->interface->altsetting->bInterfaceNumber);
+	*device = calloc(1, sizeof(usb_device_t));
 
-		if (rc != LIBUSB_SUCCESS) {
+	if (*device == NULL) {
+		libusb_unref_device(dev);
+		releaseContext();
+		return ERR_USB;
+	}
+
+	rc = libusb_open(dev, &((*device)->handle));
+
+	if (rc != LIBUSB_SUCCESS) {
 #ifdef DEBUG
-			ctccid_debug("libusb_claim_interface failed. rc = %i (%s)\n", rc, libusb_error_to_string(rc));
+		ctccid_debug("libusb_open failed. rc = %i (%s)\n", rc, libusb_error_to_string(rc));
 #endif
-			libusb_close((*device)->handle);
-			free(*device);
-			libusb_free_device_list(devs, 1);
-			refcnt--;
-			if (refcnt == 0) {
-				libusb_exit(context);
-				context = NULL;
-			}
-			return ERR_USB;
-		}
+		free(*device);
+		libusb_unref_device(dev);
+		releaseContext();
+		return ERR_USB;
+	}
 
-		/*
-		 * Search for the bulk in/out endpoints
-		 */
-		for (i = 0; i < (*device)->configuration_descriptor->interface->altsetting->bNumEndpoints; i++) {
+	rc = libusb_get_active_config_descriptor(dev, &((*device)->configuration_descriptor));
+	libusb_unref_device(dev);
 
-			uint8_t bEndpointAddress;
+	if (rc != LIBUSB_SUCCESS) {
+#ifdef DEBUG
+		ctccid_debug("libusb_get_active_config_descriptor failed. rc = %i (%s)\n", rc, libusb_error_to_string(rc));
+#endif
+		libusb_close((*device)->handle);
+		free(*device);
+		releaseContext();
+		return ERR_USB;
+	}
 
-			if ((*device)->configuration_descriptor->interface->altsetting->endpoint[i].bmAttributes
-					== LIBUSB_TRANSFER_TYPE_INTERRUPT) {
-				/*
-				 * Ignore the interrupt endpoint
-				 */
-				continue;
-			}
+	rc = libusb_claim_interface((*device)->handle, (*device)->configuration_descriptor->interface->altsetting->bInterfaceNumber);
 
-			if (((*device)->configuration_descriptor->interface->altsetting->endpoint[i].bmAttributes
-					& LIBUSB_TRANSFER_TYPE_BULK) != LIBUSB_TRANSFER_TYPE_BULK) {
-				/*
-				 * No bulk endpoint - try the next one
-				 */
-				continue;
-			}
+	if (rc != LIBUSB_SUCCESS) {
+#ifdef DEBUG
+		ctccid_debug("libusb_claim_interface failed. rc = %i (%s)\n", rc, libusb_error_to_string(rc));
+#endif
+		libusb_free_config_descriptor((*device)->configuration_descriptor);
+		libusb_close((*device)->handle);
+		free(*device);
+		releaseContext();
+		return ERR_USB;
+	}
 
-			bEndpointAddress = (*device)->configuration_descriptor->interface->altsetting->endpoint[i].bEndpointAddress;
+	/*
+	 * Search for the bulk in/out endpoints
+	 */
+	for (i = 0; i < (*device)->configuration_descriptor->interface->altsetting->bNumEndpoints; i++) {
 
-			if ((bEndpointAddress & LIBUSB_ENDPOINT_DIR_MASK) == LIBUSB_ENDPOINT_IN) {
-				(*device)->bulk_in = bEndpointAddress;
-			}
+		uint8_t bEndpointAddress;
 
-			if ((bEndpointAddress & LIBUSB_ENDPOINT_DIR_MASK) == LIBUSB_ENDPOINT_OUT) {
-				(*device)->bulk_out = bEndpointAddress;
-			}
+		if ((*device)->configuration_descriptor->interface->altsetting->endpoint[i].bmAttributes
+				== LIBUSB_TRANSFER_TYPE_INTERRUPT) {
+			/*
+			 * Ignore the interrupt endpoint
+			 */
+			continue;
 		}
 
-		rc = USB_OK;
+		if (((*device)->configuration_descriptor->interface->altsetting->endpoint[i].bmAttributes
+				& LIBUSB_TRANSFER_TYPE_BULK) != LIBUSB_TRANSFER_TYPE_BULK) {
+			/*
+			 * No bulk endpoint - try the next one
+			 */
+			continue;
+		}
 
-	} else { /* no reader found */
-		rc = ERR_NO_READER;
-	}
+		bEndpointAddress = (*device)->configuration_descriptor->interface->altsetting->endpoint[i].bEndpointAddress;
 
-	libusb_free_device_list(devs, 1);
+		if ((bEndpointAddress & LIBUSB_ENDPOINT_DIR_MASK) == LIBUSB_ENDPOINT_IN) {
+			(*device)->bulk_in = bEndpointAddress;
+		}
 
-	if (rc == ERR_NO_READER) {
-		refcnt--;
-		if (refcnt == 0) {
-			libusb_exit(context);
-			context = NULL;
+		if ((bEndpointAddress & LIBUSB_ENDPOINT_DIR_MASK) == LIBUSB_ENDPOINT_OUT) {
+			(*device)->bulk_out = bEndpointAddress;
 		}
 	}
 
-	return rc;
+	return USB_OK;
 }
 
 
@@ -313,7 +585,7 @@ int USB_Open(unsigned short pn, usb_device_t **device)
  * @param device Structure with device specific data
  * @return Status code \ref USB_OK, \ref ERR_USB
  */
-void USB_GetCCIDDescriptor(usb_device_t *device, unsigned char const **desc, int *length)
+static void libusbGetCCIDDescriptor(usb_device_t *device, unsigned char const **desc, int *length)
 {
 	if (length)
 		*length = device->configuration_descriptor->interface->altsetting->extra_length;
@@ -329,7 +601,7 @@ void USB_GetCCIDDescriptor(usb_device_t *device, unsigned char const **desc, int
  * @param device Structure with device specific data
  * @return Status code \ref USB_OK, \ref ERR_USB
  */
-int USB_Close(usb_device_t **device)
+static int libusbClose(usb_device_t **device)
 {
 
 	int rc;
@@ -337,7 +609,8 @@ int USB_Close(usb_device_t **device)
 	rc = libusb_release_interface((*device)->handle,
 								  (*device)->configuration_descriptor->interface->altsetting->bInterfaceNumber);
 
-	if (rc != LIBUSB_SUCCESS) {
+	/* A detached reader has already released the interface */
+	if ((rc != LIBUSB_SUCCESS) && (rc != LIBUSB_ERROR_NO_DEVICE)) {
 #ifdef DEBUG
 		ctccid_debug("libusb_release_interface failed. rc = %i (%s)\n", rc, libusb_error_to_string(rc));
 #endif
@@ -349,11 +622,7 @@ int USB_Close(usb_device_t **device)
 	free(*device);
 	*device = NULL;
 
-	refcnt--;
-	if (refcnt == 0) {
-		libusb_exit(context);
-		context = NULL;
-	}
+	releaseContext();
 
 	return USB_OK;
 }
@@ -368,7 +637,7 @@ int USB_Close(usb_device_t **device)
  * @param buffer Data buffer
  * @return Status code \ref USB_OK, \ref ERR_USB
  */
-int USB_Write(usb_device_t *device, unsigned int length, unsigned char *buffer)
+static int libusbWrite(usb_device_t *device, unsigned int length, unsigned char *buffer)
 {
 	int rc;
 	int send;
@@ -395,7 +664,7 @@ int USB_Write(usb_device_t *device, unsigned int length, unsigned char *buffer)
  * @param buffer Data buffer
  * @return Status code \ref USB_OK, \ref ERR_USB
  */
-int USB_Read(usb_device_t *device, unsigned int *length, unsigned char *buffer)
+static int libusbRead(usb_device_t *device, unsigned int *length, unsigned char *buffer)
 {
 	int rc;
 	int read;
@@ -414,3 +683,142 @@ int USB_Read(usb_device_t *device, unsigned int *length, unsigned char *buffer)
 
 	return USB_OK;
 }
+
+
+
+/*
+ * Default backend using libusb bulk transfers
+ */
+static const usb_backend_t libusbBackend = {
+	"libusb",
+	libusbOpen,
+	libusbClose,
+	libusbListPorts,
+	libusbGetCCIDDescriptor,
+	libusbWrite,
+	libusbRead
+};
+
+/*
+ * Backend used for devices opened with USB_Open()
+ */
+static const usb_backend_t *activeBackend = &libusbBackend;
+
+
+
+/**
+ * Install the backend used for devices opened thereafter. Devices already open
+ * remain bound to the backend that opened them.
+ *
+ * @param backend The backend or NULL to restore the default libusb backend
+ */
+void USB_SetBackend(const usb_backend_t *backend)
+{
+	activeBackend = backend ? backend : &libusbBackend;
+}
+
+
+
+/**
+ * Return the backend used for devices opened with USB_Open()
+ *
+ * @return The active backend
+ */
+const usb_backend_t *USB_GetBackend()
+{
+	return activeBackend;
+}
+
+
+
+/**
+ * Open USB device at the specified port using the active backend
+ *
+ * @param pn Port number
+ * @param device Structure holding device specific data
+ * @return Status code \ref USB_OK, \ref ERR_NO_READER, \ref ERR_USB
+ */
+int USB_Open(unsigned short pn, usb_device_t **device)
+{
+	const usb_backend_t *backend = activeBackend;
+	int rc;
+
+	rc = backend->open(pn, device);
+
+	if (rc == USB_OK) {
+		(*device)->backend = backend;
+	}
+
+	return rc;
+}
+
+
+
+/**
+ * Return the port numbers of all readers attached to the active backend
+ *
+ * @param ports Array receiving the port numbers or NULL to query the number of ports
+ * @param count Size of array on input, number of ports on output
+ * @return Status code \ref USB_OK, \ref ERR_USB or \ref ERR_NO_READER if the array is too small
+ */
+int USB_ListPorts(unsigned short *ports, int *count)
+{
+	return activeBackend->listPorts(ports, count);
+}
+
+
+
+/**
+ * Close USB device and free allocated resources
+ *
+ * @param device Structure with device specific data
+ * @return Status code \ref USB_OK, \ref ERR_USB
+ */
+int USB_Close(usb_device_t **device)
+{
+	return (*device)->backend->close(device);
+}
+
+
+
+/**
+ * Return the 54 byte CCID Descriptor
+ *
+ * @param device Structure with device specific data
+ * @param desc Pointer to descriptor
+ * @param length Length of descriptor
+ */
+void USB_GetCCIDDescriptor(usb_device_t *device, unsigned char const **desc, int *length)
+{
+	device->backend->getCCIDDescriptor(device, desc, length);
+}
+
+
+
+/**
+ * Write data block to specified USB device
+ *
+ * @param device Device specific data
+ * @param length Length of data to write
+ * @param buffer Data buffer
+ * @return Status code \ref USB_OK, \ref ERR_USB
+ */
+int USB_Write(usb_device_t *device, unsigned int length, unsigned char *buffer)
+{
+	return device->backend->write(device, length, buffer);
+}
+
+
+
+/**
+ * Read data block from specified USB device
+ *
+ * @param device Device specific data
+ * @param length Length of data buffer
+ * @param buffer Data buffer
+ * @return Status code \ref USB_OK, \ref ERR_USB
+ */
+int USB_Read(usb_device_t *device, unsigned int *length, unsigned char *buffer)
+{
+	return device->backend->read(device, length, buffer);
+}
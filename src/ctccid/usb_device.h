@@ -73,6 +73,16 @@
  */
 typedef struct usb_device {
 
+        /**
+         * Backend that opened the device and serves all further requests
+         */
+        const struct usb_backend *backend;
+
+        /**
+         * Backend specific data, e.g. the state of an emulated reader
+         */
+        void *privateData;
+
         /**
          * Libusb device handle
          */
@@ -94,8 +104,30 @@ typedef struct usb_device {
 
 } usb_device_t;
 
+/**
+ * Set of functions implementing the USB transport for a device.
+ *
+ * The default backend uses libusb bulk transfers. Alternative backends, e.g. the
+ * CCID reader emulator, can be installed with USB_SetBackend() and are used for
+ * all devices opened thereafter.
+ */
+typedef struct usb_backend {
+        /** Name of backend used in debug output */
+        const char *name;
+        int (*open)(unsigned short pn, usb_device_t **device);
+        int (*close)(usb_device_t **device);
+        int (*listPorts)(unsigned short *ports, int *count);
+        void (*getCCIDDescriptor)(usb_device_t *device, unsigned char const **desc, int *length);
+        int (*write)(usb_device_t *device, unsigned int length, unsigned char *buffer);
+        int (*read)(usb_device_t *device, unsigned int *length, unsigned char *buffer);
+} usb_backend_t;
+
+void USB_SetBackend(const usb_backend_t *backend);
+const usb_backend_t *USB_GetBackend();
+
 int USB_Open(unsigned short pn, usb_device_t **device);
 int USB_Close(usb_device_t **device);
+int USB_ListPorts(unsigned short *ports, int *count);
 void USB_GetCCIDDescriptor(usb_device_t *device, unsigned char const **desc, int *length);
 int USB_Write(usb_device_t *device, unsigned int length, unsigned char *buffer);
 int USB_Read(usb_device_t *device, unsigned int *length, unsigned char *buffer);
@@ -396,6 +396,218 @@ int asn1Validate(unsigned char *data, size_t length)
 
 
 
+/*
+ * Validate the TLV object at data and append nodes for it and its nested objects
+ *
+ * @return size of the TLV object or ASN1_INDEX_INVALID / ASN1_INDEX_OVERFLOW
+ */
+static int indexObject(unsigned char *base, int ofs, int avail, int depth, int parent, int maxdepth, struct asn1Node *nodes, int maxnodes, int *count)
+{
+	unsigned char *data = base + ofs;
+	unsigned int tag;
+	int i, l, c, hl, tl, node, remain;
+
+	if (avail < 2) {		// Object must have at least two bytes
+		return ASN1_INDEX_INVALID;
+	}
+
+	if (depth > ASN1_INDEX_MAX_NESTING) {	// Limit recursion on malicious input
+		return ASN1_INDEX_INVALID;
+	}
+
+	i = 0;					// Decode tag
+	tag = data[i];
+	if ((tag & 0x1F) == 0x1F) {
+		do	{				// Decode multi-byte tag
+			i++;
+			if ((i >= avail) || (i > 4)) {
+				return ASN1_INDEX_INVALID;
+			}
+			tag = (tag << 8) | data[i];
+		} while (data[i] & 0x80);
+	}
+	i++;
+
+	if (i >= avail) {		// Length missing
+		return ASN1_INDEX_INVALID;
+	}
+
+	l = data[i++];
+
+	if (l & 0x80) {			// Multi-byte length
+		c = l & 0x7F;
+		if (c > 3) {		// No more than 3 byte in length indicator
+			return ASN1_INDEX_INVALID;
+		}
+		l = c > 0 ? 0 : -1;	// Undetermined length if c == 0
+		while (c--) {
+			if (i >= avail) {
+				return ASN1_INDEX_INVALID;
+			}
+			l = (l << 8) | data[i++];
+		}
+	}
+	hl = i;
+
+	if (hl + l > avail) {
+		return ASN1_INDEX_INVALID;
+	}
+
+	node = -1;
+	if (depth <= maxdepth) {
+		if (*count >= maxnodes) {
+			return ASN1_INDEX_OVERFLOW;
+		}
+		node = (*count)++;
+		nodes[node].tag = tag;
+		nodes[node].offset = ofs;
+		nodes[node].value = ofs + hl;
+		nodes[node].length = l;
+		nodes[node].depth = depth;
+		nodes[node].parent = parent;
+	}
+
+	if ((l == 0) || !(*data & 0x20)) {
+		return l < 0 ? ASN1_INDEX_INVALID : hl + l;
+	}
+
+	// Traverse into constructed object
+	remain = l < 0 ? avail - hl : l;
+	i = hl;
+	while (remain > 0) {
+		tl = indexObject(base, ofs + i, remain, depth + 1, node, maxdepth, nodes, maxnodes, count);
+		if (tl < 0) {
+			return tl;
+		}
+
+		i += tl;
+		remain -= tl;
+
+		if ((l < 0) && (data[i - tl] == 0) && (tl == 2)) {	// End-of-contents
+			l = i - hl;
+			if (node >= 0) {
+				nodes[node].length = l;
+			}
+			break;
+		}
+	}
+
+	if (l < 0) {			// End-of-contents missing
+		return ASN1_INDEX_INVALID;
+	}
+
+	return hl + l;
+}
+
+
+
+/**
+ * Validate a TLV structure and build a flat index of the contained objects in a single pass
+ *
+ * Nodes are stored in the order of their appearance, so that the children of a node
+ * follow the node. Nested objects are validated at any level, but only recorded in the
+ * index up to the given depth. Decoding fields then requires scanning the index rather
+ * than walking the encoded structure from the root for each field. Structures nested
+ * deeper than ASN1_INDEX_MAX_NESTING levels are rejected as invalid.
+ *
+ * @param data      The first tag byte
+ * @param length    The maximum length of the buffer
+ * @param maxdepth  Deepest nesting level recorded in the index, 0 for the outermost object only
+ * @param nodes     The array receiving the nodes
+ * @param maxnodes  The number of entries in nodes
+ * @return          Number of nodes, ASN1_INDEX_INVALID or ASN1_INDEX_OVERFLOW
+ */
+int asn1Index(unsigned char *data, size_t length, int maxdepth, struct asn1Node *nodes, int maxnodes)
+{
+	int rc, count;
+
+	count = 0;
+	rc = indexObject(data, 0, (int)length, 0, -1, maxdepth, nodes, maxnodes, &count);
+
+	if (rc < 0) {
+		return rc;
+	}
+
+	return count;
+}
+
+
+
+/**
+ * Locate a child node in the index
+ *
+ * @param nodes     The index
+ * @param count     Number of nodes in the index
+ * @param parent    Index of the parent node
+ * @param n         Position of the child, starting at 0
+ * @return          Index of the child node or -1 if not found
+ */
+int asn1IndexChild(struct asn1Node *nodes, int count, int parent, int n)
+{
+	int i;
+
+	if ((parent < 0) || (parent >= count)) {
+		return -1;
+	}
+
+	for (i = parent + 1; (i < count) && (nodes[i].depth > nodes[parent].depth); i++) {
+		if ((nodes[i].parent == parent) && (n-- == 0)) {
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+
+
+/**
+ * Find a node in the index by path
+ *
+ * Like asn1Find() the path is a concatenation of tag values starting with the outermost
+ * tag. In each level the first object with a matching tag is selected.
+ *
+ * @param nodes     The index
+ * @param count     Number of nodes in the index
+ * @param path      Path to the desired object (List of tags)
+ * @param level     Number of tags in the path
+ * @return          Index of the node or -1 if not found
+ */
+int asn1IndexFind(struct asn1Node *nodes, int count, unsigned char *path, int level)
+{
+	unsigned int tag;
+	int i, node;
+
+	if ((count <= 0) || (level <= 0)) {
+		return -1;
+	}
+
+	tag = asn1Tag(&path);
+	if (nodes[0].tag != tag) {
+		return -1;
+	}
+
+	node = 0;
+	while (--level) {
+		tag = asn1Tag(&path);
+
+		for (i = node + 1; (i < count) && (nodes[i].depth > nodes[node].depth); i++) {
+			if ((nodes[i].parent == node) && (nodes[i].tag == tag)) {
+				break;
+			}
+		}
+
+		if ((i >= count) || (nodes[i].depth <= nodes[node].depth)) {
+			return -1;
+		}
+		node = i;
+	}
+
+	return node;
+}
+
+
+
 /**
  * Decode a field of up to 32 bit flags into a long value
  *
@@ -466,6 +678,10 @@ void testASN1()
 	unsigned char t15[] = { 0x24, 0x01, 0x01 };
 	unsigned char t16[] = { 0x24, 0x02, 0x01, 0x01 };
 	unsigned char t17[] = { 0x24, 0x06, 0x01, 0x01, 0x01, 0x02, 0x01, 0x01 };
+	unsigned char t18[] = { 0x24, 0x80, 0x01, 0x01, 0x01, 0x00, 0x00 };
+	unsigned char t19[2 * (ASN1_INDEX_MAX_NESTING + 2)];
+	struct asn1Node nodes[4];
+	int i;
 
 	assert(asn1Validate(t1, 0) == 1);
 	assert(asn1Validate(t1, 1) == 1);
@@ -486,4 +702,32 @@ void testASN1()
 	assert(asn1Validate(t15, sizeof(t15)) == 3);
 	assert(asn1Validate(t16, sizeof(t16)) == 4);
 	assert(asn1Validate(t17, sizeof(t17)) == 0);
+
+	assert(asn1Index(t1, sizeof(t1), 8, nodes, 4) == 1);
+	assert(asn1Index(t15, sizeof(t15), 8, nodes, 4) == ASN1_INDEX_INVALID);
+	assert(asn1Index(t16, sizeof(t16), 8, nodes, 4) == ASN1_INDEX_INVALID);
+	assert(asn1Index(t17, sizeof(t17), 8, nodes, 2) == ASN1_INDEX_OVERFLOW);
+	assert(asn1Index(t17, sizeof(t17), 0, nodes, 4) == 1);
+	assert(asn1Index(t17, sizeof(t17), 8, nodes, 4) == 3);
+	assert((nodes[2].tag == 0x02) && (nodes[2].offset == 5) && (nodes[2].value == 7) && (nodes[2].length == 1));
+	assert((nodes[2].depth == 1) && (nodes[2].parent == 0));
+	assert(asn1IndexChild(nodes, 3, 0, 1) == 2);
+	assert(asn1IndexChild(nodes, 3, 0, 2) == -1);
+	assert(asn1IndexFind(nodes, 3, (unsigned char *)"\x24\x02", 2) == 2);
+	assert(asn1IndexFind(nodes, 3, (unsigned char *)"\x24\x03", 2) == -1);
+	assert(asn1Index(t18, sizeof(t18), 8, nodes, 4) == 3);
+	assert(nodes[0].length == 5);
+	assert(asn1Index(t18, sizeof(t18) - 1, 8, nodes, 4) == ASN1_INDEX_INVALID);
+
+	for (i = 0; i < ASN1_INDEX_MAX_NESTING + 1; i++) {	// Deepest accepted nesting
+		t19[i * 2] = 0x30;
+		t19[i * 2 + 1] = (ASN1_INDEX_MAX_NESTING - i) * 2;
+	}
+	assert(asn1Index(t19, (ASN1_INDEX_MAX_NESTING + 1) * 2, 0, nodes, 4) == 1);
+
+	for (i = 0; i < ASN1_INDEX_MAX_NESTING + 2; i++) {	// One level too deep
+		t19[i * 2] = 0x30;
+		t19[i * 2 + 1] = (ASN1_INDEX_MAX_NESTING + 1 - i) * 2;
+	}
+	assert(asn1Index(t19, sizeof(t19), 0, nodes, 4) == ASN1_INDEX_INVALID);
 }
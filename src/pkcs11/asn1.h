@@ -49,6 +49,23 @@ extern "C" {
 #define ASN1_UTF8String         0x0C
 #define ASN1_SEQUENCE           0x30
 
+/**
+ * Node in a flat index of a TLV structure, as created by asn1Index()
+ */
+struct asn1Node {
+	unsigned int tag;       /**< Tag as decoded by asn1Tag()                    */
+	int offset;             /**< Offset of the tag field in the buffer           */
+	int value;              /**< Offset of the value field in the buffer         */
+	int length;             /**< Length of the value field                       */
+	int depth;              /**< Nesting level, 0 for the outermost object       */
+	int parent;             /**< Index of the enclosing node, -1 for the root    */
+};
+
+#define ASN1_INDEX_INVALID      -1      /**< Structure does not validate           */
+#define ASN1_INDEX_OVERFLOW     -2      /**< More nodes than fit into the index    */
+
+#define ASN1_INDEX_MAX_NESTING  32      /**< Deepest nesting accepted by asn1Index() */
+
 unsigned int    asn1Tag(unsigned char **Ref);
 int             asn1Length(unsigned char **Ref);
 void            asn1StoreTag(unsigned char **Ref, unsigned short Tag);
@@ -57,6 +74,9 @@ int             asn1Encap(unsigned short Tag, unsigned char *Msg, int MsgLen);
 unsigned char  *asn1Find(unsigned char *data, unsigned char *path, int level);
 int             asn1Validate(unsigned char *data, size_t length);
 int             asn1Next(unsigned char **ref, int *reflen, int *tag, int *length, unsigned char **value);
+int             asn1Index(unsigned char *data, size_t length, int maxdepth, struct asn1Node *nodes, int maxnodes);
+int             asn1IndexChild(struct asn1Node *nodes, int count, int parent, int n);
+int             asn1IndexFind(struct asn1Node *nodes, int count, unsigned char *path, int level);
 void            asn1DecodeFlags(unsigned char *data, size_t length, unsigned long *flags);
 int             asn1DecodeInteger(unsigned char *data, size_t length, int *value);
 
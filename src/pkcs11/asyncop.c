@@ -0,0 +1,634 @@
+/**
+ * SmartCard-HSM PKCS#11 Module
+ *
+ * Copyright (c) 2013, CardContact Systems GmbH, Minden, Germany
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of CardContact Systems GmbH nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CardContact Systems GmbH BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file    asyncop.c
+ * @brief   Asynchronous execution of key operations
+ *
+ * Submitted operations are executed by a small pool of executor threads, which
+ * call the same token functions as C_Sign() and C_Decrypt(). Results are collected
+ * in a completion list. On POSIX systems a file descriptor becomes readable while
+ * completions are pending, so that an event loop can wait for it with poll() or
+ * epoll. On Linux this is an eventfd, elsewhere the read end of a pipe.
+ *
+ * The number of executors defaults to DEFAULT_ASYNC_THREADS and can be changed up to
+ * MAX_ASYNC_THREADS with the environment variable PKCS11_ASYNC_THREADS. Several
+ * executors per slot allow host processing to overlap with the card working on
+ * another request, see slotqueue.c. If the application does not allow the library
+ * to create threads, operations are executed during submission.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
+#endif
+
+#include <common/thread.h>
+#include <common/memset_s.h>
+#include <common/securemem.h>
+
+#include <pkcs11/p11generic.h>
+#include <pkcs11/asyncop.h>
+#include <pkcs11/session.h>
+#include <pkcs11/slot.h>
+#include <pkcs11/slotpool.h>
+
+#ifdef DEBUG
+#include <pkcs11/debug.h>
+#endif
+
+#define DEFAULT_ASYNC_THREADS	4
+#define MAX_ASYNC_THREADS		32
+
+
+
+extern struct p11Context_t *context;
+extern int handleDeviceError(CK_SESSION_HANDLE hSession);
+
+
+
+/**
+ * Submitted operation
+ */
+struct asyncJob {
+	CK_ULONG ticket;                  /**< Ticket returned to the application  */
+	int type;                         /**< ASYNC_SIGN or ASYNC_DECRYPT         */
+	CK_SESSION_HANDLE hSession;       /**< Session used for the operation      */
+	CK_OBJECT_HANDLE hKey;            /**< Key used for the operation          */
+	struct p11Object_t *object;       /**< Key located at submission           */
+	CK_MECHANISM_TYPE mech;           /**< Mechanism validated at submission   */
+	unsigned char *input;             /**< Copy of the input data              */
+	CK_ULONG inputLen;                /**< Length of input data                */
+	CK_BYTE_PTR output;               /**< Output buffer of the application    */
+	CK_ULONG outputLen;               /**< Size of output buffer or result     */
+	CK_RV rv;                         /**< Result of the operation             */
+	struct asyncJob *next;            /**< Next job in list                    */
+};
+
+
+
+/**
+ * State shared between submission, executors and completion
+ */
+static struct {
+	MUTEX mutex;                      /**< Protects all fields below           */
+	COND pending;                     /**< Signalled for new job or stop      */
+	THREAD executor[MAX_ASYNC_THREADS];
+	int executors;                    /**< Number of running executors         */
+	int started;                      /**< Executors have been started         */
+	int stop;                         /**< Executors shall terminate           */
+	struct asyncJob *first;           /**< Next job to execute                 */
+	struct asyncJob *last;            /**< Last job to execute                 */
+	struct asyncJob *doneFirst;       /**< Oldest completed job                */
+	struct asyncJob *doneLast;        /**< Latest completed job                */
+	CK_ULONG nextTicket;              /**< Next ticket to assign               */
+	int readfd;                       /**< Descriptor passed to application    */
+	int writefd;                      /**< Descriptor signalled by executors   */
+	int signalled;                    /**< readfd is readable                  */
+} async;
+
+
+
+/*
+ * Determine the number of executor threads
+ */
+static int getAsyncThreads()
+{
+	char *po;
+	int threads;
+
+	if (context->noThreads)
+		return 0;
+
+	threads = DEFAULT_ASYNC_THREADS;
+
+	po = getenv("PKCS11_ASYNC_THREADS");
+	if (po) {
+		threads = atoi(po);
+#ifdef DEBUG
+		debug("PKCS11_ASYNC_THREADS=%s\n", po);
+#endif
+	}
+
+	if (threads < 0)
+		threads = 0;
+
+	if (threads > MAX_ASYNC_THREADS)
+		threads = MAX_ASYNC_THREADS;
+
+	return threads;
+}
+
+
+
+/*
+ * Make the descriptor readable. Must be called with the mutex locked.
+ */
+static void signalCompletion()
+{
+#ifndef _WIN32
+#ifdef __linux__
+	uint64_t one = 1;
+#else
+	unsigned char one = 1;
+#endif
+
+	if ((async.writefd < 0) || async.signalled)
+		return;
+
+	if (write(async.writefd, &one, sizeof(one)) == sizeof(one))
+		async.signalled = 1;
+#endif
+}
+
+
+
+/*
+ * Drain the descriptor after all completions were taken. Must be called with the mutex locked.
+ */
+static void clearCompletion()
+{
+#ifndef _WIN32
+	unsigned char scr[8];
+
+	if ((async.readfd < 0) || !async.signalled)
+		return;
+
+	while (read(async.readfd, scr, sizeof(scr)) > 0)
+		;
+
+	async.signalled = 0;
+#endif
+}
+
+
+
+/*
+ * Append the job to the completion list. Must be called with the mutex locked.
+ */
+static void completeJob(struct asyncJob *job)
+{
+	job->next = NULL;
+
+	if (async.doneLast) {
+		async.doneLast->next = job;
+	} else {
+		async.doneFirst = job;
+	}
+	async.doneLast = job;
+
+	signalCompletion();
+}
+
+
+
+/*
+ * Release the job and wipe the input data
+ */
+static void freeJob(struct asyncJob *job)
+{
+	if (job->input) {
+		memset_s(job->input, job->inputLen, 0, job->inputLen);
+		secureFree(job->input);
+	}
+	free(job);
+}
+
+
+
+/*
+ * Locate the key for the session, as done by C_SignInit() and C_DecryptInit()
+ *
+ * The lookup is done under the global lock, so that the session can not be closed
+ * concurrently. The key object remains valid after the lock is released, as objects
+ * of a removed token are not released before the next token removal on that slot.
+ */
+static int findSessionKey(CK_SESSION_HANDLE hSession, CK_OBJECT_HANDLE hKey, struct p11Object_t **pObject)
+{
+	int rv;
+	struct p11Slot_t *pSlot;
+	struct p11Session_t *pSession;
+
+	p11LockMutex(context->mutex);
+
+	rv = findSessionByHandle(&context->sessionPool, hSession, &pSession);
+
+	if (rv == CKR_OK)
+		rv = findSlot(&context->slotPool, pSession->slotID, &pSlot);
+
+	if (rv == CKR_OK)
+		rv = findSlotKey(pSlot, hKey, pObject);
+
+	p11UnlockMutex(context->mutex);
+
+	if (rv != CKR_OK)
+		return rv;
+
+	if ((*pObject)->ops == NULL)
+		return CKR_FUNCTION_NOT_SUPPORTED;
+
+	return CKR_OK;
+}
+
+
+
+/*
+ * Execute the job on the current thread. The key is located again, as the session
+ * may have been closed or the token removed since submission. The job fails if the
+ * handle now refers to a different key object than at submission.
+ *
+ * A device error is handled as in C_Sign() and C_Decrypt(), with handleDeviceError()
+ * taking the global lock while validating the token.
+ */
+static void executeJob(struct asyncJob *job)
+{
+	int rv;
+	struct p11Object_t *pObject;
+
+	rv = findSessionKey(job->hSession, job->hKey, &pObject);
+
+	if ((rv == CKR_OK) && (pObject != job->object))
+		rv = CKR_KEY_HANDLE_INVALID;
+
+	if (rv == CKR_OK) {
+		if (job->type == ASYNC_SIGN) {
+			rv = pObject->ops->C_Sign(pObject, job->mech, job->input, job->inputLen, job->output, &job->outputLen);
+		} else {
+			rv = pObject->ops->C_Decrypt(pObject, job->mech, job->input, job->inputLen, job->output, &job->outputLen);
+		}
+
+		if (rv == CKR_DEVICE_ERROR) {
+			rv = handleDeviceError(job->hSession);
+		}
+	}
+
+	job->rv = rv;
+
+	memset_s(job->input, job->inputLen, 0, job->inputLen);
+	secureFree(job->input);
+	job->input = NULL;
+}
+
+
+
+/*
+ * Executor thread taking jobs until stopped
+ */
+static void *asyncExecutor(void *arg)
+{
+	struct asyncJob *job;
+
+	mutex_lock(&async.mutex);
+
+	while (1) {
+		while ((async.first == NULL) && !async.stop) {
+			cond_wait(&async.pending, &async.mutex);
+		}
+
+		if (async.stop)
+			break;
+
+		job = async.first;
+		async.first = job->next;
+		if (async.first == NULL)
+			async.last = NULL;
+
+		mutex_unlock(&async.mutex);
+
+		executeJob(job);
+
+		mutex_lock(&async.mutex);
+
+		completeJob(job);
+	}
+
+	mutex_unlock(&async.mutex);
+
+	return NULL;
+}
+
+
+
+/*
+ * Start the executor threads on first submission. Must be called with the mutex locked.
+ */
+static void startExecutors()
+{
+	int threads;
+
+	threads = getAsyncThreads();
+
+	for (async.executors = 0; async.executors < threads; async.executors++) {
+		if (thread_create(&async.executor[async.executors], asyncExecutor, NULL) != 0) {
+#ifdef DEBUG
+			debug("Could only start %d executor threads\n", async.executors);
+#endif
+			break;
+		}
+	}
+
+	async.started = 1;
+}
+
+
+
+/**
+ * Prepare the shared state. Called from C_Initialize().
+ *
+ * @return           CKR_OK or CKR_GENERAL_ERROR
+ */
+int initAsyncOperations()
+{
+	memset(&async, 0, sizeof(async));
+
+	async.nextTicket = 1;
+	async.readfd = -1;
+	async.writefd = -1;
+
+	if (mutex_init(&async.mutex) != 0)
+		return CKR_GENERAL_ERROR;
+
+	if (cond_init(&async.pending) != 0) {
+		mutex_destroy(&async.mutex);
+		return CKR_GENERAL_ERROR;
+	}
+
+	return CKR_OK;
+}
+
+
+
+/**
+ * Stop the executors and release all jobs. Called from C_Finalize() before the pools
+ * are released. Jobs not yet executed are discarded.
+ */
+void terminateAsyncOperations()
+{
+	struct asyncJob *job;
+	int i;
+
+	mutex_lock(&async.mutex);
+	async.stop = 1;
+	cond_broadcast(&async.pending);
+	mutex_unlock(&async.mutex);
+
+	for (i = 0; i < async.executors; i++) {
+		thread_join(&async.executor[i]);
+	}
+
+	while ((job = async.first) != NULL) {
+		async.first = job->next;
+		freeJob(job);
+	}
+
+	while ((job = async.doneFirst) != NULL) {
+		async.doneFirst = job->next;
+		freeJob(job);
+	}
+
+#ifndef _WIN32
+	if (async.readfd >= 0)
+		close(async.readfd);
+
+	if ((async.writefd >= 0) && (async.writefd != async.readfd))
+		close(async.writefd);
+#endif
+
+	cond_destroy(&async.pending);
+	mutex_destroy(&async.mutex);
+}
+
+
+
+/**
+ * Validate and queue an operation
+ *
+ * Key and mechanism are validated with C_SignInit() or C_DecryptInit() of the token,
+ * so that errors are reported at submission. The input is copied, the output buffer
+ * must remain valid until the completion has been collected.
+ *
+ * @param type          ASYNC_SIGN or ASYNC_DECRYPT
+ * @param hSession      The session handle
+ * @param pMechanism    The mechanism
+ * @param hKey          The key handle
+ * @param pInput        The input data
+ * @param ulInputLen    The length of the input data
+ * @param pOutput       The output buffer or NULL to determine the length
+ * @param ulOutputLen   The size of the output buffer
+ * @param pulTicket     The ticket identifying the completion
+ * @return              CKR_OK or any error from C_SignInit() or C_DecryptInit()
+ */
+int submitAsyncOperation(int type, CK_SESSION_HANDLE hSession, CK_MECHANISM_PTR pMechanism, CK_OBJECT_HANDLE hKey,
+		CK_BYTE_PTR pInput, CK_ULONG ulInputLen, CK_BYTE_PTR pOutput, CK_ULONG ulOutputLen, CK_ULONG_PTR pulTicket)
+{
+	int rv;
+	struct p11Object_t *pObject;
+	struct asyncJob *job;
+
+	FUNC_CALLED();
+
+	rv = findSessionKey(hSession, hKey, &pObject);
+
+	if (rv != CKR_OK) {
+		FUNC_RETURNS(rv);
+	}
+
+	if (type == ASYNC_SIGN) {
+		if ((pObject->ops->C_SignInit == NULL) || (pObject->ops->C_Sign == NULL))
+			FUNC_FAILS(CKR_FUNCTION_NOT_SUPPORTED, "Operation not supported by token");
+
+		rv = pObject->ops->C_SignInit(pObject, pMechanism);
+	} else {
+		if ((pObject->ops->C_DecryptInit == NULL) || (pObject->ops->C_Decrypt == NULL))
+			FUNC_FAILS(CKR_FUNCTION_NOT_SUPPORTED, "Operation not supported by token");
+
+		rv = pObject->ops->C_DecryptInit(pObject, pMechanism);
+	}
+
+	if (rv != CKR_OK) {
+		FUNC_RETURNS(rv);
+	}
+
+	job = (struct asyncJob *)calloc(1, sizeof(struct asyncJob));
+
+	if (job == NULL) {
+		FUNC_FAILS(CKR_HOST_MEMORY, "Out of memory");
+	}
+
+	job->input = secureAlloc(ulInputLen ? ulInputLen : 1);
+
+	if (job->input == NULL) {
+		free(job);
+		FUNC_FAILS(CKR_HOST_MEMORY, "Out of memory");
+	}
+
+	memcpy(job->input, pInput, ulInputLen);
+	job->inputLen = ulInputLen;
+	job->type = type;
+	job->hSession = hSession;
+	job->hKey = hKey;
+	job->object = pObject;
+	job->mech = pMechanism->mechanism;
+	job->output = pOutput;
+	job->outputLen = ulOutputLen;
+
+	mutex_lock(&async.mutex);
+
+	if (!async.started)
+		startExecutors();
+
+	job->ticket = async.nextTicket++;
+
+	if (async.nextTicket == 0)
+		async.nextTicket = 1;
+
+	*pulTicket = job->ticket;
+
+	if (async.executors == 0) {
+		mutex_unlock(&async.mutex);
+		executeJob(job);
+		mutex_lock(&async.mutex);
+		completeJob(job);
+	} else {
+		job->next = NULL;
+		if (async.last) {
+			async.last->next = job;
+		} else {
+			async.first = job;
+		}
+		async.last = job;
+
+		cond_signal(&async.pending);
+	}
+
+	mutex_unlock(&async.mutex);
+
+	FUNC_RETURNS(CKR_OK);
+}
+
+
+
+/**
+ * Return the descriptor that becomes readable while completions are pending
+ *
+ * The descriptor is owned by the module and closed in C_Finalize(). The application
+ * must not read from it, it is cleared when getAsyncCompletions() took the last completion.
+ *
+ * @param pFd           The descriptor
+ * @return              CKR_OK, CKR_FUNCTION_NOT_SUPPORTED on Windows or CKR_GENERAL_ERROR
+ */
+int getAsyncEventDescriptor(int *pFd)
+{
+#ifdef _WIN32
+	return CKR_FUNCTION_NOT_SUPPORTED;
+#else
+	int fds[2];
+
+	mutex_lock(&async.mutex);
+
+	if (async.readfd < 0) {
+#ifdef __linux__
+		fds[0] = fds[1] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+		if (fds[0] < 0) {
+			mutex_unlock(&async.mutex);
+			return CKR_GENERAL_ERROR;
+		}
+#else
+		if (pipe(fds) != 0) {
+			mutex_unlock(&async.mutex);
+			return CKR_GENERAL_ERROR;
+		}
+
+		fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+		fcntl(fds[1], F_SETFL, fcntl(fds[1], F_GETFL) | O_NONBLOCK);
+		fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+		fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+#endif
+		async.readfd = fds[0];
+		async.writefd = fds[1];
+
+		// Completions collected before the descriptor existed
+		if (async.doneFirst)
+			signalCompletion();
+	}
+
+	*pFd = async.readfd;
+
+	mutex_unlock(&async.mutex);
+
+	return CKR_OK;
+#endif
+}
+
+
+
+/**
+ * Take completed operations from the completion list in order of completion
+ *
+ * @param pCompletions  The array receiving the completions
+ * @param ulMaxCount    The size of the array
+ * @param pulCount      The number of completions returned
+ * @return              CKR_OK
+ */
+int getAsyncCompletions(SC_ASYNC_COMPLETION_PTR pCompletions, CK_ULONG ulMaxCount, CK_ULONG_PTR pulCount)
+{
+	struct asyncJob *job;
+	CK_ULONG count = 0;
+
+	mutex_lock(&async.mutex);
+
+	while ((count < ulMaxCount) && ((job = async.doneFirst) != NULL)) {
+		async.doneFirst = job->next;
+		if (async.doneFirst == NULL)
+			async.doneLast = NULL;
+
+		pCompletions[count].ulTicket = job->ticket;
+		pCompletions[count].rv = job->rv;
+		pCompletions[count].ulOutputLen = job->outputLen;
+		count++;
+
+		freeJob(job);
+	}
+
+	if (async.doneFirst == NULL)
+		clearCompletion();
+
+	mutex_unlock(&async.mutex);
+
+	*pulCount = count;
+
+	return CKR_OK;
+}
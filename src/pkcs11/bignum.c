@@ -0,0 +1,407 @@
+/**
+ * SmartCard-HSM PKCS#11 Module
+ *
+ * Copyright (c) 2013, CardContact Systems GmbH, Minden, Germany
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of CardContact Systems GmbH nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CardContact Systems GmbH BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file    bignum.c
+ * @brief   Multi-precision integer and Montgomery arithmetic for public key operations
+ *
+ * Only operations with public values are performed, so the code is not written
+ * to run in constant time.
+ */
+
+#include <string.h>
+
+#include <pkcs11/bignum.h>
+
+
+
+/**
+ * Convert a big-endian byte string into a number
+ *
+ * @param a          The number with limbs limbs
+ * @param limbs      The number of limbs
+ * @param buf        The byte string
+ * @param len        The length of the byte string
+ * @return           0 or -1 if the value does not fit
+ */
+int bnFromBytes(uint32_t *a, int limbs, const unsigned char *buf, size_t len)
+{
+	size_t i;
+
+	while ((len > 0) && (*buf == 0)) {
+		buf++;
+		len--;
+	}
+
+	if (len > (size_t)limbs * 4)
+		return -1;
+
+	memset(a, 0, limbs * sizeof(uint32_t));
+
+	for (i = 0; i < len; i++) {
+		a[i >> 2] |= (uint32_t)buf[len - 1 - i] << ((i & 3) << 3);
+	}
+	return 0;
+}
+
+
+
+/**
+ * Convert a number into a big-endian byte string of fixed length
+ *
+ * Leading bytes beyond the number of limbs are set to zero, excess limbs are truncated.
+ */
+void bnToBytes(const uint32_t *a, int limbs, unsigned char *buf, size_t len)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		buf[len - 1 - i] = (i >> 2) < (size_t)limbs ? (unsigned char)(a[i >> 2] >> ((i & 3) << 3)) : 0;
+	}
+}
+
+
+
+/**
+ * Return the number of significant bits
+ */
+int bnBits(const uint32_t *a, int limbs)
+{
+	int bits;
+	uint32_t w;
+
+	while ((limbs > 0) && (a[limbs - 1] == 0))
+		limbs--;
+
+	if (limbs == 0)
+		return 0;
+
+	bits = (limbs - 1) * 32;
+	for (w = a[limbs - 1]; w; w >>= 1)
+		bits++;
+
+	return bits;
+}
+
+
+
+int bnIsZero(const uint32_t *a, int limbs)
+{
+	while (limbs--) {
+		if (a[limbs])
+			return 0;
+	}
+	return 1;
+}
+
+
+
+/**
+ * Compare two numbers
+ *
+ * @return           -1, 0 or 1 if a is less than, equal or greater than b
+ */
+int bnCmp(const uint32_t *a, const uint32_t *b, int limbs)
+{
+	while (limbs--) {
+		if (a[limbs] != b[limbs])
+			return a[limbs] > b[limbs] ? 1 : -1;
+	}
+	return 0;
+}
+
+
+
+/**
+ * r = a + b
+ *
+ * @return           The carry
+ */
+uint32_t bnAdd(uint32_t *r, const uint32_t *a, const uint32_t *b, int limbs)
+{
+	uint64_t c = 0;
+	int i;
+
+	for (i = 0; i < limbs; i++) {
+		c += (uint64_t)a[i] + b[i];
+		r[i] = (uint32_t)c;
+		c >>= 32;
+	}
+	return (uint32_t)c;
+}
+
+
+
+/**
+ * r = a - b
+ *
+ * @return           The borrow
+ */
+uint32_t bnSub(uint32_t *r, const uint32_t *a, const uint32_t *b, int limbs)
+{
+	uint64_t c = 0;
+	int i;
+
+	for (i = 0; i < limbs; i++) {
+		c = (uint64_t)a[i] - b[i] - c;
+		r[i] = (uint32_t)c;
+		c = (c >> 32) & 1;
+	}
+	return (uint32_t)c;
+}
+
+
+
+void bnShiftRight(uint32_t *a, int limbs, int bits)
+{
+	int i, words = bits >> 5;
+
+	bits &= 31;
+
+	for (i = 0; i < limbs; i++) {
+		a[i] = (i + words < limbs) ? a[i + words] : 0;
+		if (bits) {
+			a[i] >>= bits;
+			if (i + words + 1 < limbs)
+				a[i] |= a[i + words + 1] << (32 - bits);
+		}
+	}
+}
+
+
+
+/*
+ * a = 2 * a mod m for a < m
+ */
+static void montDouble(const struct montContext *ctx, uint32_t *a)
+{
+	uint32_t carry;
+
+	carry = bnAdd(a, a, a, ctx->limbs);
+
+	if (carry || (bnCmp(a, ctx->m, ctx->limbs) >= 0))
+		bnSub(a, a, ctx->m, ctx->limbs);
+}
+
+
+
+/**
+ * Prepare a context for Montgomery multiplication
+ *
+ * @param ctx        The context
+ * @param modulus    The big-endian encoded modulus, which must be odd
+ * @param len        The length of the modulus
+ * @param limbs      The number of limbs for operands or 0 to derive from the modulus
+ * @return           0 or -1 if the modulus is invalid or too large
+ */
+int montInit(struct montContext *ctx, const unsigned char *modulus, size_t len, int limbs)
+{
+	uint32_t x;
+	int bits, i;
+
+	while ((len > 0) && (*modulus == 0)) {
+		modulus++;
+		len--;
+	}
+
+	if (limbs == 0)
+		limbs = (int)((len + 3) >> 2);
+
+	if ((len == 0) || (limbs > BN_MAX_LIMBS) || (len > (size_t)limbs * 4) || !(modulus[len - 1] & 1))
+		return -1;
+
+	memset(ctx, 0, sizeof(*ctx));
+	ctx->limbs = limbs;
+	bnFromBytes(ctx->m, limbs, modulus, len);
+
+	bits = bnBits(ctx->m, limbs);
+
+	if (bits < 2)
+		return -1;
+
+	// Newton iteration doubles the number of correct low order bits in each step
+	x = ctx->m[0];
+	for (i = 0; i < 4; i++)
+		x *= 2 - ctx->m[0] * x;
+	ctx->minv = (uint32_t)0 - x;
+
+	// R mod m is obtained by doubling the largest power of two below m
+	ctx->one[(bits - 1) >> 5] = (uint32_t)1 << ((bits - 1) & 31);
+	for (i = bits - 1; i < limbs * 32; i++)
+		montDouble(ctx, ctx->one);
+
+	// R^2 = (2^limbs * R)^(2^5) / R^(2^5 - 1) using Montgomery squaring
+	memcpy(ctx->rr, ctx->one, limbs * sizeof(uint32_t));
+	for (i = 0; i < limbs; i++)
+		montDouble(ctx, ctx->rr);
+
+	for (i = 0; i < 5; i++)
+		montMul(ctx, ctx->rr, ctx->rr, ctx->rr);
+
+	return 0;
+}
+
+
+
+/**
+ * Reduce a number to the range of the modulus by subtraction
+ *
+ * Only suitable for values that are a small multiple of the modulus.
+ */
+void montReduce(const struct montContext *ctx, uint32_t *a)
+{
+	while (bnCmp(a, ctx->m, ctx->limbs) >= 0)
+		bnSub(a, a, ctx->m, ctx->limbs);
+}
+
+
+
+/**
+ * r = a * b / R mod m for a, b < m
+ *
+ * r may be the same as a or b.
+ */
+void montMul(const struct montContext *ctx, uint32_t *r, const uint32_t *a, const uint32_t *b)
+{
+	uint32_t t[BN_MAX_LIMBS + 2], u;
+	uint64_t c;
+	int n = ctx->limbs, i, j;
+
+	memset(t, 0, (n + 2) * sizeof(uint32_t));
+
+	for (i = 0; i < n; i++) {
+		// t += a * b[i]
+		c = 0;
+		for (j = 0; j < n; j++) {
+			c = (uint64_t)a[j] * b[i] + t[j] + (c >> 32);
+			t[j] = (uint32_t)c;
+		}
+		c = (uint64_t)t[n] + (c >> 32);
+		t[n] = (uint32_t)c;
+		t[n + 1] = (uint32_t)(c >> 32);
+
+		// t = (t + u * m) / 2^32
+		u = t[0] * ctx->minv;
+		c = (uint64_t)u * ctx->m[0] + t[0];
+		for (j = 1; j < n; j++) {
+			c = (uint64_t)u * ctx->m[j] + t[j] + (c >> 32);
+			t[j - 1] = (uint32_t)c;
+		}
+		c = (uint64_t)t[n] + (c >> 32);
+		t[n - 1] = (uint32_t)c;
+		t[n] = t[n + 1] + (uint32_t)(c >> 32);
+	}
+
+	if (t[n] || (bnCmp(t, ctx->m, n) >= 0))
+		bnSub(t, t, ctx->m, n);
+
+	memcpy(r, t, n * sizeof(uint32_t));
+}
+
+
+
+/**
+ * r = a + b mod m
+ */
+void montAdd(const struct montContext *ctx, uint32_t *r, const uint32_t *a, const uint32_t *b)
+{
+	uint32_t carry;
+
+	carry = bnAdd(r, a, b, ctx->limbs);
+
+	if (carry || (bnCmp(r, ctx->m, ctx->limbs) >= 0))
+		bnSub(r, r, ctx->m, ctx->limbs);
+}
+
+
+
+/**
+ * r = a - b mod m
+ */
+void montSub(const struct montContext *ctx, uint32_t *r, const uint32_t *a, const uint32_t *b)
+{
+	if (bnSub(r, a, b, ctx->limbs))
+		bnAdd(r, r, ctx->m, ctx->limbs);
+}
+
+
+
+/**
+ * Convert a number smaller than m into Montgomery form
+ */
+void montToMont(const struct montContext *ctx, uint32_t *r, const uint32_t *a)
+{
+	montMul(ctx, r, a, ctx->rr);
+}
+
+
+
+/**
+ * Convert a number from Montgomery form
+ */
+void montFromMont(const struct montContext *ctx, uint32_t *r, const uint32_t *a)
+{
+	uint32_t one[BN_MAX_LIMBS];
+
+	memset(one, 0, ctx->limbs * sizeof(uint32_t));
+	one[0] = 1;
+	montMul(ctx, r, a, one);
+}
+
+
+
+/**
+ * r = a ^ exp mod m with a and r in Montgomery form
+ *
+ * @param exp        The big-endian encoded exponent
+ * @param len        The length of the exponent
+ */
+void montExp(const struct montContext *ctx, uint32_t *r, const uint32_t *a, const unsigned char *exp, size_t len)
+{
+	uint32_t x[BN_MAX_LIMBS], b[BN_MAX_LIMBS];
+	size_t i;
+	int bit, started;
+
+	memcpy(b, a, ctx->limbs * sizeof(uint32_t));
+	memcpy(x, ctx->one, ctx->limbs * sizeof(uint32_t));
+	started = 0;
+
+	for (i = 0; i < len; i++) {
+		for (bit = 7; bit >= 0; bit--) {
+			// Squaring is skipped until the leading one bit, e.g. for 65537
+			if (started)
+				montMul(ctx, x, x, x);
+
+			if ((exp[i] >> bit) & 1) {
+				montMul(ctx, x, x, b);
+				started = 1;
+			}
+		}
+	}
+
+	memcpy(r, x, ctx->limbs * sizeof(uint32_t));
+}
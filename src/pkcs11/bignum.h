@@ -0,0 +1,74 @@
+/**
+ * SmartCard-HSM PKCS#11 Module
+ *
+ * Copyright (c) 2013, CardContact Systems GmbH, Minden, Germany
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of CardContact Systems GmbH nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CardContact Systems GmbH BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file    bignum.h
+ * @brief   Multi-precision integer and Montgomery arithmetic for public key operations
+ */
+
+#ifndef ___BIGNUM_H_INC___
+#define ___BIGNUM_H_INC___
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define BN_MAX_BITS             4096
+#define BN_MAX_LIMBS            (BN_MAX_BITS / 32)
+
+/**
+ * Odd modulus and precomputed values for Montgomery multiplication
+ *
+ * Numbers are arrays of 32 bit limbs with the least significant limb first.
+ * All numbers used with a context have ctx->limbs limbs.
+ */
+struct montContext {
+	int limbs;                        /**< Number of limbs in modulus and operands */
+	uint32_t minv;                    /**< -m^-1 mod 2^32                          */
+	uint32_t m[BN_MAX_LIMBS];         /**< The modulus                             */
+	uint32_t one[BN_MAX_LIMBS];       /**< R mod m, i.e. 1 in Montgomery form      */
+	uint32_t rr[BN_MAX_LIMBS];        /**< R^2 mod m                               */
+};
+
+int bnFromBytes(uint32_t *a, int limbs, const unsigned char *buf, size_t len);
+void bnToBytes(const uint32_t *a, int limbs, unsigned char *buf, size_t len);
+int bnBits(const uint32_t *a, int limbs);
+int bnIsZero(const uint32_t *a, int limbs);
+int bnCmp(const uint32_t *a, const uint32_t *b, int limbs);
+uint32_t bnAdd(uint32_t *r, const uint32_t *a, const uint32_t *b, int limbs);
+uint32_t bnSub(uint32_t *r, const uint32_t *a, const uint32_t *b, int limbs);
+void bnShiftRight(uint32_t *a, int limbs, int bits);
+
+int montInit(struct montContext *ctx, const unsigned char *modulus, size_t len, int limbs);
+void montReduce(const struct montContext *ctx, uint32_t *a);
+void montMul(const struct montContext *ctx, uint32_t *r, const uint32_t *a, const uint32_t *b);
+void montAdd(const struct montContext *ctx, uint32_t *r, const uint32_t *a, const uint32_t *b);
+void montSub(const struct montContext *ctx, uint32_t *r, const uint32_t *a, const uint32_t *b);
+void montToMont(const struct montContext *ctx, uint32_t *r, const uint32_t *a);
+void montFromMont(const struct montContext *ctx, uint32_t *r, const uint32_t *a);
+void montExp(const struct montContext *ctx, uint32_t *r, const uint32_t *a, const unsigned char *exp, size_t len);
+
+#endif /* ___BIGNUM_H_INC___ */
@@ -83,101 +83,85 @@ int createCertificateObject(CK_ATTRIBUTE_PTR pTemplate, CK_ULONG ulCount, struct
 
 
 
-/**
- * Populate the attribute CKA_ISSUER, CKA_SUBJECT and CKA_SERIAL from certificate
+/*
+ * Number of nodes in the index of a certificate. Only the outer structure and
+ * the fields of the TBSCertificate are recorded
  */
-int populateIssuerSubjectSerial(struct p11Object_t *pObject)
-{
-	CK_ATTRIBUTE attr = { CKA_VALUE, NULL, 0 };
-	struct p11Attribute_t *pattr;
-	int tag, length, buflen;
-	unsigned char *value, *cursor, *obj;
+#define CERT_INDEX_NODES    32
 
-	attr.type = CKA_VALUE;
-	if (findAttribute(pObject, &attr, &pattr) < 0) {
-		return -1;
-	}
 
-	cursor = pattr->attrData.pValue;
-	buflen = pattr->attrData.ulValueLen;
 
-	if (asn1Validate(cursor, buflen)) {
-		return -1;
-	}
-
-	// Outer SEQUENCE
-	if (!asn1Next(&cursor, &buflen, &tag, &length, &value)) {
-		return -1;
-	}
+/*
+ * Position of fields in the TBSCertificate, following the optional version
+ */
+#define TBS_SERIAL          0
+#define TBS_ISSUER          2
+#define TBS_SUBJECT         4
+#define TBS_SPKI            5
 
-	cursor = value;
-	buflen = length;
 
-	// TBS SEQUENCE
-	if (!asn1Next(&cursor, &buflen, &tag, &length, &value)) {
-		return -1;
-	}
 
-	cursor = value;
-	buflen = length;
+/**
+ * Validate and index the certificate in CKA_VALUE
+ *
+ * @param pObject   The object containing the certificate
+ * @param cert      Pointer updated with the first byte of the certificate
+ * @param nodes     The array receiving the index
+ * @param count     Pointer to variable updated with the number of nodes
+ * @param first     Pointer to variable updated with the position of the serial number in the TBSCertificate
+ * @return          Index of the TBSCertificate node or -1
+ */
+static int indexCertificate(struct p11Object_t *pObject, unsigned char **cert, struct asn1Node *nodes, int *count, int *first)
+{
+	CK_ATTRIBUTE attr = { CKA_VALUE, NULL, 0 };
+	struct p11Attribute_t *pattr;
+	int tbs, i;
 
-	obj = cursor;
-	if (!asn1Next(&cursor, &buflen, &tag, &length, &value)) {
+	if (findAttribute(pObject, &attr, &pattr) < 0) {
 		return -1;
 	}
 
-	if (tag == 0xA0) {				// Skip optional cert type
-		obj = cursor;
-		if (!asn1Next(&cursor, &buflen, &tag, &length, &value)) {
-			return -1;
-		}
-	}
+	*cert = pattr->attrData.pValue;
+
+	// Certificate, TBSCertificate and the fields in the TBSCertificate
+	*count = asn1Index(*cert, pattr->attrData.ulValueLen, 2, nodes, CERT_INDEX_NODES);
 
-	if (tag != ASN1_INTEGER) {
+	if (*count <= 0) {
 		return -1;
 	}
 
-	attr.type = CKA_SERIAL_NUMBER;
-	attr.pValue = obj;
-	attr.ulValueLen = cursor - obj;
+	tbs = asn1IndexChild(nodes, *count, 0, 0);
 
-	addAttribute(pObject, &attr);
+	i = asn1IndexChild(nodes, *count, tbs, 0);
 
-	if (!asn1Next(&cursor, &buflen, &tag, &length, &value)) {	// Skip SignatureAlgorithm
+	if (i < 0) {
 		return -1;
 	}
 
-	obj = cursor;
-	if (!asn1Next(&cursor, &buflen, &tag, &length, &value)) {	// Decode Issuer
-		return -1;
-	}
+	*first = nodes[i].tag == 0xA0 ? 1 : 0;	// Skip optional cert type
 
-	if (tag != ASN1_SEQUENCE) {
-		return -1;
-	}
+	return tbs;
+}
 
-	attr.type = CKA_ISSUER;
-	attr.pValue = obj;
-	attr.ulValueLen = cursor - obj;
 
-	addAttribute(pObject, &attr);
 
-	if (!asn1Next(&cursor, &buflen, &tag, &length, &value)) {	// Skip validity dates
-		return -1;
-	}
+/**
+ * Add the encoded field from the TBSCertificate as attribute
+ */
+static int addFieldAttribute(struct p11Object_t *pObject, CK_ATTRIBUTE_TYPE type, unsigned char *cert, struct asn1Node *nodes, int count, int tbs, int pos, unsigned int tag)
+{
+	CK_ATTRIBUTE attr;
+	int i;
 
-	obj = cursor;
-	if (!asn1Next(&cursor, &buflen, &tag, &length, &value)) {	// Decode Subject
-		return -1;
-	}
+	i = asn1IndexChild(nodes, count, tbs, pos);
 
-	if (tag != ASN1_SEQUENCE) {
+	if ((i < 0) || (nodes[i].tag != tag)) {
 		return -1;
 	}
 
-	attr.type = CKA_SUBJECT;
-	attr.pValue = obj;
-	attr.ulValueLen = cursor - obj;
+	attr.type = type;
+	attr.pValue = cert + nodes[i].offset;
+	attr.ulValueLen = nodes[i].value + nodes[i].length - nodes[i].offset;
 
 	addAttribute(pObject, &attr);
 
@@ -186,76 +170,57 @@ int populateIssuerSubjectSerial(struct p11Object_t *pObject)
 
 
 
-int getSubjectPublicKeyInfo(struct p11Object_t *pObject, unsigned char **spki)
+/**
+ * Populate the attribute CKA_ISSUER, CKA_SUBJECT and CKA_SERIAL from certificate
+ */
+int populateIssuerSubjectSerial(struct p11Object_t *pObject)
 {
-	CK_ATTRIBUTE attr = { CKA_VALUE, NULL, 0 };
-	struct p11Attribute_t *pattr;
-	int tag, length, buflen;
-	unsigned char *value, *cursor;
-
-	attr.type = CKA_VALUE;
-	if (findAttribute(pObject, &attr, &pattr) < 0) {
-		return -1;
-	}
+	struct asn1Node nodes[CERT_INDEX_NODES];
+	unsigned char *cert;
+	int tbs, count, first;
 
-	cursor = pattr->attrData.pValue;
-	buflen = pattr->attrData.ulValueLen;
+	tbs = indexCertificate(pObject, &cert, nodes, &count, &first);
 
-	if (asn1Validate(cursor, buflen)) {
+	if (tbs < 0) {
 		return -1;
 	}
 
-	// Outer SEQUENCE
-	if (!asn1Next(&cursor, &buflen, &tag, &length, &value)) {
+	if (addFieldAttribute(pObject, CKA_SERIAL_NUMBER, cert, nodes, count, tbs, first + TBS_SERIAL, ASN1_INTEGER) < 0) {
 		return -1;
 	}
 
-	cursor = value;
-	buflen = length;
-
-	// TBS SEQUENCE
-	if (!asn1Next(&cursor, &buflen, &tag, &length, &value)) {
+	if (addFieldAttribute(pObject, CKA_ISSUER, cert, nodes, count, tbs, first + TBS_ISSUER, ASN1_SEQUENCE) < 0) {
 		return -1;
 	}
 
-	cursor = value;
-	buflen = length;
-
-	if (!asn1Next(&cursor, &buflen, &tag, &length, &value)) {
+	if (addFieldAttribute(pObject, CKA_SUBJECT, cert, nodes, count, tbs, first + TBS_SUBJECT, ASN1_SEQUENCE) < 0) {
 		return -1;
 	}
 
-	if (tag == 0xA0) {				// Skip optional cert type
-		if (!asn1Next(&cursor, &buflen, &tag, &length, &value)) {
-			return -1;
-		}
-	}
+	return 0;
+}
 
-	if (!asn1Next(&cursor, &buflen, &tag, &length, &value)) {	// Skip SignatureAlgorithm
-		return -1;
-	}
 
-	if (!asn1Next(&cursor, &buflen, &tag, &length, &value)) {	// Skip Issuer
-		return -1;
-	}
 
-	if (!asn1Next(&cursor, &buflen, &tag, &length, &value)) {	// Skip validity dates
-		return -1;
-	}
+int getSubjectPublicKeyInfo(struct p11Object_t *pObject, unsigned char **spki)
+{
+	struct asn1Node nodes[CERT_INDEX_NODES];
+	unsigned char *cert;
+	int tbs, count, first, i;
 
-	if (!asn1Next(&cursor, &buflen, &tag, &length, &value)) {	// Skip Subject
+	tbs = indexCertificate(pObject, &cert, nodes, &count, &first);
+
+	if (tbs < 0) {
 		return -1;
 	}
 
-	*spki =cursor;
+	i = asn1IndexChild(nodes, count, tbs, first + TBS_SPKI);
 
-	if (!asn1Next(&cursor, &buflen, &tag, &length, &value)) {	// Skip SubjectPublicKeyInfo
+	if ((i < 0) || (nodes[i].tag != ASN1_SEQUENCE)) {
 		return -1;
 	}
 
-	if (tag != ASN1_SEQUENCE) {
-		return -1;
-	}
+	*spki = cert + nodes[i].offset;
 
 	return 0;
 }
@@ -266,7 +231,8 @@ int decodeModulusExponentFromSPKI(unsigned char *spki,
                                  CK_ATTRIBUTE_PTR modulus,
                                  CK_ATTRIBUTE_PTR exponent)
 {
-	int tag, length, buflen;
+	struct asn1Node nodes[4];
+	int tag, length, buflen, count;
 	unsigned char *value, *cursor;
 
 	cursor = spki;				// spk is ASN.1 validated before, not need to check again
@@ -303,34 +269,22 @@ int decodeModulusExponentFromSPKI(unsigned char *spki,
 	}
 
 	cursor = value + 1;
-	buflen = length - 1;
 
-	if (asn1Validate(cursor, buflen) != 0) {
-		return -1;
-	}
+	// RSAPublicKey SEQUENCE with modulus and exponent
+	count = asn1Index(cursor, length - 1, 1, nodes, sizeof(nodes) / sizeof(*nodes));
 
-	// Outer SEQUENCE
-	if (!asn1Next(&cursor, &buflen, &tag, &length, &value)) {
+	if ((count < 3) || (nodes[0].tag != ASN1_SEQUENCE)) {
 		return -1;
 	}
 
-	if (tag != ASN1_SEQUENCE) {
+	if ((nodes[1].tag != ASN1_INTEGER) || (nodes[2].tag != ASN1_INTEGER)) {
 		return -1;
 	}
 
-	cursor = value;
-	buflen = length;
+	value = cursor + nodes[1].value;
+	length = nodes[1].length;
 
-	// Modulus
-	if (!asn1Next(&cursor, &buflen, &tag, &length, &value)) {
-		return -1;
-	}
-
-	if (tag != ASN1_INTEGER) {
-		return -1;
-	}
-
-	if (*value == 0) {
+	if ((length > 0) && (*value == 0)) {
 		value++;
 		length--;
 	}
@@ -339,18 +293,9 @@ int decodeModulusExponentFromSPKI(unsigned char *spki,
 	modulus->pValue = value;
 	modulus->ulValueLen = length;
 
-	// Exponent
-	if (!asn1Next(&cursor, &buflen, &tag, &length, &value)) {
-		return -1;
-	}
-
-	if (tag != ASN1_INTEGER) {
-		return -1;
-	}
-
 	exponent->type = CKA_PUBLIC_EXPONENT;
-	exponent->pValue = value;
-	exponent->ulValueLen = length;
+	exponent->pValue = cursor + nodes[2].value;
+	exponent->ulValueLen = nodes[2].length;
 
 	return 0;
 }
@@ -0,0 +1,252 @@
+/**
+ * SmartCard-HSM PKCS#11 Module
+ *
+ * Copyright (c) 2013, CardContact Systems GmbH, Minden, Germany
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of CardContact Systems GmbH nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CardContact Systems GmbH BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file    digest-arm.c
+ * @brief   SHA-1 and SHA-256 compression functions using the ARMv8 crypto extensions
+ *
+ * The kernels are compiled with a function specific target. The hardware capabilities
+ * reported by the operating system decide at runtime if they are used.
+ */
+
+#include <pkcs11/digest.h>
+
+#if defined(__aarch64__) || defined(_M_ARM64)
+
+#include <arm_neon.h>
+
+#if defined(__linux__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#elif defined(_WIN32)
+#include <windows.h>
+#endif
+
+#if defined(__clang__)
+#define TARGET_CRYPTO __attribute__((target("crypto")))
+#elif defined(__GNUC__)
+#define TARGET_CRYPTO __attribute__((target("+crypto")))
+#else
+#define TARGET_CRYPTO
+#endif
+
+
+
+static int hasSHA1()
+{
+#if defined(__linux__)
+	return (getauxval(AT_HWCAP) & HWCAP_SHA1) != 0;
+#elif defined(__APPLE__)
+	return 1;
+#elif defined(_WIN32)
+	return IsProcessorFeaturePresent(PF_ARM_V8_CRYPTO_INSTRUCTIONS_AVAILABLE);
+#else
+	return 0;
+#endif
+}
+
+
+
+static int hasSHA2()
+{
+#if defined(__linux__)
+	return (getauxval(AT_HWCAP) & HWCAP_SHA2) != 0;
+#elif defined(__APPLE__)
+	return 1;
+#elif defined(_WIN32)
+	return IsProcessorFeaturePresent(PF_ARM_V8_CRYPTO_INSTRUCTIONS_AVAILABLE);
+#else
+	return 0;
+#endif
+}
+
+
+
+static uint32x4_t loadBE(const unsigned char *data)
+{
+	return vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data)));
+}
+
+
+
+TARGET_CRYPTO
+static void sha1BlocksCE(void *st, const unsigned char *data, size_t blocks)
+{
+	uint32_t *state = (uint32_t *)st;
+	uint32x4_t abcd, abcdSave, tmp, m0, m1, m2, m3;
+	uint32_t e0, e0Save, e1;
+
+	abcd = vld1q_u32(state);
+	e0 = state[4];
+
+	// Four rounds with hash function f, then advance the message schedule
+#define ROUNDS4(f, m, k) \
+	tmp = vaddq_u32(m, vdupq_n_u32(k)); \
+	e1 = vsha1h_u32(vgetq_lane_u32(abcd, 0)); \
+	abcd = f(abcd, e0, tmp); \
+	e0 = e1
+#define SCHEDULE(a, b, c, d)    a = vsha1su1q_u32(vsha1su0q_u32(a, b, c), d)
+
+	while (blocks--) {
+		abcdSave = abcd;
+		e0Save = e0;
+
+		m0 = loadBE(data);
+		m1 = loadBE(data + 16);
+		m2 = loadBE(data + 32);
+		m3 = loadBE(data + 48);
+
+		ROUNDS4(vsha1cq_u32, m0, 0x5A827999); SCHEDULE(m0, m1, m2, m3);
+		ROUNDS4(vsha1cq_u32, m1, 0x5A827999); SCHEDULE(m1, m2, m3, m0);
+		ROUNDS4(vsha1cq_u32, m2, 0x5A827999); SCHEDULE(m2, m3, m0, m1);
+		ROUNDS4(vsha1cq_u32, m3, 0x5A827999); SCHEDULE(m3, m0, m1, m2);
+		ROUNDS4(vsha1cq_u32, m0, 0x5A827999); SCHEDULE(m0, m1, m2, m3);
+		ROUNDS4(vsha1pq_u32, m1, 0x6ED9EBA1); SCHEDULE(m1, m2, m3, m0);
+		ROUNDS4(vsha1pq_u32, m2, 0x6ED9EBA1); SCHEDULE(m2, m3, m0, m1);
+		ROUNDS4(vsha1pq_u32, m3, 0x6ED9EBA1); SCHEDULE(m3, m0, m1, m2);
+		ROUNDS4(vsha1pq_u32, m0, 0x6ED9EBA1); SCHEDULE(m0, m1, m2, m3);
+		ROUNDS4(vsha1pq_u32, m1, 0x6ED9EBA1); SCHEDULE(m1, m2, m3, m0);
+		ROUNDS4(vsha1mq_u32, m2, 0x8F1BBCDC); SCHEDULE(m2, m3, m0, m1);
+		ROUNDS4(vsha1mq_u32, m3, 0x8F1BBCDC); SCHEDULE(m3, m0, m1, m2);
+		ROUNDS4(vsha1mq_u32, m0, 0x8F1BBCDC); SCHEDULE(m0, m1, m2, m3);
+		ROUNDS4(vsha1mq_u32, m1, 0x8F1BBCDC); SCHEDULE(m1, m2, m3, m0);
+		ROUNDS4(vsha1mq_u32, m2, 0x8F1BBCDC); SCHEDULE(m2, m3, m0, m1);
+		ROUNDS4(vsha1pq_u32, m3, 0xCA62C1D6); SCHEDULE(m3, m0, m1, m2);
+		ROUNDS4(vsha1pq_u32, m0, 0xCA62C1D6);
+		ROUNDS4(vsha1pq_u32, m1, 0xCA62C1D6);
+		ROUNDS4(vsha1pq_u32, m2, 0xCA62C1D6);
+		ROUNDS4(vsha1pq_u32, m3, 0xCA62C1D6);
+
+		abcd = vaddq_u32(abcd, abcdSave);
+		e0 += e0Save;
+
+		data += 64;
+	}
+
+#undef ROUNDS4
+#undef SCHEDULE
+
+	vst1q_u32(state, abcd);
+	state[4] = e0;
+}
+
+
+
+TARGET_CRYPTO
+static void sha256BlocksCE(void *st, const unsigned char *data, size_t blocks)
+{
+	uint32_t *state = (uint32_t *)st;
+	uint32x4_t state0, state1, abcdSave, efghSave, tmp, tmp2, m0, m1, m2, m3;
+
+	state0 = vld1q_u32(&state[0]);
+	state1 = vld1q_u32(&state[4]);
+
+#define ROUNDS4(m, i) \
+	tmp = vaddq_u32(m, vld1q_u32(&digestK256[i])); \
+	tmp2 = state0; \
+	state0 = vsha256hq_u32(state0, state1, tmp); \
+	state1 = vsha256h2q_u32(state1, tmp2, tmp)
+#define SCHEDULE(a, b, c, d)    a = vsha256su1q_u32(vsha256su0q_u32(a, b), c, d)
+
+	while (blocks--) {
+		abcdSave = state0;
+		efghSave = state1;
+
+		m0 = loadBE(data);
+		m1 = loadBE(data + 16);
+		m2 = loadBE(data + 32);
+		m3 = loadBE(data + 48);
+
+		ROUNDS4(m0, 0);  SCHEDULE(m0, m1, m2, m3);
+		ROUNDS4(m1, 4);  SCHEDULE(m1, m2, m3, m0);
+		ROUNDS4(m2, 8);  SCHEDULE(m2, m3, m0, m1);
+		ROUNDS4(m3, 12); SCHEDULE(m3, m0, m1, m2);
+		ROUNDS4(m0, 16); SCHEDULE(m0, m1, m2, m3);
+		ROUNDS4(m1, 20); SCHEDULE(m1, m2, m3, m0);
+		ROUNDS4(m2, 24); SCHEDULE(m2, m3, m0, m1);
+		ROUNDS4(m3, 28); SCHEDULE(m3, m0, m1, m2);
+		ROUNDS4(m0, 32); SCHEDULE(m0, m1, m2, m3);
+		ROUNDS4(m1, 36); SCHEDULE(m1, m2, m3, m0);
+		ROUNDS4(m2, 40); SCHEDULE(m2, m3, m0, m1);
+		ROUNDS4(m3, 44); SCHEDULE(m3, m0, m1, m2);
+		ROUNDS4(m0, 48);
+		ROUNDS4(m1, 52);
+		ROUNDS4(m2, 56);
+		ROUNDS4(m3, 60);
+
+		state0 = vaddq_u32(state0, abcdSave);
+		state1 = vaddq_u32(state1, efghSave);
+
+		data += 64;
+	}
+
+#undef ROUNDS4
+#undef SCHEDULE
+
+	vst1q_u32(&state[0], state0);
+	vst1q_u32(&state[4], state1);
+}
+
+
+
+/**
+ * Return the SHA-1 compression function using the crypto extensions
+ *
+ * @return           The function or NULL if the CPU does not support the extensions
+ */
+digestBlocks_t getSHA1BlocksARM()
+{
+	return hasSHA1() ? sha1BlocksCE : NULL;
+}
+
+
+
+/**
+ * Return the SHA-256 compression function using the crypto extensions
+ *
+ * @return           The function or NULL if the CPU does not support the extensions
+ */
+digestBlocks_t getSHA256BlocksARM()
+{
+	return hasSHA2() ? sha256BlocksCE : NULL;
+}
+
+#else
+
+digestBlocks_t getSHA1BlocksARM()
+{
+	return NULL;
+}
+
+
+
+digestBlocks_t getSHA256BlocksARM()
+{
+	return NULL;
+}
+
+#endif
@@ -0,0 +1,253 @@
+/**
+ * SmartCard-HSM PKCS#11 Module
+ *
+ * Copyright (c) 2013, CardContact Systems GmbH, Minden, Germany
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of CardContact Systems GmbH nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CardContact Systems GmbH BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file    digest-x86.c
+ * @brief   SHA-1 and SHA-256 compression functions using the x86 SHA extensions
+ *
+ * The kernels are compiled with a function specific target, so that the module
+ * still runs on CPUs without SHA extensions. CPUID decides at runtime if they are used.
+ */
+
+#include <pkcs11/digest.h>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#define TARGET_SHA
+#else
+#include <cpuid.h>
+#define TARGET_SHA __attribute__((target("sha,sse4.1,ssse3")))
+#endif
+
+#include <immintrin.h>
+
+
+
+static int hasSHAExtensions()
+{
+#ifdef _MSC_VER
+	int r[4];
+
+	__cpuid(r, 0);
+	if (r[0] < 7)
+		return 0;
+
+	__cpuid(r, 1);
+	if (!(r[2] & (1 << 19)) || !(r[2] & (1 << 9)))		// SSE4.1 and SSSE3
+		return 0;
+
+	__cpuidex(r, 7, 0);
+	return (r[1] >> 29) & 1;
+#else
+	unsigned int a, b, c, d;
+
+	if (__get_cpuid_max(0, NULL) < 7)
+		return 0;
+
+	__cpuid(1, a, b, c, d);
+	if (!(c & bit_SSE4_1) || !(c & bit_SSSE3))
+		return 0;
+
+	__cpuid_count(7, 0, a, b, c, d);
+	return (b >> 29) & 1;
+#endif
+}
+
+
+
+TARGET_SHA
+static void sha1BlocksSHANI(void *st, const unsigned char *data, size_t blocks)
+{
+	uint32_t *state = (uint32_t *)st;
+	__m128i abcd, abcdSave, e0, e0Save, e1, m0, m1, m2, m3;
+	const __m128i mask = _mm_set_epi64x(0x0001020304050607ULL, 0x08090A0B0C0D0E0FULL);
+
+	abcd = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)state), 0x1B);
+	e0 = _mm_set_epi32(state[4], 0, 0, 0);
+
+	// Four rounds using e0/e1 alternately, then advance the message schedule
+#define ROUNDS4(ea, eb, m, f) \
+	ea = _mm_sha1nexte_epu32(ea, m); \
+	eb = abcd; \
+	abcd = _mm_sha1rnds4_epu32(abcd, ea, f)
+#define MSG1(a, b)      a = _mm_sha1msg1_epu32(a, b)
+#define MSG2(a, b)      a = _mm_sha1msg2_epu32(a, b)
+#define XOR(a, b)       a = _mm_xor_si128(a, b)
+
+	while (blocks--) {
+		abcdSave = abcd;
+		e0Save = e0;
+
+		m0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 0)), mask);
+		m1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 16)), mask);
+		m2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 32)), mask);
+		m3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 48)), mask);
+
+		e0 = _mm_add_epi32(e0, m0);
+		e1 = abcd;
+		abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+
+		ROUNDS4(e1, e0, m1, 0); MSG1(m0, m1);
+		ROUNDS4(e0, e1, m2, 0); MSG1(m1, m2); XOR(m0, m2);
+		ROUNDS4(e1, e0, m3, 0); MSG2(m0, m3); MSG1(m2, m3); XOR(m1, m3);
+		ROUNDS4(e0, e1, m0, 0); MSG2(m1, m0); MSG1(m3, m0); XOR(m2, m0);
+		ROUNDS4(e1, e0, m1, 1); MSG2(m2, m1); MSG1(m0, m1); XOR(m3, m1);
+		ROUNDS4(e0, e1, m2, 1); MSG2(m3, m2); MSG1(m1, m2); XOR(m0, m2);
+		ROUNDS4(e1, e0, m3, 1); MSG2(m0, m3); MSG1(m2, m3); XOR(m1, m3);
+		ROUNDS4(e0, e1, m0, 1); MSG2(m1, m0); MSG1(m3, m0); XOR(m2, m0);
+		ROUNDS4(e1, e0, m1, 1); MSG2(m2, m1); MSG1(m0, m1); XOR(m3, m1);
+		ROUNDS4(e0, e1, m2, 2); MSG2(m3, m2); MSG1(m1, m2); XOR(m0, m2);
+		ROUNDS4(e1, e0, m3, 2); MSG2(m0, m3); MSG1(m2, m3); XOR(m1, m3);
+		ROUNDS4(e0, e1, m0, 2); MSG2(m1, m0); MSG1(m3, m0); XOR(m2, m0);
+		ROUNDS4(e1, e0, m1, 2); MSG2(m2, m1); MSG1(m0, m1); XOR(m3, m1);
+		ROUNDS4(e0, e1, m2, 2); MSG2(m3, m2); MSG1(m1, m2); XOR(m0, m2);
+		ROUNDS4(e1, e0, m3, 3); MSG2(m0, m3); MSG1(m2, m3); XOR(m1, m3);
+		ROUNDS4(e0, e1, m0, 3); MSG2(m1, m0); MSG1(m3, m0); XOR(m2, m0);
+		ROUNDS4(e1, e0, m1, 3); MSG2(m2, m1); XOR(m3, m1);
+		ROUNDS4(e0, e1, m2, 3); MSG2(m3, m2);
+		ROUNDS4(e1, e0, m3, 3);
+
+		e0 = _mm_sha1nexte_epu32(e0, e0Save);
+		abcd = _mm_add_epi32(abcd, abcdSave);
+
+		data += 64;
+	}
+
+#undef ROUNDS4
+#undef MSG1
+#undef MSG2
+#undef XOR
+
+	_mm_storeu_si128((__m128i *)state, _mm_shuffle_epi32(abcd, 0x1B));
+	state[4] = _mm_extract_epi32(e0, 3);
+}
+
+
+
+TARGET_SHA
+static void sha256BlocksSHANI(void *st, const unsigned char *data, size_t blocks)
+{
+	uint32_t *state = (uint32_t *)st;
+	__m128i state0, state1, abefSave, cdghSave, msg, tmp, m0, m1, m2, m3;
+	const __m128i mask = _mm_set_epi64x(0x0C0D0E0F08090A0BULL, 0x0405060700010203ULL);
+
+	// Rearrange ABCD EFGH into ABEF CDGH as expected by sha256rnds2
+	tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&state[0]), 0xB1);
+	state1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&state[4]), 0x1B);
+	state0 = _mm_alignr_epi8(tmp, state1, 8);
+	state1 = _mm_blend_epi16(state1, tmp, 0xF0);
+
+#define ROUNDS4(m, i) \
+	msg = _mm_add_epi32(m, _mm_loadu_si128((const __m128i *)&digestK256[i])); \
+	state1 = _mm_sha256rnds2_epu32(state1, state0, msg); \
+	state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(msg, 0x0E))
+#define MSG1(a, b)      a = _mm_sha256msg1_epu32(a, b)
+#define MSG2(a, b, c)   a = _mm_sha256msg2_epu32(_mm_add_epi32(a, _mm_alignr_epi8(b, c, 4)), b)
+
+	while (blocks--) {
+		abefSave = state0;
+		cdghSave = state1;
+
+		m0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 0)), mask);
+		m1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 16)), mask);
+		m2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 32)), mask);
+		m3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 48)), mask);
+
+		ROUNDS4(m0, 0);
+		ROUNDS4(m1, 4);  MSG1(m0, m1);
+		ROUNDS4(m2, 8);  MSG1(m1, m2);
+		ROUNDS4(m3, 12); MSG2(m0, m3, m2); MSG1(m2, m3);
+		ROUNDS4(m0, 16); MSG2(m1, m0, m3); MSG1(m3, m0);
+		ROUNDS4(m1, 20); MSG2(m2, m1, m0); MSG1(m0, m1);
+		ROUNDS4(m2, 24); MSG2(m3, m2, m1); MSG1(m1, m2);
+		ROUNDS4(m3, 28); MSG2(m0, m3, m2); MSG1(m2, m3);
+		ROUNDS4(m0, 32); MSG2(m1, m0, m3); MSG1(m3, m0);
+		ROUNDS4(m1, 36); MSG2(m2, m1, m0); MSG1(m0, m1);
+		ROUNDS4(m2, 40); MSG2(m3, m2, m1); MSG1(m1, m2);
+		ROUNDS4(m3, 44); MSG2(m0, m3, m2); MSG1(m2, m3);
+		ROUNDS4(m0, 48); MSG2(m1, m0, m3); MSG1(m3, m0);
+		ROUNDS4(m1, 52); MSG2(m2, m1, m0);
+		ROUNDS4(m2, 56); MSG2(m3, m2, m1);
+		ROUNDS4(m3, 60);
+
+		state0 = _mm_add_epi32(state0, abefSave);
+		state1 = _mm_add_epi32(state1, cdghSave);
+
+		data += 64;
+	}
+
+#undef ROUNDS4
+#undef MSG1
+#undef MSG2
+
+	tmp = _mm_shuffle_epi32(state0, 0x1B);
+	state1 = _mm_shuffle_epi32(state1, 0xB1);
+	_mm_storeu_si128((__m128i *)&state[0], _mm_blend_epi16(tmp, state1, 0xF0));
+	_mm_storeu_si128((__m128i *)&state[4], _mm_alignr_epi8(state1, tmp, 8));
+}
+
+
+
+/**
+ * Return the SHA-1 compression function using SHA extensions
+ *
+ * @return           The function or NULL if the CPU does not support SHA extensions
+ */
+digestBlocks_t getSHA1BlocksX86()
+{
+	return hasSHAExtensions() ? sha1BlocksSHANI : NULL;
+}
+
+
+
+/**
+ * Return the SHA-256 compression function using SHA extensions
+ *
+ * @return           The function or NULL if the CPU does not support SHA extensions
+ */
+digestBlocks_t getSHA256BlocksX86()
+{
+	return hasSHAExtensions() ? sha256BlocksSHANI : NULL;
+}
+
+#else
+
+digestBlocks_t getSHA1BlocksX86()
+{
+	return NULL;
+}
+
+
+
+digestBlocks_t getSHA256BlocksX86()
+{
+	return NULL;
+}
+
+#endif
@@ -0,0 +1,655 @@
+/**
+ * SmartCard-HSM PKCS#11 Module
+ *
+ * Copyright (c) 2013, CardContact Systems GmbH, Minden, Germany
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of CardContact Systems GmbH nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CardContact Systems GmbH BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file    digest.c
+ * @brief   Host implementation of the SHA-1 and SHA-2 hash functions
+ *
+ * The compression functions are selected once in initDigestEngine(). CPUs with
+ * hash instructions use the kernels in digest-x86.c or digest-arm.c for SHA-1 and
+ * SHA-256, all other cases use the portable implementation below. Setting the
+ * environment variable PKCS11_DIGEST_GENERIC disables the accelerated kernels.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <common/memset_s.h>
+
+#include <pkcs11/digest.h>
+
+#ifdef DEBUG
+#include <pkcs11/debug.h>
+#endif
+
+
+
+#define ROL32(x, n)     (((x) << (n)) | ((x) >> (32 - (n))))
+#define ROR32(x, n)     (((x) >> (n)) | ((x) << (32 - (n))))
+#define ROR64(x, n)     (((x) >> (n)) | ((x) << (64 - (n))))
+
+#define CH(x, y, z)     (((x) & (y)) ^ (~(x) & (z)))
+#define MAJ(x, y, z)    (((x) & (y)) | ((z) & ((x) | (y))))
+
+
+
+static const uint32_t sha1IV[5] = {
+	0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0
+};
+
+static const uint32_t sha224IV[8] = {
+	0xC1059ED8, 0x367CD507, 0x3070DD17, 0xF70E5939, 0xFFC00B31, 0x68581511, 0x64F98FA7, 0xBEFA4FA4
+};
+
+static const uint32_t sha256IV[8] = {
+	0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A, 0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19
+};
+
+static const uint64_t sha384IV[8] = {
+	0xCBBB9D5DC1059ED8ULL, 0x629A292A367CD507ULL, 0x9159015A3070DD17ULL, 0x152FECD8F70E5939ULL,
+	0x67332667FFC00B31ULL, 0x8EB44A8768581511ULL, 0xDB0C2E0D64F98FA7ULL, 0x47B5481DBEFA4FA4ULL
+};
+
+static const uint64_t sha512IV[8] = {
+	0x6A09E667F3BCC908ULL, 0xBB67AE8584CAA73BULL, 0x3C6EF372FE94F82BULL, 0xA54FF53A5F1D36F1ULL,
+	0x510E527FADE682D1ULL, 0x9B05688C2B3E6C1FULL, 0x1F83D9ABFB41BD6BULL, 0x5BE0CD19137E2179ULL
+};
+
+/* DER encoded DigestInfo without the hash value as used in PKCS#1 v1.5 signatures */
+static const unsigned char sha1Prefix[] = {
+	0x30, 0x21, 0x30, 0x09, 0x06, 0x05, 0x2B, 0x0E, 0x03, 0x02, 0x1A, 0x05, 0x00, 0x04, 0x14
+};
+
+static const unsigned char sha224Prefix[] = {
+	0x30, 0x2D, 0x30, 0x0D, 0x06, 0x09, 0x60, 0x86, 0x48, 0x01, 0x65, 0x03, 0x04, 0x02, 0x04, 0x05, 0x00, 0x04, 0x1C
+};
+
+static const unsigned char sha256Prefix[] = {
+	0x30, 0x31, 0x30, 0x0D, 0x06, 0x09, 0x60, 0x86, 0x48, 0x01, 0x65, 0x03, 0x04, 0x02, 0x01, 0x05, 0x00, 0x04, 0x20
+};
+
+static const unsigned char sha384Prefix[] = {
+	0x30, 0x41, 0x30, 0x0D, 0x06, 0x09, 0x60, 0x86, 0x48, 0x01, 0x65, 0x03, 0x04, 0x02, 0x02, 0x05, 0x00, 0x04, 0x30
+};
+
+static const unsigned char sha512Prefix[] = {
+	0x30, 0x51, 0x30, 0x0D, 0x06, 0x09, 0x60, 0x86, 0x48, 0x01, 0x65, 0x03, 0x04, 0x02, 0x03, 0x05, 0x00, 0x04, 0x40
+};
+
+/* Round constants, also used by the accelerated SHA-256 kernels */
+const uint32_t digestK256[64] = {
+	0x428A2F98, 0x71374491, 0xB5C0FBCF, 0xE9B5DBA5, 0x3956C25B, 0x59F111F1, 0x923F82A4, 0xAB1C5ED5,
+	0xD807AA98, 0x12835B01, 0x243185BE, 0x550C7DC3, 0x72BE5D74, 0x80DEB1FE, 0x9BDC06A7, 0xC19BF174,
+	0xE49B69C1, 0xEFBE4786, 0x0FC19DC6, 0x240CA1CC, 0x2DE92C6F, 0x4A7484AA, 0x5CB0A9DC, 0x76F988DA,
+	0x983E5152, 0xA831C66D, 0xB00327C8, 0xBF597FC7, 0xC6E00BF3, 0xD5A79147, 0x06CA6351, 0x14292967,
+	0x27B70A85, 0x2E1B2138, 0x4D2C6DFC, 0x53380D13, 0x650A7354, 0x766A0ABB, 0x81C2C92E, 0x92722C85,
+	0xA2BFE8A1, 0xA81A664B, 0xC24B8B70, 0xC76C51A3, 0xD192E819, 0xD6990624, 0xF40E3585, 0x106AA070,
+	0x19A4C116, 0x1E376C08, 0x2748774C, 0x34B0BCB5, 0x391C0CB3, 0x4ED8AA4A, 0x5B9CCA4F, 0x682E6FF3,
+	0x748F82EE, 0x78A5636F, 0x84C87814, 0x8CC70208, 0x90BEFFFA, 0xA4506CEB, 0xBEF9A3F7, 0xC67178F2
+};
+
+static const uint64_t K512[80] = {
+	0x428A2F98D728AE22ULL, 0x7137449123EF65CDULL, 0xB5C0FBCFEC4D3B2FULL, 0xE9B5DBA58189DBBCULL,
+	0x3956C25BF348B538ULL, 0x59F111F1B605D019ULL, 0x923F82A4AF194F9BULL, 0xAB1C5ED5DA6D8118ULL,
+	0xD807AA98A3030242ULL, 0x12835B0145706FBEULL, 0x243185BE4EE4B28CULL, 0x550C7DC3D5FFB4E2ULL,
+	0x72BE5D74F27B896FULL, 0x80DEB1FE3B1696B1ULL, 0x9BDC06A725C71235ULL, 0xC19BF174CF692694ULL,
+	0xE49B69C19EF14AD2ULL, 0xEFBE4786384F25E3ULL, 0x0FC19DC68B8CD5B5ULL, 0x240CA1CC77AC9C65ULL,
+	0x2DE92C6F592B0275ULL, 0x4A7484AA6EA6E483ULL, 0x5CB0A9DCBD41FBD4ULL, 0x76F988DA831153B5ULL,
+	0x983E5152EE66DFABULL, 0xA831C66D2DB43210ULL, 0xB00327C898FB213FULL, 0xBF597FC7BEEF0EE4ULL,
+	0xC6E00BF33DA88FC2ULL, 0xD5A79147930AA725ULL, 0x06CA6351E003826FULL, 0x142929670A0E6E70ULL,
+	0x27B70A8546D22FFCULL, 0x2E1B21385C26C926ULL, 0x4D2C6DFC5AC42AEDULL, 0x53380D139D95B3DFULL,
+	0x650A73548BAF63DEULL, 0x766A0ABB3C77B2A8ULL, 0x81C2C92E47EDAEE6ULL, 0x92722C851482353BULL,
+	0xA2BFE8A14CF10364ULL, 0xA81A664BBC423001ULL, 0xC24B8B70D0F89791ULL, 0xC76C51A30654BE30ULL,
+	0xD192E819D6EF5218ULL, 0xD69906245565A910ULL, 0xF40E35855771202AULL, 0x106AA07032BBD1B8ULL,
+	0x19A4C116B8D2D0C8ULL, 0x1E376C085141AB53ULL, 0x2748774CDF8EEB99ULL, 0x34B0BCB5E19B48A8ULL,
+	0x391C0CB3C5C95A63ULL, 0x4ED8AA4AE3418ACBULL, 0x5B9CCA4F7763E373ULL, 0x682E6FF3D6B2B8A3ULL,
+	0x748F82EE5DEFB2FCULL, 0x78A5636F43172F60ULL, 0x84C87814A1F0AB72ULL, 0x8CC702081A6439ECULL,
+	0x90BEFFFA23631E28ULL, 0xA4506CEBDE82BDE9ULL, 0xBEF9A3F7B2C67915ULL, 0xC67178F2E372532BULL,
+	0xCA273ECEEA26619CULL, 0xD186B8C721C0C207ULL, 0xEADA7DD6CDE0EB1EULL, 0xF57D4F7FEE6ED178ULL,
+	0x06F067AA72176FBAULL, 0x0A637DC5A2C898A6ULL, 0x113F9804BEF90DAEULL, 0x1B710B35131C471BULL,
+	0x28DB77F523047D84ULL, 0x32CAAB7B40C72493ULL, 0x3C9EBE0A15C9BEBCULL, 0x431D67C49C100D4CULL,
+	0x4CC5D4BECB3E42B6ULL, 0x597F299CFC657E2AULL, 0x5FCB6FAB3AD6FAECULL, 0x6C44198C4A475817ULL
+};
+
+
+
+static uint32_t load32(const unsigned char *p)
+{
+	return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+
+
+static uint64_t load64(const unsigned char *p)
+{
+	return ((uint64_t)load32(p) << 32) | load32(p + 4);
+}
+
+
+
+static void store32(unsigned char *p, uint32_t v)
+{
+	p[0] = (unsigned char)(v >> 24);
+	p[1] = (unsigned char)(v >> 16);
+	p[2] = (unsigned char)(v >> 8);
+	p[3] = (unsigned char)v;
+}
+
+
+
+static void store64(unsigned char *p, uint64_t v)
+{
+	store32(p, (uint32_t)(v >> 32));
+	store32(p + 4, (uint32_t)v);
+}
+
+
+
+/*
+ * Portable SHA-1 compression function
+ */
+static void sha1Blocks(void *st, const unsigned char *data, size_t blocks)
+{
+	uint32_t *state = (uint32_t *)st;
+	uint32_t w[16], a, b, c, d, e, t, x;
+	int i;
+
+	while (blocks--) {
+		for (i = 0; i < 16; i++) {
+			w[i] = load32(data + 4 * i);
+		}
+
+		a = state[0];
+		b = state[1];
+		c = state[2];
+		d = state[3];
+		e = state[4];
+
+#define SHA1_W(i)   (i < 16 ? w[i] : (x = w[(i + 13) & 15] ^ w[(i + 8) & 15] ^ w[(i + 2) & 15] ^ w[i & 15], w[i & 15] = ROL32(x, 1)))
+#define SHA1_ROUND(f, k) \
+		t = ROL32(a, 5) + (f) + e + (k) + SHA1_W(i); \
+		e = d; d = c; c = ROL32(b, 30); b = a; a = t
+
+		for (i = 0; i < 20; i++) {
+			SHA1_ROUND(CH(b, c, d), 0x5A827999);
+		}
+		for (; i < 40; i++) {
+			SHA1_ROUND(b ^ c ^ d, 0x6ED9EBA1);
+		}
+		for (; i < 60; i++) {
+			SHA1_ROUND(MAJ(b, c, d), 0x8F1BBCDC);
+		}
+		for (; i < 80; i++) {
+			SHA1_ROUND(b ^ c ^ d, 0xCA62C1D6);
+		}
+
+#undef SHA1_ROUND
+#undef SHA1_W
+
+		state[0] += a;
+		state[1] += b;
+		state[2] += c;
+		state[3] += d;
+		state[4] += e;
+
+		data += 64;
+	}
+
+	memset_s(w, sizeof(w), 0, sizeof(w));
+}
+
+
+
+/*
+ * Portable SHA-256 compression function
+ */
+static void sha256Blocks(void *st, const unsigned char *data, size_t blocks)
+{
+	uint32_t *state = (uint32_t *)st;
+	uint32_t w[64], s[8], t1, t2;
+	int i;
+
+	while (blocks--) {
+		for (i = 0; i < 16; i++) {
+			w[i] = load32(data + 4 * i);
+		}
+
+		for (; i < 64; i++) {
+			w[i] = w[i - 16] + w[i - 7] +
+				(ROR32(w[i - 15], 7) ^ ROR32(w[i - 15], 18) ^ (w[i - 15] >> 3)) +
+				(ROR32(w[i - 2], 17) ^ ROR32(w[i - 2], 19) ^ (w[i - 2] >> 10));
+		}
+
+		memcpy(s, state, sizeof(s));
+
+		// Eight rounds per iteration rotate the working variables by renaming
+#define SHA256_ROUND(a, b, c, d, e, f, g, h, i) \
+		t1 = h + (ROR32(e, 6) ^ ROR32(e, 11) ^ ROR32(e, 25)) + CH(e, f, g) + digestK256[i] + w[i]; \
+		t2 = (ROR32(a, 2) ^ ROR32(a, 13) ^ ROR32(a, 22)) + MAJ(a, b, c); \
+		d += t1; \
+		h = t1 + t2
+
+		for (i = 0; i < 64; i += 8) {
+			SHA256_ROUND(s[0], s[1], s[2], s[3], s[4], s[5], s[6], s[7], i);
+			SHA256_ROUND(s[7], s[0], s[1], s[2], s[3], s[4], s[5], s[6], i + 1);
+			SHA256_ROUND(s[6], s[7], s[0], s[1], s[2], s[3], s[4], s[5], i + 2);
+			SHA256_ROUND(s[5], s[6], s[7], s[0], s[1], s[2], s[3], s[4], i + 3);
+			SHA256_ROUND(s[4], s[5], s[6], s[7], s[0], s[1], s[2], s[3], i + 4);
+			SHA256_ROUND(s[3], s[4], s[5], s[6], s[7], s[0], s[1], s[2], i + 5);
+			SHA256_ROUND(s[2], s[3], s[4], s[5], s[6], s[7], s[0], s[1], i + 6);
+			SHA256_ROUND(s[1], s[2], s[3], s[4], s[5], s[6], s[7], s[0], i + 7);
+		}
+
+#undef SHA256_ROUND
+
+		for (i = 0; i < 8; i++) {
+			state[i] += s[i];
+		}
+
+		data += 64;
+	}
+
+	memset_s(w, sizeof(w), 0, sizeof(w));
+	memset_s(s, sizeof(s), 0, sizeof(s));
+}
+
+
+
+/*
+ * Portable SHA-512 compression function
+ */
+static void sha512Blocks(void *st, const unsigned char *data, size_t blocks)
+{
+	uint64_t *state = (uint64_t *)st;
+	uint64_t w[80], s[8], t1, t2;
+	int i;
+
+	while (blocks--) {
+		for (i = 0; i < 16; i++) {
+			w[i] = load64(data + 8 * i);
+		}
+
+		for (; i < 80; i++) {
+			w[i] = w[i - 16] + w[i - 7] +
+				(ROR64(w[i - 15], 1) ^ ROR64(w[i - 15], 8) ^ (w[i - 15] >> 7)) +
+				(ROR64(w[i - 2], 19) ^ ROR64(w[i - 2], 61) ^ (w[i - 2] >> 6));
+		}
+
+		memcpy(s, state, sizeof(s));
+
+#define SHA512_ROUND(a, b, c, d, e, f, g, h, i) \
+		t1 = h + (ROR64(e, 14) ^ ROR64(e, 18) ^ ROR64(e, 41)) + CH(e, f, g) + K512[i] + w[i]; \
+		t2 = (ROR64(a, 28) ^ ROR64(a, 34) ^ ROR64(a, 39)) + MAJ(a, b, c); \
+		d += t1; \
+		h = t1 + t2
+
+		for (i = 0; i < 80; i += 8) {
+			SHA512_ROUND(s[0], s[1], s[2], s[3], s[4], s[5], s[6], s[7], i);
+			SHA512_ROUND(s[7], s[0], s[1], s[2], s[3], s[4], s[5], s[6], i + 1);
+			SHA512_ROUND(s[6], s[7], s[0], s[1], s[2], s[3], s[4], s[5], i + 2);
+			SHA512_ROUND(s[5], s[6], s[7], s[0], s[1], s[2], s[3], s[4], i + 3);
+			SHA512_ROUND(s[4], s[5], s[6], s[7], s[0], s[1], s[2], s[3], i + 4);
+			SHA512_ROUND(s[3], s[4], s[5], s[6], s[7], s[0], s[1], s[2], i + 5);
+			SHA512_ROUND(s[2], s[3], s[4], s[5], s[6], s[7], s[0], s[1], i + 6);
+			SHA512_ROUND(s[1], s[2], s[3], s[4], s[5], s[6], s[7], s[0], i + 7);
+		}
+
+#undef SHA512_ROUND
+
+		for (i = 0; i < 8; i++) {
+			state[i] += s[i];
+		}
+
+		data += 128;
+	}
+
+	memset_s(w, sizeof(w), 0, sizeof(w));
+	memset_s(s, sizeof(s), 0, sizeof(s));
+}
+
+
+
+static digestBlocks_t sha1Impl = sha1Blocks;
+static digestBlocks_t sha256Impl = sha256Blocks;
+static digestBlocks_t sha512Impl = sha512Blocks;
+
+static const char *sha1Name = "generic";
+static const char *sha256Name = "generic";
+static const char *sha512Name = "generic";
+
+/**
+ * Supported hash mechanisms
+ */
+static struct digestAlgorithm {
+	CK_MECHANISM_TYPE mech;           /**< The hash mechanism                  */
+	int size;                         /**< Length of the hash value            */
+	int blockSize;                    /**< Length of a block                   */
+	const void *iv;                   /**< Initial hash value                  */
+	int ivSize;                       /**< Size of initial hash value          */
+	digestBlocks_t *blocks;           /**< Selected compression function       */
+	const char **implementation;      /**< Name of selected implementation     */
+	const unsigned char *prefix;      /**< DigestInfo header                   */
+	int prefixSize;                   /**< Length of DigestInfo header         */
+} digestAlgorithms[] = {
+	{ CKM_SHA_1,  20, 64,  sha1IV,   sizeof(sha1IV),   &sha1Impl,   &sha1Name,   sha1Prefix,   sizeof(sha1Prefix) },
+	{ CKM_SHA224, 28, 64,  sha224IV, sizeof(sha224IV), &sha256Impl, &sha256Name, sha224Prefix, sizeof(sha224Prefix) },
+	{ CKM_SHA256, 32, 64,  sha256IV, sizeof(sha256IV), &sha256Impl, &sha256Name, sha256Prefix, sizeof(sha256Prefix) },
+	{ CKM_SHA384, 48, 128, sha384IV, sizeof(sha384IV), &sha512Impl, &sha512Name, sha384Prefix, sizeof(sha384Prefix) },
+	{ CKM_SHA512, 64, 128, sha512IV, sizeof(sha512IV), &sha512Impl, &sha512Name, sha512Prefix, sizeof(sha512Prefix) }
+};
+
+
+
+static struct digestAlgorithm *findAlgorithm(CK_MECHANISM_TYPE mech)
+{
+	int i;
+
+	for (i = 0; i < sizeof(digestAlgorithms) / sizeof(*digestAlgorithms); i++) {
+		if (digestAlgorithms[i].mech == mech)
+			return &digestAlgorithms[i];
+	}
+	return NULL;
+}
+
+
+
+/**
+ * Select the compression functions for the CPU. Called from C_Initialize().
+ */
+void initDigestEngine()
+{
+	digestBlocks_t f;
+
+	sha1Impl = sha1Blocks;
+	sha256Impl = sha256Blocks;
+	sha512Impl = sha512Blocks;
+	sha1Name = sha256Name = sha512Name = "generic";
+
+	if (getenv("PKCS11_DIGEST_GENERIC"))
+		return;
+
+	if ((f = getSHA1BlocksX86()) != NULL) {
+		sha1Impl = f;
+		sha1Name = "x86 SHA extensions";
+	} else if ((f = getSHA1BlocksARM()) != NULL) {
+		sha1Impl = f;
+		sha1Name = "ARMv8 crypto extensions";
+	}
+
+	if ((f = getSHA256BlocksX86()) != NULL) {
+		sha256Impl = f;
+		sha256Name = "x86 SHA extensions";
+	} else if ((f = getSHA256BlocksARM()) != NULL) {
+		sha256Impl = f;
+		sha256Name = "ARMv8 crypto extensions";
+	}
+
+#ifdef DEBUG
+	debug("SHA-1 %s, SHA-256 %s, SHA-512 %s\n", sha1Name, sha256Name, sha512Name);
+#endif
+}
+
+
+
+/**
+ * Return the length of the hash value
+ *
+ * @param mech       The hash mechanism
+ * @return           The length or -1 if the mechanism is not supported
+ */
+int getDigestSize(CK_MECHANISM_TYPE mech)
+{
+	struct digestAlgorithm *alg = findAlgorithm(mech);
+
+	return alg ? alg->size : -1;
+}
+
+
+
+/**
+ * Return the name of the compression function selected for the mechanism
+ *
+ * @param mech       The hash mechanism
+ * @return           The name or NULL if the mechanism is not supported
+ */
+const char *getDigestImplementation(CK_MECHANISM_TYPE mech)
+{
+	struct digestAlgorithm *alg = findAlgorithm(mech);
+
+	return alg ? *alg->implementation : NULL;
+}
+
+
+
+/**
+ * Return the DER encoded DigestInfo header that precedes the hash value
+ *
+ * @param mech       The hash mechanism
+ * @param len        The variable receiving the length of the header
+ * @return           The header or NULL if the mechanism is not supported
+ */
+const unsigned char *getDigestInfoPrefix(CK_MECHANISM_TYPE mech, int *len)
+{
+	struct digestAlgorithm *alg = findAlgorithm(mech);
+
+	if (alg == NULL)
+		return NULL;
+
+	*len = alg->prefixSize;
+	return alg->prefix;
+}
+
+
+
+/**
+ * Copy the supported hash mechanisms into the list
+ *
+ * @param pMechanismList The list or NULL to determine the number of mechanisms
+ * @param ulCount       The size of the list
+ * @return              The number of hash mechanisms
+ */
+int getDigestMechanisms(CK_MECHANISM_TYPE_PTR pMechanismList, CK_ULONG ulCount)
+{
+	int i, count;
+
+	count = sizeof(digestAlgorithms) / sizeof(*digestAlgorithms);
+
+	for (i = 0; pMechanismList && (i < count) && (i < ulCount); i++) {
+		pMechanismList[i] = digestAlgorithms[i].mech;
+	}
+
+	return count;
+}
+
+
+
+/**
+ * Start a hash computation
+ *
+ * @param ctx        The context
+ * @param mech       The hash mechanism
+ * @return           CKR_OK or CKR_MECHANISM_INVALID
+ */
+int digestInit(struct digestContext *ctx, CK_MECHANISM_TYPE mech)
+{
+	struct digestAlgorithm *alg = findAlgorithm(mech);
+
+	if (alg == NULL)
+		return CKR_MECHANISM_INVALID;
+
+	memset(ctx, 0, sizeof(*ctx));
+	ctx->mech = mech;
+	ctx->size = alg->size;
+	ctx->blockSize = alg->blockSize;
+	memcpy(&ctx->state, alg->iv, alg->ivSize);
+
+	ctx->blocks = *alg->blocks;
+
+	return CKR_OK;
+}
+
+
+
+/**
+ * Add data to the hash computation
+ *
+ * @param ctx        The context
+ * @param data       The data
+ * @param len        The length of the data
+ */
+void digestUpdate(struct digestContext *ctx, const unsigned char *data, size_t len)
+{
+	size_t n;
+
+	ctx->length += len;
+
+	if (ctx->buffered) {
+		n = ctx->blockSize - ctx->buffered;
+		if (n > len)
+			n = len;
+
+		memcpy(ctx->buffer + ctx->buffered, data, n);
+		ctx->buffered += (int)n;
+		data += n;
+		len -= n;
+
+		if (ctx->buffered < ctx->blockSize)
+			return;
+
+		ctx->blocks(&ctx->state, ctx->buffer, 1);
+		ctx->buffered = 0;
+	}
+
+	n = len / ctx->blockSize;
+
+	if (n) {
+		ctx->blocks(&ctx->state, data, n);
+		data += n * ctx->blockSize;
+		len -= n * ctx->blockSize;
+	}
+
+	if (len) {
+		memcpy(ctx->buffer, data, len);
+		ctx->buffered = (int)len;
+	}
+}
+
+
+
+/**
+ * Export the intermediate hash value over the complete blocks processed so far
+ *
+ * The chaining value is encoded big-endian in full width, i.e. 20 bytes for SHA-1,
+ * 32 bytes for SHA-224/256 and 64 bytes for SHA-384/512. Data still buffered in
+ * an incomplete block is not included.
+ *
+ * @param ctx        The context
+ * @param state      Buffer receiving the intermediate hash value of DIGEST_MAX_SIZE bytes
+ * @return           The length of the intermediate hash value
+ */
+int digestGetState(struct digestContext *ctx, unsigned char *state)
+{
+	int i;
+
+	if (ctx->blockSize == 128) {
+		for (i = 0; i < 8; i++) {
+			store64(state + 8 * i, ctx->state.s64[i]);
+		}
+		return 64;
+	}
+
+	for (i = 0; i < (ctx->size == 20 ? 5 : 8); i++) {
+		store32(state + 4 * i, ctx->state.s32[i]);
+	}
+	return i * 4;
+}
+
+
+
+/**
+ * Complete the hash computation and wipe the context
+ *
+ * @param ctx        The context
+ * @param digest     The buffer receiving the hash value of ctx->size bytes
+ * @return           The length of the hash value
+ */
+int digestFinal(struct digestContext *ctx, unsigned char *digest)
+{
+	int i, lenofs, size;
+
+	// SHA-384/512 use a 128 bit length field, of which the upper 64 bit remain zero
+	lenofs = ctx->blockSize - (ctx->blockSize == 128 ? 16 : 8);
+
+	ctx->buffer[ctx->buffered++] = 0x80;
+
+	if (ctx->buffered > lenofs) {
+		memset(ctx->buffer + ctx->buffered, 0, ctx->blockSize - ctx->buffered);
+		ctx->blocks(&ctx->state, ctx->buffer, 1);
+		ctx->buffered = 0;
+	}
+
+	memset(ctx->buffer + ctx->buffered, 0, ctx->blockSize - 8 - ctx->buffered);
+	store64(ctx->buffer + ctx->blockSize - 8, ctx->length << 3);
+	ctx->blocks(&ctx->state, ctx->buffer, 1);
+
+	if (ctx->blockSize == 128) {
+		for (i = 0; i < ctx->size / 8; i++) {
+			store64(digest + 8 * i, ctx->state.s64[i]);
+		}
+	} else {
+		for (i = 0; i < ctx->size / 4; i++) {
+			store32(digest + 4 * i, ctx->state.s32[i]);
+		}
+	}
+
+	size = ctx->size;
+	memset_s(ctx, sizeof(*ctx), 0, sizeof(*ctx));
+
+	return size;
+}
+
+
+
+/**
+ * Compute the hash value in a single call
+ *
+ * @param mech       The hash mechanism
+ * @param data       The data
+ * @param len        The length of the data
+ * @param digest     The buffer receiving the hash value
+ * @return           The length of the hash value or -1 if the mechanism is not supported
+ */
+int digest(CK_MECHANISM_TYPE mech, const unsigned char *data, size_t len, unsigned char *digest)
+{
+	struct digestContext ctx;
+
+	if (digestInit(&ctx, mech) != CKR_OK)
+		return -1;
+
+	digestUpdate(&ctx, data, len);
+	return digestFinal(&ctx, digest);
+}
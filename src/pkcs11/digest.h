@@ -0,0 +1,82 @@
+/**
+ * SmartCard-HSM PKCS#11 Module
+ *
+ * Copyright (c) 2013, CardContact Systems GmbH, Minden, Germany
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of CardContact Systems GmbH nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CardContact Systems GmbH BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file    digest.h
+ * @brief   Host implementation of the SHA-1 and SHA-2 hash functions
+ */
+
+#ifndef ___DIGEST_H_INC___
+#define ___DIGEST_H_INC___
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <pkcs11/cryptoki.h>
+
+#define DIGEST_MAX_SIZE         64
+#define DIGEST_MAX_BLOCK        128
+
+typedef void (*digestBlocks_t)(void *state, const unsigned char *data, size_t blocks);
+
+/**
+ * State of a hash computation
+ */
+struct digestContext {
+	CK_MECHANISM_TYPE mech;           /**< The hash mechanism                  */
+	int size;                         /**< Length of the hash value            */
+	int blockSize;                    /**< Length of a block, 64 or 128        */
+	digestBlocks_t blocks;            /**< Compression function                */
+	union {
+		uint32_t s32[8];
+		uint64_t s64[8];
+	} state;                          /**< Intermediate hash value             */
+	uint64_t length;                  /**< Number of bytes processed           */
+	unsigned char buffer[DIGEST_MAX_BLOCK]; /**< Incomplete block              */
+	int buffered;                     /**< Bytes in buffer                     */
+};
+
+void initDigestEngine();
+int getDigestSize(CK_MECHANISM_TYPE mech);
+const char *getDigestImplementation(CK_MECHANISM_TYPE mech);
+const unsigned char *getDigestInfoPrefix(CK_MECHANISM_TYPE mech, int *len);
+int getDigestMechanisms(CK_MECHANISM_TYPE_PTR pMechanismList, CK_ULONG ulCount);
+int digestInit(struct digestContext *ctx, CK_MECHANISM_TYPE mech);
+void digestUpdate(struct digestContext *ctx, const unsigned char *data, size_t len);
+int digestGetState(struct digestContext *ctx, unsigned char *state);
+int digestFinal(struct digestContext *ctx, unsigned char *digest);
+int digest(CK_MECHANISM_TYPE mech, const unsigned char *data, size_t len, unsigned char *digest);
+
+extern const uint32_t digestK256[64];
+
+/* Accelerated compression functions, NULL if not available on the CPU */
+digestBlocks_t getSHA1BlocksX86();
+digestBlocks_t getSHA256BlocksX86();
+digestBlocks_t getSHA1BlocksARM();
+digestBlocks_t getSHA256BlocksARM();
+
+#endif /* ___DIGEST_H_INC___ */
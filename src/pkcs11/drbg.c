@@ -0,0 +1,240 @@
+/**
+ * SmartCard-HSM PKCS#11 Module
+ *
+ * Copyright (c) 2013, CardContact Systems GmbH, Minden, Germany
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of CardContact Systems GmbH nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CardContact Systems GmbH BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file    drbg.c
+ * @brief   Hash_DRBG with SHA-256 according to NIST SP 800-90A
+ *
+ * The generator turns a small amount of entropy from the token into an
+ * arbitrary amount of random data at the speed of the host hash function.
+ * Entropy input, nonce and reseed policy are provided by the caller.
+ */
+
+#include <string.h>
+
+#include <common/memset_s.h>
+
+#include <pkcs11/digest.h>
+#include <pkcs11/drbg.h>
+
+
+
+/*
+ * a = (a + b) mod 2^seedlen, with b right aligned to a
+ */
+static void addModSeedLen(unsigned char *a, const unsigned char *b, size_t blen)
+{
+	unsigned int carry = 0;
+	int i, j;
+
+	for (i = DRBG_SEED_LEN - 1, j = (int)blen - 1; i >= 0; i--, j--) {
+		carry += a[i];
+		if (j >= 0)
+			carry += b[j];
+		a[i] = (unsigned char)carry;
+		carry >>= 8;
+	}
+}
+
+
+
+/*
+ * Hash_df from SP 800-90A 10.3.1, deriving seedlen bytes from the concatenation of up to three inputs
+ */
+static void hashDf(unsigned char *out,
+		unsigned char prefix, int usePrefix,
+		const unsigned char *in1, size_t in1Len,
+		const unsigned char *in2, size_t in2Len,
+		const unsigned char *in3, size_t in3Len)
+{
+	struct digestContext ctx;
+	unsigned char hdr[5], hash[32];
+	size_t ofs, l;
+
+	hdr[0] = 1;
+	hdr[1] = 0;
+	hdr[2] = 0;
+	hdr[3] = (DRBG_SEED_LEN * 8) >> 8;
+	hdr[4] = (DRBG_SEED_LEN * 8) & 0xFF;
+
+	for (ofs = 0; ofs < DRBG_SEED_LEN; ofs += l) {
+		digestInit(&ctx, CKM_SHA256);
+		digestUpdate(&ctx, hdr, sizeof(hdr));
+		if (usePrefix)
+			digestUpdate(&ctx, &prefix, 1);
+		if (in1Len)
+			digestUpdate(&ctx, in1, in1Len);
+		if (in2Len)
+			digestUpdate(&ctx, in2, in2Len);
+		if (in3Len)
+			digestUpdate(&ctx, in3, in3Len);
+		digestFinal(&ctx, hash);
+
+		l = DRBG_SEED_LEN - ofs;
+		if (l > sizeof(hash))
+			l = sizeof(hash);
+		memcpy(out + ofs, hash, l);
+		hdr[0]++;
+	}
+
+	memset_s(&ctx, sizeof(ctx), 0, sizeof(ctx));
+	memset_s(hash, sizeof(hash), 0, sizeof(hash));
+}
+
+
+
+/*
+ * Derive V and C from the seed material and reset the reseed counter
+ */
+static void drbgSetSeed(struct hashDrbg *drbg,
+		unsigned char prefix, int usePrefix,
+		const unsigned char *in1, size_t in1Len,
+		const unsigned char *in2, size_t in2Len,
+		const unsigned char *in3, size_t in3Len)
+{
+	unsigned char seed[DRBG_SEED_LEN];
+
+	hashDf(seed, prefix, usePrefix, in1, in1Len, in2, in2Len, in3, in3Len);
+	memcpy(drbg->V, seed, DRBG_SEED_LEN);
+	hashDf(drbg->C, 0x00, 1, drbg->V, DRBG_SEED_LEN, NULL, 0, NULL, 0);
+	drbg->reseedCounter = 1;
+
+	memset_s(seed, sizeof(seed), 0, sizeof(seed));
+}
+
+
+
+/**
+ * Instantiate the generator (SP 800-90A 10.1.1.2)
+ *
+ * @param drbg       The generator state
+ * @param entropy    Entropy input of at least DRBG_SECURITY_STRENGTH bytes
+ * @param entropyLen Length of entropy input
+ * @param nonce      Nonce of at least DRBG_SECURITY_STRENGTH / 2 bytes
+ * @param nonceLen   Length of nonce
+ * @param pers       Optional personalization string or NULL
+ * @param persLen    Length of personalization string
+ */
+void drbgInstantiate(struct hashDrbg *drbg,
+		const unsigned char *entropy, size_t entropyLen,
+		const unsigned char *nonce, size_t nonceLen,
+		const unsigned char *pers, size_t persLen)
+{
+	drbgSetSeed(drbg, 0, 0, entropy, entropyLen, nonce, nonceLen, pers, persLen);
+}
+
+
+
+/**
+ * Reseed the generator with fresh entropy (SP 800-90A 10.1.1.3)
+ *
+ * @param drbg       The generator state
+ * @param entropy    Entropy input of at least DRBG_SECURITY_STRENGTH bytes
+ * @param entropyLen Length of entropy input
+ * @param add        Optional additional input or NULL
+ * @param addLen     Length of additional input
+ */
+void drbgReseed(struct hashDrbg *drbg,
+		const unsigned char *entropy, size_t entropyLen,
+		const unsigned char *add, size_t addLen)
+{
+	unsigned char v[DRBG_SEED_LEN];
+
+	memcpy(v, drbg->V, DRBG_SEED_LEN);
+	drbgSetSeed(drbg, 0x01, 1, v, DRBG_SEED_LEN, entropy, entropyLen, add, addLen);
+	memset_s(v, sizeof(v), 0, sizeof(v));
+}
+
+
+
+/**
+ * Generate random bytes (SP 800-90A 10.1.1.4)
+ *
+ * @param drbg       The generator state
+ * @param out        The buffer receiving the random bytes
+ * @param outLen     The number of bytes, at most DRBG_MAX_REQUEST
+ * @param add        Optional additional input or NULL
+ * @param addLen     Length of additional input
+ * @return           0 or -1 if the request is too large or a reseed is required
+ */
+int drbgGenerate(struct hashDrbg *drbg,
+		unsigned char *out, size_t outLen,
+		const unsigned char *add, size_t addLen)
+{
+	struct digestContext ctx;
+	unsigned char data[DRBG_SEED_LEN], hash[32], cnt[8], one = 1, prefix;
+	uint64_t counter;
+	size_t l;
+	int i;
+
+	if ((outLen > DRBG_MAX_REQUEST) || (drbg->reseedCounter > DRBG_RESEED_INTERVAL))
+		return -1;
+
+	if (addLen) {
+		prefix = 0x02;
+		digestInit(&ctx, CKM_SHA256);
+		digestUpdate(&ctx, &prefix, 1);
+		digestUpdate(&ctx, drbg->V, DRBG_SEED_LEN);
+		digestUpdate(&ctx, add, addLen);
+		digestFinal(&ctx, hash);
+		addModSeedLen(drbg->V, hash, sizeof(hash));
+	}
+
+	// Hashgen
+	memcpy(data, drbg->V, DRBG_SEED_LEN);
+	while (outLen > 0) {
+		digest(CKM_SHA256, data, DRBG_SEED_LEN, hash);
+		l = outLen < sizeof(hash) ? outLen : sizeof(hash);
+		memcpy(out, hash, l);
+		out += l;
+		outLen -= l;
+		addModSeedLen(data, &one, 1);
+	}
+
+	// V = V + Hash(0x03 || V) + C + reseed_counter
+	prefix = 0x03;
+	digestInit(&ctx, CKM_SHA256);
+	digestUpdate(&ctx, &prefix, 1);
+	digestUpdate(&ctx, drbg->V, DRBG_SEED_LEN);
+	digestFinal(&ctx, hash);
+
+	counter = drbg->reseedCounter;
+	for (i = sizeof(cnt) - 1; i >= 0; i--) {
+		cnt[i] = (unsigned char)counter;
+		counter >>= 8;
+	}
+
+	addModSeedLen(drbg->V, hash, sizeof(hash));
+	addModSeedLen(drbg->V, drbg->C, DRBG_SEED_LEN);
+	addModSeedLen(drbg->V, cnt, sizeof(cnt));
+	drbg->reseedCounter++;
+
+	memset_s(&ctx, sizeof(ctx), 0, sizeof(ctx));
+	memset_s(data, sizeof(data), 0, sizeof(data));
+	memset_s(hash, sizeof(hash), 0, sizeof(hash));
+	return 0;
+}
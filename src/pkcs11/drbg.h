@@ -0,0 +1,64 @@
+/**
+ * SmartCard-HSM PKCS#11 Module
+ *
+ * Copyright (c) 2013, CardContact Systems GmbH, Minden, Germany
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of CardContact Systems GmbH nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CardContact Systems GmbH BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file    drbg.h
+ * @brief   Hash_DRBG with SHA-256 according to NIST SP 800-90A
+ */
+
+#ifndef ___DRBG_H_INC___
+#define ___DRBG_H_INC___
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define DRBG_SEED_LEN           55          /**< seedlen of SHA-256 in bytes                  */
+#define DRBG_SECURITY_STRENGTH  32          /**< Security strength of SHA-256 in bytes        */
+#define DRBG_MAX_REQUEST        65536       /**< Maximum number of bytes per generate request */
+#define DRBG_RESEED_INTERVAL    (1ULL << 48) /**< Maximum number of requests between reseeds  */
+
+/**
+ * Internal state of the Hash_DRBG
+ */
+struct hashDrbg {
+	unsigned char V[DRBG_SEED_LEN];       /**< Value updated with each request     */
+	unsigned char C[DRBG_SEED_LEN];       /**< Constant derived from the seed      */
+	uint64_t reseedCounter;               /**< Requests since last (re)seed        */
+};
+
+void drbgInstantiate(struct hashDrbg *drbg,
+		const unsigned char *entropy, size_t entropyLen,
+		const unsigned char *nonce, size_t nonceLen,
+		const unsigned char *pers, size_t persLen);
+void drbgReseed(struct hashDrbg *drbg,
+		const unsigned char *entropy, size_t entropyLen,
+		const unsigned char *add, size_t addLen);
+int drbgGenerate(struct hashDrbg *drbg,
+		unsigned char *out, size_t outLen,
+		const unsigned char *add, size_t addLen);
+
+#endif /* ___DRBG_H_INC___ */
@@ -0,0 +1,782 @@
+/**
+ * SmartCard-HSM PKCS#11 Module
+ *
+ * Copyright (c) 2013, CardContact Systems GmbH, Minden, Germany
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of CardContact Systems GmbH nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CardContact Systems GmbH BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file    ecc.c
+ * @brief   Elliptic curve arithmetic and ECDSA signature verification
+ *
+ * Curves are given either by the object identifier of a named curve or by explicit
+ * domain parameters in CKA_EC_PARAMS. Points use Jacobian coordinates, so that a
+ * single field inversion is needed when the result is converted to affine form.
+ */
+
+#include <string.h>
+
+#include <pkcs11/ecc.h>
+#include <pkcs11/asn1.h>
+
+
+
+/**
+ * Named curve with parameters p, a, b, Gx, Gy and n each encoded with size bytes
+ */
+struct ecNamedCurve {
+	const unsigned char *oid;
+	int oidLen;
+	int size;
+	const unsigned char *params;
+};
+
+/* secp192r1 */
+static const unsigned char secp192r1OID[] = { 0x06, 0x08, 0x2A, 0x86, 0x48, 0xCE, 0x3D, 0x03, 0x01, 0x01 };
+static const unsigned char secp192r1Params[] = {
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFE,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFE,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFC,
+	0x64, 0x21, 0x05, 0x19, 0xE5, 0x9C, 0x80, 0xE7, 0x0F, 0xA7, 0xE9, 0xAB, 0x72, 0x24, 0x30, 0x49,
+	0xFE, 0xB8, 0xDE, 0xEC, 0xC1, 0x46, 0xB9, 0xB1,
+	0x18, 0x8D, 0xA8, 0x0E, 0xB0, 0x30, 0x90, 0xF6, 0x7C, 0xBF, 0x20, 0xEB, 0x43, 0xA1, 0x88, 0x00,
+	0xF4, 0xFF, 0x0A, 0xFD, 0x82, 0xFF, 0x10, 0x12,
+	0x07, 0x19, 0x2B, 0x95, 0xFF, 0xC8, 0xDA, 0x78, 0x63, 0x10, 0x11, 0xED, 0x6B, 0x24, 0xCD, 0xD5,
+	0x73, 0xF9, 0x77, 0xA1, 0x1E, 0x79, 0x48, 0x11,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x99, 0xDE, 0xF8, 0x36,
+	0x14, 0x6B, 0xC9, 0xB1, 0xB4, 0xD2, 0x28, 0x31
+};
+
+/* secp224r1 */
+static const unsigned char secp224r1OID[] = { 0x06, 0x05, 0x2B, 0x81, 0x04, 0x00, 0x21 };
+static const unsigned char secp224r1Params[] = {
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFE,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFE,
+	0xB4, 0x05, 0x0A, 0x85, 0x0C, 0x04, 0xB3, 0xAB, 0xF5, 0x41, 0x32, 0x56, 0x50, 0x44, 0xB0, 0xB7,
+	0xD7, 0xBF, 0xD8, 0xBA, 0x27, 0x0B, 0x39, 0x43, 0x23, 0x55, 0xFF, 0xB4,
+	0xB7, 0x0E, 0x0C, 0xBD, 0x6B, 0xB4, 0xBF, 0x7F, 0x32, 0x13, 0x90, 0xB9, 0x4A, 0x03, 0xC1, 0xD3,
+	0x56, 0xC2, 0x11, 0x22, 0x34, 0x32, 0x80, 0xD6, 0x11, 0x5C, 0x1D, 0x21,
+	0xBD, 0x37, 0x63, 0x88, 0xB5, 0xF7, 0x23, 0xFB, 0x4C, 0x22, 0xDF, 0xE6, 0xCD, 0x43, 0x75, 0xA0,
+	0x5A, 0x07, 0x47, 0x64, 0x44, 0xD5, 0x81, 0x99, 0x85, 0x00, 0x7E, 0x34,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x16, 0xA2,
+	0xE0, 0xB8, 0xF0, 0x3E, 0x13, 0xDD, 0x29, 0x45, 0x5C, 0x5C, 0x2A, 0x3D
+};
+
+/* secp256r1 */
+static const unsigned char secp256r1OID[] = { 0x06, 0x08, 0x2A, 0x86, 0x48, 0xCE, 0x3D, 0x03, 0x01, 0x07 };
+static const unsigned char secp256r1Params[] = {
+	0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFC,
+	0x5A, 0xC6, 0x35, 0xD8, 0xAA, 0x3A, 0x93, 0xE7, 0xB3, 0xEB, 0xBD, 0x55, 0x76, 0x98, 0x86, 0xBC,
+	0x65, 0x1D, 0x06, 0xB0, 0xCC, 0x53, 0xB0, 0xF6, 0x3B, 0xCE, 0x3C, 0x3E, 0x27, 0xD2, 0x60, 0x4B,
+	0x6B, 0x17, 0xD1, 0xF2, 0xE1, 0x2C, 0x42, 0x47, 0xF8, 0xBC, 0xE6, 0xE5, 0x63, 0xA4, 0x40, 0xF2,
+	0x77, 0x03, 0x7D, 0x81, 0x2D, 0xEB, 0x33, 0xA0, 0xF4, 0xA1, 0x39, 0x45, 0xD8, 0x98, 0xC2, 0x96,
+	0x4F, 0xE3, 0x42, 0xE2, 0xFE, 0x1A, 0x7F, 0x9B, 0x8E, 0xE7, 0xEB, 0x4A, 0x7C, 0x0F, 0x9E, 0x16,
+	0x2B, 0xCE, 0x33, 0x57, 0x6B, 0x31, 0x5E, 0xCE, 0xCB, 0xB6, 0x40, 0x68, 0x37, 0xBF, 0x51, 0xF5,
+	0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0x00, 0x00, 0x00, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xBC, 0xE6, 0xFA, 0xAD, 0xA7, 0x17, 0x9E, 0x84, 0xF3, 0xB9, 0xCA, 0xC2, 0xFC, 0x63, 0x25, 0x51
+};
+
+/* secp384r1 */
+static const unsigned char secp384r1OID[] = { 0x06, 0x05, 0x2B, 0x81, 0x04, 0x00, 0x22 };
+static const unsigned char secp384r1Params[] = {
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFE,
+	0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFE,
+	0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFF, 0xFF, 0xFF, 0xFC,
+	0xB3, 0x31, 0x2F, 0xA7, 0xE2, 0x3E, 0xE7, 0xE4, 0x98, 0x8E, 0x05, 0x6B, 0xE3, 0xF8, 0x2D, 0x19,
+	0x18, 0x1D, 0x9C, 0x6E, 0xFE, 0x81, 0x41, 0x12, 0x03, 0x14, 0x08, 0x8F, 0x50, 0x13, 0x87, 0x5A,
+	0xC6, 0x56, 0x39, 0x8D, 0x8A, 0x2E, 0xD1, 0x9D, 0x2A, 0x85, 0xC8, 0xED, 0xD3, 0xEC, 0x2A, 0xEF,
+	0xAA, 0x87, 0xCA, 0x22, 0xBE, 0x8B, 0x05, 0x37, 0x8E, 0xB1, 0xC7, 0x1E, 0xF3, 0x20, 0xAD, 0x74,
+	0x6E, 0x1D, 0x3B, 0x62, 0x8B, 0xA7, 0x9B, 0x98, 0x59, 0xF7, 0x41, 0xE0, 0x82, 0x54, 0x2A, 0x38,
+	0x55, 0x02, 0xF2, 0x5D, 0xBF, 0x55, 0x29, 0x6C, 0x3A, 0x54, 0x5E, 0x38, 0x72, 0x76, 0x0A, 0xB7,
+	0x36, 0x17, 0xDE, 0x4A, 0x96, 0x26, 0x2C, 0x6F, 0x5D, 0x9E, 0x98, 0xBF, 0x92, 0x92, 0xDC, 0x29,
+	0xF8, 0xF4, 0x1D, 0xBD, 0x28, 0x9A, 0x14, 0x7C, 0xE9, 0xDA, 0x31, 0x13, 0xB5, 0xF0, 0xB8, 0xC0,
+	0x0A, 0x60, 0xB1, 0xCE, 0x1D, 0x7E, 0x81, 0x9D, 0x7A, 0x43, 0x1D, 0x7C, 0x90, 0xEA, 0x0E, 0x5F,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xC7, 0x63, 0x4D, 0x81, 0xF4, 0x37, 0x2D, 0xDF,
+	0x58, 0x1A, 0x0D, 0xB2, 0x48, 0xB0, 0xA7, 0x7A, 0xEC, 0xEC, 0x19, 0x6A, 0xCC, 0xC5, 0x29, 0x73
+};
+
+/* secp521r1 */
+static const unsigned char secp521r1OID[] = { 0x06, 0x05, 0x2B, 0x81, 0x04, 0x00, 0x23 };
+static const unsigned char secp521r1Params[] = {
+	0x01, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF,
+	0x01, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFC,
+	0x00, 0x51, 0x95, 0x3E, 0xB9, 0x61, 0x8E, 0x1C, 0x9A, 0x1F, 0x92, 0x9A, 0x21, 0xA0, 0xB6, 0x85,
+	0x40, 0xEE, 0xA2, 0xDA, 0x72, 0x5B, 0x99, 0xB3, 0x15, 0xF3, 0xB8, 0xB4, 0x89, 0x91, 0x8E, 0xF1,
+	0x09, 0xE1, 0x56, 0x19, 0x39, 0x51, 0xEC, 0x7E, 0x93, 0x7B, 0x16, 0x52, 0xC0, 0xBD, 0x3B, 0xB1,
+	0xBF, 0x07, 0x35, 0x73, 0xDF, 0x88, 0x3D, 0x2C, 0x34, 0xF1, 0xEF, 0x45, 0x1F, 0xD4, 0x6B, 0x50,
+	0x3F, 0x00,
+	0x00, 0xC6, 0x85, 0x8E, 0x06, 0xB7, 0x04, 0x04, 0xE9, 0xCD, 0x9E, 0x3E, 0xCB, 0x66, 0x23, 0x95,
+	0xB4, 0x42, 0x9C, 0x64, 0x81, 0x39, 0x05, 0x3F, 0xB5, 0x21, 0xF8, 0x28, 0xAF, 0x60, 0x6B, 0x4D,
+	0x3D, 0xBA, 0xA1, 0x4B, 0x5E, 0x77, 0xEF, 0xE7, 0x59, 0x28, 0xFE, 0x1D, 0xC1, 0x27, 0xA2, 0xFF,
+	0xA8, 0xDE, 0x33, 0x48, 0xB3, 0xC1, 0x85, 0x6A, 0x42, 0x9B, 0xF9, 0x7E, 0x7E, 0x31, 0xC2, 0xE5,
+	0xBD, 0x66,
+	0x01, 0x18, 0x39, 0x29, 0x6A, 0x78, 0x9A, 0x3B, 0xC0, 0x04, 0x5C, 0x8A, 0x5F, 0xB4, 0x2C, 0x7D,
+	0x1B, 0xD9, 0x98, 0xF5, 0x44, 0x49, 0x57, 0x9B, 0x44, 0x68, 0x17, 0xAF, 0xBD, 0x17, 0x27, 0x3E,
+	0x66, 0x2C, 0x97, 0xEE, 0x72, 0x99, 0x5E, 0xF4, 0x26, 0x40, 0xC5, 0x50, 0xB9, 0x01, 0x3F, 0xAD,
+	0x07, 0x61, 0x35, 0x3C, 0x70, 0x86, 0xA2, 0x72, 0xC2, 0x40, 0x88, 0xBE, 0x94, 0x76, 0x9F, 0xD1,
+	0x66, 0x50,
+	0x01, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFA, 0x51, 0x86, 0x87, 0x83, 0xBF, 0x2F, 0x96, 0x6B, 0x7F, 0xCC, 0x01, 0x48, 0xF7, 0x09,
+	0xA5, 0xD0, 0x3B, 0xB5, 0xC9, 0xB8, 0x89, 0x9C, 0x47, 0xAE, 0xBB, 0x6F, 0xB7, 0x1E, 0x91, 0x38,
+	0x64, 0x09
+};
+
+/* secp256k1 */
+static const unsigned char secp256k1OID[] = { 0x06, 0x05, 0x2B, 0x81, 0x04, 0x00, 0x0A };
+static const unsigned char secp256k1Params[] = {
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFE, 0xFF, 0xFF, 0xFC, 0x2F,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x07,
+	0x79, 0xBE, 0x66, 0x7E, 0xF9, 0xDC, 0xBB, 0xAC, 0x55, 0xA0, 0x62, 0x95, 0xCE, 0x87, 0x0B, 0x07,
+	0x02, 0x9B, 0xFC, 0xDB, 0x2D, 0xCE, 0x28, 0xD9, 0x59, 0xF2, 0x81, 0x5B, 0x16, 0xF8, 0x17, 0x98,
+	0x48, 0x3A, 0xDA, 0x77, 0x26, 0xA3, 0xC4, 0x65, 0x5D, 0xA4, 0xFB, 0xFC, 0x0E, 0x11, 0x08, 0xA8,
+	0xFD, 0x17, 0xB4, 0x48, 0xA6, 0x85, 0x54, 0x19, 0x9C, 0x47, 0xD0, 0x8F, 0xFB, 0x10, 0xD4, 0xB8,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFE,
+	0xBA, 0xAE, 0xDC, 0xE6, 0xAF, 0x48, 0xA0, 0x3B, 0xBF, 0xD2, 0x5E, 0x8C, 0xD0, 0x36, 0x41, 0x41
+};
+
+/* brainpoolP192r1 */
+static const unsigned char brainpoolP192r1OID[] = { 0x06, 0x09, 0x2B, 0x24, 0x03, 0x03, 0x02, 0x08, 0x01, 0x01, 0x03 };
+static const unsigned char brainpoolP192r1Params[] = {
+	0xC3, 0x02, 0xF4, 0x1D, 0x93, 0x2A, 0x36, 0xCD, 0xA7, 0xA3, 0x46, 0x30, 0x93, 0xD1, 0x8D, 0xB7,
+	0x8F, 0xCE, 0x47, 0x6D, 0xE1, 0xA8, 0x62, 0x97,
+	0x6A, 0x91, 0x17, 0x40, 0x76, 0xB1, 0xE0, 0xE1, 0x9C, 0x39, 0xC0, 0x31, 0xFE, 0x86, 0x85, 0xC1,
+	0xCA, 0xE0, 0x40, 0xE5, 0xC6, 0x9A, 0x28, 0xEF,
+	0x46, 0x9A, 0x28, 0xEF, 0x7C, 0x28, 0xCC, 0xA3, 0xDC, 0x72, 0x1D, 0x04, 0x4F, 0x44, 0x96, 0xBC,
+	0xCA, 0x7E, 0xF4, 0x14, 0x6F, 0xBF, 0x25, 0xC9,
+	0xC0, 0xA0, 0x64, 0x7E, 0xAA, 0xB6, 0xA4, 0x87, 0x53, 0xB0, 0x33, 0xC5, 0x6C, 0xB0, 0xF0, 0x90,
+	0x0A, 0x2F, 0x5C, 0x48, 0x53, 0x37, 0x5F, 0xD6,
+	0x14, 0xB6, 0x90, 0x86, 0x6A, 0xBD, 0x5B, 0xB8, 0x8B, 0x5F, 0x48, 0x28, 0xC1, 0x49, 0x00, 0x02,
+	0xE6, 0x77, 0x3F, 0xA2, 0xFA, 0x29, 0x9B, 0x8F,
+	0xC3, 0x02, 0xF4, 0x1D, 0x93, 0x2A, 0x36, 0xCD, 0xA7, 0xA3, 0x46, 0x2F, 0x9E, 0x9E, 0x91, 0x6B,
+	0x5B, 0xE8, 0xF1, 0x02, 0x9A, 0xC4, 0xAC, 0xC1
+};
+
+/* brainpoolP224r1 */
+static const unsigned char brainpoolP224r1OID[] = { 0x06, 0x09, 0x2B, 0x24, 0x03, 0x03, 0x02, 0x08, 0x01, 0x01, 0x05 };
+static const unsigned char brainpoolP224r1Params[] = {
+	0xD7, 0xC1, 0x34, 0xAA, 0x26, 0x43, 0x66, 0x86, 0x2A, 0x18, 0x30, 0x25, 0x75, 0xD1, 0xD7, 0x87,
+	0xB0, 0x9F, 0x07, 0x57, 0x97, 0xDA, 0x89, 0xF5, 0x7E, 0xC8, 0xC0, 0xFF,
+	0x68, 0xA5, 0xE6, 0x2C, 0xA9, 0xCE, 0x6C, 0x1C, 0x29, 0x98, 0x03, 0xA6, 0xC1, 0x53, 0x0B, 0x51,
+	0x4E, 0x18, 0x2A, 0xD8, 0xB0, 0x04, 0x2A, 0x59, 0xCA, 0xD2, 0x9F, 0x43,
+	0x25, 0x80, 0xF6, 0x3C, 0xCF, 0xE4, 0x41, 0x38, 0x87, 0x07, 0x13, 0xB1, 0xA9, 0x23, 0x69, 0xE3,
+	0x3E, 0x21, 0x35, 0xD2, 0x66, 0xDB, 0xB3, 0x72, 0x38, 0x6C, 0x40, 0x0B,
+	0x0D, 0x90, 0x29, 0xAD, 0x2C, 0x7E, 0x5C, 0xF4, 0x34, 0x08, 0x23, 0xB2, 0xA8, 0x7D, 0xC6, 0x8C,
+	0x9E, 0x4C, 0xE3, 0x17, 0x4C, 0x1E, 0x6E, 0xFD, 0xEE, 0x12, 0xC0, 0x7D,
+	0x58, 0xAA, 0x56, 0xF7, 0x72, 0xC0, 0x72, 0x6F, 0x24, 0xC6, 0xB8, 0x9E, 0x4E, 0xCD, 0xAC, 0x24,
+	0x35, 0x4B, 0x9E, 0x99, 0xCA, 0xA3, 0xF6, 0xD3, 0x76, 0x14, 0x02, 0xCD,
+	0xD7, 0xC1, 0x34, 0xAA, 0x26, 0x43, 0x66, 0x86, 0x2A, 0x18, 0x30, 0x25, 0x75, 0xD0, 0xFB, 0x98,
+	0xD1, 0x16, 0xBC, 0x4B, 0x6D, 0xDE, 0xBC, 0xA3, 0xA5, 0xA7, 0x93, 0x9F
+};
+
+/* brainpoolP256r1 */
+static const unsigned char brainpoolP256r1OID[] = { 0x06, 0x09, 0x2B, 0x24, 0x03, 0x03, 0x02, 0x08, 0x01, 0x01, 0x07 };
+static const unsigned char brainpoolP256r1Params[] = {
+	0xA9, 0xFB, 0x57, 0xDB, 0xA1, 0xEE, 0xA9, 0xBC, 0x3E, 0x66, 0x0A, 0x90, 0x9D, 0x83, 0x8D, 0x72,
+	0x6E, 0x3B, 0xF6, 0x23, 0xD5, 0x26, 0x20, 0x28, 0x20, 0x13, 0x48, 0x1D, 0x1F, 0x6E, 0x53, 0x77,
+	0x7D, 0x5A, 0x09, 0x75, 0xFC, 0x2C, 0x30, 0x57, 0xEE, 0xF6, 0x75, 0x30, 0x41, 0x7A, 0xFF, 0xE7,
+	0xFB, 0x80, 0x55, 0xC1, 0x26, 0xDC, 0x5C, 0x6C, 0xE9, 0x4A, 0x4B, 0x44, 0xF3, 0x30, 0xB5, 0xD9,
+	0x26, 0xDC, 0x5C, 0x6C, 0xE9, 0x4A, 0x4B, 0x44, 0xF3, 0x30, 0xB5, 0xD9, 0xBB, 0xD7, 0x7C, 0xBF,
+	0x95, 0x84, 0x16, 0x29, 0x5C, 0xF7, 0xE1, 0xCE, 0x6B, 0xCC, 0xDC, 0x18, 0xFF, 0x8C, 0x07, 0xB6,
+	0x8B, 0xD2, 0xAE, 0xB9, 0xCB, 0x7E, 0x57, 0xCB, 0x2C, 0x4B, 0x48, 0x2F, 0xFC, 0x81, 0xB7, 0xAF,
+	0xB9, 0xDE, 0x27, 0xE1, 0xE3, 0xBD, 0x23, 0xC2, 0x3A, 0x44, 0x53, 0xBD, 0x9A, 0xCE, 0x32, 0x62,
+	0x54, 0x7E, 0xF8, 0x35, 0xC3, 0xDA, 0xC4, 0xFD, 0x97, 0xF8, 0x46, 0x1A, 0x14, 0x61, 0x1D, 0xC9,
+	0xC2, 0x77, 0x45, 0x13, 0x2D, 0xED, 0x8E, 0x54, 0x5C, 0x1D, 0x54, 0xC7, 0x2F, 0x04, 0x69, 0x97,
+	0xA9, 0xFB, 0x57, 0xDB, 0xA1, 0xEE, 0xA9, 0xBC, 0x3E, 0x66, 0x0A, 0x90, 0x9D, 0x83, 0x8D, 0x71,
+	0x8C, 0x39, 0x7A, 0xA3, 0xB5, 0x61, 0xA6, 0xF7, 0x90, 0x1E, 0x0E, 0x82, 0x97, 0x48, 0x56, 0xA7
+};
+
+/* brainpoolP320r1 */
+static const unsigned char brainpoolP320r1OID[] = { 0x06, 0x09, 0x2B, 0x24, 0x03, 0x03, 0x02, 0x08, 0x01, 0x01, 0x09 };
+static const unsigned char brainpoolP320r1Params[] = {
+	0xD3, 0x5E, 0x47, 0x20, 0x36, 0xBC, 0x4F, 0xB7, 0xE1, 0x3C, 0x78, 0x5E, 0xD2, 0x01, 0xE0, 0x65,
+	0xF9, 0x8F, 0xCF, 0xA6, 0xF6, 0xF4, 0x0D, 0xEF, 0x4F, 0x92, 0xB9, 0xEC, 0x78, 0x93, 0xEC, 0x28,
+	0xFC, 0xD4, 0x12, 0xB1, 0xF1, 0xB3, 0x2E, 0x27,
+	0x3E, 0xE3, 0x0B, 0x56, 0x8F, 0xBA, 0xB0, 0xF8, 0x83, 0xCC, 0xEB, 0xD4, 0x6D, 0x3F, 0x3B, 0xB8,
+	0xA2, 0xA7, 0x35, 0x13, 0xF5, 0xEB, 0x79, 0xDA, 0x66, 0x19, 0x0E, 0xB0, 0x85, 0xFF, 0xA9, 0xF4,
+	0x92, 0xF3, 0x75, 0xA9, 0x7D, 0x86, 0x0E, 0xB4,
+	0x52, 0x08, 0x83, 0x94, 0x9D, 0xFD, 0xBC, 0x42, 0xD3, 0xAD, 0x19, 0x86, 0x40, 0x68, 0x8A, 0x6F,
+	0xE1, 0x3F, 0x41, 0x34, 0x95, 0x54, 0xB4, 0x9A, 0xCC, 0x31, 0xDC, 0xCD, 0x88, 0x45, 0x39, 0x81,
+	0x6F, 0x5E, 0xB4, 0xAC, 0x8F, 0xB1, 0xF1, 0xA6,
+	0x43, 0xBD, 0x7E, 0x9A, 0xFB, 0x53, 0xD8, 0xB8, 0x52, 0x89, 0xBC, 0xC4, 0x8E, 0xE5, 0xBF, 0xE6,
+	0xF2, 0x01, 0x37, 0xD1, 0x0A, 0x08, 0x7E, 0xB6, 0xE7, 0x87, 0x1E, 0x2A, 0x10, 0xA5, 0x99, 0xC7,
+	0x10, 0xAF, 0x8D, 0x0D, 0x39, 0xE2, 0x06, 0x11,
+	0x14, 0xFD, 0xD0, 0x55, 0x45, 0xEC, 0x1C, 0xC8, 0xAB, 0x40, 0x93, 0x24, 0x7F, 0x77, 0x27, 0x5E,
+	0x07, 0x43, 0xFF, 0xED, 0x11, 0x71, 0x82, 0xEA, 0xA9, 0xC7, 0x78, 0x77, 0xAA, 0xAC, 0x6A, 0xC7,
+	0xD3, 0x52, 0x45, 0xD1, 0x69, 0x2E, 0x8E, 0xE1,
+	0xD3, 0x5E, 0x47, 0x20, 0x36, 0xBC, 0x4F, 0xB7, 0xE1, 0x3C, 0x78, 0x5E, 0xD2, 0x01, 0xE0, 0x65,
+	0xF9, 0x8F, 0xCF, 0xA5, 0xB6, 0x8F, 0x12, 0xA3, 0x2D, 0x48, 0x2E, 0xC7, 0xEE, 0x86, 0x58, 0xE9,
+	0x86, 0x91, 0x55, 0x5B, 0x44, 0xC5, 0x93, 0x11
+};
+
+/* brainpoolP384r1 */
+static const unsigned char brainpoolP384r1OID[] = { 0x06, 0x09, 0x2B, 0x24, 0x03, 0x03, 0x02, 0x08, 0x01, 0x01, 0x0B };
+static const unsigned char brainpoolP384r1Params[] = {
+	0x8C, 0xB9, 0x1E, 0x82, 0xA3, 0x38, 0x6D, 0x28, 0x0F, 0x5D, 0x6F, 0x7E, 0x50, 0xE6, 0x41, 0xDF,
+	0x15, 0x2F, 0x71, 0x09, 0xED, 0x54, 0x56, 0xB4, 0x12, 0xB1, 0xDA, 0x19, 0x7F, 0xB7, 0x11, 0x23,
+	0xAC, 0xD3, 0xA7, 0x29, 0x90, 0x1D, 0x1A, 0x71, 0x87, 0x47, 0x00, 0x13, 0x31, 0x07, 0xEC, 0x53,
+	0x7B, 0xC3, 0x82, 0xC6, 0x3D, 0x8C, 0x15, 0x0C, 0x3C, 0x72, 0x08, 0x0A, 0xCE, 0x05, 0xAF, 0xA0,
+	0xC2, 0xBE, 0xA2, 0x8E, 0x4F, 0xB2, 0x27, 0x87, 0x13, 0x91, 0x65, 0xEF, 0xBA, 0x91, 0xF9, 0x0F,
+	0x8A, 0xA5, 0x81, 0x4A, 0x50, 0x3A, 0xD4, 0xEB, 0x04, 0xA8, 0xC7, 0xDD, 0x22, 0xCE, 0x28, 0x26,
+	0x04, 0xA8, 0xC7, 0xDD, 0x22, 0xCE, 0x28, 0x26, 0x8B, 0x39, 0xB5, 0x54, 0x16, 0xF0, 0x44, 0x7C,
+	0x2F, 0xB7, 0x7D, 0xE1, 0x07, 0xDC, 0xD2, 0xA6, 0x2E, 0x88, 0x0E, 0xA5, 0x3E, 0xEB, 0x62, 0xD5,
+	0x7C, 0xB4, 0x39, 0x02, 0x95, 0xDB, 0xC9, 0x94, 0x3A, 0xB7, 0x86, 0x96, 0xFA, 0x50, 0x4C, 0x11,
+	0x1D, 0x1C, 0x64, 0xF0, 0x68, 0xCF, 0x45, 0xFF, 0xA2, 0xA6, 0x3A, 0x81, 0xB7, 0xC1, 0x3F, 0x6B,
+	0x88, 0x47, 0xA3, 0xE7, 0x7E, 0xF1, 0x4F, 0xE3, 0xDB, 0x7F, 0xCA, 0xFE, 0x0C, 0xBD, 0x10, 0xE8,
+	0xE8, 0x26, 0xE0, 0x34, 0x36, 0xD6, 0x46, 0xAA, 0xEF, 0x87, 0xB2, 0xE2, 0x47, 0xD4, 0xAF, 0x1E,
+	0x8A, 0xBE, 0x1D, 0x75, 0x20, 0xF9, 0xC2, 0xA4, 0x5C, 0xB1, 0xEB, 0x8E, 0x95, 0xCF, 0xD5, 0x52,
+	0x62, 0xB7, 0x0B, 0x29, 0xFE, 0xEC, 0x58, 0x64, 0xE1, 0x9C, 0x05, 0x4F, 0xF9, 0x91, 0x29, 0x28,
+	0x0E, 0x46, 0x46, 0x21, 0x77, 0x91, 0x81, 0x11, 0x42, 0x82, 0x03, 0x41, 0x26, 0x3C, 0x53, 0x15,
+	0x8C, 0xB9, 0x1E, 0x82, 0xA3, 0x38, 0x6D, 0x28, 0x0F, 0x5D, 0x6F, 0x7E, 0x50, 0xE6, 0x41, 0xDF,
+	0x15, 0x2F, 0x71, 0x09, 0xED, 0x54, 0x56, 0xB3, 0x1F, 0x16, 0x6E, 0x6C, 0xAC, 0x04, 0x25, 0xA7,
+	0xCF, 0x3A, 0xB6, 0xAF, 0x6B, 0x7F, 0xC3, 0x10, 0x3B, 0x88, 0x32, 0x02, 0xE9, 0x04, 0x65, 0x65
+};
+
+/* brainpoolP512r1 */
+static const unsigned char brainpoolP512r1OID[] = { 0x06, 0x09, 0x2B, 0x24, 0x03, 0x03, 0x02, 0x08, 0x01, 0x01, 0x0D };
+static const unsigned char brainpoolP512r1Params[] = {
+	0xAA, 0xDD, 0x9D, 0xB8, 0xDB, 0xE9, 0xC4, 0x8B, 0x3F, 0xD4, 0xE6, 0xAE, 0x33, 0xC9, 0xFC, 0x07,
+	0xCB, 0x30, 0x8D, 0xB3, 0xB3, 0xC9, 0xD2, 0x0E, 0xD6, 0x63, 0x9C, 0xCA, 0x70, 0x33, 0x08, 0x71,
+	0x7D, 0x4D, 0x9B, 0x00, 0x9B, 0xC6, 0x68, 0x42, 0xAE, 0xCD, 0xA1, 0x2A, 0xE6, 0xA3, 0x80, 0xE6,
+	0x28, 0x81, 0xFF, 0x2F, 0x2D, 0x82, 0xC6, 0x85, 0x28, 0xAA, 0x60, 0x56, 0x58, 0x3A, 0x48, 0xF3,
+	0x78, 0x30, 0xA3, 0x31, 0x8B, 0x60, 0x3B, 0x89, 0xE2, 0x32, 0x71, 0x45, 0xAC, 0x23, 0x4C, 0xC5,
+	0x94, 0xCB, 0xDD, 0x8D, 0x3D, 0xF9, 0x16, 0x10, 0xA8, 0x34, 0x41, 0xCA, 0xEA, 0x98, 0x63, 0xBC,
+	0x2D, 0xED, 0x5D, 0x5A, 0xA8, 0x25, 0x3A, 0xA1, 0x0A, 0x2E, 0xF1, 0xC9, 0x8B, 0x9A, 0xC8, 0xB5,
+	0x7F, 0x11, 0x17, 0xA7, 0x2B, 0xF2, 0xC7, 0xB9, 0xE7, 0xC1, 0xAC, 0x4D, 0x77, 0xFC, 0x94, 0xCA,
+	0x3D, 0xF9, 0x16, 0x10, 0xA8, 0x34, 0x41, 0xCA, 0xEA, 0x98, 0x63, 0xBC, 0x2D, 0xED, 0x5D, 0x5A,
+	0xA8, 0x25, 0x3A, 0xA1, 0x0A, 0x2E, 0xF1, 0xC9, 0x8B, 0x9A, 0xC8, 0xB5, 0x7F, 0x11, 0x17, 0xA7,
+	0x2B, 0xF2, 0xC7, 0xB9, 0xE7, 0xC1, 0xAC, 0x4D, 0x77, 0xFC, 0x94, 0xCA, 0xDC, 0x08, 0x3E, 0x67,
+	0x98, 0x40, 0x50, 0xB7, 0x5E, 0xBA, 0xE5, 0xDD, 0x28, 0x09, 0xBD, 0x63, 0x80, 0x16, 0xF7, 0x23,
+	0x81, 0xAE, 0xE4, 0xBD, 0xD8, 0x2E, 0xD9, 0x64, 0x5A, 0x21, 0x32, 0x2E, 0x9C, 0x4C, 0x6A, 0x93,
+	0x85, 0xED, 0x9F, 0x70, 0xB5, 0xD9, 0x16, 0xC1, 0xB4, 0x3B, 0x62, 0xEE, 0xF4, 0xD0, 0x09, 0x8E,
+	0xFF, 0x3B, 0x1F, 0x78, 0xE2, 0xD0, 0xD4, 0x8D, 0x50, 0xD1, 0x68, 0x7B, 0x93, 0xB9, 0x7D, 0x5F,
+	0x7C, 0x6D, 0x50, 0x47, 0x40, 0x6A, 0x5E, 0x68, 0x8B, 0x35, 0x22, 0x09, 0xBC, 0xB9, 0xF8, 0x22,
+	0x7D, 0xDE, 0x38, 0x5D, 0x56, 0x63, 0x32, 0xEC, 0xC0, 0xEA, 0xBF, 0xA9, 0xCF, 0x78, 0x22, 0xFD,
+	0xF2, 0x09, 0xF7, 0x00, 0x24, 0xA5, 0x7B, 0x1A, 0xA0, 0x00, 0xC5, 0x5B, 0x88, 0x1F, 0x81, 0x11,
+	0xB2, 0xDC, 0xDE, 0x49, 0x4A, 0x5F, 0x48, 0x5E, 0x5B, 0xCA, 0x4B, 0xD8, 0x8A, 0x27, 0x63, 0xAE,
+	0xD1, 0xCA, 0x2B, 0x2F, 0xA8, 0xF0, 0x54, 0x06, 0x78, 0xCD, 0x1E, 0x0F, 0x3A, 0xD8, 0x08, 0x92,
+	0xAA, 0xDD, 0x9D, 0xB8, 0xDB, 0xE9, 0xC4, 0x8B, 0x3F, 0xD4, 0xE6, 0xAE, 0x33, 0xC9, 0xFC, 0x07,
+	0xCB, 0x30, 0x8D, 0xB3, 0xB3, 0xC9, 0xD2, 0x0E, 0xD6, 0x63, 0x9C, 0xCA, 0x70, 0x33, 0x08, 0x70,
+	0x55, 0x3E, 0x5C, 0x41, 0x4C, 0xA9, 0x26, 0x19, 0x41, 0x86, 0x61, 0x19, 0x7F, 0xAC, 0x10, 0x47,
+	0x1D, 0xB1, 0xD3, 0x81, 0x08, 0x5D, 0xDA, 0xDD, 0xB5, 0x87, 0x96, 0x82, 0x9C, 0xA9, 0x00, 0x69
+};
+
+static const struct ecNamedCurve namedCurves[] = {
+	{ secp192r1OID, sizeof(secp192r1OID), 24, secp192r1Params },
+	{ secp224r1OID, sizeof(secp224r1OID), 28, secp224r1Params },
+	{ secp256r1OID, sizeof(secp256r1OID), 32, secp256r1Params },
+	{ secp384r1OID, sizeof(secp384r1OID), 48, secp384r1Params },
+	{ secp521r1OID, sizeof(secp521r1OID), 66, secp521r1Params },
+	{ secp256k1OID, sizeof(secp256k1OID), 32, secp256k1Params },
+	{ brainpoolP192r1OID, sizeof(brainpoolP192r1OID), 24, brainpoolP192r1Params },
+	{ brainpoolP224r1OID, sizeof(brainpoolP224r1OID), 28, brainpoolP224r1Params },
+	{ brainpoolP256r1OID, sizeof(brainpoolP256r1OID), 32, brainpoolP256r1Params },
+	{ brainpoolP320r1OID, sizeof(brainpoolP320r1OID), 40, brainpoolP320r1Params },
+	{ brainpoolP384r1OID, sizeof(brainpoolP384r1OID), 48, brainpoolP384r1Params },
+	{ brainpoolP512r1OID, sizeof(brainpoolP512r1OID), 64, brainpoolP512r1Params },
+};
+
+/* id-fieldType prime-field */
+static const unsigned char primeFieldOID[] = { 0x2A, 0x86, 0x48, 0xCE, 0x3D, 0x01, 0x01 };
+
+
+
+static int isOnCurve(const struct ecCurve *curve, const uint32_t *x, const uint32_t *y)
+{
+	const struct montContext *p = &curve->p;
+	uint32_t l[EC_MAX_LIMBS], r[EC_MAX_LIMBS], t[EC_MAX_LIMBS];
+
+	// y^2 = x^3 + ax + b
+	montMul(p, l, y, y);
+	montMul(p, r, x, x);
+	montMul(p, r, r, x);
+	montMul(p, t, curve->a, x);
+	montAdd(p, r, r, t);
+	montAdd(p, r, r, curve->b);
+
+	return bnCmp(l, r, p->limbs) == 0;
+}
+
+
+
+/*
+ * Load a field element given as big-endian byte string and convert into Montgomery form
+ */
+static int loadElement(const struct montContext *ctx, uint32_t *r, const unsigned char *data, size_t len)
+{
+	if ((bnFromBytes(r, ctx->limbs, data, len) < 0) || (bnCmp(r, ctx->m, ctx->limbs) >= 0))
+		return -1;
+
+	montToMont(ctx, r, r);
+	return 0;
+}
+
+
+
+static int initCurve(struct ecCurve *curve, const unsigned char *p, size_t plen, const unsigned char *a, size_t alen,
+		const unsigned char *b, size_t blen, const unsigned char *gx, const unsigned char *gy, const unsigned char *n, size_t nlen)
+{
+	uint32_t t[EC_MAX_LIMBS], two[EC_MAX_LIMBS];
+	int limbs;
+
+	while ((plen > 0) && (*p == 0)) {
+		p++;
+		plen--;
+	}
+
+	if ((plen == 0) || (plen > EC_MAX_BYTES))
+		return -1;
+
+	memset(curve, 0, sizeof(*curve));
+	curve->size = (int)plen;
+	limbs = (curve->size + 3) >> 2;
+
+	if ((montInit(&curve->p, p, plen, limbs) < 0) || (montInit(&curve->n, n, nlen, limbs) < 0))
+		return -1;
+
+	curve->orderSize = (bnBits(curve->n.m, limbs) + 7) >> 3;
+
+	if ((loadElement(&curve->p, curve->a, a, alen) < 0) || (loadElement(&curve->p, curve->b, b, blen) < 0))
+		return -1;
+
+	curve->aIsZero = bnIsZero(curve->a, limbs);
+
+	if ((loadElement(&curve->p, curve->g.x, gx, plen) < 0) || (loadElement(&curve->p, curve->g.y, gy, plen) < 0))
+		return -1;
+
+	memcpy(curve->g.z, curve->p.one, limbs * sizeof(uint32_t));
+
+	if (!isOnCurve(curve, curve->g.x, curve->g.y))
+		return -1;
+
+	memset(two, 0, sizeof(two));
+	two[0] = 2;
+
+	bnSub(t, curve->p.m, two, limbs);
+	bnToBytes(t, limbs, curve->pm2, curve->size);
+	bnSub(t, curve->n.m, two, limbs);
+	bnToBytes(t, limbs, curve->nm2, curve->size);
+
+	return 0;
+}
+
+
+
+/*
+ * Return the value of the n-th child of parent, if it has the expected tag
+ */
+static const unsigned char *childValue(const unsigned char *data, struct asn1Node *nodes, int count, int parent, int n, unsigned int tag, size_t *len)
+{
+	int i;
+
+	i = asn1IndexChild(nodes, count, parent, n);
+
+	if ((i < 0) || (nodes[i].tag != tag))
+		return NULL;
+
+	*len = nodes[i].length;
+	return data + nodes[i].value;
+}
+
+
+
+/*
+ * Decode ECParameters with explicit domain parameters over a prime field
+ */
+static int decodeExplicitParams(struct ecCurve *curve, const unsigned char *params, size_t len)
+{
+	struct asn1Node nodes[16];
+	const unsigned char *oid, *p, *a, *b, *base, *n;
+	size_t oidLen = 0, plen = 0, alen = 0, blen = 0, baseLen = 0, nlen = 0;
+	int count, fieldID, curveSeq;
+
+	count = asn1Index((unsigned char *)params, len, 2, nodes, sizeof(nodes) / sizeof(*nodes));
+
+	if ((count <= 0) || (nodes[0].tag != ASN1_SEQUENCE))
+		return -1;
+
+	fieldID = asn1IndexChild(nodes, count, 0, 1);
+	curveSeq = asn1IndexChild(nodes, count, 0, 2);
+
+	if ((fieldID < 0) || (curveSeq < 0))
+		return -1;
+
+	oid = childValue(params, nodes, count, fieldID, 0, ASN1_OBJECT_IDENTIFIER, &oidLen);
+	p = childValue(params, nodes, count, fieldID, 1, ASN1_INTEGER, &plen);
+	a = childValue(params, nodes, count, curveSeq, 0, ASN1_OCTET_STRING, &alen);
+	b = childValue(params, nodes, count, curveSeq, 1, ASN1_OCTET_STRING, &blen);
+	base = childValue(params, nodes, count, 0, 3, ASN1_OCTET_STRING, &baseLen);
+	n = childValue(params, nodes, count, 0, 4, ASN1_INTEGER, &nlen);
+
+	if (!oid || !p || !a || !b || !base || !n)
+		return -1;
+
+	if ((oidLen != sizeof(primeFieldOID)) || memcmp(oid, primeFieldOID, oidLen))
+		return -1;
+
+	while ((plen > 0) && (*p == 0)) {
+		p++;
+		plen--;
+	}
+
+	// Only uncompressed base points are supported
+	if ((baseLen != 1 + 2 * plen) || (*base != 0x04))
+		return -1;
+
+	return initCurve(curve, p, plen, a, alen, b, blen, base + 1, base + 1 + plen, n, nlen);
+}
+
+
+
+/**
+ * Set up the curve from the DER encoded CKA_EC_PARAMS
+ *
+ * @param curve      The curve
+ * @param params     Object identifier of a named curve or ECParameters
+ * @param len        The length of params
+ * @return           0 or -1 if the curve is unknown or invalid
+ */
+int ecDecodeParams(struct ecCurve *curve, const unsigned char *params, size_t len)
+{
+	const struct ecNamedCurve *c;
+	int i, size;
+
+	for (i = 0; i < sizeof(namedCurves) / sizeof(*namedCurves); i++) {
+		c = &namedCurves[i];
+
+		if ((len == c->oidLen) && !memcmp(params, c->oid, len)) {
+			size = c->size;
+			return initCurve(curve, c->params, size, c->params + size, size, c->params + 2 * size, size,
+					c->params + 3 * size, c->params + 4 * size, c->params + 5 * size, size);
+		}
+	}
+
+	if ((len > 2) && (*params == ASN1_SEQUENCE))
+		return decodeExplicitParams(curve, params, len);
+
+	return -1;
+}
+
+
+
+/**
+ * Decode an uncompressed point from CKA_EC_POINT and check that it is on the curve
+ *
+ * The point may be wrapped in an OCTET STRING as required by PKCS#11 or given
+ * as plain 04 || x || y.
+ *
+ * @param curve      The curve
+ * @param point      The decoded point
+ * @param data       The encoded point
+ * @param len        The length of data
+ * @return           0 or -1 if the point is invalid
+ */
+int ecDecodePoint(const struct ecCurve *curve, struct ecPoint *point, const unsigned char *data, size_t len)
+{
+	unsigned char *cursor;
+	int length;
+
+	if ((len != 1 + 2 * (size_t)curve->size) && (len > 2) && (*data == ASN1_OCTET_STRING)) {
+		cursor = (unsigned char *)data;
+		asn1Tag(&cursor);
+		length = asn1Length(&cursor);
+
+		if ((length < 0) || ((size_t)length != len - (cursor - data)))
+			return -1;
+
+		len = length;
+		data = cursor;
+	}
+
+	if ((len != 1 + 2 * (size_t)curve->size) || (*data != 0x04))
+		return -1;
+
+	memset(point, 0, sizeof(*point));
+
+	if ((loadElement(&curve->p, point->x, data + 1, curve->size) < 0) ||
+		(loadElement(&curve->p, point->y, data + 1 + curve->size, curve->size) < 0))
+		return -1;
+
+	memcpy(point->z, curve->p.one, curve->p.limbs * sizeof(uint32_t));
+
+	return isOnCurve(curve, point->x, point->y) ? 0 : -1;
+}
+
+
+
+/*
+ * r = 2 * a
+ */
+static void pointDouble(const struct ecCurve *curve, struct ecPoint *r, const struct ecPoint *a)
+{
+	const struct montContext *p = &curve->p;
+	uint32_t yy[EC_MAX_LIMBS], s[EC_MAX_LIMBS], m[EC_MAX_LIMBS], t[EC_MAX_LIMBS];
+
+	if (a->infinity || bnIsZero(a->y, p->limbs)) {
+		r->infinity = 1;
+		return;
+	}
+
+	// S = 4 * X * Y^2
+	montMul(p, yy, a->y, a->y);
+	montMul(p, s, a->x, yy);
+	montAdd(p, s, s, s);
+	montAdd(p, s, s, s);
+
+	// M = 3 * X^2 + a * Z^4
+	montMul(p, m, a->x, a->x);
+	montAdd(p, t, m, m);
+	montAdd(p, m, m, t);
+
+	if (!curve->aIsZero) {
+		montMul(p, t, a->z, a->z);
+		montMul(p, t, t, t);
+		montMul(p, t, t, curve->a);
+		montAdd(p, m, m, t);
+	}
+
+	// Z' = 2 * Y * Z
+	montMul(p, r->z, a->y, a->z);
+	montAdd(p, r->z, r->z, r->z);
+
+	// X' = M^2 - 2 * S
+	montMul(p, t, m, m);
+	montSub(p, t, t, s);
+	montSub(p, r->x, t, s);
+
+	// Y' = M * (S - X') - 8 * Y^4
+	montSub(p, s, s, r->x);
+	montMul(p, s, m, s);
+	montMul(p, yy, yy, yy);
+	montAdd(p, yy, yy, yy);
+	montAdd(p, yy, yy, yy);
+	montAdd(p, yy, yy, yy);
+	montSub(p, r->y, s, yy);
+
+	r->infinity = 0;
+}
+
+
+
+/*
+ * r = a + b, where r may be the same as a
+ */
+static void pointAdd(const struct ecCurve *curve, struct ecPoint *r, const struct ecPoint *a, const struct ecPoint *b)
+{
+	const struct montContext *p = &curve->p;
+	uint32_t u1[EC_MAX_LIMBS], u2[EC_MAX_LIMBS], s1[EC_MAX_LIMBS], s2[EC_MAX_LIMBS];
+	uint32_t h[EC_MAX_LIMBS], hh[EC_MAX_LIMBS], rr[EC_MAX_LIMBS], t[EC_MAX_LIMBS];
+	int bAffine;
+
+	if (b->infinity) {
+		if (r != a)
+			*r = *a;
+		return;
+	}
+
+	if (a->infinity) {
+		*r = *b;
+		return;
+	}
+
+	// U2 = X2 * Z1^2, S2 = Y2 * Z1^3
+	montMul(p, t, a->z, a->z);
+	montMul(p, u2, b->x, t);
+	montMul(p, t, t, a->z);
+	montMul(p, s2, b->y, t);
+
+	// U1 = X1 * Z2^2, S1 = Y1 * Z2^3, which simplifies for Z2 = 1
+	bAffine = !bnCmp(b->z, p->one, p->limbs);
+
+	if (bAffine) {
+		memcpy(u1, a->x, p->limbs * sizeof(uint32_t));
+		memcpy(s1, a->y, p->limbs * sizeof(uint32_t));
+	} else {
+		montMul(p, t, b->z, b->z);
+		montMul(p, u1, a->x, t);
+		montMul(p, t, t, b->z);
+		montMul(p, s1, a->y, t);
+	}
+
+	montSub(p, h, u2, u1);
+	montSub(p, rr, s2, s1);
+
+	if (bnIsZero(h, p->limbs)) {
+		if (bnIsZero(rr, p->limbs)) {
+			pointDouble(curve, r, a);
+		} else {
+			r->infinity = 1;
+		}
+		return;
+	}
+
+	// Z3 = Z1 * Z2 * H
+	montMul(p, r->z, a->z, h);
+	if (!bAffine)
+		montMul(p, r->z, r->z, b->z);
+
+	// X3 = R^2 - H^3 - 2 * U1 * H^2
+	montMul(p, hh, h, h);
+	montMul(p, h, h, hh);
+	montMul(p, u1, u1, hh);
+	montMul(p, t, rr, rr);
+	montSub(p, t, t, h);
+	montSub(p, t, t, u1);
+	montSub(p, r->x, t, u1);
+
+	// Y3 = R * (U1 * H^2 - X3) - S1 * H^3
+	montSub(p, u1, u1, r->x);
+	montMul(p, u1, rr, u1);
+	montMul(p, s1, s1, h);
+	montSub(p, r->y, u1, s1);
+
+	r->infinity = 0;
+}
+
+
+
+static int testBit(const uint32_t *a, int bit)
+{
+	return (a[bit >> 5] >> (bit & 31)) & 1;
+}
+
+
+
+/*
+ * r = u1 * G + u2 * Q using simultaneous double-and-add
+ */
+static void pointMulAdd(const struct ecCurve *curve, struct ecPoint *r, const uint32_t *u1, const uint32_t *u2, const struct ecPoint *q)
+{
+	struct ecPoint gq;
+	int bits, b1, b2, i;
+
+	pointAdd(curve, &gq, &curve->g, q);
+
+	bits = bnBits(u1, curve->p.limbs);
+	i = bnBits(u2, curve->p.limbs);
+	if (i > bits)
+		bits = i;
+
+	r->infinity = 1;
+
+	for (i = bits - 1; i >= 0; i--) {
+		pointDouble(curve, r, r);
+
+		b1 = testBit(u1, i);
+		b2 = testBit(u2, i);
+
+		if (b1 && b2) {
+			pointAdd(curve, r, r, &gq);
+		} else if (b1) {
+			pointAdd(curve, r, r, &curve->g);
+		} else if (b2) {
+			pointAdd(curve, r, r, q);
+		}
+	}
+}
+
+
+
+/**
+ * Verify an ECDSA signature
+ *
+ * @param curve      The curve
+ * @param q          The public key
+ * @param hash       The hash value, truncated to the length of the group order
+ * @param hashLen    The length of the hash value
+ * @param signature  The concatenation of r and s, each with the length of the group order
+ * @param signatureLen The length of the signature
+ * @return           0 if the signature is valid or -1
+ */
+int ecdsaVerify(const struct ecCurve *curve, const struct ecPoint *q, const unsigned char *hash, size_t hashLen, const unsigned char *signature, size_t signatureLen)
+{
+	const struct montContext *n = &curve->n;
+	uint32_t r[EC_MAX_LIMBS], s[EC_MAX_LIMBS], e[EC_MAX_LIMBS], u1[EC_MAX_LIMBS], u2[EC_MAX_LIMBS];
+	struct ecPoint x;
+	int bits;
+
+	if (signatureLen != 2 * (size_t)curve->orderSize)
+		return -1;
+
+	bnFromBytes(r, n->limbs, signature, curve->orderSize);
+	bnFromBytes(s, n->limbs, signature + curve->orderSize, curve->orderSize);
+
+	if (bnIsZero(r, n->limbs) || bnIsZero(s, n->limbs) ||
+		(bnCmp(r, n->m, n->limbs) >= 0) || (bnCmp(s, n->m, n->limbs) >= 0))
+		return -1;
+
+	// e is formed from the leftmost bits of the hash value
+	if (hashLen > (size_t)curve->orderSize)
+		hashLen = curve->orderSize;
+
+	bnFromBytes(e, n->limbs, hash, hashLen);
+
+	bits = bnBits(n->m, n->limbs);
+	if ((int)hashLen * 8 > bits)
+		bnShiftRight(e, n->limbs, (int)hashLen * 8 - bits);
+
+	montReduce(n, e);
+
+	// w = s^-1, u1 = e * w, u2 = r * w with w in Montgomery form, so that u1 and u2 are not
+	montToMont(n, s, s);
+	montExp(n, s, s, curve->nm2, curve->size);
+	montMul(n, u1, e, s);
+	montMul(n, u2, r, s);
+
+	pointMulAdd(curve, &x, u1, u2, q);
+
+	if (x.infinity)
+		return -1;
+
+	// Affine x = X / Z^2
+	montExp(&curve->p, x.z, x.z, curve->pm2, curve->size);
+	montMul(&curve->p, x.z, x.z, x.z);
+	montMul(&curve->p, x.x, x.x, x.z);
+	montFromMont(&curve->p, x.x, x.x);
+
+	montReduce(n, x.x);
+
+	return bnCmp(x.x, r, n->limbs) == 0 ? 0 : -1;
+}
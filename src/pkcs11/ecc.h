@@ -0,0 +1,71 @@
+/**
+ * SmartCard-HSM PKCS#11 Module
+ *
+ * Copyright (c) 2013, CardContact Systems GmbH, Minden, Germany
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of CardContact Systems GmbH nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CardContact Systems GmbH BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file    ecc.h
+ * @brief   Elliptic curve arithmetic and ECDSA signature verification
+ */
+
+#ifndef ___ECC_H_INC___
+#define ___ECC_H_INC___
+
+#include <pkcs11/bignum.h>
+
+#define EC_MAX_BYTES            66
+#define EC_MAX_LIMBS            ((EC_MAX_BYTES + 3) / 4)
+
+/**
+ * Point in Jacobian coordinates with values in Montgomery form
+ */
+struct ecPoint {
+	int infinity;                     /**< Point at infinity                   */
+	uint32_t x[EC_MAX_LIMBS];
+	uint32_t y[EC_MAX_LIMBS];
+	uint32_t z[EC_MAX_LIMBS];
+};
+
+/**
+ * Curve over a prime field in short Weierstrass form
+ */
+struct ecCurve {
+	int size;                         /**< Length of a field element in bytes  */
+	int orderSize;                    /**< Length of the group order in bytes  */
+	int aIsZero;                      /**< Coefficient a is zero               */
+	struct montContext p;             /**< Prime of the field                  */
+	struct montContext n;             /**< Order of the base point             */
+	uint32_t a[EC_MAX_LIMBS];         /**< Coefficient a                       */
+	uint32_t b[EC_MAX_LIMBS];         /**< Coefficient b                       */
+	struct ecPoint g;                 /**< Base point                          */
+	unsigned char pm2[EC_MAX_BYTES];  /**< p - 2 for inversion in the field    */
+	unsigned char nm2[EC_MAX_BYTES];  /**< n - 2 for inversion modulo n        */
+};
+
+int ecDecodeParams(struct ecCurve *curve, const unsigned char *params, size_t len);
+int ecDecodePoint(const struct ecCurve *curve, struct ecPoint *point, const unsigned char *data, size_t len);
+int ecdsaVerify(const struct ecCurve *curve, const struct ecPoint *q, const unsigned char *hash, size_t hashLen, const unsigned char *signature, size_t signatureLen);
+
+#endif /* ___ECC_H_INC___ */
@@ -0,0 +1,254 @@
+/**
+ * SmartCard-HSM PKCS#11 Module
+ *
+ * Copyright (c) 2013, CardContact Systems GmbH, Minden, Germany
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of CardContact Systems GmbH nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CardContact Systems GmbH BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file    encrypt.c
+ * @brief   Encryption with RSA public keys in the host
+ *
+ * Encryption only needs the public key, so it is performed in the host. Keys
+ * of the token can then be used to wrap session keys without a second library.
+ */
+
+#include <string.h>
+
+#include <common/memset_s.h>
+
+#include <pkcs11/encrypt.h>
+
+
+
+static const CK_MECHANISM_TYPE encryptMechanisms[] = {
+	CKM_RSA_X_509,
+	CKM_RSA_PKCS,
+	CKM_RSA_PKCS_OAEP
+};
+
+
+
+/**
+ * Return the list of mechanisms supported for encryption
+ *
+ * @param pMechanismList Buffer receiving the list or NULL
+ * @param ulCount    The size of the buffer
+ * @return           The number of mechanisms
+ */
+int getEncryptMechanisms(CK_MECHANISM_TYPE_PTR pMechanismList, CK_ULONG ulCount)
+{
+	int i, count;
+
+	count = sizeof(encryptMechanisms) / sizeof(*encryptMechanisms);
+
+	for (i = 0; pMechanismList && (i < count) && (i < ulCount); i++) {
+		pMechanismList[i] = encryptMechanisms[i];
+	}
+
+	return count;
+}
+
+
+
+/**
+ * Describe the encryption support for a mechanism
+ *
+ * @param mech       The mechanism
+ * @param pInfo      Filled with key sizes and CKF_ENCRYPT
+ * @return           0 or -1 if the mechanism is not supported in the host
+ */
+int getEncryptMechanismInfo(CK_MECHANISM_TYPE mech, CK_MECHANISM_INFO_PTR pInfo)
+{
+	int i;
+
+	for (i = 0; i < sizeof(encryptMechanisms) / sizeof(*encryptMechanisms); i++) {
+		if (encryptMechanisms[i] == mech) {
+			pInfo->flags = CKF_ENCRYPT;
+			pInfo->ulMinKeySize = 512;
+			pInfo->ulMaxKeySize = BN_MAX_BITS;
+			return 0;
+		}
+	}
+	return -1;
+}
+
+
+
+/*
+ * Take hash algorithm, mask generation function and label from the OAEP parameter
+ */
+static CK_RV setOAEPParameter(struct encryptContext *ctx, CK_MECHANISM_PTR pMechanism)
+{
+	CK_RSA_PKCS_OAEP_PARAMS params;
+
+	if ((pMechanism->pParameter == NULL) || (pMechanism->ulParameterLen != sizeof(params))) {
+		return CKR_MECHANISM_PARAM_INVALID;
+	}
+
+	memcpy(&params, pMechanism->pParameter, sizeof(params));
+
+	ctx->oaepHash = params.hashAlg;
+	ctx->mgfHash = getMGF1Hash(params.mgf);
+
+	if ((getDigestSize(ctx->oaepHash) < 0) || (ctx->mgfHash == 0)) {
+		return CKR_MECHANISM_PARAM_INVALID;
+	}
+
+	if (params.ulSourceDataLen > 0) {
+		if ((params.source != CKZ_DATA_SPECIFIED) || !isValidPtr(params.pSourceData)) {
+			return CKR_MECHANISM_PARAM_INVALID;
+		}
+	}
+
+	digest(ctx->oaepHash, params.pSourceData, params.ulSourceDataLen, ctx->labelHash);
+	return CKR_OK;
+}
+
+
+
+/**
+ * Start an encryption operation
+ *
+ * @param ctx        The context to initialize
+ * @param key        The public key object
+ * @param pMechanism The mechanism and parameter passed by the application
+ * @return           CKR_OK or a PKCS#11 error code
+ */
+CK_RV encryptInit(struct encryptContext *ctx, struct p11Object_t *key, CK_MECHANISM_PTR pMechanism)
+{
+	CK_MECHANISM_INFO info;
+	unsigned char *modulus, *exponent;
+	size_t modulusLen, exponentLen;
+	CK_RV rv;
+
+	if (getEncryptMechanismInfo(pMechanism->mechanism, &info) < 0) {
+		return CKR_MECHANISM_INVALID;
+	}
+
+	if (getULongAttribute(key, CKA_CLASS, CK_UNAVAILABLE_INFORMATION) != CKO_PUBLIC_KEY) {
+		return CKR_KEY_FUNCTION_NOT_PERMITTED;
+	}
+
+	if (!getBooleanAttribute(key, CKA_ENCRYPT, 1)) {
+		return CKR_KEY_FUNCTION_NOT_PERMITTED;
+	}
+
+	if (getULongAttribute(key, CKA_KEY_TYPE, CK_UNAVAILABLE_INFORMATION) != CKK_RSA) {
+		return CKR_KEY_TYPE_INCONSISTENT;
+	}
+
+	memset(ctx, 0, sizeof(*ctx));
+	ctx->mech = pMechanism->mechanism;
+
+	if (ctx->mech == CKM_RSA_PKCS_OAEP) {
+		rv = setOAEPParameter(ctx, pMechanism);
+
+		if (rv != CKR_OK) {
+			return rv;
+		}
+	}
+
+	if ((getAttributeValue(key, CKA_MODULUS, &modulus, &modulusLen) < 0) ||
+		(getAttributeValue(key, CKA_PUBLIC_EXPONENT, &exponent, &exponentLen) < 0)) {
+		return CKR_KEY_TYPE_INCONSISTENT;
+	}
+
+	if (rsaInitPublicKey(&ctx->key, modulus, modulusLen, exponent, exponentLen) < 0) {
+		return CKR_KEY_SIZE_RANGE;
+	}
+
+	switch(ctx->mech) {
+	case CKM_RSA_X_509:
+		ctx->maxDataLen = ctx->key.size;
+		break;
+	case CKM_RSA_PKCS:
+		ctx->maxDataLen = ctx->key.size - 11;
+		break;
+	case CKM_RSA_PKCS_OAEP:
+		if (ctx->key.size < 2 * getDigestSize(ctx->oaepHash) + 2) {
+			return CKR_KEY_SIZE_RANGE;
+		}
+		ctx->maxDataLen = ctx->key.size - 2 * getDigestSize(ctx->oaepHash) - 2;
+		break;
+	}
+
+	return CKR_OK;
+}
+
+
+
+/**
+ * Encrypt the data
+ *
+ * If out is NULL, then only the length of the cryptogram is returned.
+ *
+ * @param ctx        The context
+ * @param data       The plain text
+ * @param dataLen    The length of the plain text
+ * @param out        Buffer receiving the cryptogram or NULL
+ * @param outLen     Size of buffer on input, length of cryptogram on output
+ * @return           CKR_OK, CKR_BUFFER_TOO_SMALL, CKR_DATA_LEN_RANGE or CKR_FUNCTION_FAILED
+ */
+CK_RV encryptData(struct encryptContext *ctx, const unsigned char *data, size_t dataLen, unsigned char *out, CK_ULONG_PTR outLen)
+{
+	unsigned char em[RSA_MAX_BYTES];
+	size_t k = ctx->key.size;
+	int rc;
+
+	if (dataLen > ctx->maxDataLen) {
+		return CKR_DATA_LEN_RANGE;
+	}
+
+	if (out == NULL) {
+		*outLen = k;
+		return CKR_OK;
+	}
+
+	if (*outLen < k) {
+		*outLen = k;
+		return CKR_BUFFER_TOO_SMALL;
+	}
+
+	switch(ctx->mech) {
+	case CKM_RSA_X_509:
+		rc = rsaPublic(&ctx->key, data, dataLen, out);
+		*outLen = k;
+		return rc < 0 ? CKR_DATA_INVALID : CKR_OK;
+	case CKM_RSA_PKCS:
+		rc = pkcs1V15AddEncryptionPadding(em, k, data, dataLen);
+		break;
+	default:
+		rc = oaepEncode(em, k, ctx->oaepHash, ctx->mgfHash, ctx->labelHash, data, dataLen);
+		break;
+	}
+
+	if ((rc < 0) || (rsaPublic(&ctx->key, em, k, out) < 0)) {
+		memset_s(em, sizeof(em), 0, sizeof(em));
+		return CKR_FUNCTION_FAILED;
+	}
+
+	memset_s(em, sizeof(em), 0, sizeof(em));
+	*outLen = k;
+	return CKR_OK;
+}
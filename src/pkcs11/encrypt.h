@@ -0,0 +1,58 @@
+/**
+ * SmartCard-HSM PKCS#11 Module
+ *
+ * Copyright (c) 2013, CardContact Systems GmbH, Minden, Germany
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of CardContact Systems GmbH nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CardContact Systems GmbH BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file    encrypt.h
+ * @brief   Encryption with RSA public keys in the host
+ */
+
+#ifndef ___ENCRYPT_H_INC___
+#define ___ENCRYPT_H_INC___
+
+#include <pkcs11/cryptoki.h>
+#include <pkcs11/object.h>
+#include <pkcs11/digest.h>
+#include <pkcs11/rsa.h>
+
+/**
+ * State of an encryption operation
+ */
+struct encryptContext {
+	CK_MECHANISM_TYPE mech;           /**< The encryption mechanism            */
+	CK_MECHANISM_TYPE oaepHash;       /**< Hash from the OAEP parameter        */
+	CK_MECHANISM_TYPE mgfHash;        /**< Hash for MGF1 from the OAEP parameter */
+	unsigned char labelHash[DIGEST_MAX_SIZE]; /**< Hash of the OAEP label      */
+	size_t maxDataLen;                /**< Maximum length of the plain text    */
+	struct rsaPublicKey key;          /**< The prepared public key             */
+};
+
+int getEncryptMechanisms(CK_MECHANISM_TYPE_PTR pMechanismList, CK_ULONG ulCount);
+int getEncryptMechanismInfo(CK_MECHANISM_TYPE mech, CK_MECHANISM_INFO_PTR pInfo);
+CK_RV encryptInit(struct encryptContext *ctx, struct p11Object_t *key, CK_MECHANISM_PTR pMechanism);
+CK_RV encryptData(struct encryptContext *ctx, const unsigned char *data, size_t dataLen, unsigned char *out, CK_ULONG_PTR outLen);
+
+#endif /* ___ENCRYPT_H_INC___ */
@@ -0,0 +1,255 @@
+/**
+ * SmartCard-HSM PKCS#11 Module
+ *
+ * Copyright (c) 2013, CardContact Systems GmbH, Minden, Germany
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of CardContact Systems GmbH nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CardContact Systems GmbH BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file    hashsign.c
+ * @brief   Hashing in the host for signature mechanisms the token only supports raw
+ *
+ * The data is hashed in the host and only the hash is sent to the token, either
+ * as is for ECDSA, as DigestInfo for PKCS#1 v1.5 or as EMSA-PSS encoded message
+ * for the raw RSA operation. PSS uses MGF1 with the same hash and a salt with the
+ * length of the hash.
+ */
+
+#include <string.h>
+
+#include <common/memset_s.h>
+
+#include <pkcs11/hashsign.h>
+#include <pkcs11/rsa.h>
+
+
+
+/**
+ * Hash-and-sign mechanisms and the raw mechanism that signs the encoded hash
+ */
+static const struct hashSignMechanism {
+	CK_MECHANISM_TYPE mech;
+	CK_MECHANISM_TYPE hash;
+	CK_MECHANISM_TYPE rawMech;
+} hashSignMechanisms[] = {
+	{ CKM_SHA1_RSA_PKCS,        CKM_SHA_1,   CKM_RSA_PKCS },
+	{ CKM_SHA224_RSA_PKCS,      CKM_SHA224,  CKM_RSA_PKCS },
+	{ CKM_SHA256_RSA_PKCS,      CKM_SHA256,  CKM_RSA_PKCS },
+	{ CKM_SHA384_RSA_PKCS,      CKM_SHA384,  CKM_RSA_PKCS },
+	{ CKM_SHA512_RSA_PKCS,      CKM_SHA512,  CKM_RSA_PKCS },
+	{ CKM_SHA1_RSA_PKCS_PSS,    CKM_SHA_1,   CKM_RSA_X_509 },
+	{ CKM_SHA224_RSA_PKCS_PSS,  CKM_SHA224,  CKM_RSA_X_509 },
+	{ CKM_SHA256_RSA_PKCS_PSS,  CKM_SHA256,  CKM_RSA_X_509 },
+	{ CKM_SHA384_RSA_PKCS_PSS,  CKM_SHA384,  CKM_RSA_X_509 },
+	{ CKM_SHA512_RSA_PKCS_PSS,  CKM_SHA512,  CKM_RSA_X_509 },
+	{ CKM_ECDSA_SHA1,           CKM_SHA_1,   CKM_ECDSA },
+	{ CKM_ECDSA_SHA224,         CKM_SHA224,  CKM_ECDSA },
+	{ CKM_ECDSA_SHA256,         CKM_SHA256,  CKM_ECDSA },
+	{ CKM_ECDSA_SHA384,         CKM_SHA384,  CKM_ECDSA },
+	{ CKM_ECDSA_SHA512,         CKM_SHA512,  CKM_ECDSA }
+};
+
+
+
+static const struct hashSignMechanism *findMechanism(CK_MECHANISM_TYPE mech)
+{
+	int i;
+
+	for (i = 0; i < sizeof(hashSignMechanisms) / sizeof(*hashSignMechanisms); i++) {
+		if (hashSignMechanisms[i].mech == mech)
+			return &hashSignMechanisms[i];
+	}
+	return NULL;
+}
+
+
+
+/**
+ * Return the raw mechanism that signs the hash encoded for a hash-and-sign mechanism
+ *
+ * @param mech       The hash-and-sign mechanism
+ * @return           CKM_RSA_PKCS, CKM_RSA_X_509, CKM_ECDSA or 0 if the mechanism does not hash
+ */
+CK_MECHANISM_TYPE getHashSignRawMechanism(CK_MECHANISM_TYPE mech)
+{
+	const struct hashSignMechanism *hm = findMechanism(mech);
+
+	return hm ? hm->rawMech : 0;
+}
+
+
+
+/**
+ * Check that the parameter of a PSS mechanism matches the encoding applied in the host,
+ * i.e. MGF1 with the same hash and a salt with the length of the hash
+ *
+ * @param mech       The hash-and-sign mechanism with parameter
+ * @return           CKR_OK, CKR_MECHANISM_INVALID or CKR_MECHANISM_PARAM_INVALID
+ */
+int checkHashSignParameter(CK_MECHANISM_PTR mech)
+{
+	const struct hashSignMechanism *hm = findMechanism(mech->mechanism);
+	CK_RSA_PKCS_PSS_PARAMS_PTR params;
+
+	if (hm == NULL)
+		return CKR_MECHANISM_INVALID;
+
+	if ((hm->rawMech != CKM_RSA_X_509) || (mech->pParameter == NULL))
+		return CKR_OK;
+
+	if (mech->ulParameterLen != sizeof(CK_RSA_PKCS_PSS_PARAMS))
+		return CKR_MECHANISM_PARAM_INVALID;
+
+	params = (CK_RSA_PKCS_PSS_PARAMS_PTR)mech->pParameter;
+
+	if ((params->hashAlg != hm->hash) || (getMGF1Hash(params->mgf) != hm->hash) ||
+			(params->sLen != getDigestSize(hm->hash)))
+		return CKR_MECHANISM_PARAM_INVALID;
+
+	return CKR_OK;
+}
+
+
+
+/**
+ * Start hashing for a hash-and-sign mechanism
+ *
+ * @param ctx        The context
+ * @param mech       The hash-and-sign mechanism
+ * @return           CKR_OK or CKR_MECHANISM_INVALID
+ */
+int hashSignInit(struct hashSignContext *ctx, CK_MECHANISM_TYPE mech)
+{
+	const struct hashSignMechanism *hm = findMechanism(mech);
+
+	if ((hm == NULL) || (digestInit(&ctx->digest, hm->hash) < 0))
+		return CKR_MECHANISM_INVALID;
+
+	ctx->mech = mech;
+	ctx->rawMech = hm->rawMech;
+	return CKR_OK;
+}
+
+
+
+/**
+ * Hash the next part of the data
+ *
+ * @param ctx        The context
+ * @param data       The data
+ * @param len        The length of the data
+ */
+void hashSignUpdate(struct hashSignContext *ctx, const unsigned char *data, size_t len)
+{
+	digestUpdate(&ctx->digest, data, len);
+}
+
+
+
+/**
+ * Complete the hash and encode it as input for the raw mechanism
+ *
+ * The context is left unchanged, so that the operation can be repeated if the signature
+ * buffer supplied by the application turns out to be too small.
+ *
+ * @param ctx        The context
+ * @param keysize    The size of the key in bits
+ * @param tbs        Buffer of at least RSA_MAX_BYTES receiving the input for the raw mechanism
+ * @param tbsLen     The variable receiving the length of the input
+ * @return           CKR_OK or any other Cryptoki error code
+ */
+int hashSignFinal(struct hashSignContext *ctx, int keysize, unsigned char *tbs, size_t *tbsLen)
+{
+	struct digestContext dc;
+	const unsigned char *prefix;
+	unsigned char h[DIGEST_MAX_SIZE];
+	int hLen, prefixLen, rc;
+
+	dc = ctx->digest;
+	hLen = digestFinal(&dc, h);
+	memset_s(&dc, sizeof(dc), 0, sizeof(dc));
+
+	rc = CKR_OK;
+
+	switch(ctx->rawMech) {
+	case CKM_ECDSA:
+		// The leftmost bits of the hash are used if it is longer than the order
+		if (hLen > (keysize + 7) >> 3)
+			hLen = (keysize + 7) >> 3;
+		memcpy(tbs, h, hLen);
+		*tbsLen = hLen;
+		break;
+	case CKM_RSA_PKCS:
+		prefix = getDigestInfoPrefix(ctx->digest.mech, &prefixLen);
+		if ((prefix == NULL) || (prefixLen + hLen + 11 > (keysize + 7) >> 3)) {
+			rc = CKR_KEY_SIZE_RANGE;
+			break;
+		}
+		memcpy(tbs, prefix, prefixLen);
+		memcpy(tbs + prefixLen, h, hLen);
+		*tbsLen = prefixLen + hLen;
+		break;
+	case CKM_RSA_X_509:
+		if (pssEncode(tbs, keysize, ctx->digest.mech, ctx->digest.mech, h, hLen, hLen) < 0) {
+			rc = CKR_KEY_SIZE_RANGE;
+			break;
+		}
+		*tbsLen = (keysize + 7) >> 3;
+		break;
+	default:
+		rc = CKR_MECHANISM_INVALID;
+	}
+
+	memset_s(h, sizeof(h), 0, sizeof(h));
+	return rc;
+}
+
+
+
+/**
+ * Hash the data in a single part and encode it as input for the raw mechanism
+ *
+ * @param mech       The hash-and-sign mechanism
+ * @param keysize    The size of the key in bits
+ * @param data       The data
+ * @param len        The length of the data
+ * @param tbs        Buffer of at least RSA_MAX_BYTES receiving the input for the raw mechanism
+ * @param tbsLen     The variable receiving the length of the input
+ * @return           CKR_OK or any other Cryptoki error code
+ */
+int hashSign(CK_MECHANISM_TYPE mech, int keysize, const unsigned char *data, size_t len, unsigned char *tbs, size_t *tbsLen)
+{
+	struct hashSignContext ctx;
+	int rc;
+
+	rc = hashSignInit(&ctx, mech);
+
+	if (rc != CKR_OK)
+		return rc;
+
+	hashSignUpdate(&ctx, data, len);
+	rc = hashSignFinal(&ctx, keysize, tbs, tbsLen);
+
+	memset_s(&ctx, sizeof(ctx), 0, sizeof(ctx));
+	return rc;
+}
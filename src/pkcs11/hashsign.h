@@ -0,0 +1,55 @@
+/**
+ * SmartCard-HSM PKCS#11 Module
+ *
+ * Copyright (c) 2013, CardContact Systems GmbH, Minden, Germany
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of CardContact Systems GmbH nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CardContact Systems GmbH BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file    hashsign.h
+ * @brief   Hashing in the host for signature mechanisms the token only supports raw
+ */
+
+#ifndef ___HASHSIGN_H_INC___
+#define ___HASHSIGN_H_INC___
+
+#include <pkcs11/cryptoki.h>
+#include <pkcs11/digest.h>
+
+/**
+ * State of a hash-and-sign operation hashed in the host
+ */
+struct hashSignContext {
+	CK_MECHANISM_TYPE mech;           /**< The hash-and-sign mechanism         */
+	CK_MECHANISM_TYPE rawMech;        /**< Mechanism signing the encoded hash  */
+	struct digestContext digest;      /**< Hash of the data processed so far   */
+};
+
+CK_MECHANISM_TYPE getHashSignRawMechanism(CK_MECHANISM_TYPE mech);
+int checkHashSignParameter(CK_MECHANISM_PTR mech);
+int hashSignInit(struct hashSignContext *ctx, CK_MECHANISM_TYPE mech);
+void hashSignUpdate(struct hashSignContext *ctx, const unsigned char *data, size_t len);
+int hashSignFinal(struct hashSignContext *ctx, int keysize, unsigned char *tbs, size_t *tbsLen);
+int hashSign(CK_MECHANISM_TYPE mech, int keysize, const unsigned char *data, size_t len, unsigned char *tbs, size_t *tbsLen);
+
+#endif /* ___HASHSIGN_H_INC___ */
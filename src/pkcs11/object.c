@@ -230,6 +230,10 @@ struct id2name_t p11CKMName[] = {
 { CKM_EC_KEY_PAIR_GEN           , "EC_KEY_PAIR_GEN", 0 },
 { CKM_ECDSA                     , "ECDSA", 0 },
 { CKM_ECDSA_SHA1                , "ECDSA_SHA1", 0 },
+{ CKM_ECDSA_SHA224              , "ECDSA_SHA224", 0 },
+{ CKM_ECDSA_SHA256              , "ECDSA_SHA256", 0 },
+{ CKM_ECDSA_SHA384              , "ECDSA_SHA384", 0 },
+{ CKM_ECDSA_SHA512              , "ECDSA_SHA512", 0 },
 { CKM_ECDH1_DERIVE              , "ECDH1_DERIVE", 0 },
 { CKM_ECDH1_COFACTOR_DERIVE     , "ECDH1_COFACTOR_DERIVE", 0 },
 { CKM_ECMQV_DERIVE              , "ECMQV_DERIVE", 0 },
@@ -582,6 +586,89 @@ int isValidPtr(void *ptr)
 
 
 
+/*
+ * Round up to an alignment suitable for attribute nodes and values
+ */
+#define ARENA_ALIGN(n)	(((n) + 2 * sizeof(void *) - 1) & ~(2 * sizeof(void *) - 1))
+
+
+
+/**
+ * Make sure the object can allocate size bytes of attribute storage without
+ * another allocation
+ *
+ * @param object the object
+ * @param size the number of bytes required
+ * @return CKR_OK or -1 if out of memory
+ */
+int reserveAttributeSpace(struct p11Object_t *object, size_t size)
+{
+	struct p11AttributeArena *arena;
+
+	size = ARENA_ALIGN(size);
+
+	if (object->arena && (object->arena->size - object->arena->used >= size)) {
+		return CKR_OK;
+	}
+
+	if (size < ATTRIBUTE_ARENA_BLOCK) {
+		size = ATTRIBUTE_ARENA_BLOCK;
+	}
+
+	arena = (struct p11AttributeArena *)malloc(ARENA_ALIGN(sizeof(struct p11AttributeArena)) + size);
+
+	if (arena == NULL) {
+		return -1;
+	}
+
+	arena->next = object->arena;
+	arena->size = size;
+	arena->used = 0;
+	object->arena = arena;
+
+	return CKR_OK;
+}
+
+
+
+/*
+ * Allocate zeroed memory from the arena of the object
+ */
+static void *allocAttributeSpace(struct p11Object_t *object, size_t size)
+{
+	unsigned char *p;
+
+	size = ARENA_ALIGN(size);
+
+	if (reserveAttributeSpace(object, size) < 0) {
+		return NULL;
+	}
+
+	p = (unsigned char *)object->arena + ARENA_ALIGN(sizeof(struct p11AttributeArena)) + object->arena->used;
+	object->arena->used += size;
+
+	memset(p, 0, size);
+	return p;
+}
+
+
+
+/*
+ * Release all blocks of the arena
+ */
+static void freeAttributeArena(struct p11Object_t *object)
+{
+	struct p11AttributeArena *arena;
+
+	while (object->arena) {
+		arena = object->arena;
+		object->arena = arena->next;
+		free(arena);
+	}
+}
+
+
+
 int addAttribute(struct p11Object_t *object, CK_ATTRIBUTE_PTR pTemplate)
 {
 	struct p11Attribute_t *pAttribute, **ppAttribute;
@@ -589,20 +676,15 @@ int addAttribute(struct p11Object_t *object, CK_ATTRIBUTE_PTR pTemplate)
 	if (pTemplate->ulValueLen && (pTemplate->pValue == NULL))
 		return -1;
 
-	pAttribute = (struct p11Attribute_t *) calloc (1, sizeof(struct p11Attribute_t));
+	// Node and value in a single chunk
+	pAttribute = (struct p11Attribute_t *)allocAttributeSpace(object, ARENA_ALIGN(sizeof(struct p11Attribute_t)) + pTemplate->ulValueLen);
 
 	if (pAttribute == NULL) {
 		return -1;
 	}
 
 	pAttribute->attrData = *pTemplate;
-
-	pAttribute->attrData.pValue = calloc(pAttribute->attrData.ulValueLen, 1);
-
-	if (pAttribute->attrData.pValue == NULL) {
-		free(pAttribute);
-		return -1;
-	}
+	pAttribute->attrData.pValue = (unsigned char *)pAttribute + ARENA_ALIGN(sizeof(struct p11Attribute_t));
 
 	if (pTemplate->pValue)
 		memcpy(pAttribute->attrData.pValue, pTemplate->pValue, pAttribute->attrData.ulValueLen);
@@ -618,6 +700,37 @@ int addAttribute(struct p11Object_t *object, CK_ATTRIBUTE_PTR pTemplate)
 
 
 
+/**
+ * Replace the value of an existing attribute. The current buffer is reused if the
+ * new value fits
+ *
+ * @param object the object containing the attribute
+ * @param attribute the attribute to update
+ * @param pTemplate the new value
+ * @return CKR_OK or -1 if out of memory
+ */
+int updateAttribute(struct p11Object_t *object, struct p11Attribute_t *attribute, CK_ATTRIBUTE_PTR pTemplate)
+{
+	void *pValue;
+
+	if (pTemplate->ulValueLen > attribute->attrData.ulValueLen) {
+		pValue = allocAttributeSpace(object, pTemplate->ulValueLen);
+
+		if (pValue == NULL) {
+			return -1;
+		}
+
+		attribute->attrData.pValue = pValue;
+	}
+
+	attribute->attrData.ulValueLen = pTemplate->ulValueLen;
+	memcpy(attribute->attrData.pValue, pTemplate->pValue, pTemplate->ulValueLen);
+
+	return CKR_OK;
+}
+
+
+
 int findAttribute(struct p11Object_t *object, CK_ATTRIBUTE_PTR attributeTemplate, struct p11Attribute_t **attribute)
 {
 	struct p11Attribute_t *attr;
@@ -641,6 +754,64 @@ int findAttribute(struct p11Object_t *object, CK_ATTRIBUTE_PTR attributeTemplate
 
 
 
+/**
+ * Locate the value of an attribute
+ *
+ * @param object     The object
+ * @param type       The attribute type
+ * @param value      Set to the value stored in the object
+ * @param len        Set to the length of the value
+ * @return           0 or -1 if the attribute is missing
+ */
+int getAttributeValue(struct p11Object_t *object, CK_ATTRIBUTE_TYPE type, unsigned char **value, size_t *len)
+{
+	CK_ATTRIBUTE attr = { type, NULL, 0 };
+	struct p11Attribute_t *pAttr;
+
+	if (findAttribute(object, &attr, &pAttr) < 0)
+		return -1;
+
+	*value = pAttr->attrData.pValue;
+	*len = pAttr->attrData.ulValueLen;
+	return 0;
+}
+
+
+
+/**
+ * Return the value of a CK_ULONG attribute or def if the attribute is missing
+ */
+CK_ULONG getULongAttribute(struct p11Object_t *object, CK_ATTRIBUTE_TYPE type, CK_ULONG def)
+{
+	unsigned char *value;
+	size_t len;
+	CK_ULONG v;
+
+	if ((getAttributeValue(object, type, &value, &len) < 0) || (len != sizeof(CK_ULONG)))
+		return def;
+
+	memcpy(&v, value, sizeof(v));
+	return v;
+}
+
+
+
+/**
+ * Return the value of a CK_BBOOL attribute or def if the attribute is missing
+ */
+int getBooleanAttribute(struct p11Object_t *object, CK_ATTRIBUTE_TYPE type, int def)
+{
+	unsigned char *value;
+	size_t len;
+
+	if ((getAttributeValue(object, type, &value, &len) < 0) || (len != sizeof(CK_BBOOL)))
+		return def;
+
+	return *value ? 1 : 0;
+}
+
+
+
 int findAttributeInTemplate(CK_ATTRIBUTE_TYPE attributeType, CK_ATTRIBUTE_PTR pTemplate, CK_ULONG ulCount)
 {
 	int i;
@@ -658,7 +829,7 @@ int findAttributeInTemplate(CK_ATTRIBUTE_TYPE attributeType, CK_ATTRIBUTE_PTR pT
 
 int removeAttribute(struct p11Object_t *object, CK_ATTRIBUTE_PTR attributeTemplate)
 {
-	struct p11Attribute_t *pAttr, **ppAttr;
+	struct p11Attribute_t **ppAttr;
 
 	ppAttr = &object->attrList;
 	while (*ppAttr && ((*ppAttr)->attrData.type != attributeTemplate->type)) {
@@ -668,12 +839,9 @@ int removeAttribute(struct p11Object_t *object, CK_ATTRIBUTE_PTR attributeTempla
 	if (*ppAttr == NULL)
 		return CKR_GENERAL_ERROR;
 
-	pAttr = *ppAttr;
+	// Storage is released with the arena
 	*ppAttr = (*ppAttr)->next;
 
-	free(pAttr->attrData.pValue);
-	free(pAttr);
-
 	return CKR_OK;
 }
 
@@ -681,10 +849,8 @@ int removeAttribute(struct p11Object_t *object, CK_ATTRIBUTE_PTR attributeTempla
 
 int removeAllAttributes(struct p11Object_t *object)
 {
-	while(object->attrList) {
-		if (removeAttribute(object, &object->attrList->attrData) != CKR_OK)
-			return CKR_GENERAL_ERROR;
-	}
+	object->attrList = NULL;
+	freeAttributeArena(object);
 
 	return CKR_OK;
 }
@@ -793,8 +959,21 @@ int dumpAttributeList(struct p11Object_t *pObject)
 
 int createObject(CK_ATTRIBUTE_PTR pTemplate, CK_ULONG ulCount, struct p11Object_t *pObject)
 {
+	size_t size;
+	unsigned int i;
 	int index;
 
+	/* Allocate storage for the template and default attributes at once */
+
+	size = ATTRIBUTE_ARENA_SPARE;
+	for (i = 0; i < ulCount; i++) {
+		size += ARENA_ALIGN(sizeof(struct p11Attribute_t)) + ARENA_ALIGN(pTemplate[i].ulValueLen);
+	}
+
+	if (reserveAttributeSpace(pObject, size) < 0) {
+		return CKR_HOST_MEMORY;
+	}
+
 	/* Check if the CKA_CLASS attribute is present */
 
 	index = findAttributeInTemplate(CKA_CLASS, pTemplate, ulCount);
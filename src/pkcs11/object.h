@@ -53,6 +53,25 @@ struct p11Attribute_t {
 
 
 
+/**
+ * Block of memory from which attributes and their values are allocated.
+ *
+ * Attributes of an object are packed into as few blocks as possible. Space
+ * of removed attributes is only returned when the object is freed.
+ */
+
+struct p11AttributeArena {
+
+    struct p11AttributeArena *next; /**< Previously filled block             */
+    size_t size;                    /**< Usable bytes in this block          */
+    size_t used;                    /**< Bytes allocated from this block     */
+};
+
+#define ATTRIBUTE_ARENA_BLOCK   512     /**< Minimum size of an arena block            */
+#define ATTRIBUTE_ARENA_SPARE   1024    /**< Space reserved for default attributes     */
+
+
+
 struct p11Token_t;				// Forward declaration
 
 /**
@@ -75,22 +94,10 @@ struct p11Object_t {
 
     struct p11Token_t *token;
 
-    int (*C_EncryptInit)  (struct p11Object_t *, CK_MECHANISM_PTR);
-    int (*C_Encrypt)      (struct p11Object_t *, CK_MECHANISM_TYPE, CK_BYTE_PTR, CK_ULONG, CK_BYTE_PTR, CK_ULONG_PTR);
-    int (*C_EncryptUpdate)(struct p11Object_t *, CK_MECHANISM_TYPE, CK_BYTE_PTR, CK_ULONG, CK_BYTE_PTR, CK_ULONG_PTR);
-    int (*C_EncryptFinal) (struct p11Object_t *, CK_MECHANISM_TYPE, CK_BYTE_PTR, CK_ULONG_PTR);
-
-    int (*C_DecryptInit)  (struct p11Object_t *, CK_MECHANISM_PTR);
-    int (*C_Decrypt)      (struct p11Object_t *, CK_MECHANISM_TYPE, CK_BYTE_PTR, CK_ULONG, CK_BYTE_PTR, CK_ULONG_PTR);
-    int (*C_DecryptUpdate)(struct p11Object_t *, CK_MECHANISM_TYPE, CK_BYTE_PTR, CK_ULONG, CK_BYTE_PTR, CK_ULONG_PTR);
-    int (*C_DecryptFinal) (struct p11Object_t *, CK_MECHANISM_TYPE, CK_BYTE_PTR, CK_ULONG_PTR);
-
-    int (*C_SignInit)     (struct p11Object_t *, CK_MECHANISM_PTR);
-    int (*C_Sign)         (struct p11Object_t *, CK_MECHANISM_TYPE, CK_BYTE_PTR, CK_ULONG, CK_BYTE_PTR, CK_ULONG_PTR);
-    int (*C_SignUpdate)   (struct p11Object_t *, CK_MECHANISM_TYPE, CK_BYTE_PTR, CK_ULONG);
-    int (*C_SignFinal)    (struct p11Object_t *, CK_MECHANISM_TYPE, CK_BYTE_PTR, CK_ULONG_PTR);
+    const struct p11ObjectOps *ops;     /**< Operations shared with other keys or NULL */
 
     struct p11Attribute_t *attrList;    /**< The list of attributes              */
+    struct p11AttributeArena *arena;    /**< Storage for attributes and values   */
     struct p11Object_t *next;       /**< Pointer to next object              */
 
 };
@@ -116,8 +123,13 @@ char *id2name(struct id2name_t *p, unsigned long id, unsigned long *attr);
 #endif
 
 int isValidPtr(void *ptr);
+int reserveAttributeSpace(struct p11Object_t *object, size_t size);
 int addAttribute(struct p11Object_t *object, CK_ATTRIBUTE_PTR pTemplate);
+int updateAttribute(struct p11Object_t *object, struct p11Attribute_t *attribute, CK_ATTRIBUTE_PTR pTemplate);
 int findAttribute(struct p11Object_t *object, CK_ATTRIBUTE_PTR attributeTemplate, struct p11Attribute_t **attribute);
+int getAttributeValue(struct p11Object_t *object, CK_ATTRIBUTE_TYPE type, unsigned char **value, size_t *len);
+CK_ULONG getULongAttribute(struct p11Object_t *object, CK_ATTRIBUTE_TYPE type, CK_ULONG def);
+int getBooleanAttribute(struct p11Object_t *object, CK_ATTRIBUTE_TYPE type, int def);
 int findAttributeInTemplate(CK_ATTRIBUTE_TYPE attributeType, CK_ATTRIBUTE_PTR pTemplate, CK_ULONG ulCount);
 int removeAttribute(struct p11Object_t *object, CK_ATTRIBUTE_PTR attributeTemplate);
 int removeAllAttributes(struct p11Object_t *object);
@@ -34,11 +34,14 @@
 #include <string.h>
 
 #include <common/mutex.h>
+#include <common/securemem.h>
 
 #include <pkcs11/p11generic.h>
 #include <pkcs11/session.h>
 #include <pkcs11/slotpool.h>
 #include <pkcs11/strbpcpy.h>
+#include <pkcs11/asyncop.h>
+#include <pkcs11/digest.h>
 
 #ifdef DEBUG
 #include <pkcs11/debug.h>
@@ -318,6 +321,16 @@ CK_DECLARE_FUNCTION(CK_RV, C_Initialize)
 #endif
 
 	context->caller = determineCaller();
+	context->noThreads = (initArgs.flags & CKF_LIBRARY_CANT_CREATE_OS_THREADS) ? 1 : 0;
+
+	// Without the pool, sensitive data is kept on the heap
+	if (secureMemInit(SECURE_POOL_SIZE) < 0) {
+#ifdef DEBUG
+		debug("[C_Initialize] Could not create locked memory pool\n");
+#endif
+	}
+
+	initDigestEngine();
 
 	initSessionPool(&context->sessionPool);
 
@@ -332,6 +345,15 @@ CK_DECLARE_FUNCTION(CK_RV, C_Initialize)
 		FUNC_RETURNS(rv);
 	}
 
+	rv = initAsyncOperations();
+
+	if (rv != CKR_OK) {
+		terminateSlotPool(&context->slotPool);
+		free(context);
+		context = NULL;
+		FUNC_RETURNS(rv);
+	}
+
 	FUNC_RETURNS(CKR_OK);
 }
 
@@ -350,6 +372,9 @@ CK_DECLARE_FUNCTION(CK_RV, C_Finalize)
 	FUNC_CALLED();
 
 	if (context != NULL) {
+		// Executors must not wait for the global lock while being joined
+		terminateAsyncOperations();
+
 		p11LockMutex(context->mutex);
 
 		terminateSessionPool(&context->sessionPool);
@@ -365,6 +390,8 @@ CK_DECLARE_FUNCTION(CK_RV, C_Finalize)
 
 		free(context);
 		context = NULL;
+
+		secureMemTerm();
 	}
 
 	context = NULL;
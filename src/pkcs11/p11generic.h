@@ -38,6 +38,7 @@
 #include <stdlib.h>
 
 #include <pkcs11/cryptoki.h>
+#include <pkcs11/p11vendor.h>
 #include <pkcs11/object.h>
 
 #ifndef VERSION_MAJOR
@@ -92,6 +93,15 @@ struct p11TokenDriver;
 
 #define INT_CKU_NO_USER 0xFF
 
+/* Number of ids reserved after the id of a slot for its first virtual slots */
+#define VIRTUAL_SLOT_IDS 3
+
+/* Maximum number of virtual slots per slot */
+#define VIRTUAL_SLOTS_MAX 256
+
+/* Further virtual slots have this bit set, the primary slot id in bits 8-30 and the index in bits 0-7 */
+#define VIRTUAL_SLOT_ID_EXTENDED 0x80000000UL
+
 /**
  * Internal structure to store information about a token.
  *
@@ -105,6 +115,7 @@ struct p11Token_t {
 
 	int pinUseCounter;                  /**< Number of crypto operations per PIN verify     */
 	int pinChangeRequired;              /**< PIN change required before use                 */
+	int objectsPending;                 /**< Objects are loaded by the driver on first use  */
 
 	CK_ULONG numberOfTokenObjects;      /**< The number of public objects in this token     */
 	struct p11Object_t *tokenObjList;   /**< Pointer to first object in pool                */
@@ -125,6 +136,7 @@ struct p11Slot_t {
 	CK_SLOT_ID id;                    /**< The id of the slot                  */
 	CK_SLOT_INFO info;                /**< General information about the slot  */
 	int closed;                       /**< Slot hardware currently absent      */
+	int pending;                      /**< Slot not yet published in pool      */
 	unsigned long hasFeatureVerifyPINDirect;
 #ifdef CTAPI
 	unsigned short ctn;               /**< Card terminal number                */
@@ -136,8 +148,12 @@ struct p11Slot_t {
 	int maxCAPDU;                     /**< Maximum length of command APDU      */
 	int maxRAPDU;                     /**< Maximum length of response APDU     */
 	int noExtLengthReadAll;           /**< Prevent using Le='000000'           */
+	unsigned int transmitErrors;      /**< Failed transmissions, e.g. on reset */
 	struct p11Slot_t *primarySlot;    /**< Base slot if slot is virtual        */
-	struct p11Slot_t *virtualSlots[2];/**< Virtual slots using this as base    */
+	struct p11Slot_t **virtualSlots;  /**< Virtual slots using this as base    */
+	int virtualSlotsSize;             /**< Number of entries in virtualSlots   */
+	struct p11SlotQueue_t *queue;     /**< Queue serialising access to the card */
+	struct p11SlotRandom_t *random;   /**< Random number generator of the slot */
 	struct p11Token_t *token;         /**< Pointer to token in the slot        */
 	struct p11Token_t *removedToken;  /**< Removed but not freed token         */
 	struct p11Slot_t *next;           /**< Pointer to next available slot      */
@@ -170,12 +186,39 @@ struct p11SessionPool_t {
 
 
 
+/**
+ * Operations shared by all key objects of the same driver and key type
+ */
+struct p11ObjectOps {
+	int (*C_EncryptInit)  (struct p11Object_t *, CK_MECHANISM_PTR);
+	int (*C_Encrypt)      (struct p11Object_t *, CK_MECHANISM_TYPE, CK_BYTE_PTR, CK_ULONG, CK_BYTE_PTR, CK_ULONG_PTR);
+	int (*C_EncryptUpdate)(struct p11Object_t *, CK_MECHANISM_TYPE, CK_BYTE_PTR, CK_ULONG, CK_BYTE_PTR, CK_ULONG_PTR);
+	int (*C_EncryptFinal) (struct p11Object_t *, CK_MECHANISM_TYPE, CK_BYTE_PTR, CK_ULONG_PTR);
+
+	int (*C_DecryptInit)  (struct p11Object_t *, CK_MECHANISM_PTR);
+	int (*C_Decrypt)      (struct p11Object_t *, CK_MECHANISM_TYPE, CK_BYTE_PTR, CK_ULONG, CK_BYTE_PTR, CK_ULONG_PTR);
+	int (*C_DecryptUpdate)(struct p11Object_t *, CK_MECHANISM_TYPE, CK_BYTE_PTR, CK_ULONG, CK_BYTE_PTR, CK_ULONG_PTR);
+	int (*C_DecryptFinal) (struct p11Object_t *, CK_MECHANISM_TYPE, CK_BYTE_PTR, CK_ULONG_PTR);
+
+	int (*C_SignInit)     (struct p11Object_t *, CK_MECHANISM_PTR);
+	int (*C_Sign)         (struct p11Object_t *, CK_MECHANISM_TYPE, CK_BYTE_PTR, CK_ULONG, CK_BYTE_PTR, CK_ULONG_PTR);
+	int (*C_SignUpdate)   (struct p11Object_t *, CK_MECHANISM_TYPE, CK_BYTE_PTR, CK_ULONG);
+	int (*C_SignFinal)    (struct p11Object_t *, CK_MECHANISM_TYPE, CK_BYTE_PTR, CK_ULONG_PTR);
+
+	/**< Optional, SC_SignBatch() falls back to C_Sign() for each item                       */
+	int (*C_SignBatch)    (struct p11Object_t *, CK_MECHANISM_TYPE, SC_SIGN_BATCH_ITEM_PTR, CK_ULONG);
+
+	/**< Optional, multi-part signatures with this mechanism are hashed in the host and signed with the raw mechanism */
+	int (*isHashedInHost) (struct p11Object_t *, CK_MECHANISM_TYPE);
+};
+
+
+
 struct p11TokenDriver {
 	const char *name;                   /**< Name of driver                                 */
 	int version;                        /**< Differentiate among card family members        */
 	int maxCAPDU;                       /**< Maximum length of command APDU                 */
 	int maxRAPDU;                       /**< Maximum length of response APDU                */
-	int maxHashBlock;                   /**< Maximum number of byte in a hash block         */
 	/**< Allow driver to check if card is a candidate based on the ATR                      */
 	int (*isCandidate)(unsigned char *atr, size_t atrLen);
 	int (*newToken)(struct p11Slot_t *slot, struct p11Token_t **token);
@@ -186,15 +229,11 @@ struct p11TokenDriver {
 	int (*logout)(struct p11Slot_t *slot);
 	int (*initpin)(struct p11Slot_t *slot, unsigned char *pin, int pinlen);
 	int (*setpin)(struct p11Slot_t *slot, unsigned char *oldpin, int oldpinlen, unsigned char *newpin, int newpinlen);
+	int (*loadObjects)(struct p11Token_t *token);  /**< Load the objects of a token created with objectsPending set */
+	void (*lock)(struct p11Token_t *token);        /**< Serialise card access outside of driver operations */
+	void (*unlock)(struct p11Token_t *token);      /**< Release card access obtained with lock() */
 
-	int (*C_DecryptInit)  (struct p11Object_t *, CK_MECHANISM_PTR);
-	int (*C_Decrypt)      (struct p11Object_t *, CK_MECHANISM_TYPE, CK_BYTE_PTR, CK_ULONG, CK_BYTE_PTR, CK_ULONG_PTR);
-	int (*C_DecryptUpdate)(struct p11Object_t *, CK_MECHANISM_TYPE, CK_BYTE_PTR, CK_ULONG, CK_BYTE_PTR, CK_ULONG_PTR);
-	int (*C_DecryptFinal) (struct p11Object_t *, CK_MECHANISM_TYPE, CK_BYTE_PTR, CK_ULONG_PTR);
-	int (*C_SignInit)     (struct p11Object_t *, CK_MECHANISM_PTR);
-	int (*C_Sign)         (struct p11Object_t *, CK_MECHANISM_TYPE, CK_BYTE_PTR, CK_ULONG, CK_BYTE_PTR, CK_ULONG_PTR);
-	int (*C_SignUpdate)   (struct p11Object_t *, CK_MECHANISM_TYPE, CK_BYTE_PTR, CK_ULONG);
-	int (*C_SignFinal)    (struct p11Object_t *, CK_MECHANISM_TYPE, CK_BYTE_PTR, CK_ULONG_PTR);
+	const struct p11ObjectOps *privateKeyOps;  /**< Operations referenced by private key objects */
 };
 
 
@@ -211,6 +250,7 @@ struct p11Context_t {
 	CK_HW_FEATURE_TYPE hw_feature;          /**< Hardware feature type of device          */
 
 	int caller;                             /**< Calling application                      */
+	int noThreads;                          /**< Library must not create OS threads       */
 
 	FILE *debugFileHandle;
 
@@ -35,13 +35,25 @@
 #include <unistd.h>
 #endif
 
+#include <stdlib.h>
+#include <string.h>
+
 #include <pkcs11/p11generic.h>
 #include <pkcs11/session.h>
 #include <pkcs11/slot.h>
 #include <pkcs11/slotpool.h>
 #include <pkcs11/token.h>
+#include <pkcs11/digest.h>
+#include <pkcs11/verify.h>
+#include <pkcs11/encrypt.h>
+#include <pkcs11/slotrandom.h>
+#include <pkcs11/hashsign.h>
+#include <pkcs11/rsa.h>
 #include <pkcs11/debug.h>
 
+#include <common/securemem.h>
+#include <common/memset_s.h>
+
 
 extern struct p11Context_t *context;
 
@@ -99,6 +111,76 @@ int handleDeviceError(CK_SESSION_HANDLE hSession) {
 
 
 
+/**
+ * Locate a key in the session objects or the token objects
+ */
+static CK_RV findKey(struct p11Session_t *pSession, CK_OBJECT_HANDLE hKey, struct p11Object_t **pObject)
+{
+	CK_RV rv;
+	struct p11Slot_t *pSlot;
+
+	if (findSessionObject(pSession, hKey, pObject) >= 0) {
+		return CKR_OK;
+	}
+
+	rv = findSlot(&context->slotPool, pSession->slotID, &pSlot);
+
+	if (rv != CKR_OK) {
+		return rv;
+	}
+
+	return findSlotKey(pSlot, hKey, pObject);
+}
+
+
+
+/*
+ * Start an encryption in the host with a public key
+ */
+static CK_RV startHostEncrypt(struct p11Session_t *pSession, struct p11Object_t *pObject, CK_MECHANISM_PTR pMechanism)
+{
+	CK_RV rv;
+
+	// The context only holds public data, so it does not need to be in secure memory
+	pSession->encrypt = calloc(1, sizeof(struct encryptContext));
+
+	if (pSession->encrypt == NULL) {
+		return CKR_HOST_MEMORY;
+	}
+
+	rv = encryptInit(pSession->encrypt, pObject, pMechanism);
+
+	if (rv != CKR_OK) {
+		endEncrypt(pSession);
+		return rv;
+	}
+
+	clearCryptoBuffer(pSession);
+	pSession->activeObjectHandle = pObject->handle;
+	pSession->activeMechanism = pMechanism->mechanism;
+	return CKR_OK;
+}
+
+
+
+/*
+ * Encrypt in the host and end the operation, unless the caller only queried the length
+ */
+static CK_RV finishHostEncrypt(struct p11Session_t *pSession, CK_BYTE_PTR pData, CK_ULONG ulDataLen, CK_BYTE_PTR pEncryptedData, CK_ULONG_PTR pulEncryptedDataLen)
+{
+	CK_RV rv;
+
+	rv = encryptData(pSession->encrypt, pData, ulDataLen, pEncryptedData, pulEncryptedDataLen);
+
+	if ((rv != CKR_BUFFER_TOO_SMALL) && ((rv != CKR_OK) || (pEncryptedData != NULL))) {
+		endEncrypt(pSession);
+	}
+
+	return rv;
+}
+
+
+
 /*  C_EncryptInit initializes an encryption operation. */
 CK_DECLARE_FUNCTION(CK_RV, C_EncryptInit)(
 		CK_SESSION_HANDLE hSession,
@@ -108,7 +190,6 @@ CK_DECLARE_FUNCTION(CK_RV, C_EncryptInit)(
 {
 	int rv;
 	struct p11Object_t *pObject;
-	struct p11Slot_t *pSlot;
 	struct p11Session_t *pSession;
 
 	FUNC_CALLED();
@@ -127,20 +208,24 @@ CK_DECLARE_FUNCTION(CK_RV, C_EncryptInit)(
 		FUNC_FAILS(CKR_OPERATION_ACTIVE, "Operation is already active");
 	}
 
-	rv = findSlot(&context->slotPool, pSession->slotID, &pSlot);
+	if (!isValidPtr(pMechanism)) {
+		FUNC_FAILS(CKR_ARGUMENTS_BAD, "Invalid pointer argument");
+	}
+
+	rv = findKey(pSession, hKey, &pObject);
 
 	if (rv != CKR_OK) {
 		FUNC_RETURNS(rv);
 	}
 
-	rv = findSlotKey(pSlot, hKey, &pObject);
-
-	if (rv != CKR_OK) {
+	// Public keys are used in the host, the token is only needed for private keys
+	if (getULongAttribute(pObject, CKA_CLASS, CK_UNAVAILABLE_INFORMATION) == CKO_PUBLIC_KEY) {
+		rv = startHostEncrypt(pSession, pObject, pMechanism);
 		FUNC_RETURNS(rv);
 	}
 
-	if (pObject->C_EncryptInit != NULL) {
-		rv = pObject->C_EncryptInit(pObject, pMechanism);
+	if ((pObject->ops != NULL) && (pObject->ops->C_EncryptInit != NULL)) {
+		rv = pObject->ops->C_EncryptInit(pObject, pMechanism);
 		if (rv == CKR_DEVICE_ERROR) {
 			rv = handleDeviceError(hSession);
 			FUNC_FAILS(rv, "Device error reported");
@@ -189,6 +274,16 @@ CK_DECLARE_FUNCTION(CK_RV, C_Encrypt)(
 		FUNC_FAILS(CKR_OPERATION_NOT_INITIALIZED, "Operation not initialized");
 	}
 
+	if (pSession->encrypt != NULL) {
+		if ((ulDataLen && !isValidPtr(pData)) || !isValidPtr(pulEncryptedDataLen)) {
+			endEncrypt(pSession);
+			FUNC_FAILS(CKR_ARGUMENTS_BAD, "Invalid pointer argument");
+		}
+
+		rv = finishHostEncrypt(pSession, pData, ulDataLen, pEncryptedData, pulEncryptedDataLen);
+		FUNC_RETURNS(rv);
+	}
+
 	rv = findSlot(&context->slotPool, pSession->slotID, &pSlot);
 
 	if (rv != CKR_OK) {
@@ -201,8 +296,8 @@ CK_DECLARE_FUNCTION(CK_RV, C_Encrypt)(
 		FUNC_RETURNS(rv);
 	}
 
-	if (pObject->C_Encrypt != NULL) {
-		rv = pObject->C_Encrypt(pObject, pSession->activeMechanism, pData, ulDataLen, pEncryptedData, pulEncryptedDataLen);
+	if ((pObject->ops != NULL) && (pObject->ops->C_Encrypt != NULL)) {
+		rv = pObject->ops->C_Encrypt(pObject, pSession->activeMechanism, pData, ulDataLen, pEncryptedData, pulEncryptedDataLen);
 		if (rv == CKR_DEVICE_ERROR) {
 			rv = handleDeviceError(hSession);
 			FUNC_FAILS(rv, "Device error reported");
@@ -247,6 +342,29 @@ CK_DECLARE_FUNCTION(CK_RV, C_EncryptUpdate)(
 		FUNC_FAILS(CKR_OPERATION_NOT_INITIALIZED, "Operation not initialized");
 	}
 
+	// The plain text is collected in the crypto buffer and encrypted in C_EncryptFinal
+	if (pSession->encrypt != NULL) {
+		if ((ulPartLen && !isValidPtr(pPart)) || !isValidPtr(pulEncryptedPartLen)) {
+			endEncrypt(pSession);
+			FUNC_FAILS(CKR_ARGUMENTS_BAD, "Invalid pointer argument");
+		}
+
+		if (pSession->cryptoBufferSize + ulPartLen > pSession->encrypt->maxDataLen) {
+			endEncrypt(pSession);
+			FUNC_FAILS(CKR_DATA_LEN_RANGE, "Data exceeds the size of the key");
+		}
+
+		rv = appendToCryptoBuffer(pSession, pPart, ulPartLen);
+
+		if (rv != CKR_OK) {
+			endEncrypt(pSession);
+			FUNC_RETURNS(rv);
+		}
+
+		*pulEncryptedPartLen = 0;
+		FUNC_RETURNS(CKR_OK);
+	}
+
 	rv = findSlot(&context->slotPool, pSession->slotID, &pSlot);
 
 	if (rv != CKR_OK) {
@@ -259,8 +377,8 @@ CK_DECLARE_FUNCTION(CK_RV, C_EncryptUpdate)(
 		FUNC_RETURNS(rv);
 	}
 
-	if (pObject->C_EncryptUpdate != NULL) {
-		rv = pObject->C_EncryptUpdate(pObject, pSession->activeMechanism, pPart, ulPartLen, pEncryptedPart, pulEncryptedPartLen);
+	if ((pObject->ops != NULL) && (pObject->ops->C_EncryptUpdate != NULL)) {
+		rv = pObject->ops->C_EncryptUpdate(pObject, pSession->activeMechanism, pPart, ulPartLen, pEncryptedPart, pulEncryptedPartLen);
 		if (rv == CKR_DEVICE_ERROR) {
 			rv = handleDeviceError(hSession);
 			FUNC_FAILS(rv, "Device error reported");
@@ -302,6 +420,16 @@ CK_DECLARE_FUNCTION(CK_RV, C_EncryptFinal)(
 		FUNC_FAILS(CKR_OPERATION_NOT_INITIALIZED, "Operation not initialized");
 	}
 
+	if (pSession->encrypt != NULL) {
+		if (!isValidPtr(pulLastEncryptedPartLen)) {
+			endEncrypt(pSession);
+			FUNC_FAILS(CKR_ARGUMENTS_BAD, "Invalid pointer argument");
+		}
+
+		rv = finishHostEncrypt(pSession, pSession->cryptoBuffer, pSession->cryptoBufferSize, pLastEncryptedPart, pulLastEncryptedPartLen);
+		FUNC_RETURNS(rv);
+	}
+
 	rv = findSlot(&context->slotPool, pSession->slotID, &pSlot);
 
 	if (rv != CKR_OK) {
@@ -314,8 +442,8 @@ CK_DECLARE_FUNCTION(CK_RV, C_EncryptFinal)(
 		FUNC_RETURNS(rv);
 	}
 
-	if (pObject->C_EncryptFinal != NULL) {
-		rv = pObject->C_EncryptFinal(pObject, pSession->activeMechanism, pLastEncryptedPart, pulLastEncryptedPartLen);
+	if ((pObject->ops != NULL) && (pObject->ops->C_EncryptFinal != NULL)) {
+		rv = pObject->ops->C_EncryptFinal(pObject, pSession->activeMechanism, pLastEncryptedPart, pulLastEncryptedPartLen);
 		if (rv == CKR_DEVICE_ERROR) {
 			rv = handleDeviceError(hSession);
 			FUNC_FAILS(rv, "Device error reported");
@@ -374,8 +502,8 @@ CK_DECLARE_FUNCTION(CK_RV, C_DecryptInit)(
 		FUNC_RETURNS(rv);
 	}
 
-	if (pObject->C_DecryptInit != NULL) {
-		rv = pObject->C_DecryptInit(pObject, pMechanism);
+	if ((pObject->ops != NULL) && (pObject->ops->C_DecryptInit != NULL)) {
+		rv = pObject->ops->C_DecryptInit(pObject, pMechanism);
 		if (rv == CKR_DEVICE_ERROR) {
 			rv = handleDeviceError(hSession);
 			FUNC_FAILS(rv, "Device error reported");
@@ -441,8 +569,8 @@ CK_DECLARE_FUNCTION(CK_RV, C_Decrypt)(
 		pSession->activeObjectHandle = CK_INVALID_HANDLE;
 	}
 
-	if (pObject->C_Decrypt != NULL) {
-		rv = pObject->C_Decrypt(pObject, pSession->activeMechanism, pEncryptedData, ulEncryptedDataLen, pData, pulDataLen);
+	if ((pObject->ops != NULL) && (pObject->ops->C_Decrypt != NULL)) {
+		rv = pObject->ops->C_Decrypt(pObject, pSession->activeMechanism, pEncryptedData, ulEncryptedDataLen, pData, pulDataLen);
 		if (rv == CKR_DEVICE_ERROR) {
 			rv = handleDeviceError(hSession);
 			FUNC_FAILS(rv, "Device error reported");
@@ -499,8 +627,8 @@ CK_DECLARE_FUNCTION(CK_RV, C_DecryptUpdate)(
 		FUNC_RETURNS(rv);
 	}
 
-	if (pObject->C_DecryptUpdate != NULL) {
-		rv = pObject->C_DecryptUpdate(pObject, pSession->activeMechanism, pEncryptedPart, ulEncryptedPartLen, pPart, pulPartLen);
+	if ((pObject->ops != NULL) && (pObject->ops->C_DecryptUpdate != NULL)) {
+		rv = pObject->ops->C_DecryptUpdate(pObject, pSession->activeMechanism, pEncryptedPart, ulEncryptedPartLen, pPart, pulPartLen);
 		if (rv == CKR_DEVICE_ERROR) {
 			rv = handleDeviceError(hSession);
 			FUNC_FAILS(rv, "Device error reported");
@@ -554,8 +682,8 @@ CK_DECLARE_FUNCTION(CK_RV, C_DecryptFinal)(
 		FUNC_RETURNS(rv);
 	}
 
-	if (pObject->C_DecryptFinal != NULL) {
-		rv = pObject->C_DecryptFinal(pObject, pSession->activeMechanism, pLastPart, pulLastPartLen);
+	if ((pObject->ops != NULL) && (pObject->ops->C_DecryptFinal != NULL)) {
+		rv = pObject->ops->C_DecryptFinal(pObject, pSession->activeMechanism, pLastPart, pulLastPartLen);
 		if (rv == CKR_DEVICE_ERROR) {
 			rv = handleDeviceError(hSession);
 			FUNC_FAILS(rv, "Device error reported");
@@ -580,7 +708,8 @@ CK_DECLARE_FUNCTION(CK_RV, C_DigestInit)(
 		CK_MECHANISM_PTR pMechanism
 )
 {
-	CK_RV rv = CKR_FUNCTION_NOT_SUPPORTED;
+	CK_RV rv;
+	struct p11Session_t *pSession;
 
 	FUNC_CALLED();
 
@@ -588,11 +717,63 @@ CK_DECLARE_FUNCTION(CK_RV, C_DigestInit)(
 		FUNC_FAILS(CKR_CRYPTOKI_NOT_INITIALIZED, "C_Initialize not called");
 	}
 
+	rv = findSessionByHandle(&context->sessionPool, hSession, &pSession);
+
+	if (rv != CKR_OK) {
+		FUNC_RETURNS(rv);
+	}
+
+	if (pSession->digest != NULL) {
+		FUNC_FAILS(CKR_OPERATION_ACTIVE, "Operation is already active");
+	}
+
+	if (!isValidPtr(pMechanism)) {
+		FUNC_FAILS(CKR_ARGUMENTS_BAD, "Invalid pointer argument");
+	}
+
+	if (getDigestSize(pMechanism->mechanism) < 0) {
+		FUNC_FAILS(CKR_MECHANISM_INVALID, "Mechanism not supported");
+	}
+
+	pSession->digest = secureAlloc(sizeof(struct digestContext));
+
+	if (pSession->digest == NULL) {
+		FUNC_FAILS(CKR_HOST_MEMORY, "Out of memory");
+	}
+
+	rv = digestInit(pSession->digest, pMechanism->mechanism);
+
 	FUNC_RETURNS(rv);
 }
 
 
 
+/**
+ * Copy the hash value to the caller's buffer and end the digest operation
+ *
+ * If pDigest is NULL or the buffer is too small, then the operation remains active.
+ */
+static CK_RV finishDigest(struct p11Session_t *pSession, CK_BYTE_PTR pDigest, CK_ULONG_PTR pulDigestLen)
+{
+	CK_ULONG size = pSession->digest->size;
+
+	if (pDigest == NULL) {
+		*pulDigestLen = size;
+		return CKR_OK;
+	}
+
+	if (*pulDigestLen < size) {
+		*pulDigestLen = size;
+		return CKR_BUFFER_TOO_SMALL;
+	}
+
+	*pulDigestLen = digestFinal(pSession->digest, pDigest);
+	endDigest(pSession);
+	return CKR_OK;
+}
+
+
+
 /*  C_Digest digests data in a single part. */
 CK_DECLARE_FUNCTION(CK_RV, C_Digest)(
 		CK_SESSION_HANDLE hSession,
@@ -602,7 +783,8 @@ CK_DECLARE_FUNCTION(CK_RV, C_Digest)(
 		CK_ULONG_PTR pulDigestLen
 )
 {
-	CK_RV rv = CKR_FUNCTION_NOT_SUPPORTED;
+	CK_RV rv;
+	struct p11Session_t *pSession;
 
 	FUNC_CALLED();
 
@@ -610,6 +792,28 @@ CK_DECLARE_FUNCTION(CK_RV, C_Digest)(
 		FUNC_FAILS(CKR_CRYPTOKI_NOT_INITIALIZED, "C_Initialize not called");
 	}
 
+	rv = findSessionByHandle(&context->sessionPool, hSession, &pSession);
+
+	if (rv != CKR_OK) {
+		FUNC_RETURNS(rv);
+	}
+
+	if (pSession->digest == NULL) {
+		FUNC_FAILS(CKR_OPERATION_NOT_INITIALIZED, "Operation not initialized");
+	}
+
+	if ((ulDataLen && !isValidPtr(pData)) || !isValidPtr(pulDigestLen)) {
+		endDigest(pSession);
+		FUNC_FAILS(CKR_ARGUMENTS_BAD, "Invalid pointer argument");
+	}
+
+	// The data is only processed once the caller provides a sufficient buffer
+	if ((pDigest != NULL) && (*pulDigestLen >= (CK_ULONG)pSession->digest->size)) {
+		digestUpdate(pSession->digest, pData, ulDataLen);
+	}
+
+	rv = finishDigest(pSession, pDigest, pulDigestLen);
+
 	FUNC_RETURNS(rv);
 }
 
@@ -623,7 +827,8 @@ CK_DECLARE_FUNCTION(CK_RV, C_DigestUpdate)(
 		CK_ULONG ulPartLen
 )
 {
-	CK_RV rv = CKR_FUNCTION_NOT_SUPPORTED;
+	CK_RV rv;
+	struct p11Session_t *pSession;
 
 	FUNC_CALLED();
 
@@ -631,7 +836,24 @@ CK_DECLARE_FUNCTION(CK_RV, C_DigestUpdate)(
 		FUNC_FAILS(CKR_CRYPTOKI_NOT_INITIALIZED, "C_Initialize not called");
 	}
 
-	FUNC_RETURNS(rv);
+	rv = findSessionByHandle(&context->sessionPool, hSession, &pSession);
+
+	if (rv != CKR_OK) {
+		FUNC_RETURNS(rv);
+	}
+
+	if (pSession->digest == NULL) {
+		FUNC_FAILS(CKR_OPERATION_NOT_INITIALIZED, "Operation not initialized");
+	}
+
+	if (ulPartLen && !isValidPtr(pPart)) {
+		endDigest(pSession);
+		FUNC_FAILS(CKR_ARGUMENTS_BAD, "Invalid pointer argument");
+	}
+
+	digestUpdate(pSession->digest, pPart, ulPartLen);
+
+	FUNC_RETURNS(CKR_OK);
 }
 
 
@@ -643,7 +865,13 @@ CK_DECLARE_FUNCTION(CK_RV, C_DigestKey)(
 		CK_OBJECT_HANDLE hKey
 )
 {
-	CK_RV rv = CKR_FUNCTION_NOT_SUPPORTED;
+	CK_RV rv;
+	CK_OBJECT_CLASS keyClass;
+	CK_ATTRIBUTE attr = { CKA_CLASS, NULL, 0 };
+	struct p11Attribute_t *pAttr;
+	struct p11Object_t *pObject;
+	struct p11Slot_t *pSlot;
+	struct p11Session_t *pSession;
 
 	FUNC_CALLED();
 
@@ -651,7 +879,43 @@ CK_DECLARE_FUNCTION(CK_RV, C_DigestKey)(
 		FUNC_FAILS(CKR_CRYPTOKI_NOT_INITIALIZED, "C_Initialize not called");
 	}
 
-	FUNC_RETURNS(rv);
+	rv = findSessionByHandle(&context->sessionPool, hSession, &pSession);
+
+	if (rv != CKR_OK) {
+		FUNC_RETURNS(rv);
+	}
+
+	if (pSession->digest == NULL) {
+		FUNC_FAILS(CKR_OPERATION_NOT_INITIALIZED, "Operation not initialized");
+	}
+
+	rv = findSlot(&context->slotPool, pSession->slotID, &pSlot);
+
+	if (rv != CKR_OK) {
+		FUNC_RETURNS(rv);
+	}
+
+	rv = findSlotKey(pSlot, hKey, &pObject);
+
+	if (rv != CKR_OK) {
+		FUNC_RETURNS(rv);
+	}
+
+	// Only secret keys with a value known to the host can be digested
+	if ((findAttribute(pObject, &attr, &pAttr) < 0) || (pAttr->attrData.ulValueLen != sizeof(keyClass))) {
+		FUNC_FAILS(CKR_KEY_INDIGESTIBLE, "Key has no class");
+	}
+
+	memcpy(&keyClass, pAttr->attrData.pValue, sizeof(keyClass));
+	attr.type = CKA_VALUE;
+
+	if ((keyClass != CKO_SECRET_KEY) || pObject->sensitiveObj || (findAttribute(pObject, &attr, &pAttr) < 0)) {
+		FUNC_FAILS(CKR_KEY_INDIGESTIBLE, "Key value not available");
+	}
+
+	digestUpdate(pSession->digest, pAttr->attrData.pValue, pAttr->attrData.ulValueLen);
+
+	FUNC_RETURNS(CKR_OK);
 }
 
 
@@ -663,7 +927,8 @@ CK_DECLARE_FUNCTION(CK_RV, C_DigestFinal)(
 		CK_ULONG_PTR pulDigestLen
 )
 {
-	CK_RV rv = CKR_FUNCTION_NOT_SUPPORTED;
+	CK_RV rv;
+	struct p11Session_t *pSession;
 
 	FUNC_CALLED();
 
@@ -671,11 +936,98 @@ CK_DECLARE_FUNCTION(CK_RV, C_DigestFinal)(
 		FUNC_FAILS(CKR_CRYPTOKI_NOT_INITIALIZED, "C_Initialize not called");
 	}
 
+	rv = findSessionByHandle(&context->sessionPool, hSession, &pSession);
+
+	if (rv != CKR_OK) {
+		FUNC_RETURNS(rv);
+	}
+
+	if (pSession->digest == NULL) {
+		FUNC_FAILS(CKR_OPERATION_NOT_INITIALIZED, "Operation not initialized");
+	}
+
+	if (!isValidPtr(pulDigestLen)) {
+		endDigest(pSession);
+		FUNC_FAILS(CKR_ARGUMENTS_BAD, "Invalid pointer argument");
+	}
+
+	rv = finishDigest(pSession, pDigest, pulDigestLen);
+
 	FUNC_RETURNS(rv);
 }
 
 
 
+/*
+ * Hash the next part of a signature that is hashed in the host
+ */
+static CK_RV updateHostHashSign(struct p11Session_t *pSession, CK_BYTE_PTR pPart, CK_ULONG ulPartLen)
+{
+	CK_RV rv;
+
+	if (!isValidPtr(pPart) && ulPartLen) {
+		return CKR_ARGUMENTS_BAD;
+	}
+
+	if (pSession->signHash == NULL) {
+		pSession->signHash = secureAlloc(sizeof(struct hashSignContext));
+
+		if (pSession->signHash == NULL) {
+			return CKR_HOST_MEMORY;
+		}
+
+		rv = hashSignInit(pSession->signHash, pSession->activeMechanism);
+
+		if (rv != CKR_OK) {
+			endSignHash(pSession);
+			return rv;
+		}
+	}
+
+	hashSignUpdate(pSession->signHash, pPart, ulPartLen);
+	return CKR_OK;
+}
+
+
+
+/*
+ * Sign the hash computed in the host with the raw mechanism of the token
+ *
+ * The operation remains active for a length query or if the buffer is too small.
+ */
+static CK_RV finishHostHashSign(struct p11Session_t *pSession, struct p11Object_t *pObject, CK_BYTE_PTR pSignature, CK_ULONG_PTR pulSignatureLen)
+{
+	CK_RV rv;
+	unsigned char tbs[RSA_MAX_BYTES];
+	size_t tbsLen;
+
+	if ((pObject->ops == NULL) || (pObject->ops->C_Sign == NULL)) {
+		return CKR_FUNCTION_NOT_SUPPORTED;
+	}
+
+	if (pSignature == NULL) {
+		return pObject->ops->C_Sign(pObject, pSession->signHash->rawMech, NULL, 0, NULL, pulSignatureLen);
+	}
+
+	rv = hashSignFinal(pSession->signHash, pObject->keysize, tbs, &tbsLen);
+
+	if (rv == CKR_OK) {
+		rv = pObject->ops->C_Sign(pObject, pSession->signHash->rawMech, tbs, tbsLen, pSignature, pulSignatureLen);
+	}
+
+	memset_s(tbs, sizeof(tbs), 0, sizeof(tbs));
+
+	if (rv != CKR_BUFFER_TOO_SMALL) {
+		pSession->activeObjectHandle = CK_INVALID_HANDLE;
+		endSignHash(pSession);
+		clearCryptoBuffer(pSession);
+	}
+
+	return rv;
+}
+
+
+
 /*  C_SignInit initializes a signature operation,
     here the signature is an appendix to the data. */
 CK_DECLARE_FUNCTION(CK_RV, C_SignInit)(
@@ -717,8 +1069,8 @@ CK_DECLARE_FUNCTION(CK_RV, C_SignInit)(
 		FUNC_RETURNS(rv);
 	}
 
-	if (pObject->C_SignInit != NULL) {
-		rv = pObject->C_SignInit(pObject, pMechanism);
+	if ((pObject->ops != NULL) && (pObject->ops->C_SignInit != NULL)) {
+		rv = pObject->ops->C_SignInit(pObject, pMechanism);
 		if (rv == CKR_DEVICE_ERROR) {
 			rv = handleDeviceError(hSession);
 			FUNC_FAILS(rv, "Device error reported");
@@ -728,6 +1080,7 @@ CK_DECLARE_FUNCTION(CK_RV, C_SignInit)(
 	}
 
 	if (!rv) {
+		endSignHash(pSession);
 		pSession->activeObjectHandle = pObject->handle;
 		pSession->activeMechanism = pMechanism->mechanism;
 		rv = CKR_OK;
@@ -780,8 +1133,8 @@ CK_DECLARE_FUNCTION(CK_RV, C_Sign)(
 		FUNC_RETURNS(rv);
 	}
 
-	if (pObject->C_Sign != NULL) {
-		rv = pObject->C_Sign(pObject, pSession->activeMechanism, pData, ulDataLen, pSignature, pulSignatureLen);
+	if ((pObject->ops != NULL) && (pObject->ops->C_Sign != NULL)) {
+		rv = pObject->ops->C_Sign(pObject, pSession->activeMechanism, pData, ulDataLen, pSignature, pulSignatureLen);
 
 		if ((pSignature != NULL) && (rv != CKR_BUFFER_TOO_SMALL)) {
 			pSession->activeObjectHandle = CK_INVALID_HANDLE;
@@ -841,12 +1194,15 @@ CK_DECLARE_FUNCTION(CK_RV, C_SignUpdate)(
 		FUNC_RETURNS(rv);
 	}
 
-	if (pObject->C_SignUpdate != NULL) {
-		rv = pObject->C_SignUpdate(pObject, pSession->activeMechanism, pPart, ulPartLen);
+	if ((pObject->ops != NULL) && (pObject->ops->C_SignUpdate != NULL)) {
+		rv = pObject->ops->C_SignUpdate(pObject, pSession->activeMechanism, pPart, ulPartLen);
 		if (rv == CKR_DEVICE_ERROR) {
 			rv = handleDeviceError(hSession);
 			FUNC_FAILS(rv, "Device error reported");
 		}
+	} else if ((pObject->ops != NULL) && (pObject->ops->isHashedInHost != NULL) &&
+			pObject->ops->isHashedInHost(pObject, pSession->activeMechanism)) {
+		rv = updateHostHashSign(pSession, pPart, ulPartLen);
 	} else {
 		rv = appendToCryptoBuffer(pSession, pPart, ulPartLen);
 	}
@@ -896,8 +1252,15 @@ CK_DECLARE_FUNCTION(CK_RV, C_SignFinal)(
 		FUNC_RETURNS(rv);
 	}
 
-	if (pObject->C_SignFinal != NULL) {
-		rv = pObject->C_SignFinal(pObject, pSession->activeMechanism, pSignature, pulSignatureLen);
+	if (pSession->signHash != NULL) {
+		rv = finishHostHashSign(pSession, pObject, pSignature, pulSignatureLen);
+
+		if (rv == CKR_DEVICE_ERROR) {
+			rv = handleDeviceError(hSession);
+			FUNC_FAILS(rv, "Device error reported");
+		}
+	} else if ((pObject->ops != NULL) && (pObject->ops->C_SignFinal != NULL)) {
+		rv = pObject->ops->C_SignFinal(pObject, pSession->activeMechanism, pSignature, pulSignatureLen);
 
 		if ((pSignature != NULL) && (rv != CKR_BUFFER_TOO_SMALL)) {
 			pSession->activeObjectHandle = CK_INVALID_HANDLE;
@@ -909,8 +1272,8 @@ CK_DECLARE_FUNCTION(CK_RV, C_SignFinal)(
 			FUNC_FAILS(rv, "Device error reported");
 		}
 	} else {
-		if (pObject->C_Sign != NULL) {
-			rv = pObject->C_Sign(pObject, pSession->activeMechanism, pSession->cryptoBuffer, pSession->cryptoBufferSize, pSignature, pulSignatureLen);
+		if ((pObject->ops != NULL) && (pObject->ops->C_Sign != NULL)) {
+			rv = pObject->ops->C_Sign(pObject, pSession->activeMechanism, pSession->cryptoBuffer, pSession->cryptoBufferSize, pSignature, pulSignatureLen);
 
 			if ((pSignature != NULL) && (rv != CKR_BUFFER_TOO_SMALL)) {
 				pSession->activeObjectHandle = CK_INVALID_HANDLE;
@@ -975,6 +1338,75 @@ CK_DECLARE_FUNCTION(CK_RV, C_SignRecover)(
 
 
 
+/**
+ * Start a verify or verify recover operation in the host
+ */
+static CK_RV startVerify(CK_SESSION_HANDLE hSession, CK_MECHANISM_PTR pMechanism, CK_OBJECT_HANDLE hKey, int recover)
+{
+	CK_RV rv;
+	struct p11Object_t *pObject;
+	struct p11Session_t *pSession;
+
+	rv = findSessionByHandle(&context->sessionPool, hSession, &pSession);
+
+	if (rv != CKR_OK) {
+		return rv;
+	}
+
+	if (pSession->verify != NULL) {
+		return CKR_OPERATION_ACTIVE;
+	}
+
+	if (!isValidPtr(pMechanism)) {
+		return CKR_ARGUMENTS_BAD;
+	}
+
+	rv = findKey(pSession, hKey, &pObject);
+
+	if (rv != CKR_OK) {
+		return rv;
+	}
+
+	// The context only holds public data, so it does not need to be in secure memory
+	pSession->verify = calloc(1, sizeof(struct verifyContext));
+
+	if (pSession->verify == NULL) {
+		return CKR_HOST_MEMORY;
+	}
+
+	rv = verifyInit(pSession->verify, pObject, pMechanism, recover);
+
+	if (rv != CKR_OK) {
+		endVerify(pSession);
+	}
+
+	return rv;
+}
+
+
+
+/**
+ * Return the session with an active verify operation
+ */
+static CK_RV getVerifySession(CK_SESSION_HANDLE hSession, int recover, struct p11Session_t **pSession)
+{
+	CK_RV rv;
+
+	rv = findSessionByHandle(&context->sessionPool, hSession, pSession);
+
+	if (rv != CKR_OK) {
+		return rv;
+	}
+
+	if (((*pSession)->verify == NULL) || ((*pSession)->verify->recover != recover)) {
+		return CKR_OPERATION_NOT_INITIALIZED;
+	}
+
+	return CKR_OK;
+}
+
+
+
 /*  C_VerifyInit initializes a verification operation, where the signature is
     an appendix to the data. */
 CK_DECLARE_FUNCTION(CK_RV, C_VerifyInit)(
@@ -983,7 +1415,7 @@ CK_DECLARE_FUNCTION(CK_RV, C_VerifyInit)(
 		CK_OBJECT_HANDLE hKey
 )
 {
-	CK_RV rv = CKR_FUNCTION_NOT_SUPPORTED;
+	CK_RV rv;
 
 	FUNC_CALLED();
 
@@ -991,6 +1423,8 @@ CK_DECLARE_FUNCTION(CK_RV, C_VerifyInit)(
 		FUNC_FAILS(CKR_CRYPTOKI_NOT_INITIALIZED, "C_Initialize not called");
 	}
 
+	rv = startVerify(hSession, pMechanism, hKey, 0);
+
 	FUNC_RETURNS(rv);
 }
 
@@ -1006,7 +1440,8 @@ CK_DECLARE_FUNCTION(CK_RV, C_Verify)(
 		CK_ULONG ulSignatureLen
 )
 {
-	CK_RV rv = CKR_FUNCTION_NOT_SUPPORTED;
+	CK_RV rv;
+	struct p11Session_t *pSession;
 
 	FUNC_CALLED();
 
@@ -1014,6 +1449,21 @@ CK_DECLARE_FUNCTION(CK_RV, C_Verify)(
 		FUNC_FAILS(CKR_CRYPTOKI_NOT_INITIALIZED, "C_Initialize not called");
 	}
 
+	rv = getVerifySession(hSession, 0, &pSession);
+
+	if (rv != CKR_OK) {
+		FUNC_RETURNS(rv);
+	}
+
+	if ((ulDataLen && !isValidPtr(pData)) || !isValidPtr(pSignature)) {
+		endVerify(pSession);
+		FUNC_FAILS(CKR_ARGUMENTS_BAD, "Invalid pointer argument");
+	}
+
+	verifyUpdate(pSession->verify, pData, ulDataLen);
+	rv = verifyFinal(pSession->verify, pSignature, ulSignatureLen);
+	endVerify(pSession);
+
 	FUNC_RETURNS(rv);
 }
 
@@ -1027,7 +1477,8 @@ CK_DECLARE_FUNCTION(CK_RV, C_VerifyUpdate)(
 		CK_ULONG ulPartLen
 )
 {
-	CK_RV rv = CKR_FUNCTION_NOT_SUPPORTED;
+	CK_RV rv;
+	struct p11Session_t *pSession;
 
 	FUNC_CALLED();
 
@@ -1035,7 +1486,20 @@ CK_DECLARE_FUNCTION(CK_RV, C_VerifyUpdate)(
 		FUNC_FAILS(CKR_CRYPTOKI_NOT_INITIALIZED, "C_Initialize not called");
 	}
 
-	FUNC_RETURNS(rv);
+	rv = getVerifySession(hSession, 0, &pSession);
+
+	if (rv != CKR_OK) {
+		FUNC_RETURNS(rv);
+	}
+
+	if (ulPartLen && !isValidPtr(pPart)) {
+		endVerify(pSession);
+		FUNC_FAILS(CKR_ARGUMENTS_BAD, "Invalid pointer argument");
+	}
+
+	verifyUpdate(pSession->verify, pPart, ulPartLen);
+
+	FUNC_RETURNS(CKR_OK);
 }
 
 
@@ -1048,7 +1512,8 @@ CK_DECLARE_FUNCTION(CK_RV, C_VerifyFinal)(
 		CK_ULONG ulSignatureLen
 )
 {
-	CK_RV rv = CKR_FUNCTION_NOT_SUPPORTED;
+	CK_RV rv;
+	struct p11Session_t *pSession;
 
 	FUNC_CALLED();
 
@@ -1056,6 +1521,20 @@ CK_DECLARE_FUNCTION(CK_RV, C_VerifyFinal)(
 		FUNC_FAILS(CKR_CRYPTOKI_NOT_INITIALIZED, "C_Initialize not called");
 	}
 
+	rv = getVerifySession(hSession, 0, &pSession);
+
+	if (rv != CKR_OK) {
+		FUNC_RETURNS(rv);
+	}
+
+	if (!isValidPtr(pSignature)) {
+		endVerify(pSession);
+		FUNC_FAILS(CKR_ARGUMENTS_BAD, "Invalid pointer argument");
+	}
+
+	rv = verifyFinal(pSession->verify, pSignature, ulSignatureLen);
+	endVerify(pSession);
+
 	FUNC_RETURNS(rv);
 }
 
@@ -1069,7 +1548,7 @@ CK_DECLARE_FUNCTION(CK_RV, C_VerifyRecoverInit)(
 		CK_OBJECT_HANDLE hKey
 )
 {
-	CK_RV rv = CKR_FUNCTION_NOT_SUPPORTED;
+	CK_RV rv;
 
 	FUNC_CALLED();
 
@@ -1077,6 +1556,8 @@ CK_DECLARE_FUNCTION(CK_RV, C_VerifyRecoverInit)(
 		FUNC_FAILS(CKR_CRYPTOKI_NOT_INITIALIZED, "C_Initialize not called");
 	}
 
+	rv = startVerify(hSession, pMechanism, hKey, 1);
+
 	FUNC_RETURNS(rv);
 }
 
@@ -1092,7 +1573,8 @@ CK_DECLARE_FUNCTION(CK_RV, C_VerifyRecover)(
 		CK_ULONG_PTR pulDataLen
 )
 {
-	CK_RV rv = CKR_FUNCTION_NOT_SUPPORTED;
+	CK_RV rv;
+	struct p11Session_t *pSession;
 
 	FUNC_CALLED();
 
@@ -1100,6 +1582,24 @@ CK_DECLARE_FUNCTION(CK_RV, C_VerifyRecover)(
 		FUNC_FAILS(CKR_CRYPTOKI_NOT_INITIALIZED, "C_Initialize not called");
 	}
 
+	rv = getVerifySession(hSession, 1, &pSession);
+
+	if (rv != CKR_OK) {
+		FUNC_RETURNS(rv);
+	}
+
+	if (!isValidPtr(pSignature) || !isValidPtr(pulDataLen)) {
+		endVerify(pSession);
+		FUNC_FAILS(CKR_ARGUMENTS_BAD, "Invalid pointer argument");
+	}
+
+	rv = verifyRecover(pSession->verify, pSignature, ulSignatureLen, pData, pulDataLen);
+
+	// Querying the length or passing a short buffer keeps the operation active
+	if ((rv != CKR_BUFFER_TOO_SMALL) && ((rv != CKR_OK) || (pData != NULL))) {
+		endVerify(pSession);
+	}
+
 	FUNC_RETURNS(rv);
 }
 
@@ -1324,7 +1824,10 @@ CK_DECLARE_FUNCTION(CK_RV, C_SeedRandom)(
 		CK_ULONG ulSeedLen
 )
 {
-	CK_RV rv = CKR_FUNCTION_NOT_SUPPORTED;
+	CK_RV rv;
+	struct p11Session_t *pSession;
+	struct p11Slot_t *pSlot;
+	struct p11Token_t *pToken;
 
 	FUNC_CALLED();
 
@@ -1332,6 +1835,35 @@ CK_DECLARE_FUNCTION(CK_RV, C_SeedRandom)(
 		FUNC_FAILS(CKR_CRYPTOKI_NOT_INITIALIZED, "C_Initialize not called");
 	}
 
+	rv = findSessionByHandle(&context->sessionPool, hSession, &pSession);
+
+	if (rv != CKR_OK) {
+		FUNC_RETURNS(rv);
+	}
+
+	if (!isValidPtr(pSeed) && ulSeedLen) {
+		FUNC_FAILS(CKR_ARGUMENTS_BAD, "Invalid pointer argument");
+	}
+
+	rv = findSlot(&context->slotPool, pSession->slotID, &pSlot);
+
+	if (rv != CKR_OK) {
+		FUNC_RETURNS(rv);
+	}
+
+	rv = getValidatedToken(pSlot, &pToken);
+
+	if (rv != CKR_OK) {
+		FUNC_RETURNS(rv);
+	}
+
+	rv = seedSlotRandom(pSlot, pSeed, ulSeedLen);
+
+	if (rv == CKR_DEVICE_ERROR) {
+		rv = handleDeviceError(hSession);
+		FUNC_FAILS(rv, "Device error reported");
+	}
+
 	FUNC_RETURNS(rv);
 }
 
@@ -1344,7 +1876,10 @@ CK_DECLARE_FUNCTION(CK_RV, C_GenerateRandom)(
 		CK_ULONG ulRandomLen
 )
 {
-	CK_RV rv = CKR_FUNCTION_NOT_SUPPORTED;
+	CK_RV rv;
+	struct p11Session_t *pSession;
+	struct p11Slot_t *pSlot;
+	struct p11Token_t *pToken;
 
 	FUNC_CALLED();
 
@@ -1352,6 +1887,35 @@ CK_DECLARE_FUNCTION(CK_RV, C_GenerateRandom)(
 		FUNC_FAILS(CKR_CRYPTOKI_NOT_INITIALIZED, "C_Initialize not called");
 	}
 
+	rv = findSessionByHandle(&context->sessionPool, hSession, &pSession);
+
+	if (rv != CKR_OK) {
+		FUNC_RETURNS(rv);
+	}
+
+	if (!isValidPtr(pRandomData) && ulRandomLen) {
+		FUNC_FAILS(CKR_ARGUMENTS_BAD, "Invalid pointer argument");
+	}
+
+	rv = findSlot(&context->slotPool, pSession->slotID, &pSlot);
+
+	if (rv != CKR_OK) {
+		FUNC_RETURNS(rv);
+	}
+
+	rv = getValidatedToken(pSlot, &pToken);
+
+	if (rv != CKR_OK) {
+		FUNC_RETURNS(rv);
+	}
+
+	rv = generateSlotRandom(pSlot, pRandomData, ulRandomLen);
+
+	if (rv == CKR_DEVICE_ERROR) {
+		rv = handleDeviceError(hSession);
+		FUNC_FAILS(rv, "Device error reported");
+	}
+
 	FUNC_RETURNS(rv);
 }
 
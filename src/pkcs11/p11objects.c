@@ -507,14 +507,10 @@ CK_DECLARE_FUNCTION(CK_RV, C_SetAttributeValue)(
 				}
 			}
 		} else {
-			if (pTemplate[i].ulValueLen > attribute->attrData.ulValueLen) {
-				free(attribute->attrData.pValue);
-				attribute->attrData.pValue = malloc(pTemplate[i].ulValueLen);
+			if (updateAttribute(pObject, attribute, &pTemplate[i]) < 0) {
+				FUNC_FAILS(CKR_HOST_MEMORY, "Out of memory");
 			}
 
-			attribute->attrData.ulValueLen = pTemplate[i].ulValueLen;
-			memcpy(attribute->attrData.pValue, pTemplate[i].pValue, pTemplate[i].ulValueLen);
-
 			pObject->dirtyFlag = 1;
 
 			rv = synchronizeToken(slot, slot->token);
@@ -580,6 +576,14 @@ CK_DECLARE_FUNCTION(CK_RV, C_FindObjectsInit)(
 		C_FindObjectsFinal(hSession);
 	}
 
+	if (slot->token) {
+		rv = loadTokenObjects(slot->token);
+
+		if (rv != CKR_OK) {
+			FUNC_RETURNS(rv);
+		}
+	}
+
 	/* session objects */
 	pObject = session->sessionObjList;
 
@@ -89,6 +89,12 @@ CK_DECLARE_FUNCTION(CK_RV, C_OpenSession)(
 		FUNC_RETURNS(rv);
 	}
 
+	rv = loadTokenObjects(token);
+
+	if (rv != CKR_OK) {
+		FUNC_RETURNS(rv);
+	}
+
 	if (!(flags & CKF_RW_SESSION) && (token->user == CKU_SO)) { /* there is already an active r/w session for SO */
 		FUNC_FAILS(CKR_SESSION_READ_WRITE_SO_EXISTS, "Can not open an R/O session if SO is logged in");
 	}
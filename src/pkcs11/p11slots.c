@@ -31,6 +31,7 @@
  * @brief   Slots management functions at the PKCS#11 interface
  */
 
+#include <stdlib.h>
 #include <string.h>
 
 #include <pkcs11/p11generic.h>
@@ -38,6 +39,9 @@
 #include <pkcs11/slotpool.h>
 #include <pkcs11/slot.h>
 #include <pkcs11/token.h>
+#include <pkcs11/digest.h>
+#include <pkcs11/verify.h>
+#include <pkcs11/encrypt.h>
 #include <pkcs11/debug.h>
 
 extern struct p11Context_t *context;
@@ -52,7 +56,7 @@ CK_DECLARE_FUNCTION(CK_RV, C_GetSlotList)(
 )
 {
 	CK_RV rv = CKR_OK;
-	struct p11Slot_t *slot;
+	struct p11Slot_t *slot, *pslot;
 	struct p11Token_t *token;
 	CK_ULONG i;
 
@@ -76,6 +80,13 @@ CK_DECLARE_FUNCTION(CK_RV, C_GetSlotList)(
 
 	rv = updateSlots(&context->slotPool);
 
+	// Query all slots concurrently rather than one by one in the loop below. Without
+	// tokenPresent cards are not connected, so virtual slots of a token are listed once
+	// the token was queried or if they were preallocated with PKCS11_PREALLOCATE_VIRTUAL_SLOTS
+	if ((rv == CKR_OK) && tokenPresent) {
+		rv = probeSlots(&context->slotPool);
+	}
+
 	if (rv != CKR_OK) {
 		p11UnlockMutex(context->mutex);
 		FUNC_RETURNS(rv);
@@ -85,7 +96,10 @@ CK_DECLARE_FUNCTION(CK_RV, C_GetSlotList)(
 	i = 0;
 
 	while (slot != NULL) {
-		if (!tokenPresent || (getValidatedToken(slot, &token) == CKR_OK)) {
+		pslot = slot->primarySlot ? slot->primarySlot : slot;
+
+		// Slots without a token have just been probed, so only check present tokens for removal
+		if (!tokenPresent || (pslot->token && (getValidatedToken(slot, &token) == CKR_OK))) {
 			if (pSlotList && (i < *pulCount)) {
 				pSlotList[i] = slot->id;
 			}
@@ -219,6 +233,69 @@ CK_DECLARE_FUNCTION(CK_RV, C_WaitForSlotEvent)(
 
 
 
+/**
+ * Build the list of mechanisms from the token driver and the mechanisms implemented in the host
+ *
+ * Hash mechanisms are appended to the token's list, verification and encryption
+ * mechanisms only if not already listed.
+ *
+ * @param token      The token
+ * @param list       Set to the list allocated with malloc()
+ * @param count      Set to the number of mechanisms in the list
+ * @return           CKR_OK or any other Cryptoki error code
+ */
+static CK_RV buildMechanismList(struct p11Token_t *token, CK_MECHANISM_TYPE_PTR *list, CK_ULONG *count)
+{
+	CK_RV rv;
+	CK_MECHANISM_TYPE_PTR mechs;
+	CK_ULONG tokenCount, total, hostCount, i, j;
+	int digests, verifies, encrypts;
+
+	rv = token->drv->getMechanismList(NULL, &tokenCount);
+
+	if (rv != CKR_OK) {
+		return rv;
+	}
+
+	digests = getDigestMechanisms(NULL, 0);
+	verifies = getVerifyMechanisms(NULL, 0);
+	encrypts = getEncryptMechanisms(NULL, 0);
+
+	mechs = malloc((tokenCount + digests + verifies + encrypts) * sizeof(CK_MECHANISM_TYPE));
+
+	if (mechs == NULL) {
+		return CKR_HOST_MEMORY;
+	}
+
+	rv = token->drv->getMechanismList(mechs, &tokenCount);
+
+	if (rv != CKR_OK) {
+		free(mechs);
+		return rv;
+	}
+
+	getDigestMechanisms(mechs + tokenCount, digests);
+	total = tokenCount + digests;
+
+	getVerifyMechanisms(mechs + total, verifies);
+	getEncryptMechanisms(mechs + total + verifies, encrypts);
+	hostCount = total + verifies + encrypts;
+
+	for (i = total; i < hostCount; i++) {
+		for (j = 0; (j < total) && (mechs[j] != mechs[i]); j++);
+
+		if (j == total) {
+			mechs[total++] = mechs[i];
+		}
+	}
+
+	*list = mechs;
+	*count = total;
+	return CKR_OK;
+}
+
+
+
 /*  C_GetMechanismList obtains a list of mechanisms supported by a token. */
 CK_DECLARE_FUNCTION(CK_RV, C_GetMechanismList)(
 		CK_SLOT_ID slotID,
@@ -227,6 +304,8 @@ CK_DECLARE_FUNCTION(CK_RV, C_GetMechanismList)(
 )
 {
 	int rv;
+	CK_ULONG count;
+	CK_MECHANISM_TYPE_PTR mechs;
 	struct p11Slot_t *slot;
 	struct p11Token_t *token;
 
@@ -256,7 +335,44 @@ CK_DECLARE_FUNCTION(CK_RV, C_GetMechanismList)(
 		FUNC_RETURNS(rv);
 	}
 
-	FUNC_RETURNS(token->drv->getMechanismList(pMechanismList, pulCount));
+	rv = buildMechanismList(token, &mechs, &count);
+
+	if (rv != CKR_OK) {
+		FUNC_RETURNS(rv);
+	}
+
+	if (pMechanismList == NULL) {
+		*pulCount = count;
+		free(mechs);
+		FUNC_RETURNS(CKR_OK);
+	}
+
+	if (*pulCount < count) {
+		*pulCount = count;
+		free(mechs);
+		FUNC_FAILS(CKR_BUFFER_TOO_SMALL, "Buffer provided by caller too small");
+	}
+
+	memcpy(pMechanismList, mechs, count * sizeof(CK_MECHANISM_TYPE));
+	*pulCount = count;
+	free(mechs);
+
+	FUNC_RETURNS(CKR_OK);
+}
+
+
+
+/*
+ * Merge the capabilities of a mechanism implemented in the host into the token's mechanism info
+ */
+static void addHostMechanismInfo(CK_MECHANISM_INFO_PTR pInfo, CK_MECHANISM_INFO_PTR pHostInfo)
+{
+	if (pInfo->flags == 0) {
+		*pInfo = *pHostInfo;
+		return;
+	}
+
+	pInfo->flags |= pHostInfo->flags;
 }
 
 
@@ -270,6 +386,7 @@ CK_DECLARE_FUNCTION(CK_RV, C_GetMechanismInfo)(
 )
 {
 	CK_RV rv = CKR_OK;
+	CK_MECHANISM_INFO info;
 	struct p11Slot_t *slot;
 	struct p11Token_t *token;
 
@@ -295,7 +412,35 @@ CK_DECLARE_FUNCTION(CK_RV, C_GetMechanismInfo)(
 		FUNC_RETURNS(rv);
 	}
 
-	FUNC_RETURNS(token->drv->getMechanismInfo(type, pInfo));
+	if (getDigestSize(type) >= 0) {
+		pInfo->ulMinKeySize = 0;
+		pInfo->ulMaxKeySize = 0;
+		pInfo->flags = CKF_DIGEST;
+		FUNC_RETURNS(CKR_OK);
+	}
+
+	// Verification and encryption are performed in the host, also for mechanisms the token does not support
+	rv = token->drv->getMechanismInfo(type, pInfo);
+
+	if (rv == CKR_MECHANISM_INVALID) {
+		pInfo->flags = 0;
+		pInfo->ulMinKeySize = 0;
+		pInfo->ulMaxKeySize = 0;
+	}
+
+	if ((rv == CKR_OK) || (rv == CKR_MECHANISM_INVALID)) {
+		if (getVerifyMechanismInfo(type, &info) == 0) {
+			addHostMechanismInfo(pInfo, &info);
+			rv = CKR_OK;
+		}
+
+		if (getEncryptMechanismInfo(type, &info) == 0) {
+			addHostMechanismInfo(pInfo, &info);
+			rv = CKR_OK;
+		}
+	}
+
+	FUNC_RETURNS(rv);
 }
 
 
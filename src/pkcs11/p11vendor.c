@@ -0,0 +1,413 @@
+/**
+ * SmartCard-HSM PKCS#11 Module
+ *
+ * Copyright (c) 2013, CardContact Systems GmbH, Minden, Germany
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of CardContact Systems GmbH nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CardContact Systems GmbH BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file    p11vendor.c
+ * @brief   Vendor extensions at the PKCS#11 interface
+ */
+
+#include <pkcs11/p11generic.h>
+#include <pkcs11/p11vendor.h>
+#include <pkcs11/session.h>
+#include <pkcs11/slot.h>
+#include <pkcs11/slotpool.h>
+#include <pkcs11/slotqueue.h>
+#include <pkcs11/asyncop.h>
+#include <pkcs11/debug.h>
+
+
+extern struct p11Context_t *context;
+extern int handleDeviceError(CK_SESSION_HANDLE hSession);
+
+
+
+/*
+ * Initialize the vendor function list.
+ */
+static SC_VENDOR_FUNCTION_LIST vendor_function_list = {
+		{ SC_VENDOR_VERSION_MAJOR, SC_VENDOR_VERSION_MINOR },
+		SC_SignBatch,
+		SC_GetSlotStatistics,
+		SC_SignAsync,
+		SC_DecryptAsync,
+		SC_GetAsyncEventDescriptor,
+		SC_GetAsyncCompletions
+};
+
+
+
+/**
+ * SC_GetVendorFunctionList returns the list of vendor extensions.
+ *
+ */
+CK_DECLARE_FUNCTION(CK_RV, SC_GetVendorFunctionList)
+(
+		SC_VENDOR_FUNCTION_LIST_PTR_PTR ppFunctionList
+)
+{
+	if (!isValidPtr(ppFunctionList)) {
+		return CKR_ARGUMENTS_BAD;
+	}
+
+	*ppFunctionList = &vendor_function_list;
+
+	return CKR_OK;
+}
+
+
+
+/*
+ * Sign each item using the C_Sign() function of the key
+ */
+static int signEach(struct p11Object_t *pObject, CK_MECHANISM_TYPE mech, SC_SIGN_BATCH_ITEM_PTR pItems, CK_ULONG ulCount)
+{
+	CK_ULONG i;
+
+	for (i = 0; i < ulCount; i++) {
+		pItems[i].rv = pObject->ops->C_Sign(pObject, mech, pItems[i].pData, pItems[i].ulDataLen, pItems[i].pSignature, &pItems[i].ulSignatureLen);
+
+		if (pItems[i].rv == CKR_DEVICE_ERROR) {
+			for (i++; i < ulCount; i++) {
+				pItems[i].rv = CKR_DEVICE_ERROR;
+			}
+			return CKR_DEVICE_ERROR;
+		}
+	}
+
+	return CKR_OK;
+}
+
+
+
+/**
+ * SC_SignBatch creates a signature for each item with the same key and mechanism.
+ *
+ * The call replaces a sequence of C_SignInit() and C_Sign() for each item. The token
+ * performs the signatures back-to-back, without interleaving operations from other
+ * sessions where the token driver supports this.
+ *
+ * The result of each signature is returned in the rv field of the item. An item with
+ * pSignature set to NULL receives the signature length, an item with a buffer that is
+ * too small fails with CKR_BUFFER_TOO_SMALL. Both do not affect other items.
+ *
+ * The session must not have an active signature operation.
+ *
+ * @param hSession      The session handle
+ * @param pMechanism    The signature mechanism
+ * @param hKey          The handle of the signing key
+ * @param pItems        The list of data to sign and the buffers for the signatures
+ * @param ulCount       The number of items
+ * @return              CKR_OK if all items have been processed or CKR_DEVICE_ERROR if processing
+ *                      was aborted due to a communication error. Otherwise the error as returned
+ *                      by C_SignInit() and no item has been processed.
+ */
+CK_DECLARE_FUNCTION(CK_RV, SC_SignBatch)
+(
+		CK_SESSION_HANDLE hSession,
+		CK_MECHANISM_PTR pMechanism,
+		CK_OBJECT_HANDLE hKey,
+		SC_SIGN_BATCH_ITEM_PTR pItems,
+		CK_ULONG ulCount
+)
+{
+	int rv;
+	struct p11Object_t *pObject;
+	struct p11Slot_t *pSlot;
+	struct p11Session_t *pSession;
+
+	FUNC_CALLED();
+
+	if (context == NULL) {
+		FUNC_FAILS(CKR_CRYPTOKI_NOT_INITIALIZED, "C_Initialize not called");
+	}
+
+	if (!isValidPtr(pMechanism) || ((ulCount > 0) && !isValidPtr(pItems))) {
+		FUNC_FAILS(CKR_ARGUMENTS_BAD, "Invalid pointer argument");
+	}
+
+	rv = findSessionByHandle(&context->sessionPool, hSession, &pSession);
+
+	if (rv != CKR_OK) {
+		FUNC_RETURNS(rv);
+	}
+
+	if (pSession->activeObjectHandle != CK_INVALID_HANDLE) {
+		FUNC_FAILS(CKR_OPERATION_ACTIVE, "Operation is already active");
+	}
+
+	rv = findSlot(&context->slotPool, pSession->slotID, &pSlot);
+
+	if (rv != CKR_OK) {
+		FUNC_RETURNS(rv);
+	}
+
+	rv = findSlotKey(pSlot, hKey, &pObject);
+
+	if (rv != CKR_OK) {
+		FUNC_RETURNS(rv);
+	}
+
+	if ((pObject->ops == NULL) || (pObject->ops->C_SignInit == NULL) || (pObject->ops->C_Sign == NULL)) {
+		FUNC_FAILS(CKR_FUNCTION_NOT_SUPPORTED, "Operation not supported by token");
+	}
+
+	// Validates key and mechanism once for all items
+	rv = pObject->ops->C_SignInit(pObject, pMechanism);
+
+	if (rv != CKR_OK) {
+		if (rv == CKR_DEVICE_ERROR) {
+			rv = handleDeviceError(hSession);
+		}
+		FUNC_FAILS(rv, "Signature initialization failed");
+	}
+
+	if (pObject->ops->C_SignBatch != NULL) {
+		rv = pObject->ops->C_SignBatch(pObject, pMechanism->mechanism, pItems, ulCount);
+	} else {
+		rv = signEach(pObject, pMechanism->mechanism, pItems, ulCount);
+	}
+
+	if (rv == CKR_DEVICE_ERROR) {
+		rv = handleDeviceError(hSession);
+		FUNC_FAILS(rv, "Device error reported");
+	}
+
+	FUNC_RETURNS(rv);
+}
+
+
+
+/**
+ * SC_GetSlotStatistics returns the utilisation of the card in a slot.
+ *
+ * Busy and idle time are counted from the time the reader was detected. The idle time
+ * is the time no command was processed by the card. Applications determine the
+ * utilisation for an interval from the difference of two calls.
+ *
+ * Virtual slots report the statistics of the reader they are based on.
+ *
+ * @param slotID        The slot
+ * @param pStatistics   The structure receiving the statistics
+ * @return              CKR_OK, CKR_SLOT_ID_INVALID or CKR_ARGUMENTS_BAD
+ */
+CK_DECLARE_FUNCTION(CK_RV, SC_GetSlotStatistics)
+(
+		CK_SLOT_ID slotID,
+		SC_SLOT_STATISTICS_PTR pStatistics
+)
+{
+	int rv;
+	struct p11Slot_t *slot;
+
+	FUNC_CALLED();
+
+	if (context == NULL) {
+		FUNC_FAILS(CKR_CRYPTOKI_NOT_INITIALIZED, "C_Initialize not called");
+	}
+
+	if (!isValidPtr(pStatistics)) {
+		FUNC_FAILS(CKR_ARGUMENTS_BAD, "Invalid pointer argument");
+	}
+
+	p11LockMutex(context->mutex);
+
+	rv = findSlot(&context->slotPool, slotID, &slot);
+
+	if (rv == CKR_OK) {
+		rv = getSlotQueueStatistics(slot, pStatistics);
+	}
+
+	p11UnlockMutex(context->mutex);
+
+	FUNC_RETURNS(rv);
+}
+
+
+
+/**
+ * SC_SignAsync submits a signature operation and returns without waiting for the token.
+ *
+ * The key and mechanism are validated before the function returns. The data is copied,
+ * the signature buffer must remain valid until the completion with the returned ticket
+ * has been collected with SC_GetAsyncCompletions(). The operation does not use the
+ * signature state of the session, so several operations can be pending for a session.
+ *
+ * @param hSession      The session handle
+ * @param pMechanism    The signature mechanism
+ * @param hKey          The handle of the signing key
+ * @param pData         The data or digest to sign
+ * @param ulDataLen     The length of the data
+ * @param pSignature    The buffer for the signature or NULL to determine the length
+ * @param ulSignatureLen The size of the buffer
+ * @param pulTicket     The ticket identifying the completion
+ * @return              CKR_OK if the operation was submitted or the error as returned by C_SignInit()
+ */
+CK_DECLARE_FUNCTION(CK_RV, SC_SignAsync)
+(
+		CK_SESSION_HANDLE hSession,
+		CK_MECHANISM_PTR pMechanism,
+		CK_OBJECT_HANDLE hKey,
+		CK_BYTE_PTR pData,
+		CK_ULONG ulDataLen,
+		CK_BYTE_PTR pSignature,
+		CK_ULONG ulSignatureLen,
+		CK_ULONG_PTR pulTicket
+)
+{
+	int rv;
+
+	FUNC_CALLED();
+
+	if (context == NULL) {
+		FUNC_FAILS(CKR_CRYPTOKI_NOT_INITIALIZED, "C_Initialize not called");
+	}
+
+	if (!isValidPtr(pMechanism) || !isValidPtr(pulTicket) || ((ulDataLen > 0) && !isValidPtr(pData))) {
+		FUNC_FAILS(CKR_ARGUMENTS_BAD, "Invalid pointer argument");
+	}
+
+	rv = submitAsyncOperation(ASYNC_SIGN, hSession, pMechanism, hKey, pData, ulDataLen, pSignature, ulSignatureLen, pulTicket);
+
+	FUNC_RETURNS(rv);
+}
+
+
+
+/**
+ * SC_DecryptAsync submits a decryption operation and returns without waiting for the token.
+ *
+ * See SC_SignAsync() for the handling of buffers and tickets.
+ *
+ * @param hSession      The session handle
+ * @param pMechanism    The decryption mechanism
+ * @param hKey          The handle of the decryption key
+ * @param pEncryptedData The cryptogram
+ * @param ulEncryptedDataLen The length of the cryptogram
+ * @param pData         The buffer for the plain text or NULL to determine the length
+ * @param ulDataLen     The size of the buffer
+ * @param pulTicket     The ticket identifying the completion
+ * @return              CKR_OK if the operation was submitted or the error as returned by C_DecryptInit()
+ */
+CK_DECLARE_FUNCTION(CK_RV, SC_DecryptAsync)
+(
+		CK_SESSION_HANDLE hSession,
+		CK_MECHANISM_PTR pMechanism,
+		CK_OBJECT_HANDLE hKey,
+		CK_BYTE_PTR pEncryptedData,
+		CK_ULONG ulEncryptedDataLen,
+		CK_BYTE_PTR pData,
+		CK_ULONG ulDataLen,
+		CK_ULONG_PTR pulTicket
+)
+{
+	int rv;
+
+	FUNC_CALLED();
+
+	if (context == NULL) {
+		FUNC_FAILS(CKR_CRYPTOKI_NOT_INITIALIZED, "C_Initialize not called");
+	}
+
+	if (!isValidPtr(pMechanism) || !isValidPtr(pulTicket) || ((ulEncryptedDataLen > 0) && !isValidPtr(pEncryptedData))) {
+		FUNC_FAILS(CKR_ARGUMENTS_BAD, "Invalid pointer argument");
+	}
+
+	rv = submitAsyncOperation(ASYNC_DECRYPT, hSession, pMechanism, hKey, pEncryptedData, ulEncryptedDataLen, pData, ulDataLen, pulTicket);
+
+	FUNC_RETURNS(rv);
+}
+
+
+
+/**
+ * SC_GetAsyncEventDescriptor returns a file descriptor that is readable while completed
+ * asynchronous operations are waiting to be collected.
+ *
+ * The descriptor can be registered with select(), poll() or epoll. It is owned by the
+ * module and must neither be read nor closed by the application.
+ *
+ * @param pFd           The descriptor
+ * @return              CKR_OK or CKR_FUNCTION_NOT_SUPPORTED on platforms without descriptors
+ */
+CK_DECLARE_FUNCTION(CK_RV, SC_GetAsyncEventDescriptor)
+(
+		int *pFd
+)
+{
+	int rv;
+
+	FUNC_CALLED();
+
+	if (context == NULL) {
+		FUNC_FAILS(CKR_CRYPTOKI_NOT_INITIALIZED, "C_Initialize not called");
+	}
+
+	if (!isValidPtr(pFd)) {
+		FUNC_FAILS(CKR_ARGUMENTS_BAD, "Invalid pointer argument");
+	}
+
+	rv = getAsyncEventDescriptor(pFd);
+
+	FUNC_RETURNS(rv);
+}
+
+
+
+/**
+ * SC_GetAsyncCompletions collects the results of completed asynchronous operations.
+ *
+ * The function does not block. The descriptor returned by SC_GetAsyncEventDescriptor()
+ * is no longer readable once all completions have been collected.
+ *
+ * @param pCompletions  The array receiving the completions
+ * @param ulMaxCount    The number of entries in the array
+ * @param pulCount      The number of completions returned, 0 if none are pending
+ * @return              CKR_OK
+ */
+CK_DECLARE_FUNCTION(CK_RV, SC_GetAsyncCompletions)
+(
+		SC_ASYNC_COMPLETION_PTR pCompletions,
+		CK_ULONG ulMaxCount,
+		CK_ULONG_PTR pulCount
+)
+{
+	int rv;
+
+	FUNC_CALLED();
+
+	if (context == NULL) {
+		FUNC_FAILS(CKR_CRYPTOKI_NOT_INITIALIZED, "C_Initialize not called");
+	}
+
+	if (!isValidPtr(pulCount) || ((ulMaxCount > 0) && !isValidPtr(pCompletions))) {
+		FUNC_FAILS(CKR_ARGUMENTS_BAD, "Invalid pointer argument");
+	}
+
+	rv = getAsyncCompletions(pCompletions, ulMaxCount, pulCount);
+
+	FUNC_RETURNS(rv);
+}
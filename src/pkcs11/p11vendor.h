@@ -0,0 +1,146 @@
+/**
+ * SmartCard-HSM PKCS#11 Module
+ *
+ * Copyright (c) 2013, CardContact Systems GmbH, Minden, Germany
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of CardContact Systems GmbH nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CardContact Systems GmbH BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file    p11vendor.h
+ * @brief   Vendor extensions at the PKCS#11 interface
+ *
+ * The extensions are obtained with SC_GetVendorFunctionList(), which the module
+ * exports next to C_GetFunctionList(). Applications should check the version
+ * in the returned list before using functions added in later versions.
+ */
+
+#ifndef ___P11VENDOR_H_INC___
+#define ___P11VENDOR_H_INC___
+
+#include <pkcs11/cryptoki.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SC_VENDOR_VERSION_MAJOR     1
+#define SC_VENDOR_VERSION_MINOR     2
+
+/**
+ * Input and result of a single signature in SC_SignBatch()
+ */
+typedef struct SC_SIGN_BATCH_ITEM {
+	CK_BYTE_PTR pData;              /**< Data or digest to be signed                            */
+	CK_ULONG ulDataLen;             /**< Length of data                                         */
+	CK_BYTE_PTR pSignature;         /**< Buffer for signature or NULL to query the length        */
+	CK_ULONG ulSignatureLen;        /**< Size of buffer on input, length of signature on output */
+	CK_RV rv;                       /**< Result of this signature                               */
+} SC_SIGN_BATCH_ITEM;
+
+typedef SC_SIGN_BATCH_ITEM CK_PTR SC_SIGN_BATCH_ITEM_PTR;
+
+/**
+ * Utilisation of the card in a slot, see SC_GetSlotStatistics()
+ */
+typedef struct SC_SLOT_STATISTICS {
+	CK_ULONG ulCommands;            /**< Number of command APDUs processed by the card          */
+	CK_ULONG ulBusyTime;            /**< Time in ms the card was processing commands            */
+	CK_ULONG ulIdleTime;            /**< Time in ms the card was waiting for commands           */
+	CK_ULONG ulQueueLength;         /**< Commands currently waiting or in progress              */
+	CK_ULONG ulMaxQueueLength;      /**< Maximum number of commands waiting at the same time    */
+} SC_SLOT_STATISTICS;
+
+typedef SC_SLOT_STATISTICS CK_PTR SC_SLOT_STATISTICS_PTR;
+
+/**
+ * Result of an asynchronous operation, see SC_GetAsyncCompletions()
+ */
+typedef struct SC_ASYNC_COMPLETION {
+	CK_ULONG ulTicket;              /**< Ticket returned by SC_SignAsync() or SC_DecryptAsync() */
+	CK_RV rv;                       /**< Result of the operation                                */
+	CK_ULONG ulOutputLen;           /**< Length of signature or plain text                      */
+} SC_ASYNC_COMPLETION;
+
+typedef SC_ASYNC_COMPLETION CK_PTR SC_ASYNC_COMPLETION_PTR;
+
+typedef CK_RV (CK_CALL_SPEC CK_PTR SC_SignBatch_t)(CK_SESSION_HANDLE hSession, CK_MECHANISM_PTR pMechanism,
+		CK_OBJECT_HANDLE hKey, SC_SIGN_BATCH_ITEM_PTR pItems, CK_ULONG ulCount);
+
+typedef CK_RV (CK_CALL_SPEC CK_PTR SC_GetSlotStatistics_t)(CK_SLOT_ID slotID, SC_SLOT_STATISTICS_PTR pStatistics);
+
+typedef CK_RV (CK_CALL_SPEC CK_PTR SC_SignAsync_t)(CK_SESSION_HANDLE hSession, CK_MECHANISM_PTR pMechanism,
+		CK_OBJECT_HANDLE hKey, CK_BYTE_PTR pData, CK_ULONG ulDataLen,
+		CK_BYTE_PTR pSignature, CK_ULONG ulSignatureLen, CK_ULONG_PTR pulTicket);
+
+typedef CK_RV (CK_CALL_SPEC CK_PTR SC_DecryptAsync_t)(CK_SESSION_HANDLE hSession, CK_MECHANISM_PTR pMechanism,
+		CK_OBJECT_HANDLE hKey, CK_BYTE_PTR pEncryptedData, CK_ULONG ulEncryptedDataLen,
+		CK_BYTE_PTR pData, CK_ULONG ulDataLen, CK_ULONG_PTR pulTicket);
+
+typedef CK_RV (CK_CALL_SPEC CK_PTR SC_GetAsyncEventDescriptor_t)(int *pFd);
+
+typedef CK_RV (CK_CALL_SPEC CK_PTR SC_GetAsyncCompletions_t)(SC_ASYNC_COMPLETION_PTR pCompletions,
+		CK_ULONG ulMaxCount, CK_ULONG_PTR pulCount);
+
+/**
+ * Table of vendor extensions
+ */
+typedef struct SC_VENDOR_FUNCTION_LIST {
+	CK_VERSION version;             /**< Version of this table                                  */
+	SC_SignBatch_t SC_SignBatch;
+	SC_GetSlotStatistics_t SC_GetSlotStatistics;   /**< Since 1.1                                   */
+	SC_SignAsync_t SC_SignAsync;                   /**< Since 1.2                                   */
+	SC_DecryptAsync_t SC_DecryptAsync;             /**< Since 1.2                                   */
+	SC_GetAsyncEventDescriptor_t SC_GetAsyncEventDescriptor; /**< Since 1.2                         */
+	SC_GetAsyncCompletions_t SC_GetAsyncCompletions; /**< Since 1.2                                 */
+} SC_VENDOR_FUNCTION_LIST;
+
+typedef SC_VENDOR_FUNCTION_LIST CK_PTR SC_VENDOR_FUNCTION_LIST_PTR;
+typedef SC_VENDOR_FUNCTION_LIST_PTR CK_PTR SC_VENDOR_FUNCTION_LIST_PTR_PTR;
+
+typedef CK_RV (CK_CALL_SPEC CK_PTR SC_GetVendorFunctionList_t)(SC_VENDOR_FUNCTION_LIST_PTR_PTR ppFunctionList);
+
+CK_DECLARE_FUNCTION(CK_RV, SC_GetVendorFunctionList)(SC_VENDOR_FUNCTION_LIST_PTR_PTR ppFunctionList);
+
+CK_DECLARE_FUNCTION(CK_RV, SC_SignBatch)(CK_SESSION_HANDLE hSession, CK_MECHANISM_PTR pMechanism,
+		CK_OBJECT_HANDLE hKey, SC_SIGN_BATCH_ITEM_PTR pItems, CK_ULONG ulCount);
+
+CK_DECLARE_FUNCTION(CK_RV, SC_GetSlotStatistics)(CK_SLOT_ID slotID, SC_SLOT_STATISTICS_PTR pStatistics);
+
+CK_DECLARE_FUNCTION(CK_RV, SC_SignAsync)(CK_SESSION_HANDLE hSession, CK_MECHANISM_PTR pMechanism,
+		CK_OBJECT_HANDLE hKey, CK_BYTE_PTR pData, CK_ULONG ulDataLen,
+		CK_BYTE_PTR pSignature, CK_ULONG ulSignatureLen, CK_ULONG_PTR pulTicket);
+
+CK_DECLARE_FUNCTION(CK_RV, SC_DecryptAsync)(CK_SESSION_HANDLE hSession, CK_MECHANISM_PTR pMechanism,
+		CK_OBJECT_HANDLE hKey, CK_BYTE_PTR pEncryptedData, CK_ULONG ulEncryptedDataLen,
+		CK_BYTE_PTR pData, CK_ULONG ulDataLen, CK_ULONG_PTR pulTicket);
+
+CK_DECLARE_FUNCTION(CK_RV, SC_GetAsyncEventDescriptor)(int *pFd);
+
+CK_DECLARE_FUNCTION(CK_RV, SC_GetAsyncCompletions)(SC_ASYNC_COMPLETION_PTR pCompletions,
+		CK_ULONG ulMaxCount, CK_ULONG_PTR pulCount);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ___P11VENDOR_H_INC___ */
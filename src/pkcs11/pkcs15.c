@@ -39,25 +39,32 @@
 
 
 
-static int decodeCommonObjectAttributes(unsigned char *coa, int coalen, struct p15CommonObjectAttributes *p15)
+/*
+ * Number of nodes in the index of a description. Descriptions are indexed
+ * only to the depth required for decoding, so this is usually sufficient
+ */
+#define P15_INDEX_NODES     64
+
+
+
+static int decodeCommonObjectAttributes(unsigned char *data, struct asn1Node *nodes, int count, int coa, struct p15CommonObjectAttributes *p15)
 {
-	int tag,len;
-	unsigned char *po;
+	struct asn1Node *node;
 	char *label;
+	int i;
 
-	if (coalen <= 0)
+	i = asn1IndexChild(nodes, count, coa, 0);
+	if (i < 0)
 		return 0;
 
-	po = coa;
-	tag = asn1Tag(&po);
+	node = &nodes[i];
 
-	if (tag == ASN1_UTF8String) {
-		len = asn1Length(&po);
-		label = calloc(len + 1, 1);
+	if (node->tag == ASN1_UTF8String) {
+		label = calloc(node->length + 1, 1);
 		if (label == NULL) {
 			return -1;
 		}
-		memcpy(label, po, len);
+		memcpy(label, data + node->value, node->length);
 		p15->label = label;
 	}
 
@@ -66,78 +73,71 @@ static int decodeCommonObjectAttributes(unsigned char *coa, int coalen, struct p
 
 
 
-static int decodeCommonKeyAttributes(unsigned char *cka, int ckalen, struct p15PrivateKeyDescription *p15)
+static int decodeCommonKeyAttributes(unsigned char *data, struct asn1Node *nodes, int count, int cka, struct p15PrivateKeyDescription *p15)
 {
-	int tag,len;
-	unsigned char *po, *obj, *id;
+	struct asn1Node *node;
+	unsigned char *id;
+	int i;
 
-	if (ckalen <= 0)
+	i = asn1IndexChild(nodes, count, cka, 0);
+	if (i < 0)
 		return 0;
 
-	po = obj = cka;
-	tag = asn1Tag(&po);
-	len = asn1Length(&po);
+	node = &nodes[i];
 
-	if ((tag != ASN1_OCTET_STRING) || (len <= 0)) {
+	if ((node->tag != ASN1_OCTET_STRING) || (node->length <= 0)) {
 		return -1;
 	}
 
-	id = calloc(len, 1);
+	id = calloc(node->length, 1);
 	if (id == NULL) {
 		return -1;
 	}
-	memcpy(id, po, len);
+	memcpy(id, data + node->value, node->length);
 	p15->id.val = id;
-	p15->id.len = len;
+	p15->id.len = node->length;
 
-	po += len;
-
-	if ((po - cka) >= ckalen) {
+	i = asn1IndexChild(nodes, count, cka, 1);
+	if (i < 0) {
 		return 0;
 	}
 
-	obj = po;
-	tag = asn1Tag(&po);
-	len = asn1Length(&po);
+	node = &nodes[i];
 
-	if ((tag != ASN1_BIT_STRING) || (len <= 1)) {
+	if ((node->tag != ASN1_BIT_STRING) || (node->length <= 1)) {
 		return -1;
 	}
 
-	asn1DecodeFlags(po + 1, len - 1, &p15->usage);
+	asn1DecodeFlags(data + node->value + 1, node->length - 1, &p15->usage);
 	return 0;
 }
 
 
 
-static int decodeKeyAttributes(unsigned char *ka, int kalen, struct p15PrivateKeyDescription *p15)
+static int decodeKeyAttributes(unsigned char *data, struct asn1Node *nodes, int count, int ka, struct p15PrivateKeyDescription *p15)
 {
-	int tag,len;
-	unsigned char *po, *obj;
+	struct asn1Node *node;
+	int i;
 
-	if (kalen <= 0)
+	i = asn1IndexChild(nodes, count, ka, 0);
+	if (i < 0)
 		return 0;
 
-	po = obj = ka;
-	tag = asn1Tag(&po);
-	len = asn1Length(&po);
+	node = &nodes[i];
 
-	if ((tag != ASN1_SEQUENCE) || (len <= 0)) {
+	if ((node->tag != ASN1_SEQUENCE) || (node->length <= 0)) {
 		return -1;
 	}
 
-	po += len;
-
-	if ((po - ka) >= kalen) {
+	i = asn1IndexChild(nodes, count, ka, 1);
+	if (i < 0) {
 		return 0;
 	}
 
-	obj = po;
-	tag = asn1Tag(&po);
-	len = asn1Length(&po);
+	node = &nodes[i];
 
-	if ((tag == ASN1_INTEGER) && (len > 0)) {
-		if (asn1DecodeInteger(po, len, &p15->keysize) < 0) {
+	if ((node->tag == ASN1_INTEGER) && (node->length > 0)) {
+		if (asn1DecodeInteger(data + node->value, node->length, &p15->keysize) < 0) {
 			return -1;
 		}
 	} else {
@@ -148,80 +148,62 @@ static int decodeKeyAttributes(unsigned char *ka, int kalen, struct p15PrivateKe
 
 
 
-static int decodePrivateKeyAttributes(unsigned char *prkd, int prkdlen, struct p15PrivateKeyDescription *p15)
+static int decodePrivateKeyAttributes(unsigned char *data, struct asn1Node *nodes, int count, int prkd, struct p15PrivateKeyDescription *p15)
 {
-	int rc,tag,len;
-	unsigned char *po, *obj;
+	int rc, i, n;
 
-	if (prkdlen <= 0) {				// Nothing to decode
+	if (nodes[prkd].length <= 0) {	// Nothing to decode
 		return 0;
 	}
 
-	po = obj = prkd;
-
-	tag = asn1Tag(&po);
-	if (tag != ASN1_SEQUENCE) {
+	i = asn1IndexChild(nodes, count, prkd, 0);
+	if ((i < 0) || (nodes[i].tag != ASN1_SEQUENCE)) {
 		return -1;
 	}
 
-	len = asn1Length(&po);
-
-	rc = decodeCommonObjectAttributes(po, len, &p15->coa);
+	rc = decodeCommonObjectAttributes(data, nodes, count, i, &p15->coa);
 	if (rc < 0) {
 		return rc;
 	}
 
-	po += len;
-
-	if ((po - prkd) >= prkdlen) {
+	i = asn1IndexChild(nodes, count, prkd, 1);
+	if (i < 0) {
 		return 0;
 	}
 
-	obj = po;
-	tag = asn1Tag(&po);
-	if (tag != ASN1_SEQUENCE) {
+	if (nodes[i].tag != ASN1_SEQUENCE) {
 		return -1;
 	}
 
-	len = asn1Length(&po);
-
-	rc = decodeCommonKeyAttributes(po, len, p15);
+	rc = decodeCommonKeyAttributes(data, nodes, count, i, p15);
 	if (rc < 0) {
 		return rc;
 	}
 
-	po += len;
-
-	if ((po - prkd) >= prkdlen) {
+	n = 2;
+	i = asn1IndexChild(nodes, count, prkd, n);
+	if (i < 0) {
 		return 0;
 	}
 
-	obj = po;
-	tag = asn1Tag(&po);
-	if (tag == 0xA0) {
-		len = asn1Length(&po);
-		po += len;
-
-		if ((po - prkd) >= prkdlen) {
+	if (nodes[i].tag == 0xA0) {		// Skip optional subclass attributes
+		i = asn1IndexChild(nodes, count, prkd, ++n);
+		if (i < 0) {
 			return 0;
 		}
-		obj = po;
-		tag = asn1Tag(&po);
 	}
 
-	len = asn1Length(&po);
-	if ((tag != 0xA1) || (len <= 0)) {
+	if ((nodes[i].tag != 0xA1) || (nodes[i].length <= 0)) {
 		return -1;
 	}
 
-	tag = asn1Tag(&po);
-	len = asn1Length(&po);
+	i = asn1IndexChild(nodes, count, i, 0);
 
-	if ((tag != ASN1_SEQUENCE) || (len <= 0)) {
+	if ((i < 0) || (nodes[i].tag != ASN1_SEQUENCE) || (nodes[i].length <= 0)) {
 		return -1;
 	}
 
-	rc = decodeKeyAttributes(po, len, p15);
+	rc = decodeKeyAttributes(data, nodes, count, i, p15);
 	if (rc < 0) {
 		return rc;
 	}
@@ -243,12 +225,13 @@ static int decodePrivateKeyAttributes(unsigned char *prkd, int prkdlen, struct p
  */
 int decodePrivateKeyDescription(unsigned char *prkd, size_t prkdlen, struct p15PrivateKeyDescription **p15)
 {
-	int rc,tag,len;
-	unsigned char *po;
+	struct asn1Node nodes[P15_INDEX_NODES];
+	int count;
 
-	rc = asn1Validate(prkd, prkdlen);
+	// Validate and index up to the key attributes in [1] { SEQUENCE { ... } }
+	count = asn1Index(prkd, prkdlen, 3, nodes, P15_INDEX_NODES);
 
-	if (rc != 0) {
+	if (count <= 0) {
 		return -1;
 	}
 
@@ -257,99 +240,74 @@ int decodePrivateKeyDescription(unsigned char *prkd, size_t prkdlen, struct p15P
 		return -1;
 	}
 
-	po = prkd;
-
-	tag = asn1Tag(&po);
-	len = asn1Length(&po);
-
-	if ((tag != ASN1_SEQUENCE) && (tag != 0xA0)) {
+	if ((nodes[0].tag != ASN1_SEQUENCE) && (nodes[0].tag != 0xA0)) {
 		return -1;
 	}
 
-	(*p15)->keytype = (int)tag;
-	rc = decodePrivateKeyAttributes(po, len, *p15);
+	(*p15)->keytype = (int)nodes[0].tag;
 
-	return rc;
+	return decodePrivateKeyAttributes(prkd, nodes, count, 0, *p15);
 }
 
 
 
-static int decodeCommonCertificateAttributes(unsigned char *cca, int ccalen, struct p15CertificateDescription *p15)
+static int decodeCommonCertificateAttributes(unsigned char *data, struct asn1Node *nodes, int count, int cca, struct p15CertificateDescription *p15)
 {
-	int tag,len;
-	unsigned char *po, *obj, *id;
+	struct asn1Node *node;
+	unsigned char *id;
+	int i;
 
-	if (ccalen <= 0)
+	i = asn1IndexChild(nodes, count, cca, 0);
+	if (i < 0)
 		return 0;
 
-	po = obj = cca;
-	tag = asn1Tag(&po);
-	len = asn1Length(&po);
+	node = &nodes[i];
 
-	if ((tag != ASN1_OCTET_STRING) || (len <= 0)) {
+	if ((node->tag != ASN1_OCTET_STRING) || (node->length <= 0)) {
 		return -1;
 	}
 
-	id = calloc(len, 1);
+	id = calloc(node->length, 1);
 	if (id == NULL) {
 		return -1;
 	}
-	memcpy(id, po, len);
+	memcpy(id, data + node->value, node->length);
 	p15->id.val = id;
-	p15->id.len = len;
-
-	po += len;
+	p15->id.len = node->length;
 
 	return 0;
 }
 
 
 
-static int decodeCertificateAttributes(unsigned char *cd, int cdlen, struct p15CertificateDescription *p15)
+static int decodeCertificateAttributes(unsigned char *data, struct asn1Node *nodes, int count, int cd, struct p15CertificateDescription *p15)
 {
-	int rc,tag,len;
-	unsigned char *po, *obj;
+	int rc, i;
 
-	if (cdlen <= 0) {				// Nothing to decode
+	if (nodes[cd].length <= 0) {	// Nothing to decode
 		return 0;
 	}
 
-	po = obj = cd;
-
-	tag = asn1Tag(&po);
-	if (tag != ASN1_SEQUENCE) {
+	i = asn1IndexChild(nodes, count, cd, 0);
+	if ((i < 0) || (nodes[i].tag != ASN1_SEQUENCE)) {
 		return -1;
 	}
 
-	len = asn1Length(&po);
-
-	rc = decodeCommonObjectAttributes(po, len, &p15->coa);
+	rc = decodeCommonObjectAttributes(data, nodes, count, i, &p15->coa);
 	if (rc < 0) {
 		return rc;
 	}
 
-	po += len;
-
-	if ((po - cd) >= cdlen) {
+	i = asn1IndexChild(nodes, count, cd, 1);
+	if (i < 0) {
 		return 0;
 	}
 
-	obj = po;
-	tag = asn1Tag(&po);
-	if (tag != ASN1_SEQUENCE) {
+	if (nodes[i].tag != ASN1_SEQUENCE) {
 		return -1;
 	}
 
-	len = asn1Length(&po);
-
-	rc = decodeCommonCertificateAttributes(po, len, p15);
-	if (rc < 0) {
-		return rc;
-	}
-
-	po += len;
-
-	return 0;
+	return decodeCommonCertificateAttributes(data, nodes, count, i, p15);
 }
 
 
@@ -366,12 +324,13 @@ static int decodeCertificateAttributes(unsigned char *cd, int cdlen, struct p15C
  */
 int decodeCertificateDescription(unsigned char *cd, size_t cdlen, struct p15CertificateDescription **p15)
 {
-	int rc,tag,len;
-	unsigned char *po;
+	struct asn1Node nodes[P15_INDEX_NODES];
+	int count;
 
-	rc = asn1Validate(cd, cdlen);
+	// Validate and index up to the content of the common attributes
+	count = asn1Index(cd, cdlen, 2, nodes, P15_INDEX_NODES);
 
-	if (rc != 0) {
+	if (count <= 0) {
 		return -1;
 	}
 
@@ -380,19 +339,13 @@ int decodeCertificateDescription(unsigned char *cd, size_t cdlen, struct p15Cert
 		return -1;
 	}
 
-	po = cd;
-
-	tag = asn1Tag(&po);
-	len = asn1Length(&po);
-
-	if ((tag != ASN1_SEQUENCE) && (tag != 0xA0)) {
+	if ((nodes[0].tag != ASN1_SEQUENCE) && (nodes[0].tag != 0xA0)) {
 		return -1;
 	}
 
-	(*p15)->certtype = (int)tag;
-	rc = decodeCertificateAttributes(po, len, *p15);
+	(*p15)->certtype = (int)nodes[0].tag;
 
-	return rc;
+	return decodeCertificateAttributes(cd, nodes, count, 0, *p15);
 }
 
 
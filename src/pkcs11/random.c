@@ -0,0 +1,126 @@
+/**
+ * SmartCard-HSM PKCS#11 Module
+ *
+ * Copyright (c) 2013, CardContact Systems GmbH, Minden, Germany
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of CardContact Systems GmbH nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CardContact Systems GmbH BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file    random.c
+ * @brief   Random numbers from the host operating system
+ *
+ * Used for padding and other values that must be unpredictable, but need
+ * not come from the token.
+ */
+
+#ifdef _WIN32
+#define _CRT_RAND_S
+#include <stdlib.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+
+#if defined(__GLIBC__) && ((__GLIBC__ > 2) || ((__GLIBC__ == 2) && (__GLIBC_MINOR__ >= 25)))
+#define HAVE_GETRANDOM
+#include <sys/random.h>
+#endif
+
+#ifndef O_CLOEXEC
+#define O_CLOEXEC 0
+#endif
+#endif
+
+#include <string.h>
+
+#include <pkcs11/random.h>
+
+
+
+/**
+ * Fill the buffer with random bytes from the operating system
+ *
+ * @param buf        The buffer
+ * @param len        The number of bytes
+ * @return           0 or -1 if no random source is available
+ */
+int getHostRandom(unsigned char *buf, size_t len)
+{
+#ifdef _WIN32
+	unsigned int r;
+	size_t l;
+
+	while (len > 0) {
+		if (rand_s(&r) != 0)
+			return -1;
+
+		l = len < sizeof(r) ? len : sizeof(r);
+		memcpy(buf, &r, l);
+		buf += l;
+		len -= l;
+	}
+	return 0;
+#else
+	ssize_t rc;
+	int fd;
+
+#ifdef HAVE_GETRANDOM
+	while (len > 0) {
+		rc = getrandom(buf, len, 0);
+
+		if (rc < 0) {
+			if (errno == EINTR)
+				continue;
+			break;			// e.g. ENOSYS on older kernels, continue with /dev/urandom
+		}
+		buf += rc;
+		len -= rc;
+	}
+
+	if (len == 0)
+		return 0;
+#endif
+
+	// Do not leak the descriptor into child processes of a forking application
+	fd = open("/dev/urandom", O_RDONLY | O_CLOEXEC);
+
+	if (fd < 0)
+		return -1;
+
+	while (len > 0) {
+		rc = read(fd, buf, len);
+
+		if (rc <= 0) {
+			if ((rc < 0) && (errno == EINTR))
+				continue;
+			close(fd);
+			return -1;
+		}
+		buf += rc;
+		len -= rc;
+	}
+
+	close(fd);
+	return 0;
+#endif
+}
@@ -0,0 +1,413 @@
+/**
+ * SmartCard-HSM PKCS#11 Module
+ *
+ * Copyright (c) 2013, CardContact Systems GmbH, Minden, Germany
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of CardContact Systems GmbH nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CardContact Systems GmbH BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file    rsa.c
+ * @brief   RSA public key operations and PKCS#1 encoding
+ *
+ * Only public key operations are implemented. Private keys never leave the token.
+ */
+
+#include <string.h>
+
+#include <pkcs11/rsa.h>
+#include <pkcs11/digest.h>
+#include <pkcs11/random.h>
+
+
+
+/**
+ * Prepare a RSA public key
+ *
+ * @param key        The key to initialize
+ * @param modulus    The big-endian modulus
+ * @param modulusLen The length of the modulus
+ * @param exponent   The big-endian public exponent
+ * @param exponentLen The length of the public exponent
+ * @return           0 or -1 if the key is not supported
+ */
+int rsaInitPublicKey(struct rsaPublicKey *key, const unsigned char *modulus, size_t modulusLen, const unsigned char *exponent, size_t exponentLen)
+{
+	while ((modulusLen > 0) && (*modulus == 0)) {
+		modulus++;
+		modulusLen--;
+	}
+
+	while ((exponentLen > 0) && (*exponent == 0)) {
+		exponent++;
+		exponentLen--;
+	}
+
+	if ((modulusLen < 64) || (modulusLen > RSA_MAX_BYTES))
+		return -1;
+
+	// The exponent must be odd and not exceed the modulus
+	if ((exponentLen == 0) || (exponentLen > modulusLen) || !(exponent[exponentLen - 1] & 1))
+		return -1;
+
+	if (montInit(&key->n, modulus, modulusLen, 0) < 0)
+		return -1;
+
+	key->size = (int)modulusLen;
+	key->bits = bnBits(key->n.m, key->n.limbs);
+	memcpy(key->e, exponent, exponentLen);
+	key->eLen = exponentLen;
+	return 0;
+}
+
+
+
+/**
+ * Perform the RSA public key operation out = in ^ e mod n
+ *
+ * @param key        The public key
+ * @param in         The big-endian input value
+ * @param inLen      The length of the input, at most the length of the modulus
+ * @param out        Buffer receiving key->size bytes
+ * @return           0 or -1 if the input is not smaller than the modulus
+ */
+int rsaPublic(const struct rsaPublicKey *key, const unsigned char *in, size_t inLen, unsigned char *out)
+{
+	const struct montContext *n = &key->n;
+	uint32_t a[BN_MAX_LIMBS];
+
+	if ((inLen > (size_t)key->size) || (bnFromBytes(a, n->limbs, in, inLen) < 0))
+		return -1;
+
+	if (bnCmp(a, n->m, n->limbs) >= 0)
+		return -1;
+
+	montToMont(n, a, a);
+	montExp(n, a, a, key->e, key->eLen);
+	montFromMont(n, a, a);
+	bnToBytes(a, n->limbs, out, key->size);
+	return 0;
+}
+
+
+
+/**
+ * Translate the MGF1 generator from a mechanism parameter into the hash mechanism
+ *
+ * @param mgf        The mask generation function, e.g. CKG_MGF1_SHA256
+ * @return           The hash mechanism or 0 if not supported
+ */
+CK_MECHANISM_TYPE getMGF1Hash(CK_RSA_PKCS_MGF_TYPE mgf)
+{
+	switch(mgf) {
+	case CKG_MGF1_SHA1:
+		return CKM_SHA_1;
+	case CKG_MGF1_SHA224:
+		return CKM_SHA224;
+	case CKG_MGF1_SHA256:
+		return CKM_SHA256;
+	case CKG_MGF1_SHA384:
+		return CKM_SHA384;
+	case CKG_MGF1_SHA512:
+		return CKM_SHA512;
+	}
+	return 0;
+}
+
+
+
+/**
+ * Apply the MGF1 mask generation function from PKCS#1 by XORing the mask into data
+ *
+ * @param hash       The hash mechanism used by MGF1
+ * @param seed       The seed
+ * @param seedLen    The length of the seed
+ * @param data       The data to mask
+ * @param len        The length of the data and mask
+ * @return           0 or -1 if the hash is not supported
+ */
+int mgf1Mask(CK_MECHANISM_TYPE hash, const unsigned char *seed, size_t seedLen, unsigned char *data, size_t len)
+{
+	struct digestContext ctx;
+	unsigned char counter[4], mask[DIGEST_MAX_SIZE];
+	uint32_t c;
+	size_t i, l;
+
+	for (c = 0; len > 0; c++) {
+		counter[0] = (unsigned char)(c >> 24);
+		counter[1] = (unsigned char)(c >> 16);
+		counter[2] = (unsigned char)(c >> 8);
+		counter[3] = (unsigned char)c;
+
+		if (digestInit(&ctx, hash) < 0)
+			return -1;
+
+		digestUpdate(&ctx, seed, seedLen);
+		digestUpdate(&ctx, counter, sizeof(counter));
+		l = digestFinal(&ctx, mask);
+
+		if (l > len)
+			l = len;
+
+		for (i = 0; i < l; i++)
+			*data++ ^= mask[i];
+
+		len -= l;
+	}
+	return 0;
+}
+
+
+
+/**
+ * Check the PKCS#1 v1.5 signature padding 00 01 FF .. FF 00 and locate the encoded data
+ *
+ * @param em         The encoded message recovered from the signature
+ * @param emLen      The length of the encoded message
+ * @param data       Set to the data following the padding
+ * @param dataLen    Set to the length of the data
+ * @return           0 or -1 if the padding is invalid
+ */
+int pkcs1V15RemoveSignaturePadding(const unsigned char *em, size_t emLen, const unsigned char **data, size_t *dataLen)
+{
+	size_t i;
+
+	if ((emLen < 11) || (em[0] != 0x00) || (em[1] != 0x01))
+		return -1;
+
+	for (i = 2; (i < emLen) && (em[i] == 0xFF); i++);
+
+	// At least 8 bytes of padding followed by a zero byte
+	if ((i < 10) || (i >= emLen) || (em[i] != 0x00))
+		return -1;
+
+	i++;
+	*data = em + i;
+	*dataLen = emLen - i;
+	return 0;
+}
+
+
+
+/**
+ * Verify an EMSA-PSS encoded message as defined in PKCS#1 v2.1
+ *
+ * @param em         The encoded message, i.e. the signature raised to e, with the length of the modulus
+ * @param modBits    The length of the modulus in bits
+ * @param hash       The hash mechanism for M'
+ * @param mgfHash    The hash mechanism for MGF1
+ * @param mHash      The hash of the message
+ * @param hLen       The length of the hash
+ * @param sLen       The length of the salt
+ * @return           0 if the encoding is consistent or -1
+ */
+int pssVerify(const unsigned char *em, int modBits, CK_MECHANISM_TYPE hash, CK_MECHANISM_TYPE mgfHash, const unsigned char *mHash, size_t hLen, size_t sLen)
+{
+	struct digestContext ctx;
+	unsigned char db[RSA_MAX_BYTES], h[DIGEST_MAX_SIZE];
+	static const unsigned char zeros[8] = { 0 };
+	int emBits = modBits - 1;
+	size_t emLen = (emBits + 7) >> 3;
+	size_t dbLen, i;
+	unsigned char topMask;
+
+	if ((getDigestSize(hash) != (int)hLen) || (emLen < hLen + sLen + 2))
+		return -1;
+
+	// The leading byte of the modulus length encoding is zero if emBits is a multiple of 8
+	if (!(emBits & 7)) {
+		if (*em != 0)
+			return -1;
+		em++;
+	}
+
+	if (em[emLen - 1] != 0xBC)
+		return -1;
+
+	dbLen = emLen - hLen - 1;
+	topMask = (unsigned char)(0xFF >> (8 * emLen - emBits));
+
+	if (em[0] & ~topMask)
+		return -1;
+
+	memcpy(db, em, dbLen);
+
+	if (mgf1Mask(mgfHash, em + dbLen, hLen, db, dbLen) < 0)
+		return -1;
+
+	db[0] &= topMask;
+
+	for (i = 0; i < dbLen - sLen - 1; i++) {
+		if (db[i] != 0)
+			return -1;
+	}
+
+	if (db[i] != 0x01)
+		return -1;
+
+	// H' = Hash(00 00 00 00 00 00 00 00 || mHash || salt)
+	digestInit(&ctx, hash);
+	digestUpdate(&ctx, zeros, sizeof(zeros));
+	digestUpdate(&ctx, mHash, hLen);
+	digestUpdate(&ctx, db + dbLen - sLen, sLen);
+	digestFinal(&ctx, h);
+
+	return memcmp(h, em + dbLen, hLen) ? -1 : 0;
+}
+
+
+
+/**
+ * Encode a hash with EMSA-PSS as defined in PKCS#1 v2.1 for signing with the raw RSA operation
+ *
+ * @param em         Buffer receiving the encoded message with the length of the modulus
+ * @param modBits    The length of the modulus in bits
+ * @param hash       The hash mechanism for M'
+ * @param mgfHash    The hash mechanism for MGF1
+ * @param mHash      The hash of the message
+ * @param hLen       The length of the hash
+ * @param sLen       The length of the random salt
+ * @return           0 or -1 if the modulus is too short or no random numbers are available
+ */
+int pssEncode(unsigned char *em, int modBits, CK_MECHANISM_TYPE hash, CK_MECHANISM_TYPE mgfHash, const unsigned char *mHash, size_t hLen, size_t sLen)
+{
+	struct digestContext ctx;
+	static const unsigned char zeros[8] = { 0 };
+	int emBits = modBits - 1;
+	size_t emLen = (emBits + 7) >> 3;
+	size_t dbLen;
+	unsigned char *db;
+
+	if ((getDigestSize(hash) != (int)hLen) || (modBits > BN_MAX_BITS) || (emLen < hLen + sLen + 2))
+		return -1;
+
+	// The leading byte of the modulus length encoding is zero if emBits is a multiple of 8
+	if (!(emBits & 7))
+		*em++ = 0;
+
+	dbLen = emLen - hLen - 1;
+	db = em;
+
+	// DB = PS || 0x01 || salt, with the salt generated in place
+	memset(db, 0, dbLen - sLen - 1);
+	db[dbLen - sLen - 1] = 0x01;
+
+	if (getHostRandom(db + dbLen - sLen, sLen) < 0)
+		return -1;
+
+	// H = Hash(00 00 00 00 00 00 00 00 || mHash || salt)
+	digestInit(&ctx, hash);
+	digestUpdate(&ctx, zeros, sizeof(zeros));
+	digestUpdate(&ctx, mHash, hLen);
+	digestUpdate(&ctx, db + dbLen - sLen, sLen);
+	digestFinal(&ctx, em + dbLen);
+
+	if (mgf1Mask(mgfHash, em + dbLen, hLen, db, dbLen) < 0)
+		return -1;
+
+	db[0] &= (unsigned char)(0xFF >> (8 * emLen - emBits));
+	em[emLen - 1] = 0xBC;
+	return 0;
+}
+
+
+
+/**
+ * Encode data for encryption with the PKCS#1 v1.5 padding 00 02 PS 00 M
+ *
+ * @param em         Buffer receiving the encoded message
+ * @param emLen      The length of the modulus
+ * @param data       The data to encrypt
+ * @param dataLen    The length of the data, at most emLen - 11
+ * @return           0 or -1 if the data is too long or no random numbers are available
+ */
+int pkcs1V15AddEncryptionPadding(unsigned char *em, size_t emLen, const unsigned char *data, size_t dataLen)
+{
+	size_t psLen, i;
+
+	if (dataLen + 11 > emLen)
+		return -1;
+
+	psLen = emLen - dataLen - 3;
+	em[0] = 0x00;
+	em[1] = 0x02;
+
+	if (getHostRandom(em + 2, psLen) < 0)
+		return -1;
+
+	// The padding string must not contain zero bytes
+	for (i = 2; i < psLen + 2; i++) {
+		while (em[i] == 0) {
+			if (getHostRandom(em + i, 1) < 0)
+				return -1;
+		}
+	}
+
+	em[psLen + 2] = 0x00;
+	memcpy(em + psLen + 3, data, dataLen);
+	return 0;
+}
+
+
+
+/**
+ * Encode data for encryption with EME-OAEP as defined in PKCS#1 v2.1
+ *
+ * @param em         Buffer receiving the encoded message
+ * @param emLen      The length of the modulus
+ * @param hash       The hash mechanism
+ * @param mgfHash    The hash mechanism for MGF1
+ * @param lHash      The hash of the label
+ * @param data       The data to encrypt
+ * @param dataLen    The length of the data, at most emLen - 2 * hLen - 2
+ * @return           0 or -1 if the data is too long or no random numbers are available
+ */
+int oaepEncode(unsigned char *em, size_t emLen, CK_MECHANISM_TYPE hash, CK_MECHANISM_TYPE mgfHash, const unsigned char *lHash, const unsigned char *data, size_t dataLen)
+{
+	unsigned char *seed, *db;
+	size_t hLen, dbLen;
+
+	hLen = getDigestSize(hash);
+
+	if (((int)hLen <= 0) || (dataLen + 2 * hLen + 2 > emLen))
+		return -1;
+
+	// EM = 00 || maskedSeed || maskedDB with DB = lHash || PS || 01 || M
+	seed = em + 1;
+	db = seed + hLen;
+	dbLen = emLen - hLen - 1;
+
+	em[0] = 0x00;
+	memcpy(db, lHash, hLen);
+	memset(db + hLen, 0, dbLen - hLen - dataLen - 1);
+	db[dbLen - dataLen - 1] = 0x01;
+	memcpy(db + dbLen - dataLen, data, dataLen);
+
+	if (getHostRandom(seed, hLen) < 0)
+		return -1;
+
+	if ((mgf1Mask(mgfHash, seed, hLen, db, dbLen) < 0) ||
+		(mgf1Mask(mgfHash, db, dbLen, seed, hLen) < 0))
+		return -1;
+
+	return 0;
+}
@@ -0,0 +1,62 @@
+/**
+ * SmartCard-HSM PKCS#11 Module
+ *
+ * Copyright (c) 2013, CardContact Systems GmbH, Minden, Germany
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of CardContact Systems GmbH nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CardContact Systems GmbH BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file    rsa.h
+ * @brief   RSA public key operations and PKCS#1 encoding
+ */
+
+#ifndef ___RSA_H_INC___
+#define ___RSA_H_INC___
+
+#include <pkcs11/cryptoki.h>
+#include <pkcs11/bignum.h>
+
+#define RSA_MAX_BYTES           (BN_MAX_BITS / 8)
+
+/**
+ * RSA public key prepared for modular exponentiation
+ */
+struct rsaPublicKey {
+	int size;                         /**< Length of the modulus in bytes      */
+	int bits;                         /**< Length of the modulus in bits       */
+	struct montContext n;             /**< The modulus                         */
+	unsigned char e[RSA_MAX_BYTES];   /**< The public exponent                 */
+	size_t eLen;                      /**< Length of the public exponent       */
+};
+
+int rsaInitPublicKey(struct rsaPublicKey *key, const unsigned char *modulus, size_t modulusLen, const unsigned char *exponent, size_t exponentLen);
+int rsaPublic(const struct rsaPublicKey *key, const unsigned char *in, size_t inLen, unsigned char *out);
+CK_MECHANISM_TYPE getMGF1Hash(CK_RSA_PKCS_MGF_TYPE mgf);
+int mgf1Mask(CK_MECHANISM_TYPE hash, const unsigned char *seed, size_t seedLen, unsigned char *data, size_t len);
+int pkcs1V15RemoveSignaturePadding(const unsigned char *em, size_t emLen, const unsigned char **data, size_t *dataLen);
+int pkcs1V15AddEncryptionPadding(unsigned char *em, size_t emLen, const unsigned char *data, size_t dataLen);
+int oaepEncode(unsigned char *em, size_t emLen, CK_MECHANISM_TYPE hash, CK_MECHANISM_TYPE mgfHash, const unsigned char *lHash, const unsigned char *data, size_t dataLen);
+int pssEncode(unsigned char *em, int modBits, CK_MECHANISM_TYPE hash, CK_MECHANISM_TYPE mgfHash, const unsigned char *mHash, size_t hLen, size_t sLen);
+int pssVerify(const unsigned char *em, int modBits, CK_MECHANISM_TYPE hash, CK_MECHANISM_TYPE mgfHash, const unsigned char *mHash, size_t hLen, size_t sLen);
+
+#endif /* ___RSA_H_INC___ */
@@ -35,6 +35,8 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <common/securemem.h>
+
 #include <pkcs11/session.h>
 #include <pkcs11/slotpool.h>
 
@@ -219,12 +221,17 @@ int removeSession(struct p11SessionPool_t *pool, CK_SESSION_HANDLE handle)
 	}
 
 	if (session->cryptoBuffer) {
-		free(session->cryptoBuffer);
+		secureFree(session->cryptoBuffer);
 		session->cryptoBuffer = NULL;
 		session->cryptoBufferMax = 0;
 		session->cryptoBufferSize = 0;
 	}
 
+	endDigest(session);
+	endVerify(session);
+	endEncrypt(session);
+	endSignHash(session);
+
 	free(session);
 
 	pool->numberOfSessions--;
@@ -449,19 +456,24 @@ void clearSearchList(struct p11Session_t *session)
  */
 int appendToCryptoBuffer(struct p11Session_t *session, CK_BYTE_PTR data, CK_ULONG length)
 {
+	CK_BYTE_PTR buffer;
+	CK_ULONG max;
+
 	if (session->cryptoBufferMax < session->cryptoBufferSize + length) {
-		if (session->cryptoBufferMax == 0) {
-			session->cryptoBufferMax = 256;
-		}
-		while (session->cryptoBufferMax < session->cryptoBufferSize + length) {
-			session->cryptoBufferMax <<= 1;
+		max = session->cryptoBufferMax ? session->cryptoBufferMax : 256;
+
+		while (max < session->cryptoBufferSize + length) {
+			max <<= 1;
 		}
 
-		session->cryptoBuffer = (CK_BYTE_PTR)realloc(session->cryptoBuffer, session->cryptoBufferMax);
-		if (session->cryptoBuffer == NULL) {
-			session->cryptoBufferMax = 0;
+		// The buffer is kept with the session and reused for subsequent operations
+		buffer = (CK_BYTE_PTR)secureRealloc(session->cryptoBuffer, max);
+		if (buffer == NULL) {
 			return CKR_HOST_MEMORY;
 		}
+
+		session->cryptoBuffer = buffer;
+		session->cryptoBufferMax = max;
 	}
 
 	memcpy(session->cryptoBuffer + session->cryptoBufferSize, data, length);
@@ -484,3 +496,65 @@ void clearCryptoBuffer(struct p11Session_t *session)
 		session->cryptoBufferSize = 0;
 	}
 }
+
+
+
+/**
+ * End the digest operation and release the hash state
+ *
+ * @param session   the session
+ */
+void endDigest(struct p11Session_t *session)
+{
+	if (session->digest) {
+		secureFree(session->digest);
+		session->digest = NULL;
+	}
+}
+
+
+
+/**
+ * End the verify operation and release the prepared key
+ *
+ * @param session   the session
+ */
+void endVerify(struct p11Session_t *session)
+{
+	if (session->verify) {
+		free(session->verify);
+		session->verify = NULL;
+	}
+}
+
+
+
+/**
+ * End the encryption in the host and clear the collected plain text
+ *
+ * @param session   the session
+ */
+void endEncrypt(struct p11Session_t *session)
+{
+	if (session->encrypt) {
+		free(session->encrypt);
+		session->encrypt = NULL;
+		session->activeObjectHandle = CK_INVALID_HANDLE;
+		clearCryptoBuffer(session);
+	}
+}
+
+
+
+/**
+ * End the signature hashed in the host and release the hash state
+ *
+ * @param session   the session
+ */
+void endSignHash(struct p11Session_t *session)
+{
+	if (session->signHash) {
+		secureFree(session->signHash);
+		session->signHash = NULL;
+	}
+}
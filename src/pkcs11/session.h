@@ -37,6 +37,10 @@
 #include <pkcs11/p11generic.h>
 #include <pkcs11/cryptoki.h>
 #include <pkcs11/object.h>
+#include <pkcs11/digest.h>
+#include <pkcs11/verify.h>
+#include <pkcs11/encrypt.h>
+#include <pkcs11/hashsign.h>
 
 
 struct p11ObjectSearch_t {
@@ -62,6 +66,10 @@ struct p11Session_t {
 	CK_BYTE_PTR cryptoBuffer;           /**< Buffer storing intermediate results                */
 	CK_ULONG cryptoBufferSize;          /**< Current content of crypto buffer                   */
 	CK_ULONG cryptoBufferMax;           /**< Current size of crypto buffer                      */
+	struct digestContext *digest;       /**< Active digest operation or NULL                    */
+	struct verifyContext *verify;       /**< Active verify operation or NULL                    */
+	struct encryptContext *encrypt;     /**< Active encryption in the host or NULL              */
+	struct hashSignContext *signHash;   /**< Hash of a signature computed in the host or NULL   */
 
 	struct p11ObjectSearch_t searchObj; /**< Store the result of a search operation             */
 
@@ -92,5 +100,9 @@ int addObjectToSearchList(struct p11Session_t *session, struct p11Object_t *obje
 void clearSearchList(struct p11Session_t *session);
 int appendToCryptoBuffer(struct p11Session_t *session, CK_BYTE_PTR data, CK_ULONG length);
 void clearCryptoBuffer(struct p11Session_t *session);
+void endDigest(struct p11Session_t *session);
+void endVerify(struct p11Session_t *session);
+void endEncrypt(struct p11Session_t *session);
+void endSignHash(struct p11Session_t *session);
 
 #endif /* ___SESSION_H_INC___ */
@@ -57,8 +57,7 @@
 
 extern struct p11Context_t *context;
 
-#define MAX_READERS 8
-static unsigned short numberOfReaders = 0;
+#define INITIAL_PORTS 8
 
 
 
@@ -93,7 +92,7 @@ int transmitAPDUwithCTAPI(struct p11Slot_t *slot, int todad,
 			apdu, sizeof(apdu));
 
 	if (rc < 0) {
-		memset_s(apdu, 0, sizeof(apdu));
+		memset_s(apdu, sizeof(apdu), 0, sizeof(apdu));
 		FUNC_FAILS(rc, "Encoding APDU failed");
 	}
 
@@ -115,7 +114,7 @@ int transmitAPDUwithCTAPI(struct p11Slot_t *slot, int todad,
 		rc = -1;
 	}
 
-	memset_s(apdu, 0, sizeof(apdu));
+	memset_s(apdu, sizeof(apdu), 0, sizeof(apdu));
 	FUNC_RETURNS(rc);
 }
 
@@ -313,34 +312,123 @@ int getCTAPIToken(struct p11Slot_t *slot, struct p11Token_t **token)
 
 
 
+/*
+ * Locate the slot serving the reader at port pn
+ */
+static struct p11Slot_t *findCTAPISlot(struct p11SlotPool_t *pool, unsigned short pn)
+{
+	struct p11Slot_t *slot;
+
+	for (slot = pool->list; slot; slot = slot->next) {
+		if (!slot->primarySlot && (slot->ctn == pn)) {
+			break;
+		}
+	}
+	return slot;
+}
+
+
+
+/*
+ * Check if port pn is in the list of attached readers
+ */
+static int isListedPort(unsigned short *ports, unsigned short count, unsigned short pn)
+{
+	while (count--) {
+		if (*ports++ == pn) {
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
+
+
+
+/*
+ * Query the port numbers of attached readers, growing the buffer as required
+ */
+static int listCTAPIPorts(unsigned short **ports, unsigned short *count)
+{
+	unsigned short size, *list, *newlist;
+	int rc;
+
+	size = INITIAL_PORTS;
+	list = NULL;
+
+	while (1) {
+		newlist = (unsigned short *)realloc(list, size * sizeof(unsigned short));
+
+		if (newlist == NULL) {
+			free(list);
+			return CKR_HOST_MEMORY;
+		}
+
+		list = newlist;
+		*count = size;
+		rc = CT_list(list, count);
+
+		if (rc != ERR_MEMORY) {
+			break;
+		}
+		size = *count > size ? *count : size << 1;
+	}
+
+	if (rc != OK) {
+#ifdef DEBUG
+		debug("CT_list returns %d\n", rc);
+#endif
+		free(list);
+		return CKR_DEVICE_ERROR;
+	}
+
+	*ports = list;
+	return CKR_OK;
+}
+
+
+
+/**
+ * updateCTAPISlots synchronizes the slot list with the attached readers
+ *
+ * The list of attached readers is obtained with CT_list(), which is maintained
+ * by hotplug notifications. Only ports without an open slot are initialized with
+ * CT_init() and slots of detached readers are closed. The port number is used as
+ * card terminal number, so that a reader reattached at the same port is served
+ * by the same slot.
+ *
+ * @param pool       Pointer to slot-pool structure.
+ *
+ * @return           CKR_OK, CKR_HOST_MEMORY or CKR_DEVICE_ERROR
+ */
 int updateCTAPISlots(struct p11SlotPool_t *pool)
 {
 	struct p11Slot_t *slot;
-	unsigned short ctn;
+	unsigned short *ports, count, i, ctn;
 	char scr[20];
 	int rc;
 
 	FUNC_CALLED();
 
-	slot = pool->list;
-	while (slot) {
-		if (slot->closed) {
-			ctn = slot->ctn;
-			rc = CT_init(ctn, ctn);
+	rc = listCTAPIPorts(&ports, &count);
 
-			if (rc != OK) {
-#ifdef DEBUG
-				debug("CT_init returns %d\n", rc);
-#endif
-			} else {
-				slot->closed = FALSE;
-			}
+	if (rc != CKR_OK) {
+		FUNC_FAILS(rc, "Listing attached readers failed");
+	}
+
+	for (slot = pool->list; slot; slot = slot->next) {
+		if (!slot->primarySlot && !slot->closed && !isListedPort(ports, count, slot->ctn)) {
+			removeToken(slot);
+			closeSlot(slot);
 		}
-		slot = slot->next;
 	}
 
-	while (numberOfReaders < MAX_READERS) {
-		ctn = numberOfReaders;
+	for (i = 0; i < count; i++) {
+		ctn = ports[i];
+		slot = findCTAPISlot(pool, ctn);
+
+		if (slot && !slot->closed) {
+			continue;
+		}
 
 		rc = CT_init(ctn, ctn);
 
@@ -348,12 +436,19 @@ int updateCTAPISlots(struct p11SlotPool_t *pool)
 #ifdef DEBUG
 			debug("CT_init returns %d\n", rc);
 #endif
-			break;
+			continue;
+		}
+
+		if (slot) {
+			slot->closed = FALSE;
+			continue;
 		}
 
 		slot = (struct p11Slot_t *) calloc(1, sizeof(struct p11Slot_t));
 
 		if (slot == NULL) {
+			CT_close(ctn);
+			free(ports);
 			FUNC_FAILS(CKR_HOST_MEMORY, "Out of memory");
 		}
 
@@ -375,11 +470,11 @@ int updateCTAPISlots(struct p11SlotPool_t *pool)
 
 		slot->info.flags = CKF_REMOVABLE_DEVICE | CKF_HW_SLOT;
 		addSlot(&context->slotPool, slot);
-		numberOfReaders++;
 
 		checkForNewCTAPIToken(slot);
 	}
 
+	free(ports);
 	FUNC_RETURNS(CKR_OK);
 }
 
@@ -48,6 +48,8 @@
 #include <pkcs11/strbpcpy.h>
 #include <pkcs11/crc32.h>
 
+#include <common/thread.h>
+
 #ifdef DEBUG
 #include <pkcs11/debug.h>
 #endif
@@ -68,9 +70,44 @@
 
 extern struct p11Context_t *context;
 
+/*
+ * Number of threads used to probe slots for tokens concurrently. The default can be
+ * changed up to MAX_PROBE_THREADS with the environment variable PKCS11_PROBE_THREADS.
+ */
+#define DEFAULT_PROBE_THREADS	8
+#define MAX_PROBE_THREADS		16
+
+/*
+ * All slots share the PC/SC contexts. Cards are connected using the global context,
+ * except during concurrent probing, where each additional thread uses a context of its own.
+ * The contexts are released when the last slot is closed.
+ */
 static SCARDCONTEXT globalContext = 0;
+static SCARDCONTEXT workerContext[MAX_PROBE_THREADS - 1];
 static int slotCounter = 0;
 
+/*
+ * Slots to be probed by the worker pool in probePCSCSlots()
+ */
+struct probeJob {
+	struct p11Slot_t *slot;           /**< Slot to probe for a token           */
+	int rc;                           /**< Result of probePCSCToken()          */
+	int closeRequired;                /**< Slot failed and must be closed      */
+};
+
+struct probeQueue {
+	MUTEX lock;                       /**< Protects next                       */
+	struct probeJob *jobs;            /**< Jobs in slot id order               */
+	int count;                        /**< Number of jobs                      */
+	int next;                         /**< Next job to be taken by a worker    */
+};
+
+struct probeThread {
+	struct probeQueue *queue;         /**< Queue shared by all workers         */
+	SCARDCONTEXT context;             /**< Context used to connect cards       */
+	THREAD thread;                    /**< Thread handle                       */
+};
+
 #ifdef DEBUG
 
 char* pcsc_error_to_string(const LONG error) {
@@ -374,9 +411,14 @@ int transmitVerifyPinAPDUviaPCSC(struct p11Slot_t *slot,
 
 
 /**
- * checkForNewPCSCToken looks into a specific slot for a token.
+ * probePCSCToken looks into a specific slot for a token.
+ *
+ * The function only changes the slot passed as argument, so that it can be called
+ * concurrently for different slots. Closing a failed slot is left to the caller.
  *
  * @param slot       Pointer to slot structure.
+ * @param hContext   The PC/SC context used to connect the card
+ * @param closeRequired Set to TRUE if the reader failed and the slot must be closed
  *
  * @return
  *                   <P><TABLE>
@@ -395,7 +437,7 @@ int transmitVerifyPinAPDUviaPCSC(struct p11Slot_t *slot,
  *                   </TR>
  *                   </TABLE></P>
  */
-static int checkForNewPCSCToken(struct p11Slot_t *slot)
+static int probePCSCToken(struct p11Slot_t *slot, SCARDCONTEXT hContext, int *closeRequired)
 {
 	struct p11Token_t *ptoken;
 	int rc, i;
@@ -409,10 +451,14 @@ static int checkForNewPCSCToken(struct p11Slot_t *slot)
 
 	FUNC_CALLED();
 
+	*closeRequired = FALSE;
+
 	if (slot->closed) {
 		FUNC_RETURNS(CKR_TOKEN_NOT_PRESENT);
 	}
 
+	slot->context = hContext;
+
 	rv = SCardConnect(slot->context, slot->readername, SCARD_SHARE_SHARED, SCARD_PROTOCOL_T1, &(slot->card), &dwActiveProtocol);
 
 #ifdef DEBUG
@@ -424,7 +470,7 @@ static int checkForNewPCSCToken(struct p11Slot_t *slot)
 	}
 
 	if (rv != SCARD_S_SUCCESS) {
-		closeSlot(slot);
+		*closeRequired = TRUE;
 		FUNC_FAILS(CKR_DEVICE_ERROR, pcsc_error_to_string(rv));
 	}
 
@@ -469,7 +515,7 @@ static int checkForNewPCSCToken(struct p11Slot_t *slot)
 	rc = SCardStatus(slot->card, NULL, &readernamelen, &state, &protocol, atr, &atrlen);
 
 	if (rc != SCARD_S_SUCCESS) {
-		closeSlot(slot);
+		*closeRequired = TRUE;
 		FUNC_FAILS(CKR_DEVICE_ERROR, pcsc_error_to_string(rc));
 	}
 
@@ -484,6 +530,30 @@ static int checkForNewPCSCToken(struct p11Slot_t *slot)
 
 
 
+/**
+ * checkForNewPCSCToken looks into a specific slot for a token and closes the
+ * slot if the reader failed.
+ *
+ * @param slot       Pointer to slot structure.
+ * @return           CKR_OK, CKR_TOKEN_NOT_PRESENT or any other Cryptoki error code
+ */
+static int checkForNewPCSCToken(struct p11Slot_t *slot)
+{
+	int rc, closeRequired;
+
+	FUNC_CALLED();
+
+	rc = probePCSCToken(slot, globalContext, &closeRequired);
+
+	if (closeRequired) {
+		closeSlot(slot);
+	}
+
+	FUNC_RETURNS(rc);
+}
+
+
+
 /**
  * checkForRemovedPCSCToken looks into a specific slot for a removed token.
  *
@@ -665,6 +735,269 @@ int matchFilter(char *value, char *filter)
 
 
 
+/**
+ * Worker thread taking slots from the probe queue until the queue is empty
+ *
+ * @param arg        The probe thread
+ * @return           NULL
+ */
+static void *probeWorker(void *arg)
+{
+	struct probeThread *pt = (struct probeThread *)arg;
+	struct probeQueue *queue = pt->queue;
+	struct probeJob *job;
+
+	while (1) {
+		mutex_lock(&queue->lock);
+		job = queue->next < queue->count ? &queue->jobs[queue->next++] : NULL;
+		mutex_unlock(&queue->lock);
+
+		if (!job)
+			break;
+
+		job->rc = probePCSCToken(job->slot, pt->context, &job->closeRequired);
+	}
+
+	return NULL;
+}
+
+
+
+/**
+ * Determine the number of probe threads
+ *
+ * Slots are probed sequentially in the calling thread if the application
+ * does not allow the library to create threads.
+ *
+ * @param count      Number of slots to be probed
+ * @return           Number of threads, including the calling thread
+ */
+static int getProbeThreads(int count)
+{
+	char *po;
+	int threads;
+
+	if ((context != NULL) && context->noThreads)
+		return 1;
+
+	threads = DEFAULT_PROBE_THREADS;
+
+	po = getenv("PKCS11_PROBE_THREADS");
+	if (po) {
+		threads = atoi(po);
+#ifdef DEBUG
+		debug("PKCS11_PROBE_THREADS=%s\n", po);
+#endif
+	}
+
+	if (threads < 1)
+		threads = 1;
+
+	if (threads > MAX_PROBE_THREADS)
+		threads = MAX_PROBE_THREADS;
+
+	return threads < count ? threads : count;
+}
+
+
+
+/**
+ * Get the PC/SC context for an additional probe thread, establishing it on first use
+ *
+ * @param index      Index of the additional thread
+ * @param hContext   The context
+ * @return           CKR_OK or CKR_DEVICE_ERROR
+ */
+static int getWorkerContext(int index, SCARDCONTEXT *hContext)
+{
+	LONG rc;
+
+	if (!workerContext[index]) {
+		rc = SCardEstablishContext(SCARD_SCOPE_SYSTEM, NULL, NULL, &workerContext[index]);
+
+#ifdef DEBUG
+		debug("SCardEstablishContext (worker %d): %s\n", index, pcsc_error_to_string(rc));
+#endif
+
+		if (rc != SCARD_S_SUCCESS) {
+			workerContext[index] = 0;
+			return CKR_DEVICE_ERROR;
+		}
+	}
+
+	*hContext = workerContext[index];
+	return CKR_OK;
+}
+
+
+
+/**
+ * Release the global context and all worker contexts
+ */
+static void releaseContexts()
+{
+	int i;
+
+	for (i = 0; i < MAX_PROBE_THREADS - 1; i++) {
+		if (workerContext[i]) {
+			SCardReleaseContext(workerContext[i]);
+			workerContext[i] = 0;
+		}
+	}
+
+	if (globalContext) {
+#ifdef DEBUG
+		debug("Releasing global PC/SC context\n");
+#endif
+		SCardReleaseContext(globalContext);
+		globalContext = 0;
+	}
+}
+
+
+
+/**
+ * Probe slots for tokens using a bounded pool of worker threads
+ *
+ * Card connect, feature probing and loading the objects from the token
+ * is done concurrently for all slots, so that the time required is about
+ * that of the slowest token. The calling thread works the queue as well,
+ * so probing continues serially if no threads can be created.
+ *
+ * @param jobs       The slots to probe
+ * @param count      Number of slots
+ */
+static void runProbeJobs(struct probeJob *jobs, int count)
+{
+	struct probeQueue queue;
+	struct probeThread *pt;
+	int i, cnt, started;
+
+	FUNC_CALLED();
+
+	queue.jobs = jobs;
+	queue.count = count;
+	queue.next = 0;
+
+	cnt = getProbeThreads(count);
+	pt = NULL;
+
+	if (cnt > 1) {
+		pt = (struct probeThread *)calloc(cnt, sizeof(struct probeThread));
+	}
+
+	if ((pt == NULL) || (mutex_init(&queue.lock) != 0)) {
+		for (i = 0; i < count; i++) {
+			jobs[i].rc = probePCSCToken(jobs[i].slot, globalContext, &jobs[i].closeRequired);
+		}
+		free(pt);
+		return;
+	}
+
+	pt[0].queue = &queue;
+	pt[0].context = globalContext;
+
+	for (started = 1; started < cnt; started++) {
+		pt[started].queue = &queue;
+
+		if (getWorkerContext(started - 1, &pt[started].context) != CKR_OK)
+			break;
+
+		if (thread_create(&pt[started].thread, probeWorker, &pt[started]) != 0)
+			break;
+	}
+
+#ifdef DEBUG
+	debug("Probing %d slots with %d threads\n", count, started);
+#endif
+
+	probeWorker(&pt[0]);
+
+	for (i = 1; i < started; i++) {
+		thread_join(&pt[i].thread);
+	}
+
+	free(pt);
+	mutex_destroy(&queue.lock);
+}
+
+
+
+/**
+ * Probe all slots without a token concurrently
+ *
+ * Cards are connected lazily on the first token query for a slot. This function
+ * allows to query all slots at once, e.g. in C_GetSlotList() with tokenPresent set,
+ * rather than probing slot after slot.
+ *
+ * Virtual slots allocated during probing are added to the pool after all workers
+ * completed.
+ *
+ * @param pool       Pointer to slot-pool structure.
+ * @return           CKR_OK or CKR_HOST_MEMORY
+ */
+int probePCSCSlots(struct p11SlotPool_t *pool)
+{
+	struct p11Slot_t *slot, *vslot;
+	struct probeJob *jobs;
+	int i, j, count;
+
+	FUNC_CALLED();
+
+	count = 0;
+	for (slot = pool->list; slot; slot = slot->next) {
+		if (!slot->primarySlot && !slot->closed && !slot->token)
+			count++;
+	}
+
+	if (count == 0) {
+		FUNC_RETURNS(CKR_OK);
+	}
+
+	jobs = (struct probeJob *)calloc(count, sizeof(struct probeJob));
+
+	if (jobs == NULL) {
+		FUNC_FAILS(CKR_HOST_MEMORY, "Out of memory");
+	}
+
+	i = 0;
+	for (slot = pool->list; slot; slot = slot->next) {
+		if (!slot->primarySlot && !slot->closed && !slot->token) {
+			slot->pending = TRUE;
+			jobs[i++].slot = slot;
+		}
+	}
+
+	runProbeJobs(jobs, count);
+
+	for (i = 0; i < count; i++) {
+		slot = jobs[i].slot;
+		slot->pending = FALSE;
+
+		for (j = 0; j < slot->virtualSlotsSize; j++) {
+			vslot = slot->virtualSlots[j];
+			if (vslot && vslot->pending) {
+				vslot->pending = FALSE;
+				addSlot(pool, vslot);
+			}
+		}
+
+		if (jobs[i].closeRequired) {
+			closeSlot(slot);
+		}
+
+#ifdef DEBUG
+		debug("Probed slot (%lu, %s) - rc=%d\n", slot->id, slot->readername, jobs[i].rc);
+#endif
+	}
+
+	free(jobs);
+
+	FUNC_RETURNS(CKR_OK);
+}
+
+
+
 int updatePCSCSlots(struct p11SlotPool_t *pool)
 {
 	struct p11Slot_t *slot,*vslot;
@@ -742,7 +1075,7 @@ int updatePCSCSlots(struct p11SlotPool_t *pool)
 		slot = pool->list;
 		match = FALSE;
 		while (slot) {
-			if (strncmp(slot->readername, p, strlen(p)) == 0) {
+			if (!slot->primarySlot && (strncmp(slot->readername, p, strlen(p)) == 0)) {
 				match = TRUE;
 				break;
 			}
@@ -752,7 +1085,10 @@ int updatePCSCSlots(struct p11SlotPool_t *pool)
 		/* Skip the reader as we already have a slot for it */
 		if (match) {
 			p += strlen(p) + 1;
-			slot->closed = FALSE;
+			if (slot->closed) {
+				slot->closed = FALSE;
+				slotCounter++;
+			}
 			continue;
 		}
 
@@ -778,18 +1114,7 @@ int updatePCSCSlots(struct p11SlotPool_t *pool)
 		if (filter)
 			slot->id = crc32(0, p, strlen(p));
 
-		rc = SCardEstablishContext(SCARD_SCOPE_SYSTEM, NULL, NULL, &(slot->context));
-
-#ifdef DEBUG
-		debug("SCardEstablishContext: %s\n", pcsc_error_to_string(rc));
-#endif
-
-		if (rc != SCARD_S_SUCCESS) {
-			free(slot);
-			free(readers);
-			FUNC_FAILS(CKR_DEVICE_ERROR, "Could not establish context to PC/SC manager");
-		}
-
+		/* The card is connected with the shared context on first use */
 		slotCounter++;
 
 		strbpcpy(slot->info.slotDescription,
@@ -827,33 +1152,31 @@ int updatePCSCSlots(struct p11SlotPool_t *pool)
 			slot->maxCAPDU = 1000;
 		}
 
-		addSlot(&context->slotPool, slot);
+		addSlot(pool, slot);
 
 #ifdef DEBUG
 		debug("Added slot (%lu, %s) - slot counter is %i\n", slot->id, slot->readername, slotCounter);
 #endif
 
-		// The PREALLOCATE option creates two additional virtual slots per card reader.
-		// This is required for Firefox/NSS which sets the friendly flag only for slots that are
-		// already present during the first C_GetSlotList
+		// The PREALLOCATE option creates additional virtual slots per card reader, two unless
+		// a number is given. This is required for Firefox/NSS which sets the friendly flag only
+		// for slots that are already present during the first C_GetSlotList
 		prealloc = getenv("PKCS11_PREALLOCATE_VIRTUAL_SLOTS");
 		if (prealloc) {
-			vslotcnt = *prealloc;
-			if ((vslotcnt == '1') || (vslotcnt == '2')) {
-				vslotcnt -= '0';
-			} else {
+			vslotcnt = atoi(prealloc);
+			if (vslotcnt <= 0) {
 				vslotcnt = 2;
+			} else if (vslotcnt > VIRTUAL_SLOTS_MAX) {
+				vslotcnt = VIRTUAL_SLOTS_MAX;
 			}
 #ifdef DEBUG
-			debug("Pre-allocate virtual slots '' %d\n", prealloc, vslotcnt);
+			debug("Pre-allocate virtual slots '%s' %d\n", prealloc, vslotcnt);
 #endif
 			for (i = 0; i < vslotcnt; i++) {
 				getVirtualSlot(slot, i, &vslot);
 			}
 		}
 
-		checkForNewPCSCToken(slot);
-
 		p += strlen(p) + 1;
 	}
 
@@ -874,43 +1197,32 @@ int closePCSCSlot(struct p11Slot_t *slot)
 	debug("Trying to close slot (%i, %s)\n", slot->id, slot->readername);
 #endif
 
-	slotCounter--;
-
-	if (slotCounter == 0 && globalContext) {
-#ifdef DEBUG
-		debug("Releasing global PC/SC context\n");
-#endif
-		rc = SCardReleaseContext(globalContext);
-
-#ifdef DEBUG
-		debug("SCardReleaseContext (%i, %s): %s\n", slot->id, slot->readername, pcsc_error_to_string(rc));
-#endif
-
-		globalContext = 0;
-	}
-
-	/* No token in slot */
-	if (!slot->card) {
-		slot->closed = TRUE;
+	if (slot->closed) {
 		FUNC_RETURNS(CKR_OK);
 	}
 
-	rc = SCardDisconnect(slot->card, SCARD_UNPOWER_CARD);
+	if (slot->card) {
+		rc = SCardDisconnect(slot->card, SCARD_UNPOWER_CARD);
 
 #ifdef DEBUG
-	debug("SCardDisconnect (%i, %s): %s\n", slot->id, slot->readername, pcsc_error_to_string(rc));
-	debug("Releasing slot specific PC/SC context - slot counter is %i\n", slotCounter);
+		debug("SCardDisconnect (%i, %s): %s\n", slot->id, slot->readername, pcsc_error_to_string(rc));
 #endif
+	}
+
+	slot->context = 0;
+	slot->card = 0;
+	slot->closed = TRUE;
 
-	rc = SCardReleaseContext(slot->context);
+	slotCounter--;
 
 #ifdef DEBUG
-	debug("SCardReleaseContext (%i, %s): %s\n", slot->id, slot->readername, pcsc_error_to_string(rc));
+	debug("Closed slot - slot counter is %i\n", slotCounter);
 #endif
 
-	slot->context = 0;
-	slot->card = 0;
-	slot->closed = TRUE;
+	/* Cards must be disconnected before the context is released */
+	if (slotCounter == 0) {
+		releaseContexts();
+	}
 
 	FUNC_RETURNS(CKR_OK);
 }
@@ -120,6 +120,7 @@ int getPCSCToken(struct p11Slot_t *slot, struct p11Token_t **token);
 int lockPCSCSlot(struct p11Slot_t *slot);
 int unlockPCSCSlot(struct p11Slot_t *slot);
 int updatePCSCSlots(struct p11SlotPool_t *pool);
+int probePCSCSlots(struct p11SlotPool_t *pool);
 int closePCSCSlot(struct p11Slot_t *slot);
 
 #endif
@@ -31,6 +31,8 @@
  * @brief   Slot implementation dispatching for PC/SC or CT-API reader
  */
 
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include <common/memset_s.h>
@@ -40,6 +42,8 @@
 #include <pkcs11/token.h>
 #include <pkcs11/slotpool.h>
 #include <pkcs11/session.h>
+#include <pkcs11/slotqueue.h>
+#include <pkcs11/slotrandom.h>
 
 #ifdef DEBUG
 #include <pkcs11/debug.h>
@@ -123,11 +127,14 @@ int removeToken(struct p11Slot_t *slot)
 
 	if (!slot->primarySlot) {
 		// Remove token from associated virtual slots
-		for (i = 0; i < sizeof(slot->virtualSlots) / sizeof(slot->virtualSlots[0]); i++) {
+		for (i = 0; i < slot->virtualSlotsSize; i++) {
 			if (slot->virtualSlots[i]) {
 				removeToken(slot->virtualSlots[i]);
 			}
 		}
+
+		// Do not continue with entropy from the removed token
+		resetSlotRandom(slot);
 	}
 
 	if (slot->removedToken) {
@@ -293,15 +300,9 @@ int transmitAPDU(struct p11Slot_t *slot,
 		FUNC_FAILS(rc, "Encoding APDU failed");
 	}
 
-#ifdef CTAPI
-	rc = transmitAPDUviaCTAPI(slot, 0,
-			apdu, rc,
-			apdu, sizeof(apdu));
-#else
-	rc = transmitAPDUviaPCSC(slot,
+	rc = queueAPDU(slot,
 			apdu, rc,
 			apdu, sizeof(apdu));
-#endif
 
 	if (rc >= 2) {
 		*SW1SW2 = (apdu[rc - 2] << 8) | apdu[rc - 1];
@@ -314,6 +315,7 @@ int transmitAPDU(struct p11Slot_t *slot,
 			memcpy(InData, apdu, rc);
 		}
 	} else {
+		slot->transmitErrors++;
 		rc = -1;
 	}
 
@@ -381,6 +383,10 @@ int transmitVerifyPinAPDU(struct p11Slot_t *slot,
 			pinblockstring, pinlengthformat,
 			apdu, rc,
 			apdu, sizeof(apdu));
+
+	if (rc < 2) {
+		slot->transmitErrors++;
+	}
 #endif
 
 	if (rc >= 2) {
@@ -409,24 +415,67 @@ void appendStr(CK_UTF8CHAR_PTR dest, int destlen, char *str)
 
 
 
+/**
+ * Grow the list of virtual slots of the slot to the given number of entries
+ *
+ * The list grows as virtual slots are created, so that virtual slots can be
+ * accessed by index in constant time.
+ *
+ * @param slot       The primary slot
+ * @param count      The number of virtual slots
+ * @return           CKR_OK, CKR_ARGUMENTS_BAD or CKR_HOST_MEMORY
+ */
+static int reserveVirtualSlots(struct p11Slot_t *slot, int count)
+{
+	struct p11Slot_t **list;
+
+	FUNC_CALLED();
+
+	if (slot->primarySlot)
+		FUNC_FAILS(CKR_ARGUMENTS_BAD, "Slot is a virtual slot");
+
+	if (count <= slot->virtualSlotsSize)
+		FUNC_RETURNS(CKR_OK);
+
+	list = (struct p11Slot_t **)realloc(slot->virtualSlots, count * sizeof(struct p11Slot_t *));
+
+	if (list == NULL)
+		FUNC_FAILS(CKR_HOST_MEMORY, "Out of memory");
+
+	memset(list + slot->virtualSlotsSize, 0, (count - slot->virtualSlotsSize) * sizeof(struct p11Slot_t *));
+
+	slot->virtualSlots = list;
+	slot->virtualSlotsSize = count;
+
+	FUNC_RETURNS(CKR_OK);
+}
+
+
+
 int getVirtualSlot(struct p11Slot_t *slot, int index, struct p11Slot_t **vslot)
 {
 	struct p11Slot_t *newslot;
-	char postfix[3];
+	char postfix[8];
+	int rc;
 
 	FUNC_CALLED();
 
-	if ((index < 0) || (index > sizeof(slot->virtualSlots) / sizeof(*slot->virtualSlots)))
-		FUNC_FAILS(CKR_ARGUMENTS_BAD, "Index must not exceed size of virtual slot list");
+	if ((index < 0) || (index >= VIRTUAL_SLOTS_MAX))
+		FUNC_FAILS(CKR_ARGUMENTS_BAD, "Index out of range");
 
 	if (slot->primarySlot)
 		FUNC_FAILS(CKR_ARGUMENTS_BAD, "Slot is a virtual slot");
 
-	if (slot->virtualSlots[index]) {
+	if ((index < slot->virtualSlotsSize) && slot->virtualSlots[index]) {
 		*vslot = slot->virtualSlots[index];
 		FUNC_RETURNS(CKR_OK);
 	}
 
+	rc = reserveVirtualSlots(slot, index + 1);
+
+	if (rc != CKR_OK)
+		FUNC_FAILS(rc, "Could not extend list of virtual slots");
+
 	newslot = (struct p11Slot_t *) calloc(1, sizeof(struct p11Slot_t));
 
 	if (newslot == NULL)
@@ -436,20 +485,30 @@ int getVirtualSlot(struct p11Slot_t *slot, int index, struct p11Slot_t **vslot)
 	newslot->token = NULL;
 	newslot->next = NULL;
 	newslot->primarySlot = slot;
-
-	/* If we already have a pre-allocated slot id, then assign the next id value */
-	if (slot->id != 0)
-		newslot->id = slot->id + index + 1;
+	newslot->virtualSlots = NULL;
+	newslot->virtualSlotsSize = 0;
+	newslot->id = 0;
+
+	/* If we already have a pre-allocated slot id, then assign the next id value. Ids of
+	 * further virtual slots are derived from the primary slot id, so that they do not
+	 * depend on the order in which virtual slots of different cards are created */
+	if (slot->id != 0) {
+		if (index < VIRTUAL_SLOT_IDS) {
+			newslot->id = slot->id + index + 1;
+		} else {
+			newslot->id = VIRTUAL_SLOT_ID_EXTENDED | ((slot->id & 0x7FFFFF) << 8) | index;
+		}
+	}
 
 	slot->virtualSlots[index] = newslot;
 
-	postfix[0] = '.';
-	postfix[1] = '2' + index;
-	postfix[2] = 0;
+	snprintf(postfix, sizeof(postfix), ".%d", index + 2);
 
 	appendStr(newslot->info.slotDescription, sizeof(slot->info.slotDescription), postfix);
 
-	addSlot(&context->slotPool, newslot);
+	/* Virtual slots of a slot still being probed are added together with the slot */
+	if (!slot->pending)
+		addSlot(&context->slotPool, newslot);
 
 	*vslot = newslot;
 	FUNC_RETURNS(CKR_OK);
@@ -593,6 +652,39 @@ int updateSlots(struct p11SlotPool_t *pool)
 
 
 
+/**
+ * Check all slots without a token for a newly inserted token
+ *
+ * Slots that still have no token afterwards need not be queried again.
+ *
+ * @param pool       Pointer to slot-pool structure.
+ * @return           CKR_OK or any other Cryptoki error code
+ */
+int probeSlots(struct p11SlotPool_t *pool)
+{
+#ifdef CTAPI
+	struct p11Slot_t *slot;
+	struct p11Token_t *token;
+#endif
+	int rc;
+
+	FUNC_CALLED();
+
+#ifdef CTAPI
+	for (slot = pool->list; slot; slot = slot->next) {
+		if (!slot->primarySlot && !slot->token)
+			getCTAPIToken(slot, &token);
+	}
+	rc = CKR_OK;
+#else
+	rc = probePCSCSlots(pool);
+#endif
+
+	FUNC_RETURNS(rc);
+}
+
+
+
 int closeSlot(struct p11Slot_t *slot)
 {
 	int rc;
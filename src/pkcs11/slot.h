@@ -60,6 +60,7 @@ int findSlotKey(struct p11Slot_t *slot, CK_OBJECT_HANDLE handle, struct p11Objec
 int lockSlot(struct p11Slot_t *slot);
 int unlockSlot(struct p11Slot_t *slot);
 int updateSlots(struct p11SlotPool_t *pool);
+int probeSlots(struct p11SlotPool_t *pool);
 int closeSlot(struct p11Slot_t *slot);
 int addToken(struct p11Slot_t *slot, struct p11Token_t *token);
 int removeToken(struct p11Slot_t *slot);
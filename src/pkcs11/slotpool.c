@@ -39,6 +39,8 @@
 #include <pkcs11/slotpool.h>
 #include <pkcs11/slot.h>
 #include <pkcs11/token.h>
+#include <pkcs11/slotqueue.h>
+#include <pkcs11/slotrandom.h>
 #include <pkcs11/debug.h>
 
 extern struct p11Context_t *context;
@@ -48,7 +50,7 @@ extern struct p11Context_t *context;
 /**
  * initSlotPool initializes the slot-pool structure.
  *
- * Call CT_init with increasing port number to determine number of readers attached
+ * Determine the attached readers and create a slot for each
  *
  * Token found in a slot are added to specific slot structure for later use.
  *
@@ -117,6 +119,11 @@ int terminateSlotPool(struct p11SlotPool_t *pool)
 		}
 
 		closeSlot(pSlot);
+		terminateSlotQueue(pSlot);
+		terminateSlotRandom(pSlot);
+
+		if (!pSlot->primarySlot && pSlot->virtualSlots)
+			free(pSlot->virtualSlots);
 
 		pFreeSlot = pSlot;
 		pSlot = pSlot->next;
@@ -128,6 +135,25 @@ int terminateSlotPool(struct p11SlotPool_t *pool)
 
 
 
+/**
+ * Assign the next slot id from the pool, unless the slot already has an id.
+ *
+ * Slots that are prepared outside the pool receive their id in the order of
+ * creation, so that ids remain stable if the slot is added later.
+ *
+ * @param pool       Pointer to slot-pool structure.
+ * @param slot       Pointer to slot structure.
+ */
+void assignSlotID(struct p11SlotPool_t *pool, struct p11Slot_t *slot)
+{
+	if (slot->id == 0) {
+		slot->id = pool->nextSlotID;
+		pool->nextSlotID += VIRTUAL_SLOT_IDS + 1;
+	}
+}
+
+
+
 /**
  * addSlot adds a slot to the slot-pool.
  *
@@ -159,10 +185,11 @@ int addSlot(struct p11SlotPool_t *pool, struct p11Slot_t *slot)
 	pool->numberOfSlots++;
 
 	/* Slot id might have been set during slot creation */
-	if (slot->id == 0) {
-		slot->id = pool->nextSlotID;
-		pool->nextSlotID += 4;
-	}
+	assignSlotID(pool, slot);
+
+	/* Without a queue the slot transmits on the calling thread */
+	initSlotQueue(slot);
+	initSlotRandom(slot);
 
 	FUNC_RETURNS(CKR_OK);
 }
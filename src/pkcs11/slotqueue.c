@@ -0,0 +1,276 @@
+/**
+ * SmartCard-HSM PKCS#11 Module
+ *
+ * Copyright (c) 2013, CardContact Systems GmbH, Minden, Germany
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of CardContact Systems GmbH nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CardContact Systems GmbH BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file    slotqueue.c
+ * @brief   First-in first-out access to the card in a slot
+ *
+ * Each physical slot owns a queue that hands the card to callers in order of arrival,
+ * using a ticket lock. Callers encode the command APDU and decode the response on their
+ * own thread, so that host processing for the next request overlaps with the card
+ * working on the current one. Transmitting on the calling thread saves the handoff to
+ * and from a separate thread, so the queue needs no worker of its own.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <time.h>
+#endif
+
+#include <common/thread.h>
+
+#include <pkcs11/p11generic.h>
+#include <pkcs11/slotqueue.h>
+
+#ifdef DEBUG
+#include <pkcs11/debug.h>
+#endif
+
+#ifdef CTAPI
+#include "slot-ctapi.h"
+#else
+#include "slot-pcsc.h"
+#endif
+
+
+
+/**
+ * Ticket lock and statistics of a slot
+ */
+struct p11SlotQueue_t {
+	MUTEX mutex;                      /**< Protects all fields below           */
+	COND turn;                        /**< Signalled if the next ticket is served */
+	unsigned long nextTicket;         /**< Ticket drawn by the next caller     */
+	unsigned long serving;            /**< Ticket that owns the card           */
+	CK_ULONG maxQueued;               /**< Maximum of requests waiting or in progress */
+	CK_ULONG commands;                /**< Number of APDUs processed           */
+	unsigned long long created;       /**< Time queue was created in us        */
+	unsigned long long busy;          /**< Time card was busy in us            */
+};
+
+
+
+/*
+ * Monotonic time in microseconds
+ */
+static unsigned long long now()
+{
+#ifdef _WIN32
+	LARGE_INTEGER freq, count;
+
+	QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&count);
+	return (unsigned long long)(count.QuadPart / freq.QuadPart) * 1000000 +
+			(unsigned long long)(count.QuadPart % freq.QuadPart) * 1000000 / freq.QuadPart;
+#else
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#endif
+}
+
+
+
+/*
+ * Transmit the APDU on the calling thread
+ */
+static int transmitDirect(struct p11Slot_t *slot,
+		unsigned char *capdu, size_t capdu_len,
+		unsigned char *rapdu, size_t rapdu_len)
+{
+#ifdef CTAPI
+	return transmitAPDUviaCTAPI(slot, 0, capdu, capdu_len, rapdu, rapdu_len);
+#else
+	return transmitAPDUviaPCSC(slot, capdu, capdu_len, rapdu, rapdu_len);
+#endif
+}
+
+
+
+/**
+ * Create the queue for a physical slot. Virtual slots use the queue of the primary slot.
+ *
+ * @param slot       The slot
+ * @return           CKR_OK or CKR_HOST_MEMORY
+ */
+int initSlotQueue(struct p11Slot_t *slot)
+{
+	struct p11SlotQueue_t *queue;
+
+	FUNC_CALLED();
+
+	if (slot->primarySlot || slot->queue)
+		FUNC_RETURNS(CKR_OK);
+
+	queue = (struct p11SlotQueue_t *)calloc(1, sizeof(struct p11SlotQueue_t));
+
+	if (queue == NULL)
+		FUNC_FAILS(CKR_HOST_MEMORY, "Out of memory");
+
+	if (mutex_init(&queue->mutex) != 0) {
+		free(queue);
+		FUNC_FAILS(CKR_HOST_MEMORY, "Could not create mutex");
+	}
+
+	if (cond_init(&queue->turn) != 0) {
+		mutex_destroy(&queue->mutex);
+		free(queue);
+		FUNC_FAILS(CKR_HOST_MEMORY, "Could not create condition");
+	}
+
+	queue->created = now();
+
+	slot->queue = queue;
+
+	FUNC_RETURNS(CKR_OK);
+}
+
+
+
+/**
+ * Release the queue of a physical slot
+ *
+ * @param slot       The slot
+ */
+void terminateSlotQueue(struct p11Slot_t *slot)
+{
+	struct p11SlotQueue_t *queue;
+
+	if (slot->primarySlot || (slot->queue == NULL))
+		return;
+
+	queue = slot->queue;
+
+	cond_destroy(&queue->turn);
+	mutex_destroy(&queue->mutex);
+	free(queue);
+
+	slot->queue = NULL;
+}
+
+
+
+/**
+ * Transmit an encoded command APDU once all earlier callers are served and wait for the response
+ *
+ * Slots without a queue transmit immediately.
+ *
+ * @param slot       The slot, virtual slots are mapped to the primary slot
+ * @param capdu      The command APDU
+ * @param capdu_len  The length of the command APDU
+ * @param rapdu      The buffer for the response APDU
+ * @param rapdu_len  The size of the response buffer
+ * @return           -1 for error or length of received response APDU
+ */
+int queueAPDU(struct p11Slot_t *slot,
+		unsigned char *capdu, size_t capdu_len,
+		unsigned char *rapdu, size_t rapdu_len)
+{
+	struct p11SlotQueue_t *queue;
+	unsigned long ticket;
+	unsigned long long start;
+	int rc;
+
+	if (slot->primarySlot)
+		slot = slot->primarySlot;
+
+	queue = slot->queue;
+
+	if (queue == NULL)
+		return transmitDirect(slot, capdu, capdu_len, rapdu, rapdu_len);
+
+	mutex_lock(&queue->mutex);
+
+	ticket = queue->nextTicket++;
+
+	if (queue->nextTicket - queue->serving > queue->maxQueued)
+		queue->maxQueued = queue->nextTicket - queue->serving;
+
+	while (ticket != queue->serving) {
+		cond_wait(&queue->turn, &queue->mutex);
+	}
+
+	mutex_unlock(&queue->mutex);
+
+	start = now();
+	rc = transmitDirect(slot, capdu, capdu_len, rapdu, rapdu_len);
+
+	mutex_lock(&queue->mutex);
+
+	queue->busy += now() - start;
+	queue->commands++;
+
+	// All waiters check whether their ticket is next
+	queue->serving++;
+	cond_broadcast(&queue->turn);
+
+	mutex_unlock(&queue->mutex);
+
+	return rc;
+}
+
+
+
+/**
+ * Return the utilisation of the card in the slot since the slot was added
+ *
+ * @param slot       The slot, virtual slots report the primary slot
+ * @param pStatistics The structure receiving the statistics
+ * @return           CKR_OK
+ */
+int getSlotQueueStatistics(struct p11Slot_t *slot, SC_SLOT_STATISTICS_PTR pStatistics)
+{
+	struct p11SlotQueue_t *queue;
+	unsigned long long elapsed;
+
+	if (slot->primarySlot)
+		slot = slot->primarySlot;
+
+	memset(pStatistics, 0, sizeof(SC_SLOT_STATISTICS));
+
+	queue = slot->queue;
+
+	if (queue == NULL)
+		return CKR_OK;
+
+	mutex_lock(&queue->mutex);
+
+	elapsed = now() - queue->created;
+
+	pStatistics->ulCommands = queue->commands;
+	pStatistics->ulBusyTime = (CK_ULONG)(queue->busy / 1000);
+	pStatistics->ulIdleTime = (CK_ULONG)((elapsed > queue->busy ? elapsed - queue->busy : 0) / 1000);
+	pStatistics->ulQueueLength = queue->nextTicket - queue->serving;
+	pStatistics->ulMaxQueueLength = queue->maxQueued;
+
+	mutex_unlock(&queue->mutex);
+
+	return CKR_OK;
+}
@@ -0,0 +1,494 @@
+/**
+ * SmartCard-HSM PKCS#11 Module
+ *
+ * Copyright (c) 2013, CardContact Systems GmbH, Minden, Germany
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of CardContact Systems GmbH nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CardContact Systems GmbH BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file    slotrandom.c
+ * @brief   Random number generator per slot, seeded from the token
+ *
+ * C_GenerateRandom is served from a Hash_DRBG owned by the physical slot. The
+ * generator is instantiated and reseeded with entropy from the token, which is
+ * fetched with GET CHALLENGE in blocks of up to ENTROPY_BLOCK bytes and kept in a
+ * pool, so that a single APDU feeds several reseeds. Requests are served in the
+ * host without card communication.
+ *
+ * The generator is reseeded after PKCS11_RANDOM_RESEED_BYTES bytes have been
+ * generated or PKCS11_RANDOM_RESEED_SECONDS seconds have passed since the last
+ * reseed, whatever comes first. A value of 0 disables the criterion.
+ *
+ * Entropy left in the pool is discarded and the generator is reseeded if the token
+ * is removed or the process forked, so that neither a different token nor the child
+ * process continue with the state seeded for the previous one.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+#include <common/mutex.h>
+#include <common/memset_s.h>
+#include <common/securemem.h>
+
+#include <pkcs11/p11generic.h>
+#include <pkcs11/slot.h>
+#include <pkcs11/slotrandom.h>
+#include <pkcs11/drbg.h>
+#include <pkcs11/random.h>
+
+#ifdef DEBUG
+#include <pkcs11/debug.h>
+#endif
+
+
+
+#define ENTROPY_BLOCK               256                 /* Bytes requested with one GET CHALLENGE       */
+#define MIN_CHALLENGE               8                   /* Size every token supports for GET CHALLENGE  */
+#define NONCE_LEN                   (DRBG_SECURITY_STRENGTH / 2)
+#define DEFAULT_RESEED_BYTES        (1024 * 1024)
+#define DEFAULT_RESEED_SECONDS      300
+
+
+
+/**
+ * Generator and entropy pool of a slot. Allocated in secure memory.
+ */
+struct p11SlotRandom_t {
+	MUTEX mutex;                      /**< Protects all fields below           */
+	struct hashDrbg drbg;             /**< The generator                       */
+	int instantiated;                 /**< Generator has been seeded           */
+	unsigned char pool[ENTROPY_BLOCK];/**< Entropy from the token not yet used */
+	int poolAvail;                    /**< Number of bytes in pool             */
+	int challengeSize;                /**< Le used for GET CHALLENGE           */
+	unsigned long long generated;     /**< Bytes generated since last reseed   */
+	time_t seeded;                    /**< Time of last reseed                 */
+	unsigned long long reseedBytes;   /**< Reseed after this number of bytes   */
+	long reseedSeconds;               /**< Reseed after this number of seconds */
+	int reseedForced;                 /**< Reseed with the next request        */
+#ifndef _WIN32
+	pid_t pid;                        /**< Process that seeded the generator   */
+#endif
+};
+
+
+
+/*
+ * Largest GET CHALLENGE supported by the reader
+ */
+static int getChallengeSize(struct p11Slot_t *slot)
+{
+	if (slot->maxRAPDU > MIN_CHALLENGE + 2 && slot->maxRAPDU - 2 < ENTROPY_BLOCK)
+		return slot->maxRAPDU - 2;
+
+	return ENTROPY_BLOCK;
+}
+
+
+
+/*
+ * Wipe the entropy remaining in the pool and force a reseed with the next request
+ */
+static void discardEntropy(struct p11SlotRandom_t *rnd)
+{
+	memset_s(rnd->pool, sizeof(rnd->pool), 0, sizeof(rnd->pool));
+	rnd->poolAvail = 0;
+	rnd->reseedForced = 1;
+}
+
+
+
+/*
+ * Refill the entropy pool with GET CHALLENGE. The size of the challenge is reduced
+ * if the token rejects the length.
+ */
+static int fillEntropyPool(struct p11Slot_t *slot, struct p11SlotRandom_t *rnd)
+{
+	struct p11Token_t *token;
+	unsigned short SW1SW2;
+	int rc, size;
+
+	token = slot->token;
+
+	while (1) {
+		size = rnd->challengeSize;
+
+		// Do not interleave with a command sequence of the token driver
+		if (token && token->drv->lock)
+			token->drv->lock(token);
+
+		rc = transmitAPDU(slot, 0x00, 0x84, 0x00, 0x00,
+				0, NULL,
+				size == 256 ? 0 : size, rnd->pool, size, &SW1SW2);
+
+		if (token && token->drv->unlock)
+			token->drv->unlock(token);
+
+		if (rc < 0) {
+			FUNC_FAILS(CKR_DEVICE_ERROR, "transmitAPDU failed");
+		}
+
+		if (SW1SW2 == 0x9000)
+			break;
+
+		if ((SW1SW2 & 0xFF00) == 0x6C00) {
+			size = SW1SW2 & 0xFF ? SW1SW2 & 0xFF : 256;
+		} else {
+			size = MIN_CHALLENGE;
+		}
+
+		if ((size >= rnd->challengeSize) || (size == 0)) {
+			FUNC_FAILS(CKR_RANDOM_NO_RNG, "Token does not support GET CHALLENGE");
+		}
+
+		rnd->challengeSize = size;
+	}
+
+	if (rc == 0) {
+		FUNC_FAILS(CKR_RANDOM_NO_RNG, "Token returned no random data");
+	}
+
+	rnd->poolAvail = rc;
+	return CKR_OK;
+}
+
+
+
+/*
+ * Take entropy from the pool, refilling it from the token as required
+ */
+static int takeEntropy(struct p11Slot_t *slot, struct p11SlotRandom_t *rnd, unsigned char *buf, int len)
+{
+	int rc, l;
+
+	while (len > 0) {
+		if (rnd->poolAvail == 0) {
+			rc = fillEntropyPool(slot, rnd);
+			if (rc != CKR_OK)
+				return rc;
+		}
+
+		l = len < rnd->poolAvail ? len : rnd->poolAvail;
+		rnd->poolAvail -= l;
+		memcpy(buf, rnd->pool + rnd->poolAvail, l);
+		memset_s(rnd->pool + rnd->poolAvail, l, 0, l);
+		buf += l;
+		len -= l;
+	}
+
+	return CKR_OK;
+}
+
+
+
+/*
+ * Instantiate or reseed the generator with entropy from the token. Random data from the host
+ * is mixed in as personalization string or additional input.
+ */
+static int reseed(struct p11Slot_t *slot, struct p11SlotRandom_t *rnd, unsigned char *add, size_t addLen)
+{
+	unsigned char entropy[DRBG_SECURITY_STRENGTH + NONCE_LEN];
+	unsigned char hostRandom[DRBG_SECURITY_STRENGTH + sizeof(CK_SLOT_ID) + sizeof(time_t)];
+	size_t hostLen;
+	time_t t;
+	int rc;
+
+	rc = takeEntropy(slot, rnd, entropy, rnd->instantiated ? DRBG_SECURITY_STRENGTH : sizeof(entropy));
+
+	if (rc != CKR_OK) {
+		memset_s(entropy, sizeof(entropy), 0, sizeof(entropy));
+		return rc;
+	}
+
+	t = time(NULL);
+
+	if (!rnd->instantiated) {
+		hostLen = 0;
+		if (getHostRandom(hostRandom, DRBG_SECURITY_STRENGTH) == 0)
+			hostLen = DRBG_SECURITY_STRENGTH;
+		memcpy(hostRandom + hostLen, &slot->id, sizeof(CK_SLOT_ID));
+		hostLen += sizeof(CK_SLOT_ID);
+		memcpy(hostRandom + hostLen, &t, sizeof(time_t));
+		hostLen += sizeof(time_t);
+
+		drbgInstantiate(&rnd->drbg,
+				entropy, DRBG_SECURITY_STRENGTH,
+				entropy + DRBG_SECURITY_STRENGTH, NONCE_LEN,
+				hostRandom, hostLen);
+		rnd->instantiated = 1;
+	} else {
+		if ((addLen == 0) && (getHostRandom(hostRandom, DRBG_SECURITY_STRENGTH) == 0)) {
+			add = hostRandom;
+			addLen = DRBG_SECURITY_STRENGTH;
+		}
+
+		drbgReseed(&rnd->drbg, entropy, DRBG_SECURITY_STRENGTH, add, addLen);
+	}
+
+	rnd->generated = 0;
+	rnd->seeded = t;
+	rnd->reseedForced = 0;
+#ifndef _WIN32
+	rnd->pid = getpid();
+#endif
+
+	memset_s(entropy, sizeof(entropy), 0, sizeof(entropy));
+	memset_s(hostRandom, sizeof(hostRandom), 0, sizeof(hostRandom));
+	return CKR_OK;
+}
+
+
+
+/*
+ * Discard the state inherited from the parent after fork(), which the parent continues to use
+ */
+static void checkFork(struct p11SlotRandom_t *rnd)
+{
+#ifndef _WIN32
+	if (rnd->instantiated && (rnd->pid != getpid()))
+		discardEntropy(rnd);
+#endif
+}
+
+
+
+/*
+ * Determine if the reseed interval or byte budget is exhausted
+ */
+static int reseedRequired(struct p11SlotRandom_t *rnd)
+{
+	if (rnd->reseedForced)
+		return 1;
+
+	if (rnd->reseedBytes && (rnd->generated >= rnd->reseedBytes))
+		return 1;
+
+	if (rnd->reseedSeconds && (time(NULL) - rnd->seeded >= rnd->reseedSeconds))
+		return 1;
+
+	return 0;
+}
+
+
+
+/**
+ * Create the generator for a physical slot. Virtual slots use the generator of the primary slot.
+ *
+ * The generator is seeded with the first request, as the slot may not contain a token yet.
+ *
+ * @param slot       The slot
+ * @return           CKR_OK or CKR_HOST_MEMORY
+ */
+int initSlotRandom(struct p11Slot_t *slot)
+{
+	struct p11SlotRandom_t *rnd;
+	char *po;
+
+	FUNC_CALLED();
+
+	if (slot->primarySlot || slot->random)
+		FUNC_RETURNS(CKR_OK);
+
+	rnd = (struct p11SlotRandom_t *)secureAlloc(sizeof(struct p11SlotRandom_t));
+
+	if (rnd == NULL)
+		FUNC_FAILS(CKR_HOST_MEMORY, "Out of memory");
+
+	if (mutex_init(&rnd->mutex) != 0) {
+		secureFree(rnd);
+		FUNC_FAILS(CKR_HOST_MEMORY, "Could not create mutex");
+	}
+
+	rnd->challengeSize = getChallengeSize(slot);
+
+	rnd->reseedBytes = DEFAULT_RESEED_BYTES;
+	po = getenv("PKCS11_RANDOM_RESEED_BYTES");
+	if (po)
+		rnd->reseedBytes = strtoull(po, NULL, 10);
+
+	rnd->reseedSeconds = DEFAULT_RESEED_SECONDS;
+	po = getenv("PKCS11_RANDOM_RESEED_SECONDS");
+	if (po)
+		rnd->reseedSeconds = atol(po);
+
+	slot->random = rnd;
+
+	FUNC_RETURNS(CKR_OK);
+}
+
+
+
+/**
+ * Wipe and release the generator of a physical slot
+ *
+ * @param slot       The slot
+ */
+void terminateSlotRandom(struct p11Slot_t *slot)
+{
+	struct p11SlotRandom_t *rnd;
+
+	if (slot->primarySlot || (slot->random == NULL))
+		return;
+
+	rnd = slot->random;
+	mutex_destroy(&rnd->mutex);
+	secureFree(rnd);
+
+	slot->random = NULL;
+}
+
+
+
+/**
+ * Generate random data from the generator of the slot
+ *
+ * The generator is instantiated with the first request and reseeded from the
+ * token if the reseed interval or byte budget is exhausted.
+ *
+ * @param slot       The slot, virtual slots are mapped to the primary slot
+ * @param buf        The buffer receiving the random data
+ * @param len        The number of bytes
+ * @return           CKR_OK or any other Cryptoki error code
+ */
+int generateSlotRandom(struct p11Slot_t *slot, unsigned char *buf, size_t len)
+{
+	struct p11SlotRandom_t *rnd;
+	size_t l;
+	int rc;
+
+	FUNC_CALLED();
+
+	if (slot->primarySlot)
+		slot = slot->primarySlot;
+
+	rnd = slot->random;
+
+	if (rnd == NULL)
+		FUNC_FAILS(CKR_RANDOM_NO_RNG, "Slot has no random number generator");
+
+	mutex_lock(&rnd->mutex);
+
+	checkFork(rnd);
+
+	rc = CKR_OK;
+	if (!rnd->instantiated || reseedRequired(rnd))
+		rc = reseed(slot, rnd, NULL, 0);
+
+	while ((rc == CKR_OK) && (len > 0)) {
+		l = len < DRBG_MAX_REQUEST ? len : DRBG_MAX_REQUEST;
+
+		if (drbgGenerate(&rnd->drbg, buf, l, NULL, 0) < 0) {
+			rc = reseed(slot, rnd, NULL, 0);
+			continue;
+		}
+
+		rnd->generated += l;
+		buf += l;
+		len -= l;
+
+		if ((len > 0) && reseedRequired(rnd))
+			rc = reseed(slot, rnd, NULL, 0);
+	}
+
+	mutex_unlock(&rnd->mutex);
+
+	if (rc != CKR_OK)
+		FUNC_FAILS(rc, "Seeding the generator failed");
+
+	FUNC_RETURNS(CKR_OK);
+}
+
+
+
+/**
+ * Mix seed material from the application into the generator of the slot
+ *
+ * The seed is used as additional input for a reseed with entropy from the token,
+ * so it can not reduce the quality of the generated data.
+ *
+ * @param slot       The slot, virtual slots are mapped to the primary slot
+ * @param seed       The seed material
+ * @param len        The length of the seed material
+ * @return           CKR_OK or any other Cryptoki error code
+ */
+int seedSlotRandom(struct p11Slot_t *slot, unsigned char *seed, size_t len)
+{
+	struct p11SlotRandom_t *rnd;
+	int rc;
+
+	FUNC_CALLED();
+
+	if (slot->primarySlot)
+		slot = slot->primarySlot;
+
+	rnd = slot->random;
+
+	if (rnd == NULL)
+		FUNC_FAILS(CKR_RANDOM_NO_RNG, "Slot has no random number generator");
+
+	mutex_lock(&rnd->mutex);
+
+	checkFork(rnd);
+
+	rc = CKR_OK;
+	if (!rnd->instantiated)
+		rc = reseed(slot, rnd, NULL, 0);
+
+	if (rc == CKR_OK)
+		rc = reseed(slot, rnd, seed, len);
+
+	mutex_unlock(&rnd->mutex);
+
+	if (rc != CKR_OK)
+		FUNC_FAILS(rc, "Seeding the generator failed");
+
+	FUNC_RETURNS(CKR_OK);
+}
+
+
+
+/**
+ * Discard the entropy taken from the token and reseed the generator of the slot with
+ * the next request, e.g. after the token was removed
+ *
+ * @param slot       The slot, virtual slots are ignored
+ */
+void resetSlotRandom(struct p11Slot_t *slot)
+{
+	struct p11SlotRandom_t *rnd;
+
+	if (slot->primarySlot || (slot->random == NULL))
+		return;
+
+	rnd = slot->random;
+
+	mutex_lock(&rnd->mutex);
+	discardEntropy(rnd);
+	rnd->challengeSize = getChallengeSize(slot);
+	mutex_unlock(&rnd->mutex);
+}
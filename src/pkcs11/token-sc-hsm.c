@@ -34,6 +34,9 @@
 #include <string.h>
 #include <ctype.h>
 
+#include <common/memset_s.h>
+#include <common/securemem.h>
+
 #include "token-sc-hsm.h"
 
 #include <pkcs11/slot.h>
@@ -45,6 +48,8 @@
 #include <pkcs11/strbpcpy.h>
 #include <pkcs11/asn1.h>
 #include <pkcs11/pkcs15.h>
+#include <pkcs11/hashsign.h>
+#include <pkcs11/rsa.h>
 #include <pkcs11/debug.h>
 
 
@@ -61,11 +66,21 @@ static const CK_MECHANISM_TYPE p11MechanismList[] = {
 		CKM_RSA_X_509,
 		CKM_RSA_PKCS,
 		CKM_SHA1_RSA_PKCS,
+		CKM_SHA224_RSA_PKCS,
 		CKM_SHA256_RSA_PKCS,
+		CKM_SHA384_RSA_PKCS,
+		CKM_SHA512_RSA_PKCS,
 		CKM_SHA1_RSA_PKCS_PSS,
+		CKM_SHA224_RSA_PKCS_PSS,
 		CKM_SHA256_RSA_PKCS_PSS,
+		CKM_SHA384_RSA_PKCS_PSS,
+		CKM_SHA512_RSA_PKCS_PSS,
 		CKM_ECDSA,
-		CKM_ECDSA_SHA1
+		CKM_ECDSA_SHA1,
+		CKM_ECDSA_SHA224,
+		CKM_ECDSA_SHA256,
+		CKM_ECDSA_SHA384,
+		CKM_ECDSA_SHA512
 };
 
 
@@ -187,12 +202,22 @@ static int getSignatureSize(CK_MECHANISM_TYPE mech, struct p11Object_t *pObject)
 	case CKM_RSA_X_509:
 	case CKM_RSA_PKCS:
 	case CKM_SHA1_RSA_PKCS:
+	case CKM_SHA224_RSA_PKCS:
 	case CKM_SHA256_RSA_PKCS:
+	case CKM_SHA384_RSA_PKCS:
+	case CKM_SHA512_RSA_PKCS:
 	case CKM_SHA1_RSA_PKCS_PSS:
+	case CKM_SHA224_RSA_PKCS_PSS:
 	case CKM_SHA256_RSA_PKCS_PSS:
+	case CKM_SHA384_RSA_PKCS_PSS:
+	case CKM_SHA512_RSA_PKCS_PSS:
 		return pObject->keysize >> 3;
 	case CKM_ECDSA:
 	case CKM_ECDSA_SHA1:
+	case CKM_ECDSA_SHA224:
+	case CKM_ECDSA_SHA256:
+	case CKM_ECDSA_SHA384:
+	case CKM_ECDSA_SHA512:
 		return pObject->keysize >> 2;
 	default:
 		return -1;
@@ -226,6 +251,31 @@ static int getAlgorithmIdForSigning(CK_MECHANISM_TYPE mech)
 
 
 
+/*
+ * Mechanisms without a matching algorithm in the SmartCard-HSM. The hash is calculated in
+ * the host and signed with ALGO_RSA_RAW or ALGO_EC_RAW, so only the hash is sent to the card.
+ */
+static int sc_hsm_isHashedInHost(struct p11Object_t *pObject, CK_MECHANISM_TYPE mech)
+{
+	switch(mech) {
+	case CKM_SHA224_RSA_PKCS:
+	case CKM_SHA384_RSA_PKCS:
+	case CKM_SHA512_RSA_PKCS:
+	case CKM_SHA224_RSA_PKCS_PSS:
+	case CKM_SHA384_RSA_PKCS_PSS:
+	case CKM_SHA512_RSA_PKCS_PSS:
+	case CKM_ECDSA_SHA224:
+	case CKM_ECDSA_SHA256:
+	case CKM_ECDSA_SHA384:
+	case CKM_ECDSA_SHA512:
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+
+
 static int getAlgorithmIdForDecryption(CK_MECHANISM_TYPE mech)
 {
 	switch(mech) {
@@ -315,6 +365,10 @@ static int sc_hsm_C_SignInit(struct p11Object_t *pObject, CK_MECHANISM_PTR mech)
 
 	FUNC_CALLED();
 
+	if (sc_hsm_isHashedInHost(pObject, mech->mechanism)) {
+		FUNC_RETURNS(checkHashSignParameter(mech));
+	}
+
 	algo = getAlgorithmIdForSigning(mech->mechanism);
 	if (algo < 0) {
 		FUNC_FAILS(CKR_MECHANISM_INVALID, "Mechanism not supported");
@@ -349,7 +403,8 @@ static int sc_hsm_C_Sign(struct p11Object_t *pObject, CK_MECHANISM_TYPE mech, CK
 {
 	int rc, algo, signaturelen;
 	unsigned short SW1SW2;
-	unsigned char scr[256];
+	unsigned char scr[256], tbs[RSA_MAX_BYTES];
+	size_t tbsLen;
 	FUNC_CALLED();
 
 	rc = getSignatureSize(mech, pObject);
@@ -368,6 +423,17 @@ static int sc_hsm_C_Sign(struct p11Object_t *pObject, CK_MECHANISM_TYPE mech, CK
 		FUNC_FAILS(CKR_BUFFER_TOO_SMALL, "Signature length is larger than buffer");
 	}
 
+	if (sc_hsm_isHashedInHost(pObject, mech)) {
+		rc = hashSign(mech, pObject->keysize, pData, ulDataLen, tbs, &tbsLen);
+		if (rc != CKR_OK) {
+			FUNC_FAILS(rc, "Hashing in the host failed");
+		}
+
+		rc = sc_hsm_C_Sign(pObject, getHashSignRawMechanism(mech), tbs, tbsLen, pSignature, pulSignatureLen);
+		memset_s(tbs, sizeof(tbs), 0, sizeof(tbs));
+		FUNC_RETURNS(rc);
+	}
+
 	algo = getAlgorithmIdForSigning(mech);
 	if (algo < 0) {
 		FUNC_FAILS(CKR_MECHANISM_INVALID, "Mechanism not supported");
@@ -572,10 +638,7 @@ static int addEECertificateAndKeyObjects(struct p11Token_t *token, unsigned char
 		FUNC_FAILS(CKR_DEVICE_ERROR, "Could not create private key object");
 	}
 
-	p11prikey->C_SignInit = sc_hsm_C_SignInit;
-	p11prikey->C_Sign = sc_hsm_C_Sign;
-	p11prikey->C_DecryptInit = sc_hsm_C_DecryptInit;
-	p11prikey->C_Decrypt = sc_hsm_C_Decrypt;
+	p11prikey->ops = token->drv->privateKeyOps;
 
 	p11prikey->tokenid = (int)id;
 	p11prikey->keysize = p11cert->keysize;
@@ -875,6 +938,7 @@ static int sc_hsm_initpin(struct p11Slot_t *slot, unsigned char *pin, int pinlen
 	rc = transmitAPDU(slot, 0x00, 0x2C, pinlen ? 0x00 : 0x01, 0x81,
 		pinlen + sizeof(sc->sopin), data,
 		0, NULL, 0, &SW1SW2);
+	memset_s(data, sizeof(data), 0, sizeof(data));
 
 	if (rc < 0) {
 		FUNC_FAILS(CKR_DEVICE_ERROR, "transmitAPDU failed");
@@ -1007,7 +1071,8 @@ int newSmartCardHSMToken(struct p11Slot_t *slot, struct p11Token_t **token)
 	}
 	pinstatus = rc;
 
-	ptoken = (struct p11Token_t *)calloc(sizeof(struct p11Token_t) + sizeof(struct token_sc_hsm), 1);
+	// Private data contains the SO-PIN, so keep it in locked memory
+	ptoken = (struct p11Token_t *)secureAlloc(sizeof(struct p11Token_t) + sizeof(struct token_sc_hsm));
 
 	if (ptoken == NULL) {
 		FUNC_FAILS(CKR_HOST_MEMORY, "Out of memory");
@@ -1028,7 +1093,7 @@ int newSmartCardHSMToken(struct p11Slot_t *slot, struct p11Token_t **token)
 	ptoken->info.ulMaxRwSessionCount = CK_EFFECTIVELY_INFINITE;
 	ptoken->info.ulSessionCount = CK_UNAVAILABLE_INFORMATION;
 
-	ptoken->info.flags = CKF_WRITE_PROTECTED | CKF_LOGIN_REQUIRED;
+	ptoken->info.flags = CKF_WRITE_PROTECTED | CKF_LOGIN_REQUIRED | CKF_RNG;
 
 	if (slot->hasFeatureVerifyPINDirect)
 		ptoken->info.flags |= CKF_PROTECTED_AUTHENTICATION_PATH;
@@ -1086,9 +1151,15 @@ static int getMechanismInfo(CK_MECHANISM_TYPE type, CK_MECHANISM_INFO_PTR pInfo)
 	case CKM_RSA_X_509:
 	case CKM_RSA_PKCS:
 	case CKM_SHA1_RSA_PKCS:
+	case CKM_SHA224_RSA_PKCS:
 	case CKM_SHA256_RSA_PKCS:
+	case CKM_SHA384_RSA_PKCS:
+	case CKM_SHA512_RSA_PKCS:
 	case CKM_SHA1_RSA_PKCS_PSS:
+	case CKM_SHA224_RSA_PKCS_PSS:
 	case CKM_SHA256_RSA_PKCS_PSS:
+	case CKM_SHA384_RSA_PKCS_PSS:
+	case CKM_SHA512_RSA_PKCS_PSS:
 		pInfo->flags = CKF_SIGN;
 		pInfo->flags |= CKF_HW|CKF_ENCRYPT|CKF_DECRYPT|CKF_GENERATE_KEY_PAIR;	// Quick fix for Peter Gutmann's cryptlib
 		pInfo->ulMinKeySize = 1024;
@@ -1097,6 +1168,10 @@ static int getMechanismInfo(CK_MECHANISM_TYPE type, CK_MECHANISM_INFO_PTR pInfo)
 
 	case CKM_ECDSA:
 	case CKM_ECDSA_SHA1:
+	case CKM_ECDSA_SHA224:
+	case CKM_ECDSA_SHA256:
+	case CKM_ECDSA_SHA384:
+	case CKM_ECDSA_SHA512:
 		pInfo->flags = CKF_SIGN;
 		pInfo->flags |= CKF_HW|CKF_VERIFY|CKF_GENERATE_KEY_PAIR; // Quick fix for Peter Gutmann's cryptlib
 		pInfo->ulMinKeySize = 192;
@@ -1114,6 +1189,29 @@ static int getMechanismInfo(CK_MECHANISM_TYPE type, CK_MECHANISM_INFO_PTR pInfo)
 
 
 
+static const struct p11ObjectOps sc_hsm_private_key_ops = {
+	NULL,					// int (*C_EncryptInit)  (struct p11Object_t *, CK_MECHANISM_PTR);
+	NULL,					// int (*C_Encrypt)      (struct p11Object_t *, CK_MECHANISM_TYPE, CK_BYTE_PTR, CK_ULONG, CK_BYTE_PTR, CK_ULONG_PTR);
+	NULL,					// int (*C_EncryptUpdate)(struct p11Object_t *, CK_MECHANISM_TYPE, CK_BYTE_PTR, CK_ULONG, CK_BYTE_PTR, CK_ULONG_PTR);
+	NULL,					// int (*C_EncryptFinal) (struct p11Object_t *, CK_MECHANISM_TYPE, CK_BYTE_PTR, CK_ULONG_PTR);
+
+	sc_hsm_C_DecryptInit,	// int (*C_DecryptInit)  (struct p11Object_t *, CK_MECHANISM_PTR);
+	sc_hsm_C_Decrypt,		// int (*C_Decrypt)      (struct p11Object_t *, CK_MECHANISM_TYPE, CK_BYTE_PTR, CK_ULONG, CK_BYTE_PTR, CK_ULONG_PTR);
+	NULL,					// int (*C_DecryptUpdate)(struct p11Object_t *, CK_MECHANISM_TYPE, CK_BYTE_PTR, CK_ULONG, CK_BYTE_PTR, CK_ULONG_PTR);
+	NULL,					// int (*C_DecryptFinal) (struct p11Object_t *, CK_MECHANISM_TYPE, CK_BYTE_PTR, CK_ULONG_PTR);
+
+	sc_hsm_C_SignInit,		// int (*C_SignInit)     (struct p11Object_t *, CK_MECHANISM_PTR);
+	sc_hsm_C_Sign,			// int (*C_Sign)         (struct p11Object_t *, CK_MECHANISM_TYPE, CK_BYTE_PTR, CK_ULONG, CK_BYTE_PTR, CK_ULONG_PTR);
+	NULL,					// int (*C_SignUpdate)   (struct p11Object_t *, CK_MECHANISM_TYPE, CK_BYTE_PTR, CK_ULONG);
+	NULL,					// int (*C_SignFinal)    (struct p11Object_t *, CK_MECHANISM_TYPE, CK_BYTE_PTR, CK_ULONG_PTR);
+
+	NULL,					// int (*C_SignBatch)    (struct p11Object_t *, CK_MECHANISM_TYPE, SC_SIGN_BATCH_ITEM_PTR, CK_ULONG);
+
+	sc_hsm_isHashedInHost	// int (*isHashedInHost) (struct p11Object_t *, CK_MECHANISM_TYPE);
+};
+
+
+
 struct p11TokenDriver *getSmartCardHSMTokenDriver()
 {
 	static struct p11TokenDriver sc_hsm_token = {
@@ -1121,7 +1219,6 @@ struct p11TokenDriver *getSmartCardHSMTokenDriver()
 		1,
 		MAX_EXT_APDU_LENGTH,
 		MAX_EXT_APDU_LENGTH,
-		0,
 		isCandidate,
 		newSmartCardHSMToken,
 		NULL,
@@ -1131,16 +1228,10 @@ struct p11TokenDriver *getSmartCardHSMTokenDriver()
 		sc_hsm_logout,
 		sc_hsm_initpin,
 		sc_hsm_setpin,
-
-		sc_hsm_C_DecryptInit,	// int (*C_DecryptInit)  (struct p11Object_t *, CK_MECHANISM_PTR);
-		sc_hsm_C_Decrypt,		// int (*C_Decrypt)      (struct p11Object_t *, CK_MECHANISM_TYPE, CK_BYTE_PTR, CK_ULONG, CK_BYTE_PTR, CK_ULONG_PTR);
-		NULL,					// int (*C_DecryptUpdate)(struct p11Object_t *, CK_MECHANISM_TYPE, CK_BYTE_PTR, CK_ULONG, CK_BYTE_PTR, CK_ULONG_PTR);
-		NULL,					// int (*C_DecryptFinal) (struct p11Object_t *, CK_MECHANISM_TYPE, CK_BYTE_PTR, CK_ULONG_PTR);
-
-		sc_hsm_C_SignInit,		// int (*C_SignInit)     (struct p11Object_t *, CK_MECHANISM_PTR);
-		sc_hsm_C_Sign,			// int (*C_Sign)         (struct p11Object_t *, CK_MECHANISM_TYPE, CK_BYTE_PTR, CK_ULONG, CK_BYTE_PTR, CK_ULONG_PTR);
-		NULL,					// int (*C_SignUpdate)   (struct p11Object_t *, CK_MECHANISM_TYPE, CK_BYTE_PTR, CK_ULONG);
-		NULL					// int (*C_SignFinal)    (struct p11Object_t *, CK_MECHANISM_TYPE, CK_BYTE_PTR, CK_ULONG_PTR);
+		NULL,
+		NULL,
+		NULL,
+		&sc_hsm_private_key_ops
 	};
 
 	return &sc_hsm_token;
@@ -398,24 +398,27 @@ static int getMechanismInfo(CK_MECHANISM_TYPE type, CK_MECHANISM_INFO_PTR pInfo)
 
 
 
-struct p11TokenDriver *getStarcosTokenDriver();
-
 struct p11TokenDriver *getSigntrust32TokenDriver()
 {
-	static struct p11TokenDriver starcos_token;
-
-	starcos_token = *getStarcosTokenDriver();
-
-	starcos_token.name = "3.2 SC32 ST";
-	starcos_token.version = 2;
-	starcos_token.maxCAPDU = 432;
-	starcos_token.maxRAPDU = 432;
-	starcos_token.maxHashBlock = 384;
-
-	starcos_token.isCandidate = isCandidate;
-	starcos_token.newToken = newSigntrust32Token;
-	starcos_token.getMechanismList = getMechanismList;
-	starcos_token.getMechanismInfo = getMechanismInfo;
+	static struct p11TokenDriver starcos_token = {
+		"3.2 SC32 ST",
+		2,
+		432,
+		432,
+		isCandidate,
+		newSigntrust32Token,
+		starcosFreeToken,
+		getMechanismList,
+		getMechanismInfo,
+		starcosLogin,
+		starcosLogout,
+		starcosInitPIN,
+		starcosSetPIN,
+		starcosLoadObjects,
+		starcosLock,
+		starcosUnlock,
+		&starcosPrivateKeyOps
+	};
 
 	return &starcos_token;
 }
@@ -327,17 +327,27 @@ static int newSigntrust35Token(struct p11Slot_t *slot, struct p11Token_t **token
 
 
 
-struct p11TokenDriver *getStarcosTokenDriver();
-
 struct p11TokenDriver *getSigntrust35TokenDriver()
 {
-	static struct p11TokenDriver starcos_token;
-
-	starcos_token = *getStarcosTokenDriver();
-
-	starcos_token.name = "3.5 ID ECC C1 ST";
-	starcos_token.isCandidate = isCandidate;
-	starcos_token.newToken = newSigntrust35Token;
+	static struct p11TokenDriver starcos_token = {
+		"3.5 ID ECC C1 ST",
+		5,
+		1920,
+		1920,
+		isCandidate,
+		newSigntrust35Token,
+		starcosFreeToken,
+		starcosGetMechanismList,
+		starcosGetMechanismInfo,
+		starcosLogin,
+		starcosLogout,
+		starcosInitPIN,
+		starcosSetPIN,
+		starcosLoadObjects,
+		starcosLock,
+		starcosUnlock,
+		&starcosPrivateKeyOps
+	};
 
 	return &starcos_token;
 }
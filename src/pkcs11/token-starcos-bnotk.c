@@ -301,17 +301,27 @@ static int newBNotKToken(struct p11Slot_t *slot, struct p11Token_t **token)
 
 
 
-struct p11TokenDriver *getStarcosTokenDriver();
-
 struct p11TokenDriver *getBNotKTokenDriver()
 {
-	static struct p11TokenDriver starcos_token;
-
-	starcos_token = *getStarcosTokenDriver();
-
-	starcos_token.name = "3.5ID ECC C1 BNK";
-	starcos_token.isCandidate = isCandidate;
-	starcos_token.newToken = newBNotKToken;
+	static struct p11TokenDriver starcos_token = {
+		"3.5ID ECC C1 BNK",
+		5,
+		1920,
+		1920,
+		isCandidate,
+		newBNotKToken,
+		starcosFreeToken,
+		starcosGetMechanismList,
+		starcosGetMechanismInfo,
+		starcosLogin,
+		starcosLogout,
+		starcosInitPIN,
+		starcosSetPIN,
+		starcosLoadObjects,
+		starcosLock,
+		starcosUnlock,
+		&starcosPrivateKeyOps
+	};
 
 	return &starcos_token;
 }
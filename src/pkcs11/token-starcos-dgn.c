@@ -257,6 +257,7 @@ static int esign_C_Sign(struct p11Object_t *pObject, CK_MECHANISM_TYPE mech, CK_
 	slot = pObject->token->slot;
 	starcosLock(pObject->token);
 	if (!slot->token) {
+		starcosUnlock(pObject->token);
 		FUNC_RETURNS(CKR_DEVICE_REMOVED);
 	}
 
@@ -283,18 +284,10 @@ static int esign_C_Sign(struct p11Object_t *pObject, CK_MECHANISM_TYPE mech, CK_
 	*d++ = 0x01;
 	*d++ = (unsigned char)pObject->tokenid;
 
-	rc = transmitAPDU(pObject->token->slot, 0x00, 0x22, 0x41, 0xA4,
-		d - scr, scr,
-		0, NULL, 0, &SW1SW2);
-
-	if (rc < 0) {
-		starcosUnlock(pObject->token);
-		FUNC_FAILS(CKR_DEVICE_ERROR, "transmitAPDU failed");
-	}
-
-	if (SW1SW2 != 0x9000) {
+	rc = starcosManageSE(pObject->token, 0xA4, scr, d - scr);
+	if (rc != CKR_OK) {
 		starcosUnlock(pObject->token);
-		FUNC_FAILS(CKR_DEVICE_ERROR, "MANAGE SE failed");
+		FUNC_FAILS(rc, "MANAGE SE failed");
 	}
 
 	rc = transmitAPDU(pObject->token->slot, 0x00, 0x88, 0x00, 0x00,
@@ -302,11 +295,13 @@ static int esign_C_Sign(struct p11Object_t *pObject, CK_MECHANISM_TYPE mech, CK_
 			0, pSignature, *pulSignatureLen, &SW1SW2);
 
 	if (rc < 0) {
+		starcosInvalidateSE(pObject->token);
 		starcosUnlock(pObject->token);
 		FUNC_FAILS(CKR_DEVICE_ERROR, "transmitAPDU failed");
 	}
 
 	if (SW1SW2 != 0x9000) {
+		starcosInvalidateSE(pObject->token);
 		starcosUnlock(pObject->token);
 		switch(SW1SW2) {
 		case 0x6A81:
@@ -322,7 +317,9 @@ static int esign_C_Sign(struct p11Object_t *pObject, CK_MECHANISM_TYPE mech, CK_
 	*pulSignatureLen = rc;
 
 	if ((pObject->token->user == CKU_USER) && (pObject->token->pinUseCounter == 1)) {
+		// The card resets the security status and environment after the single use of the PIN
 		pObject->token->user = INT_CKU_NO_USER;
+		starcosInvalidateSE(pObject->token);
 	}
 
 	starcosUnlock(pObject->token);
@@ -342,7 +339,55 @@ static int isCandidate(unsigned char *atr, size_t atrLen)
 
 
 struct p11TokenDriver *getDGNTokenDriver();
-struct p11TokenDriver *getStarcosTokenDriver();
+static int newDGNToken(struct p11Slot_t *slot, struct p11Token_t **token);
+
+
+
+/*
+ * Keys in the eSign application sign with esign_C_Sign()
+ */
+static const struct p11ObjectOps esign_private_key_ops = {
+	NULL,					// int (*C_EncryptInit)  (struct p11Object_t *, CK_MECHANISM_PTR);
+	NULL,					// int (*C_Encrypt)      (struct p11Object_t *, CK_MECHANISM_TYPE, CK_BYTE_PTR, CK_ULONG, CK_BYTE_PTR, CK_ULONG_PTR);
+	NULL,					// int (*C_EncryptUpdate)(struct p11Object_t *, CK_MECHANISM_TYPE, CK_BYTE_PTR, CK_ULONG, CK_BYTE_PTR, CK_ULONG_PTR);
+	NULL,					// int (*C_EncryptFinal) (struct p11Object_t *, CK_MECHANISM_TYPE, CK_BYTE_PTR, CK_ULONG_PTR);
+
+	starcos_C_DecryptInit,	// int (*C_DecryptInit)  (struct p11Object_t *, CK_MECHANISM_PTR);
+	starcos_C_Decrypt,		// int (*C_Decrypt)      (struct p11Object_t *, CK_MECHANISM_TYPE, CK_BYTE_PTR, CK_ULONG, CK_BYTE_PTR, CK_ULONG_PTR);
+	NULL,					// int (*C_DecryptUpdate)(struct p11Object_t *, CK_MECHANISM_TYPE, CK_BYTE_PTR, CK_ULONG, CK_BYTE_PTR, CK_ULONG_PTR);
+	NULL,					// int (*C_DecryptFinal) (struct p11Object_t *, CK_MECHANISM_TYPE, CK_BYTE_PTR, CK_ULONG_PTR);
+
+	starcos_C_SignInit,		// int (*C_SignInit)     (struct p11Object_t *, CK_MECHANISM_PTR);
+	esign_C_Sign,			// int (*C_Sign)         (struct p11Object_t *, CK_MECHANISM_TYPE, CK_BYTE_PTR, CK_ULONG, CK_BYTE_PTR, CK_ULONG_PTR);
+	NULL,					// int (*C_SignUpdate)   (struct p11Object_t *, CK_MECHANISM_TYPE, CK_BYTE_PTR, CK_ULONG);
+	NULL,					// int (*C_SignFinal)    (struct p11Object_t *, CK_MECHANISM_TYPE, CK_BYTE_PTR, CK_ULONG_PTR);
+
+	NULL,					// int (*C_SignBatch)    (struct p11Object_t *, CK_MECHANISM_TYPE, SC_SIGN_BATCH_ITEM_PTR, CK_ULONG);
+
+	NULL					// int (*isHashedInHost) (struct p11Object_t *, CK_MECHANISM_TYPE);
+};
+
+
+
+static struct p11TokenDriver esign_token = {
+	"3.5ID ECC C1 DGN",
+	5,
+	1920,
+	1920,
+	isCandidate,
+	newDGNToken,
+	starcosFreeToken,
+	starcosGetMechanismList,
+	starcosGetMechanismInfo,
+	starcosLogin,
+	starcosLogout,
+	starcosInitPIN,
+	starcosSetPIN,
+	starcosLoadObjects,
+	starcosLock,
+	starcosUnlock,
+	&esign_private_key_ops
+};
 
 
 /**
@@ -354,7 +399,6 @@ struct p11TokenDriver *getStarcosTokenDriver();
  */
 static int newDGNToken(struct p11Slot_t *slot, struct p11Token_t **token)
 {
-	static struct p11TokenDriver esign_token;
 	struct p11Token_t *ptoken;
 	struct p11TokenDriver *drv;
 	struct p11Slot_t *vslot;
@@ -362,12 +406,6 @@ static int newDGNToken(struct p11Slot_t *slot, struct p11Token_t **token)
 
 	FUNC_CALLED();
 
-	esign_token = *getStarcosTokenDriver();
-	esign_token.name = "3.5ID ECC C1 DGN";
-	esign_token.isCandidate = isCandidate;
-	esign_token.newToken = newDGNToken;
-	esign_token.C_Sign = esign_C_Sign;
-
 	rc = createStarcosToken(slot, &ptoken, &esign_token, &starcosApplications[1]);
 	if (rc != CKR_OK)
 		FUNC_FAILS(rc, "Base token creation failed");
@@ -403,13 +441,25 @@ static int newDGNToken(struct p11Slot_t *slot, struct p11Token_t **token)
 
 struct p11TokenDriver *getDGNTokenDriver()
 {
-	static struct p11TokenDriver starcos_token;
-
-	starcos_token = *getStarcosTokenDriver();
-
-	starcos_token.name = "3.5ID ECC C1 DGN";
-	starcos_token.isCandidate = isCandidate;
-	starcos_token.newToken = newDGNToken;
+	static struct p11TokenDriver starcos_token = {
+		"3.5ID ECC C1 DGN",
+		5,
+		1920,
+		1920,
+		isCandidate,
+		newDGNToken,
+		starcosFreeToken,
+		starcosGetMechanismList,
+		starcosGetMechanismInfo,
+		starcosLogin,
+		starcosLogout,
+		starcosInitPIN,
+		starcosSetPIN,
+		starcosLoadObjects,
+		starcosLock,
+		starcosUnlock,
+		&starcosPrivateKeyOps
+	};
 
 	return &starcos_token;
 }
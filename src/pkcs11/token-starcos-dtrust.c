@@ -32,6 +32,9 @@
  */
 
 #include <string.h>
+
+#include <common/securemem.h>
+
 #include "token-starcos.h"
 
 #include "bytestring.h"
@@ -193,6 +196,9 @@ static int isCandidate(unsigned char *atr, size_t atrLen)
 
 
 
+/*
+ * Load the objects of the application when the token is first used
+ */
 static int loadObjects(struct p11Token_t *token)
 {
 	struct starcosPrivateData *sc;
@@ -202,10 +208,18 @@ static int loadObjects(struct p11Token_t *token)
 
 	sc = starcosGetPrivateData(token);
 
+	starcosLock(token);
+
+	if (!token->objectsPending) {
+		starcosUnlock(token);
+		FUNC_RETURNS(CKR_OK);
+	}
+
 	// The D-Trust card stores certificates in a separate DF
 	rc = starcosSwitchApplication(token, &starcosApplications[2]);
 	if (rc != CKR_OK) {
-		FUNC_FAILS(rc, "Could not switch to DF.Certs");
+		starcosUnlock(token);
+		FUNC_FAILS(CKR_DEVICE_ERROR, "Could not switch to DF.Certs");
 	}
 
 	for (i = 0; i < sc->application->certsLen; i++) {
@@ -219,7 +233,14 @@ static int loadObjects(struct p11Token_t *token)
 		}
 	}
 
-	starcosSelectApplication(token);
+	rc = starcosSelectApplication(token);
+	if (rc < 0) {
+		// Drop the certificates, so that the next attempt does not add them twice
+		removeAllObjectsFromList(&token->tokenObjList);
+		token->numberOfTokenObjects = 0;
+		starcosUnlock(token);
+		FUNC_FAILS(CKR_DEVICE_ERROR, "selecting application failed");
+	}
 
 	for (i = 0; i < sc->application->privateKeysLen; i++) {
 		struct p15PrivateKeyDescription *p15 = &sc->application->privateKeys[i];
@@ -232,6 +253,9 @@ static int loadObjects(struct p11Token_t *token)
 		}
 	}
 
+	setTokenObjectsLoaded(token);
+
+	starcosUnlock(token);
 	FUNC_RETURNS(CKR_OK);
 }
 
@@ -252,7 +276,8 @@ static int createDTrustToken(struct p11Slot_t *slot, struct p11Token_t **token,
 
 	FUNC_CALLED();
 
-	ptoken = (struct p11Token_t *)calloc(sizeof(struct p11Token_t) + sizeof(struct starcosPrivateData), 1);
+	// Private data contains the SO-PIN, so keep it in locked memory
+	ptoken = (struct p11Token_t *)secureAlloc(sizeof(struct p11Token_t) + sizeof(struct starcosPrivateData));
 
 	if (ptoken == NULL) {
 		FUNC_FAILS(CKR_HOST_MEMORY, "Out of memory");
@@ -274,7 +299,7 @@ static int createDTrustToken(struct p11Slot_t *slot, struct p11Token_t **token,
 	ptoken->info.firmwareVersion.major = 3;
 	ptoken->info.firmwareVersion.minor = drv->version;
 
-	ptoken->info.flags = CKF_WRITE_PROTECTED;
+	ptoken->info.flags = CKF_WRITE_PROTECTED | CKF_RNG;
 	ptoken->user = INT_CKU_NO_USER;
 	ptoken->drv = drv;
 
@@ -282,7 +307,12 @@ static int createDTrustToken(struct p11Slot_t *slot, struct p11Token_t **token,
 	sc->selectedApplication = 0;
 	sc->application = application;
 
-	p11CreateMutex(&sc->mutex);
+	sc->hashLastRound = starcosHashLastRound();
+
+	if (starcosInitScheduler(ptoken) != CKR_OK) {
+		secureFree(ptoken);
+		FUNC_FAILS(CKR_HOST_MEMORY, "Out of memory");
+	}
 
 	strbpcpy(ptoken->info.label, sc->application->name, sizeof(ptoken->info.label));
 
@@ -310,12 +340,8 @@ static int createDTrustToken(struct p11Slot_t *slot, struct p11Token_t **token,
 	if (ptoken->pinUseCounter != 1)
 		ptoken->info.flags |= CKF_LOGIN_REQUIRED;
 
-	rc = loadObjects(ptoken);
-
-	if (rc < 0) {
-		drv->freeToken(ptoken);
-		FUNC_FAILS(CKR_DEVICE_ERROR, "Error loading objects from token");
-	}
+	// Objects are loaded when the token is first used, saving the SELECT and reads for unused applications
+	ptoken->objectsPending = TRUE;
 
 	rc = starcosCheckPINStatus(slot, sc->application->pinref);
 
@@ -446,23 +472,27 @@ static int getMechanismInfo(CK_MECHANISM_TYPE type, CK_MECHANISM_INFO_PTR pInfo)
 
 
 
-struct p11TokenDriver *getStarcosTokenDriver();
-
 struct p11TokenDriver *getDTrustTokenDriver()
 {
-	static struct p11TokenDriver token;
-
-	token = *getStarcosTokenDriver();
-
-	token.name = "3.4 QES C1 DTR";
-	token.version = 4;
-	token.maxCAPDU = 584;
-	token.maxRAPDU = 584;
-	token.maxHashBlock = 576;
-	token.isCandidate = isCandidate;
-	token.newToken = newDTrustToken,
-	token.getMechanismList = getMechanismList;
-	token.getMechanismInfo = getMechanismInfo;
+	static struct p11TokenDriver token = {
+		"3.4 QES C1 DTR",
+		4,
+		584,
+		584,
+		isCandidate,
+		newDTrustToken,
+		starcosFreeToken,
+		getMechanismList,
+		getMechanismInfo,
+		starcosLogin,
+		starcosLogout,
+		starcosInitPIN,
+		starcosSetPIN,
+		loadObjects,
+		starcosLock,
+		starcosUnlock,
+		&starcosPrivateKeyOps
+	};
 
 	return &token;
 }
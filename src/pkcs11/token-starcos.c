@@ -31,7 +31,13 @@
  * @brief   Basic Token implementation for a Starcos card
  */
 
+#include <stdlib.h>
 #include <string.h>
+
+#include <common/memset_s.h>
+#include <common/thread.h>
+#include <common/securemem.h>
+
 #include "token-starcos.h"
 
 #include "bytestring.h"
@@ -44,6 +50,7 @@
 #include <pkcs11/publickeyobject.h>
 #include <pkcs11/strbpcpy.h>
 #include <pkcs11/asn1.h>
+#include <pkcs11/digest.h>
 #include <pkcs11/pkcs15.h>
 #include <pkcs11/debug.h>
 
@@ -91,14 +98,140 @@ struct starcosPrivateData *starcosGetPrivateData(struct p11Token_t *token)
 
 
 
-void starcosLock(struct p11Token_t *token)
+/**
+ * Operation waiting for the card
+ */
+struct starcosWaiter {
+	int aidId;                        /**< Application used by the operation   */
+	int granted;                      /**< The operation owns the card         */
+	struct starcosWaiter *next;       /**< Next waiter in order of arrival     */
+};
+
+
+
+/**
+ * Scheduler serialising the operations on a card shared by several applications
+ */
+struct starcosScheduler {
+	MUTEX mutex;                      /**< Protects all fields below           */
+	COND released;                    /**< Signalled if the card was handed over */
+	int busy;                         /**< An operation owns the card          */
+	int limit;                        /**< Maximum number of times the oldest waiter is overtaken */
+	int overtaken;                    /**< Times the oldest waiter was overtaken so far */
+	struct starcosWaiter *first;      /**< Oldest waiter                       */
+	struct starcosWaiter *last;       /**< Youngest waiter                     */
+};
+
+
+
+/**
+ * Create the scheduler for the card. Only the scheduler of the token in the primary slot is used.
+ *
+ * The environment variable PKCS11_STARCOS_GROUP_LIMIT defines how often the oldest waiting
+ * operation may be overtaken by operations for the application currently selected. The
+ * default is 8, 0 serves operations strictly in order of arrival.
+ *
+ * Waiting operations block on a condition variable, which the locking call-backs in
+ * CK_C_INITIALIZE_ARGS can not provide. The scheduler therefore uses the native threading
+ * primitives, so applications sharing a STARCOS token between threads must call
+ * C_Initialize() with CKF_OS_LOCKING_OK.
+ *
+ * @param token     The token
+ * @return          CKR_OK or CKR_HOST_MEMORY
+ */
+int starcosInitScheduler(struct p11Token_t *token)
 {
 	struct starcosPrivateData *sc;
+	struct starcosScheduler *sched;
+	char *po;
+
+	sched = (struct starcosScheduler *)calloc(1, sizeof(struct starcosScheduler));
+
+	if (sched == NULL)
+		return CKR_HOST_MEMORY;
+
+	if (mutex_init(&sched->mutex) != 0) {
+		free(sched);
+		return CKR_HOST_MEMORY;
+	}
+
+	if (cond_init(&sched->released) != 0) {
+		mutex_destroy(&sched->mutex);
+		free(sched);
+		return CKR_HOST_MEMORY;
+	}
+
+	sched->limit = 8;
+
+	po = getenv("PKCS11_STARCOS_GROUP_LIMIT");
+	if (po && (atoi(po) >= 0)) {
+		sched->limit = atoi(po);
+	}
+
+	sc = starcosGetPrivateData(token);
+	sc->scheduler = sched;
+	return CKR_OK;
+}
+
+
+
+void starcosTerminateScheduler(struct p11Token_t *token)
+{
+	struct starcosPrivateData *sc;
+
+	sc = starcosGetPrivateData(token);
+
+	if (sc->scheduler == NULL)
+		return;
+
+	cond_destroy(&sc->scheduler->released);
+	mutex_destroy(&sc->scheduler->mutex);
+	free(sc->scheduler);
+	sc->scheduler = NULL;
+}
+
+
+
+/**
+ * Acquire the card for an operation of the token
+ *
+ * Operations wait in order of arrival. When the card is released, the first waiter for the
+ * application selected on the card takes over, saving a SELECT, unless the oldest waiter
+ * has been overtaken the configured number of times.
+ *
+ * @param token     The token in a primary or virtual slot
+ */
+void starcosLock(struct p11Token_t *token)
+{
+	struct starcosScheduler *sched;
+	struct starcosWaiter waiter;
 
 	FUNC_CALLED();
 
-	sc = starcosGetPrivateData(getBaseToken(token));
-	p11LockMutex(sc->mutex);
+	sched = starcosGetPrivateData(getBaseToken(token))->scheduler;
+
+	mutex_lock(&sched->mutex);
+
+	if (!sched->busy && (sched->first == NULL)) {
+		sched->busy = 1;
+	} else {
+		waiter.aidId = starcosGetPrivateData(token)->application->aidId;
+		waiter.granted = 0;
+		waiter.next = NULL;
+
+		if (sched->last) {
+			sched->last->next = &waiter;
+		} else {
+			sched->first = &waiter;
+		}
+		sched->last = &waiter;
+
+		while (!waiter.granted) {
+			cond_wait(&sched->released, &sched->mutex);
+		}
+	}
+
+	mutex_unlock(&sched->mutex);
 
 #ifdef DEBUG
 	debug("Lock released\n");
@@ -107,14 +240,58 @@ void starcosLock(struct p11Token_t *token)
 
 
 
+/**
+ * Release the card and hand it over to the next waiting operation
+ *
+ * @param token     The token in a primary or virtual slot
+ */
 void starcosUnlock(struct p11Token_t *token)
 {
 	struct starcosPrivateData *sc;
+	struct starcosScheduler *sched;
+	struct starcosWaiter *waiter, *prev;
 
 	FUNC_CALLED();
 
 	sc = starcosGetPrivateData(getBaseToken(token));
-	p11UnlockMutex(sc->mutex);
+	sched = sc->scheduler;
+
+	mutex_lock(&sched->mutex);
+
+	sched->busy = 0;
+
+	prev = NULL;
+	waiter = sched->first;
+
+	if ((waiter != NULL) && (waiter->aidId != sc->selectedApplication) && (sched->overtaken < sched->limit)) {
+		for (prev = waiter; (prev->next != NULL) && (prev->next->aidId != sc->selectedApplication); prev = prev->next);
+
+		if (prev->next != NULL) {
+			waiter = prev->next;
+			sched->overtaken++;
+		} else {
+			prev = NULL;
+		}
+	}
+
+	if (waiter != NULL) {
+		if (prev != NULL) {
+			prev->next = waiter->next;
+		} else {
+			sched->first = waiter->next;
+			sched->overtaken = 0;
+		}
+
+		if (sched->last == waiter) {
+			sched->last = prev;
+		}
+
+		waiter->granted = 1;
+		sched->busy = 1;
+		cond_broadcast(&sched->released);
+	}
+
+	mutex_unlock(&sched->mutex);
 }
 
 
@@ -139,6 +316,10 @@ int starcosSwitchApplication(struct p11Token_t *token, struct starcosApplication
 		return 0;
 	}
 
+	// Selecting an application resets the security environment
+	starcosInvalidateSE(token);
+	*sa = 0;
+
 	rc = transmitAPDU(token->slot, 0x00, 0xA4, 0x04, 0x0C,
 			application->aid.len, application->aid.val,
 			0, NULL, 0, &SW1SW2);
@@ -170,6 +351,103 @@ int starcosSelectApplication(struct p11Token_t *token)
 
 
 
+/**
+ * Set a control reference template in the security environment with MANAGE SE
+ *
+ * The templates set are remembered for the card, so that repeating the same MANAGE SE
+ * for a sequence of operations with the same key and algorithm is skipped. The templates
+ * are forgotten if any transmission to the card failed in the meantime.
+ *
+ * @param token     The token
+ * @param crt       The tag of the control reference template, e.g. 0xB6 for the DST
+ * @param data      The content of the template
+ * @param len       The length of the content
+ * @return          CKR_OK or CKR_DEVICE_ERROR
+ */
+int starcosManageSE(struct p11Token_t *token, unsigned char crt, unsigned char *data, int len)
+{
+	struct starcosPrivateData *sc;
+	struct starcosSETemplate *se, *unused;
+	unsigned short SW1SW2;
+	int rc, i;
+
+	FUNC_CALLED();
+
+	sc = starcosGetPrivateData(getBaseToken(token));
+
+	// A card reset or reconnect, e.g. detected by VERIFY, PIN status or GET CHALLENGE,
+	// clears the security environment on the card
+	if (sc->seTransmitErrors != getBaseToken(token)->slot->transmitErrors) {
+		starcosInvalidateSE(token);
+	}
+
+	se = NULL;
+	unused = NULL;
+	for (i = 0; i < STARCOS_SE_CACHE_SIZE; i++) {
+		if (sc->se[i].crt == crt) {
+			se = &sc->se[i];
+			break;
+		}
+		if ((unused == NULL) && (sc->se[i].crt == 0)) {
+			unused = &sc->se[i];
+		}
+	}
+
+	if ((se != NULL) && (se->len == len) && !memcmp(se->data, data, len)) {
+		FUNC_RETURNS(CKR_OK);
+	}
+
+	if (se == NULL) {
+		se = unused;
+	}
+
+	if (se != NULL) {
+		se->crt = 0;
+	}
+
+	rc = transmitAPDU(token->slot, 0x00, 0x22, 0x41, crt,
+		len, data,
+		0, NULL, 0, &SW1SW2);
+
+	if (rc < 0) {
+		starcosInvalidateSE(token);
+		FUNC_FAILS(CKR_DEVICE_ERROR, "transmitAPDU failed");
+	}
+
+	if (SW1SW2 != 0x9000) {
+		starcosInvalidateSE(token);
+		FUNC_FAILS(CKR_DEVICE_ERROR, "MANAGE SE failed");
+	}
+
+	if ((se != NULL) && (len <= sizeof(se->data))) {
+		se->crt = crt;
+		memcpy(se->data, data, len);
+		se->len = len;
+	}
+
+	FUNC_RETURNS(CKR_OK);
+}
+
+
+
+/**
+ * Forget the templates set in the security environment, e.g. after an error or a reset
+ *
+ * @param token     The token
+ */
+void starcosInvalidateSE(struct p11Token_t *token)
+{
+	struct p11Token_t *base;
+	struct starcosPrivateData *sc;
+
+	base = getBaseToken(token);
+	sc = starcosGetPrivateData(base);
+	memset(sc->se, 0, sizeof(sc->se));
+	sc->seTransmitErrors = base->slot->transmitErrors;
+}
+
+
+
 int starcosReadTLVEF(struct p11Token_t *token, bytestring fid, unsigned char *content, size_t len)
 {
 	int rc, le, ne, ofs, maxapdu;
@@ -320,7 +598,8 @@ int starcosUpdatePinStatus(struct p11Token_t *token, int pinstatus)
 
 int starcosDeterminePinUseCounter(struct p11Token_t *token, unsigned char recref, int *useCounter, int *lifeCycle)
 {
-	int rc,ucpathlen;
+	struct asn1Node nodes[128];		// Sufficient for a record of 256 bytes
+	int rc,ucpathlen,count,i;
 	unsigned short SW1SW2;
 	unsigned char rec[256], *p,*fid,*ucpath;
 	FUNC_CALLED();
@@ -362,27 +641,25 @@ int starcosDeterminePinUseCounter(struct p11Token_t *token, unsigned char recref
 	}
 
 	rc = asn1Encap(0x30, rec, rc);
-	rc = asn1Validate(rec, rc);
+	count = asn1Index(rec, rc, ucpathlen - 1, nodes, sizeof(nodes) / sizeof(*nodes));
 
-	if (rc > 0) {
-		FUNC_FAILS(rc, "ASN.1 structure invalid");
+	if (count < 0) {
+		FUNC_FAILS(count, "ASN.1 structure invalid");
 	}
 
 	*useCounter = 0;
-	p = asn1Find(rec, ucpath, ucpathlen);
+	i = asn1IndexFind(nodes, count, ucpath, ucpathlen);
 
-	if (p) {
-		asn1Tag(&p);
-		asn1Length(&p);
+	if (i >= 0) {
+		p = rec + nodes[i].value;
 
 		*useCounter = (*p == 0xFF ? 0 : *p);
 	}
 
-	p = asn1Find(rec, (unsigned char *)"\x30\x8A", 2);
+	i = asn1IndexFind(nodes, count, (unsigned char *)"\x30\x8A", 2);
 
-	if (p) {
-		asn1Tag(&p);
-		asn1Length(&p);
+	if (i >= 0) {
+		p = rec + nodes[i].value;
 
 		*lifeCycle = *p;
 	}
@@ -456,28 +733,33 @@ static int getAlgorithmIdForSigning(struct p11Token_t *token, CK_MECHANISM_TYPE
 
 
 
-static int getAlgorithmIdForDigest(struct p11Token_t *token, CK_MECHANISM_TYPE mech, unsigned char **algotlv)
+static int getAlgorithmIdForDigest(struct p11Token_t *token, CK_MECHANISM_TYPE mech, unsigned char **algotlv, CK_MECHANISM_TYPE *hash)
 {
 	switch(mech) {
 	case CKM_SHA1_RSA_PKCS:
 	case CKM_SHA1_RSA_PKCS_PSS:
 		*algotlv = algo_SHA1;
+		*hash = CKM_SHA_1;
 		break;
 	case CKM_SHA224_RSA_PKCS:
 	case CKM_SHA224_RSA_PKCS_PSS:
 		*algotlv = algo_SHA224;
+		*hash = CKM_SHA224;
 		break;
 	case CKM_SHA256_RSA_PKCS:
 	case CKM_SHA256_RSA_PKCS_PSS:
 		*algotlv = algo_SHA256;
+		*hash = CKM_SHA256;
 		break;
 	case CKM_SHA384_RSA_PKCS:
 	case CKM_SHA384_RSA_PKCS_PSS:
 		*algotlv = algo_SHA384;
+		*hash = CKM_SHA384;
 		break;
 	case CKM_SHA512_RSA_PKCS:
 	case CKM_SHA512_RSA_PKCS_PSS:
 		*algotlv = algo_SHA512;
+		*hash = CKM_SHA512;
 		break;
 	default:
 		return CKR_MECHANISM_INVALID;
@@ -515,98 +797,161 @@ static int getAlgorithmIdForDecryption(struct p11Token_t *token, CK_MECHANISM_TY
 
 
 
+/*
+ * Status words with which the card rejects the complete hash value in PSO HASH
+ */
+static int isHashFormatRejected(unsigned short SW1SW2)
+{
+	switch(SW1SW2) {
+	case 0x6700:		// Wrong length
+	case 0x6985:		// Conditions of use not satisfied
+	case 0x6A80:		// Incorrect parameters in the data field
+	case 0x6A81:		// Function not supported
+	case 0x6D00:		// Instruction not supported
+	case 0x6E00:		// Class not supported
+		return 1;
+	}
+	return 0;
+}
+
+
+
+/**
+ * Determine if only the last round of the hash is passed to the card, even if it accepts
+ * the complete hash value
+ *
+ * This is enabled with PKCS11_STARCOS_HASH_LAST_ROUND=1.
+ *
+ * @return          TRUE if the card shall perform the last round of the hash
+ */
+int starcosHashLastRound()
+{
+	char *po;
+
+	po = getenv("PKCS11_STARCOS_HASH_LAST_ROUND");
+	return po && atoi(po);
+}
+
+
+
+/**
+ * Hash the data in the host and transfer the result to the card for a subsequent signature
+ *
+ * Cards accepting a complete hash value receive only the hash. Otherwise the intermediate
+ * hash value over all complete blocks and the number of bits hashed are transferred together
+ * with the remaining data, for which the card performs the last round. Either way the
+ * amount of data sent to the card does not depend on the length of the message.
+ */
 int starcosDigest(struct p11Token_t *token, CK_MECHANISM_TYPE mech, unsigned char *data, size_t len)
 {
-	int rc,chunk;
+	struct starcosPrivateData *sc;
+	struct digestContext ctx;
+	CK_MECHANISM_TYPE hash;
+	int rc, i, hlen, cntlen, scrlen, algolen;
+	size_t tail;
 	unsigned short SW1SW2;
-	unsigned char scr[1008],*algo, *po;
+	unsigned char scr[256], hashValue[DIGEST_MAX_SIZE + 2], *algo, *po;
 
 	FUNC_CALLED();
 
-	rc = getAlgorithmIdForDigest(token, mech, &algo);
+	rc = getAlgorithmIdForDigest(token, mech, &algo, &hash);
 	if (rc != CKR_OK) {
 		FUNC_FAILS(rc, "getAlgorithmIdForDigest() failed");
 	}
 
 	po = algo;
 	asn1Tag(&po);
-	rc = asn1Length(&po);
-	rc += po - algo;
+	algolen = asn1Length(&po);
+	algolen += po - algo;
 
-	rc = transmitAPDU(token->slot, 0x00, 0x22, 0x41, 0xAA,
-		rc, algo,
-		0, NULL, 0, &SW1SW2);
-
-	if (rc < 0) {
-		FUNC_FAILS(CKR_DEVICE_ERROR, "transmitAPDU failed");
+	rc = starcosManageSE(token, 0xAA, algo, algolen);
+	if (rc != CKR_OK) {
+		FUNC_FAILS(rc, "MANAGE SE failed");
 	}
 
-	if (SW1SW2 != 0x9000) {
-		FUNC_FAILS(CKR_DEVICE_ERROR, "MANAGE SE failed");
+	digestInit(&ctx, hash);
+
+	tail = len % ctx.blockSize;
+	digestUpdate(&ctx, data, len - tail);
+
+	// Intermediate hash value, followed by the bit counter of the length used in the padding
+	po = scr + 2;
+	if (len > tail) {
+		hlen = digestGetState(&ctx, po);
+		po += hlen;
+		cntlen = ctx.blockSize == 128 ? 16 : 8;
+		memset(po, 0, cntlen - 8);
+		po += cntlen - 8;
+		hlen += cntlen;
+		for (i = 56; i >= 0; i -= 8) {
+			*po++ = (unsigned char)((ctx.length << 3) >> i);
+		}
+	} else {
+		hlen = 0;
 	}
+	scr[0] = 0x90;
+	scr[1] = (unsigned char)hlen;
+	memcpy(po, data + len - tail, tail);
+	scrlen = asn1Encap(0x80, po, tail) + hlen + 2;
+
+	digestUpdate(&ctx, data + len - tail, tail);
+	hlen = digestFinal(&ctx, hashValue);
 
-	if (len <= 1000) {
-		scr[0] = 0x90;
-		scr[1] = 0x00;
-		memcpy(scr + 2, data, len);
-		rc = asn1Encap(0x80, scr + 2, len) + 2;
+	sc = starcosGetPrivateData(token);
+
+	if (!sc->hashLastRound) {
+		memmove(hashValue + 2, hashValue, hlen);
+		hashValue[0] = 0x90;
+		hashValue[1] = (unsigned char)hlen;
 
 		rc = transmitAPDU(token->slot, 0x00, 0x2A, 0x90, 0xA0,
-				rc, scr,
+				hlen + 2, hashValue,
 				0, NULL, 0, &SW1SW2);
 
 		if (rc < 0) {
+			starcosInvalidateSE(token);
 			FUNC_FAILS(CKR_DEVICE_ERROR, "transmitAPDU failed");
 		}
 
-		if (SW1SW2 != 0x9000) {
-			FUNC_FAILS(CKR_DEVICE_ERROR, "Hash operation failed");
+		if (SW1SW2 == 0x9000) {
+			FUNC_RETURNS(CKR_OK);
 		}
-	} else {
-		scr[0] = 0x90;
-		scr[1] = 0x00;
 
-		rc = transmitAPDU(token->slot, 0x10, 0x2A, 0x90, 0xA0,
-				2, scr,
-				0, NULL, 0, &SW1SW2);
+		starcosInvalidateSE(token);
 
-		if (rc < 0) {
-			FUNC_FAILS(CKR_DEVICE_ERROR, "transmitAPDU failed");
-		}
-
-		if (SW1SW2 != 0x9000) {
+		if (!isHashFormatRejected(SW1SW2)) {
 			FUNC_FAILS(CKR_DEVICE_ERROR, "Hash operation failed");
 		}
 
-		while (len > 0) {
-			chunk = (len > token->drv->maxHashBlock ? token->drv->maxHashBlock : len);
-
-			memcpy(scr, data, chunk);
-			rc = asn1Encap(0x80, scr, chunk);
-
-			rc = transmitAPDU(token->slot, len > chunk ? 0x10 : 0x00, 0x2A, 0x90, 0xA0,
-					rc, scr,
-					0, NULL, 0, &SW1SW2);
+		rc = starcosManageSE(token, 0xAA, algo, algolen);
+		if (rc != CKR_OK) {
+			FUNC_FAILS(rc, "MANAGE SE failed");
+		}
+	}
 
-			if (rc < 0) {
-				FUNC_FAILS(CKR_DEVICE_ERROR, "transmitAPDU failed");
-			}
+	rc = transmitAPDU(token->slot, 0x00, 0x2A, 0x90, 0xA0,
+			scrlen, scr,
+			0, NULL, 0, &SW1SW2);
 
-			if (SW1SW2 != 0x9000) {
-				FUNC_FAILS(CKR_DEVICE_ERROR, "Hash operation failed");
-			}
+	if (rc < 0) {
+		starcosInvalidateSE(token);
+		FUNC_FAILS(CKR_DEVICE_ERROR, "transmitAPDU failed");
+	}
 
-			len -= chunk;
-			data += chunk;
-		}
+	if (SW1SW2 != 0x9000) {
+		starcosInvalidateSE(token);
+		FUNC_FAILS(CKR_DEVICE_ERROR, "Hash operation failed");
 	}
 
-	return CKR_OK;
+	// The card rejected the complete hash value, so use the last round for later signatures
+	sc->hashLastRound = 1;
+
+	FUNC_RETURNS(CKR_OK);
 }
 
 
 
-static int starcos_C_SignInit(struct p11Object_t *pObject, CK_MECHANISM_PTR mech)
+int starcos_C_SignInit(struct p11Object_t *pObject, CK_MECHANISM_PTR mech)
 {
 	unsigned char *algotlv;
 
@@ -617,47 +962,20 @@ static int starcos_C_SignInit(struct p11Object_t *pObject, CK_MECHANISM_PTR mech
 
 
 
-static int starcos_C_Sign(struct p11Object_t *pObject, CK_MECHANISM_TYPE mech, CK_BYTE_PTR pData, CK_ULONG ulDataLen, CK_BYTE_PTR pSignature, CK_ULONG_PTR pulSignatureLen)
+/*
+ * Perform the signature with the token locked and the application selected
+ */
+static int starcosSign(struct p11Object_t *pObject, CK_MECHANISM_TYPE mech, CK_BYTE_PTR pData, CK_ULONG ulDataLen, CK_BYTE_PTR pSignature, CK_ULONG_PTR pulSignatureLen)
 {
-	int rc, len, signaturelen;
+	int rc, len;
 	unsigned short SW1SW2;
 	unsigned char scr[256],*s, *d;
-	struct p11Slot_t *slot;
 
 	FUNC_CALLED();
 
-	rc = getSignatureSize(mech, pObject);
-	if (rc < 0) {
-		FUNC_FAILS(CKR_MECHANISM_INVALID, "Unknown mechanism");
-	}
-	signaturelen = rc;
-
-	if (pSignature == NULL) {
-		*pulSignatureLen = signaturelen;
-		FUNC_RETURNS(CKR_OK);
-	}
-
-	if (*pulSignatureLen < signaturelen) {
-		*pulSignatureLen = signaturelen;
-		FUNC_FAILS(CKR_BUFFER_TOO_SMALL, "Signature length is larger than buffer");
-	}
-
-	slot = pObject->token->slot;
-	starcosLock(pObject->token);
-	if (!slot->token) {
-		FUNC_RETURNS(CKR_DEVICE_REMOVED);
-	}
-
-	rc = starcosSelectApplication(pObject->token);
-	if (rc < 0) {
-		starcosUnlock(pObject->token);
-		FUNC_FAILS(CKR_DEVICE_ERROR, "selecting application failed");
-	}
-
 	if ((mech != CKM_RSA_PKCS) && (mech != CKM_ECDSA) && (mech != CKM_ECDSA_SHA1)) {
 		rc = starcosDigest(pObject->token, mech, pData, ulDataLen);
 		if (rc != CKR_OK) {
-			starcosUnlock(pObject->token);
 			FUNC_FAILS(rc, "digesting failed");
 		}
 		pData = NULL;
@@ -666,7 +984,6 @@ static int starcos_C_Sign(struct p11Object_t *pObject, CK_MECHANISM_TYPE mech, C
 
 	rc = getAlgorithmIdForSigning(pObject->token, mech, &s);
 	if (rc != CKR_OK) {
-		starcosUnlock(pObject->token);
 		FUNC_FAILS(rc, "getAlgorithmIdForSigning() failed");
 	}
 
@@ -681,18 +998,9 @@ static int starcos_C_Sign(struct p11Object_t *pObject, CK_MECHANISM_TYPE mech, C
 	*d++ = 0x01;
 	*d++ = (unsigned char)pObject->tokenid;
 
-	rc = transmitAPDU(pObject->token->slot, 0x00, 0x22, 0x41, 0xB6,
-		d - scr, scr,
-		0, NULL, 0, &SW1SW2);
-
-	if (rc < 0) {
-		starcosUnlock(pObject->token);
-		FUNC_FAILS(CKR_DEVICE_ERROR, "transmitAPDU failed");
-	}
-
-	if (SW1SW2 != 0x9000) {
-		starcosUnlock(pObject->token);
-		FUNC_FAILS(CKR_DEVICE_ERROR, "MANAGE SE failed");
+	rc = starcosManageSE(pObject->token, 0xB6, scr, d - scr);
+	if (rc != CKR_OK) {
+		FUNC_FAILS(rc, "MANAGE SE failed");
 	}
 
 	rc = transmitAPDU(pObject->token->slot, 0x00, 0x2A, 0x9E, 0x9A,
@@ -700,12 +1008,12 @@ static int starcos_C_Sign(struct p11Object_t *pObject, CK_MECHANISM_TYPE mech, C
 			0, pSignature, *pulSignatureLen, &SW1SW2);
 
 	if (rc < 0) {
-		starcosUnlock(pObject->token);
+		starcosInvalidateSE(pObject->token);
 		FUNC_FAILS(CKR_DEVICE_ERROR, "transmitAPDU failed");
 	}
 
 	if (SW1SW2 != 0x9000) {
-		starcosUnlock(pObject->token);
+		starcosInvalidateSE(pObject->token);
 		switch(SW1SW2) {
 		case 0x6A81:
 			FUNC_FAILS(CKR_KEY_FUNCTION_NOT_PERMITTED, "Signature operation not allowed for key");
@@ -720,16 +1028,122 @@ static int starcos_C_Sign(struct p11Object_t *pObject, CK_MECHANISM_TYPE mech, C
 	*pulSignatureLen = rc;
 
 	if ((pObject->token->user == CKU_USER) && (pObject->token->pinUseCounter == 1)) {
+		// The card resets the security status and environment after the single use of the PIN
 		pObject->token->user = INT_CKU_NO_USER;
+		starcosInvalidateSE(pObject->token);
+	}
+
+	FUNC_RETURNS(CKR_OK);
+}
+
+
+
+static int starcos_C_Sign(struct p11Object_t *pObject, CK_MECHANISM_TYPE mech, CK_BYTE_PTR pData, CK_ULONG ulDataLen, CK_BYTE_PTR pSignature, CK_ULONG_PTR pulSignatureLen)
+{
+	int rc, signaturelen;
+	struct p11Slot_t *slot;
+
+	FUNC_CALLED();
+
+	rc = getSignatureSize(mech, pObject);
+	if (rc < 0) {
+		FUNC_FAILS(CKR_MECHANISM_INVALID, "Unknown mechanism");
+	}
+	signaturelen = rc;
+
+	if (pSignature == NULL) {
+		*pulSignatureLen = signaturelen;
+		FUNC_RETURNS(CKR_OK);
+	}
+
+	if (*pulSignatureLen < signaturelen) {
+		*pulSignatureLen = signaturelen;
+		FUNC_FAILS(CKR_BUFFER_TOO_SMALL, "Signature length is larger than buffer");
+	}
+
+	slot = pObject->token->slot;
+	starcosLock(pObject->token);
+	if (!slot->token) {
+		starcosUnlock(pObject->token);
+		FUNC_RETURNS(CKR_DEVICE_REMOVED);
+	}
+
+	rc = starcosSelectApplication(pObject->token);
+	if (rc < 0) {
+		starcosUnlock(pObject->token);
+		FUNC_FAILS(CKR_DEVICE_ERROR, "selecting application failed");
+	}
+
+	rc = starcosSign(pObject, mech, pData, ulDataLen, pSignature, pulSignatureLen);
+
+	starcosUnlock(pObject->token);
+	FUNC_RETURNS(rc);
+}
+
+
+
+/*
+ * Create a batch of signatures, locking the token and selecting the application only once
+ */
+static int starcos_C_SignBatch(struct p11Object_t *pObject, CK_MECHANISM_TYPE mech, SC_SIGN_BATCH_ITEM_PTR pItems, CK_ULONG ulCount)
+{
+	int rc, signaturelen;
+	struct p11Slot_t *slot;
+	CK_ULONG i;
+
+	FUNC_CALLED();
+
+	rc = getSignatureSize(mech, pObject);
+	if (rc < 0) {
+		FUNC_FAILS(CKR_MECHANISM_INVALID, "Unknown mechanism");
+	}
+	signaturelen = rc;
+
+	slot = pObject->token->slot;
+	starcosLock(pObject->token);
+	if (!slot->token) {
+		starcosUnlock(pObject->token);
+		FUNC_RETURNS(CKR_DEVICE_REMOVED);
+	}
+
+	rc = starcosSelectApplication(pObject->token);
+	if (rc < 0) {
+		starcosUnlock(pObject->token);
+		FUNC_FAILS(CKR_DEVICE_ERROR, "selecting application failed");
+	}
+
+	for (i = 0; i < ulCount; i++) {
+		if (pItems[i].pSignature == NULL) {
+			pItems[i].ulSignatureLen = signaturelen;
+			pItems[i].rv = CKR_OK;
+		} else if (pItems[i].ulSignatureLen < signaturelen) {
+			pItems[i].ulSignatureLen = signaturelen;
+			pItems[i].rv = CKR_BUFFER_TOO_SMALL;
+		} else {
+			pItems[i].rv = starcosSign(pObject, mech, pItems[i].pData, pItems[i].ulDataLen, pItems[i].pSignature, &pItems[i].ulSignatureLen);
+
+			// A failed transmission leaves the card in an undefined state
+			if (pItems[i].rv == CKR_DEVICE_ERROR) {
+				break;
+			}
+		}
 	}
 
 	starcosUnlock(pObject->token);
+
+	if (i < ulCount) {
+		for (i++; i < ulCount; i++) {
+			pItems[i].rv = CKR_DEVICE_ERROR;
+		}
+		FUNC_FAILS(CKR_DEVICE_ERROR, "Signature operation failed");
+	}
+
 	FUNC_RETURNS(CKR_OK);
 }
 
 
 
-static int starcos_C_DecryptInit(struct p11Object_t *pObject, CK_MECHANISM_PTR mech)
+int starcos_C_DecryptInit(struct p11Object_t *pObject, CK_MECHANISM_PTR mech)
 {
 	unsigned char *algotlv;
 
@@ -740,7 +1154,7 @@ static int starcos_C_DecryptInit(struct p11Object_t *pObject, CK_MECHANISM_PTR m
 
 
 
-static int starcos_C_Decrypt(struct p11Object_t *pObject, CK_MECHANISM_TYPE mech, CK_BYTE_PTR pEncryptedData, CK_ULONG ulEncryptedDataLen, CK_BYTE_PTR pData, CK_ULONG_PTR pulDataLen)
+int starcos_C_Decrypt(struct p11Object_t *pObject, CK_MECHANISM_TYPE mech, CK_BYTE_PTR pEncryptedData, CK_ULONG ulEncryptedDataLen, CK_BYTE_PTR pData, CK_ULONG_PTR pulDataLen)
 {
 	int rc, len;
 	unsigned char *d,*s;
@@ -761,6 +1175,7 @@ static int starcos_C_Decrypt(struct p11Object_t *pObject, CK_MECHANISM_TYPE mech
 	slot = pObject->token->slot;
 	starcosLock(pObject->token);
 	if (!slot->token) {
+		starcosUnlock(pObject->token);
 		FUNC_RETURNS(CKR_DEVICE_REMOVED);
 	}
 
@@ -787,18 +1202,10 @@ static int starcos_C_Decrypt(struct p11Object_t *pObject, CK_MECHANISM_TYPE mech
 	*d++ = 0x01;
 	*d++ = (unsigned char)pObject->tokenid;
 
-	rc = transmitAPDU(pObject->token->slot, 0x00, 0x22, 0x41, 0xB8,
-		d - scr, scr,
-		0, NULL, 0, &SW1SW2);
-
-	if (rc < 0) {
-		starcosUnlock(pObject->token);
-		FUNC_FAILS(CKR_DEVICE_ERROR, "transmitAPDU failed");
-	}
-
-	if (SW1SW2 != 0x9000) {
+	rc = starcosManageSE(pObject->token, 0xB8, scr, d - scr);
+	if (rc != CKR_OK) {
 		starcosUnlock(pObject->token);
-		FUNC_FAILS(CKR_DEVICE_ERROR, "MANAGE SE failed");
+		FUNC_FAILS(rc, "MANAGE SE failed");
 	}
 
 	scr[0] = 0x81;
@@ -808,7 +1215,9 @@ static int starcos_C_Decrypt(struct p11Object_t *pObject, CK_MECHANISM_TYPE mech
 			257, scr,
 			0, scr, sizeof(scr), &SW1SW2);
 
-	starcosUnlock(pObject->token);
+	if ((rc < 0) || (SW1SW2 != 0x9000)) {
+		starcosInvalidateSE(pObject->token);
+	}
 
 	if (rc < 0) {
 		starcosUnlock(pObject->token);
@@ -828,14 +1237,17 @@ static int starcos_C_Decrypt(struct p11Object_t *pObject, CK_MECHANISM_TYPE mech
 		FUNC_FAILS(CKR_DEVICE_ERROR, "Decryption operation failed");
 	}
 
-	*pulDataLen = rc;
 	if (rc > *pulDataLen) {
+		*pulDataLen = rc;
 		starcosUnlock(pObject->token);
 		FUNC_FAILS(CKR_BUFFER_TOO_SMALL, "supplied buffer too small");
 	}
+	*pulDataLen = rc;
 
 	if ((pObject->token->user == CKU_USER) && (pObject->token->pinUseCounter == 1)) {
+		// The card resets the security status and environment after the single use of the PIN
 		pObject->token->user = INT_CKU_NO_USER;
+		starcosInvalidateSE(pObject->token);
 	}
 
 	memcpy(pData, scr, rc);
@@ -902,10 +1314,7 @@ int starcosAddPrivateKeyObject(struct p11Token_t *token, struct p15PrivateKeyDes
 		FUNC_FAILS(CKR_DEVICE_ERROR, "Could not create private key object");
 	}
 
-	p11prikey->C_SignInit = token->drv->C_SignInit;
-	p11prikey->C_Sign = token->drv->C_Sign;
-	p11prikey->C_DecryptInit = token->drv->C_DecryptInit;
-	p11prikey->C_Decrypt = token->drv->C_Decrypt;
+	p11prikey->ops = token->drv->privateKeyOps;
 
 	p11prikey->tokenid = p15->keyReference;
 	p11prikey->keysize = p15->keysize;
@@ -925,7 +1334,10 @@ int starcosAddPrivateKeyObject(struct p11Token_t *token, struct p15PrivateKeyDes
 
 
 
-static int loadObjects(struct p11Token_t *token)
+/*
+ * Load the objects of the application when the token is first used
+ */
+int starcosLoadObjects(struct p11Token_t *token)
 {
 	struct starcosPrivateData *sc;
 	int rc,i;
@@ -934,6 +1346,19 @@ static int loadObjects(struct p11Token_t *token)
 
 	sc = starcosGetPrivateData(token);
 
+	starcosLock(token);
+
+	if (!token->objectsPending) {
+		starcosUnlock(token);
+		FUNC_RETURNS(CKR_OK);
+	}
+
+	rc = starcosSelectApplication(token);
+	if (rc < 0) {
+		starcosUnlock(token);
+		FUNC_FAILS(CKR_DEVICE_ERROR, "selecting application failed");
+	}
+
 	for (i = 0; i < sc->application->certsLen; i++) {
 		struct p15CertificateDescription *p15 = &sc->application->certs[i];
 
@@ -956,6 +1381,9 @@ static int loadObjects(struct p11Token_t *token)
 		}
 	}
 
+	setTokenObjectsLoaded(token);
+
+	starcosUnlock(token);
 	FUNC_RETURNS(CKR_OK);
 }
 
@@ -1002,17 +1430,20 @@ int encodeF2B(unsigned char *pin, int pinlen, unsigned char *f2b)
  * @param pinLen    The length of the PIN supplied in pin
  * @return          CKR_OK or any other Cryptoki error code
  */
-static int login(struct p11Slot_t *slot, int userType, unsigned char *pin, int pinlen)
+int starcosLogin(struct p11Slot_t *slot, int userType, unsigned char *pin, int pinlen)
 {
 	int rc = CKR_OK;
 	unsigned short SW1SW2;
 	unsigned char f2b[8];
+	struct p11Token_t *token;
 	struct starcosPrivateData *sc;
 
 	FUNC_CALLED();
 
-	starcosLock(slot->token);
+	token = slot->token;
+	starcosLock(token);
 	if (!slot->token) {
+		starcosUnlock(token);
 		FUNC_RETURNS(CKR_DEVICE_REMOVED);
 	}
 
@@ -1092,11 +1523,12 @@ static int login(struct p11Slot_t *slot, int userType, unsigned char *pin, int p
  * @param pinLen    The length of the PIN supplied in pin
  * @return          CKR_OK or any other Cryptoki error code
  */
-static int initpin(struct p11Slot_t *slot, unsigned char *pin, int pinlen)
+int starcosInitPIN(struct p11Slot_t *slot, unsigned char *pin, int pinlen)
 {
 	int rc = CKR_OK;
 	unsigned short SW1SW2;
 	unsigned char data[16], pinref;
+	struct p11Token_t *token;
 	struct starcosPrivateData *sc;
 
 	FUNC_CALLED();
@@ -1109,8 +1541,10 @@ static int initpin(struct p11Slot_t *slot, unsigned char *pin, int pinlen)
 		}
 	}
 
-	starcosLock(slot->token);
+	token = slot->token;
+	starcosLock(token);
 	if (!slot->token) {
+		starcosUnlock(token);
 		FUNC_RETURNS(CKR_DEVICE_REMOVED);
 	}
 
@@ -1136,6 +1570,8 @@ static int initpin(struct p11Slot_t *slot, unsigned char *pin, int pinlen)
 				sizeof(sc->sopin), data,
 				0, NULL, 0, &SW1SW2);
 	}
+	memset_s(data, sizeof(data), 0, sizeof(data));
+
 	if (rc < 0) {
 		starcosUnlock(slot->token);
 		FUNC_FAILS(CKR_DEVICE_ERROR, "transmitAPDU failed");
@@ -1176,11 +1612,12 @@ static int initpin(struct p11Slot_t *slot, unsigned char *pin, int pinlen)
  * @param newpinLen The length of the PIN supplied in newpin
  * @return          CKR_OK or any other Cryptoki error code
  */
-static int setpin(struct p11Slot_t *slot, unsigned char *oldpin, int oldpinlen, unsigned char *newpin, int newpinlen)
+int starcosSetPIN(struct p11Slot_t *slot, unsigned char *oldpin, int oldpinlen, unsigned char *newpin, int newpinlen)
 {
 	int rc = CKR_OK;
 	unsigned short SW1SW2;
 	unsigned char data[16];
+	struct p11Token_t *token;
 	struct starcosPrivateData *sc;
 
 	FUNC_CALLED();
@@ -1201,8 +1638,10 @@ static int setpin(struct p11Slot_t *slot, unsigned char *oldpin, int oldpinlen,
 		FUNC_FAILS(rc, "Could not encode NewPIN");
 	}
 
-	starcosLock(slot->token);
+	token = slot->token;
+	starcosLock(token);
 	if (!slot->token) {
+		starcosUnlock(token);
 		FUNC_RETURNS(CKR_DEVICE_REMOVED);
 	}
 
@@ -1248,7 +1687,7 @@ static int setpin(struct p11Slot_t *slot, unsigned char *oldpin, int oldpinlen,
  * @param slot      The slot in which the token is inserted
  * @return          CKR_OK or any other Cryptoki error code
  */
-static int logout(struct p11Slot_t *slot)
+int starcosLogout(struct p11Slot_t *slot)
 {
 	struct starcosPrivateData *sc;
 
@@ -1257,17 +1696,16 @@ static int logout(struct p11Slot_t *slot)
 	sc = starcosGetPrivateData(slot->token);
 	memset(sc->sopin, 0, sizeof(sc->sopin));
 
+	starcosInvalidateSE(slot->token);
+
 	FUNC_RETURNS(CKR_OK);
 }
 
 
 
-static void freeStarcosToken(struct p11Token_t *token)
+void starcosFreeToken(struct p11Token_t *token)
 {
-	struct starcosPrivateData *sc;
-
-	sc = starcosGetPrivateData(token);
-	p11DestroyMutex(sc->mutex);
+	starcosTerminateScheduler(token);
 }
 
 
@@ -1287,7 +1725,8 @@ int createStarcosToken(struct p11Slot_t *slot, struct p11Token_t **token, struct
 
 	FUNC_CALLED();
 
-	ptoken = (struct p11Token_t *)calloc(sizeof(struct p11Token_t) + sizeof(struct starcosPrivateData), 1);
+	// Private data contains the SO-PIN, so keep it in locked memory
+	ptoken = (struct p11Token_t *)secureAlloc(sizeof(struct p11Token_t) + sizeof(struct starcosPrivateData));
 
 	if (ptoken == NULL) {
 		FUNC_FAILS(CKR_HOST_MEMORY, "Out of memory");
@@ -1309,7 +1748,7 @@ int createStarcosToken(struct p11Slot_t *slot, struct p11Token_t **token, struct
 	ptoken->info.firmwareVersion.major = 3;
 	ptoken->info.firmwareVersion.minor = drv->version;
 
-	ptoken->info.flags = CKF_WRITE_PROTECTED;
+	ptoken->info.flags = CKF_WRITE_PROTECTED | CKF_RNG;
 	ptoken->user = INT_CKU_NO_USER;
 	ptoken->drv = drv;
 
@@ -1317,7 +1756,12 @@ int createStarcosToken(struct p11Slot_t *slot, struct p11Token_t **token, struct
 	sc->selectedApplication = 0;
 	sc->application = application;
 
-	p11CreateMutex(&sc->mutex);
+	sc->hashLastRound = starcosHashLastRound();
+
+	if (starcosInitScheduler(ptoken) != CKR_OK) {
+		secureFree(ptoken);
+		FUNC_FAILS(CKR_HOST_MEMORY, "Out of memory");
+	}
 
 	strbpcpy(ptoken->info.label, sc->application->name, sizeof(ptoken->info.label));
 
@@ -1345,12 +1789,8 @@ int createStarcosToken(struct p11Slot_t *slot, struct p11Token_t **token, struct
 	if (ptoken->pinUseCounter != 1)
 		ptoken->info.flags |= CKF_LOGIN_REQUIRED;
 
-	rc = loadObjects(ptoken);
-
-	if (rc < 0) {
-		drv->freeToken(ptoken);
-		FUNC_FAILS(CKR_DEVICE_ERROR, "Error loading objects from token");
-	}
+	// Objects are loaded when the token is first used, saving the SELECT and reads for unused applications
+	ptoken->objectsPending = TRUE;
 
 	rc = starcosCheckPINStatus(slot, sc->application->pinref);
 
@@ -1377,7 +1817,7 @@ int createStarcosToken(struct p11Slot_t *slot, struct p11Token_t **token, struct
 
 
 
-static int getMechanismList(CK_MECHANISM_TYPE_PTR pMechanismList, CK_ULONG_PTR pulCount)
+int starcosGetMechanismList(CK_MECHANISM_TYPE_PTR pMechanismList, CK_ULONG_PTR pulCount)
 {
 	int numberOfMechanisms;
 
@@ -1402,7 +1842,7 @@ static int getMechanismList(CK_MECHANISM_TYPE_PTR pMechanismList, CK_ULONG_PTR p
 
 
 
-static int getMechanismInfo(CK_MECHANISM_TYPE type, CK_MECHANISM_INFO_PTR pInfo)
+int starcosGetMechanismInfo(CK_MECHANISM_TYPE type, CK_MECHANISM_INFO_PTR pInfo)
 {
 	CK_RV rv = CKR_OK;
 
@@ -1446,6 +1886,29 @@ static int getMechanismInfo(CK_MECHANISM_TYPE type, CK_MECHANISM_INFO_PTR pInfo)
 
 
 
+const struct p11ObjectOps starcosPrivateKeyOps = {
+	NULL,					// int (*C_EncryptInit)  (struct p11Object_t *, CK_MECHANISM_PTR);
+	NULL,					// int (*C_Encrypt)      (struct p11Object_t *, CK_MECHANISM_TYPE, CK_BYTE_PTR, CK_ULONG, CK_BYTE_PTR, CK_ULONG_PTR);
+	NULL,					// int (*C_EncryptUpdate)(struct p11Object_t *, CK_MECHANISM_TYPE, CK_BYTE_PTR, CK_ULONG, CK_BYTE_PTR, CK_ULONG_PTR);
+	NULL,					// int (*C_EncryptFinal) (struct p11Object_t *, CK_MECHANISM_TYPE, CK_BYTE_PTR, CK_ULONG_PTR);
+
+	starcos_C_DecryptInit,	// int (*C_DecryptInit)  (struct p11Object_t *, CK_MECHANISM_PTR);
+	starcos_C_Decrypt,		// int (*C_Decrypt)      (struct p11Object_t *, CK_MECHANISM_TYPE, CK_BYTE_PTR, CK_ULONG, CK_BYTE_PTR, CK_ULONG_PTR);
+	NULL,					// int (*C_DecryptUpdate)(struct p11Object_t *, CK_MECHANISM_TYPE, CK_BYTE_PTR, CK_ULONG, CK_BYTE_PTR, CK_ULONG_PTR);
+	NULL,					// int (*C_DecryptFinal) (struct p11Object_t *, CK_MECHANISM_TYPE, CK_BYTE_PTR, CK_ULONG_PTR);
+
+	starcos_C_SignInit,		// int (*C_SignInit)     (struct p11Object_t *, CK_MECHANISM_PTR);
+	starcos_C_Sign,			// int (*C_Sign)         (struct p11Object_t *, CK_MECHANISM_TYPE, CK_BYTE_PTR, CK_ULONG, CK_BYTE_PTR, CK_ULONG_PTR);
+	NULL,					// int (*C_SignUpdate)   (struct p11Object_t *, CK_MECHANISM_TYPE, CK_BYTE_PTR, CK_ULONG);
+	NULL,					// int (*C_SignFinal)    (struct p11Object_t *, CK_MECHANISM_TYPE, CK_BYTE_PTR, CK_ULONG_PTR);
+
+	starcos_C_SignBatch,	// int (*C_SignBatch)    (struct p11Object_t *, CK_MECHANISM_TYPE, SC_SIGN_BATCH_ITEM_PTR, CK_ULONG);
+
+	NULL					// int (*isHashedInHost) (struct p11Object_t *, CK_MECHANISM_TYPE);
+};
+
+
+
 struct p11TokenDriver *getStarcosTokenDriver()
 {
 	static struct p11TokenDriver starcos_token = {
@@ -1453,28 +1916,19 @@ struct p11TokenDriver *getStarcosTokenDriver()
 		5,
 		1920,
 		1920,
-		// Chunk must be aligned to the hash block size
-		// As we support SHA-2 up to 512 we choose 7 * 128 as chunk size
-		896,
 		NULL,
 		NULL,
-		freeStarcosToken,
-		getMechanismList,
-		getMechanismInfo,
-		login,
-		logout,
-		initpin,
-		setpin,
-
-		starcos_C_DecryptInit,	// int (*C_DecryptInit)  (struct p11Object_t *, CK_MECHANISM_PTR);
-		starcos_C_Decrypt,		// int (*C_Decrypt)      (struct p11Object_t *, CK_MECHANISM_TYPE, CK_BYTE_PTR, CK_ULONG, CK_BYTE_PTR, CK_ULONG_PTR);
-		NULL,					// int (*C_DecryptUpdate)(struct p11Object_t *, CK_MECHANISM_TYPE, CK_BYTE_PTR, CK_ULONG, CK_BYTE_PTR, CK_ULONG_PTR);
-		NULL,					// int (*C_DecryptFinal) (struct p11Object_t *, CK_MECHANISM_TYPE, CK_BYTE_PTR, CK_ULONG_PTR);
-
-		starcos_C_SignInit,		// int (*C_SignInit)     (struct p11Object_t *, CK_MECHANISM_PTR);
-		starcos_C_Sign,			// int (*C_Sign)         (struct p11Object_t *, CK_MECHANISM_TYPE, CK_BYTE_PTR, CK_ULONG, CK_BYTE_PTR, CK_ULONG_PTR);
-		NULL,					// int (*C_SignUpdate)   (struct p11Object_t *, CK_MECHANISM_TYPE, CK_BYTE_PTR, CK_ULONG);
-		NULL					// int (*C_SignFinal)    (struct p11Object_t *, CK_MECHANISM_TYPE, CK_BYTE_PTR, CK_ULONG_PTR);
+		starcosFreeToken,
+		starcosGetMechanismList,
+		starcosGetMechanismInfo,
+		starcosLogin,
+		starcosLogout,
+		starcosInitPIN,
+		starcosSetPIN,
+		starcosLoadObjects,
+		starcosLock,
+		starcosUnlock,
+		&starcosPrivateKeyOps
 	};
 
 	return &starcos_token;
@@ -56,27 +56,63 @@ struct starcosApplication {
 	size_t certsLen;
 };
 
+#define STARCOS_SE_CACHE_SIZE   4
+#define STARCOS_SE_MAX_DATA     32
+
+/**
+ * Control reference template last set in the security environment with MANAGE SE
+ */
+struct starcosSETemplate {
+	unsigned char crt;                          /**< Tag of the template or 0 if unused */
+	unsigned char data[STARCOS_SE_MAX_DATA];    /**< Content of the template            */
+	int len;                                    /**< Length of the content              */
+};
+
 struct starcosPrivateData {
 	struct starcosApplication   *application;
 	int                         selectedApplication;
-	void                        *mutex;
+	struct starcosSETemplate    se[STARCOS_SE_CACHE_SIZE];
+	unsigned int                seTransmitErrors;   /**< Failed transmissions of the slot when se was valid */
+	struct starcosScheduler     *scheduler;
+	int                         hashLastRound;
 	unsigned char               sopin[8];
 };
 
 struct starcosPrivateData *starcosGetPrivateData(struct p11Token_t *token);
+int starcosInitScheduler(struct p11Token_t *token);
+void starcosTerminateScheduler(struct p11Token_t *token);
 void starcosLock(struct p11Token_t *token);
 void starcosUnlock(struct p11Token_t *token);
 int starcosSwitchApplication(struct p11Token_t *token, struct starcosApplication *application);
 int starcosSelectApplication(struct p11Token_t *token);
+int starcosManageSE(struct p11Token_t *token, unsigned char crt, unsigned char *data, int len);
+void starcosInvalidateSE(struct p11Token_t *token);
 int starcosReadTLVEF(struct p11Token_t *token, bytestring fid, unsigned char *content, size_t len);
 int starcosCheckPINStatus(struct p11Slot_t *slot, unsigned char pinref);
 int starcosUpdatePinStatus(struct p11Token_t *token, int pinstatus);
 int starcosAddCertificateObject(struct p11Token_t *token, struct p15CertificateDescription *p15);
 int starcosAddPrivateKeyObject(struct p11Token_t *token, struct p15PrivateKeyDescription *p15);
+int starcosHashLastRound();
 int starcosDigest(struct p11Token_t *token, CK_MECHANISM_TYPE mech, unsigned char *data, size_t len);
 int starcosDeterminePinUseCounter(struct p11Token_t *token, unsigned char recref, int *useCounter, int *lifeCycle);
 int encodeF2B(unsigned char *pin, int pinlen, unsigned char *f2b);
 
 int createStarcosToken(struct p11Slot_t *slot, struct p11Token_t **token, struct p11TokenDriver *drv, struct starcosApplication *application);
 
+/* Driver functions shared by the drivers for Starcos based cards */
+void starcosFreeToken(struct p11Token_t *token);
+int starcosGetMechanismList(CK_MECHANISM_TYPE_PTR pMechanismList, CK_ULONG_PTR pulCount);
+int starcosGetMechanismInfo(CK_MECHANISM_TYPE type, CK_MECHANISM_INFO_PTR pInfo);
+int starcosLogin(struct p11Slot_t *slot, int userType, unsigned char *pin, int pinlen);
+int starcosLogout(struct p11Slot_t *slot);
+int starcosInitPIN(struct p11Slot_t *slot, unsigned char *pin, int pinlen);
+int starcosSetPIN(struct p11Slot_t *slot, unsigned char *oldpin, int oldpinlen, unsigned char *newpin, int newpinlen);
+int starcosLoadObjects(struct p11Token_t *token);
+int starcos_C_SignInit(struct p11Object_t *pObject, CK_MECHANISM_PTR mech);
+int starcos_C_DecryptInit(struct p11Object_t *pObject, CK_MECHANISM_PTR mech);
+int starcos_C_Decrypt(struct p11Object_t *pObject, CK_MECHANISM_TYPE mech, CK_BYTE_PTR pEncryptedData, CK_ULONG ulEncryptedDataLen, CK_BYTE_PTR pData, CK_ULONG_PTR pulDataLen);
+
+/* Operations of private keys on Starcos based cards */
+extern const struct p11ObjectOps starcosPrivateKeyOps;
+
 #endif /* ___TOKEN_STARCOS_H_INC___ */
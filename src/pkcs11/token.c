@@ -37,6 +37,12 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+#include <common/securemem.h>
+
 #include <pkcs11/strbpcpy.h>
 
 #include <pkcs11/token.h>
@@ -432,12 +438,59 @@ void freeToken(struct p11Token_t *token)
 
 		removePrivateObjects(token);
 		removePublicObjects(token);
-		free(token);
+		secureFree(token);
 	}
 }
 
 
 
+/**
+ * Load the objects of a token whose driver defers loading until the token is first used
+ *
+ * @param token     Pointer to token
+ * @return          CKR_OK or any other Cryptoki error code
+ */
+int loadTokenObjects(struct p11Token_t *token)
+{
+	int pending;
+
+	if (token->drv->loadObjects == NULL)
+		return CKR_OK;
+
+	// Pairs with the release in setTokenObjectsLoaded(), so that the objects added by
+	// the driver are visible once the flag is seen cleared
+#ifdef _WIN32
+	pending = InterlockedOr((LONG volatile *)&token->objectsPending, 0);
+#else
+	pending = __atomic_load_n(&token->objectsPending, __ATOMIC_ACQUIRE);
+#endif
+
+	if (!pending)
+		return CKR_OK;
+
+	return token->drv->loadObjects(token);
+}
+
+
+
+/**
+ * Clear objectsPending after the driver added all objects of the token
+ *
+ * The driver calls this with the token locked, as the final step of loadObjects.
+ *
+ * @param token     Pointer to token
+ */
+void setTokenObjectsLoaded(struct p11Token_t *token)
+{
+#ifdef _WIN32
+	InterlockedExchange((LONG volatile *)&token->objectsPending, FALSE);
+#else
+	__atomic_store_n(&token->objectsPending, FALSE, __ATOMIC_RELEASE);
+#endif
+}
+
+
+
 /**
  * Return the base token if this token is in a virtual slot
  *
@@ -86,6 +86,8 @@ int removeObjectLeavingAttributes(struct p11Token_t *token, CK_OBJECT_HANDLE han
 int saveObjects(struct p11Slot_t *slot, struct p11Token_t *token, int publicObject);
 int destroyObject(struct p11Slot_t *slot, struct p11Token_t *token, struct p11Object_t *object);
 int synchronizeToken(struct p11Slot_t *slot, struct p11Token_t *token);
+int loadTokenObjects(struct p11Token_t *token);
+void setTokenObjectsLoaded(struct p11Token_t *token);
 struct p11Token_t *getBaseToken(struct p11Token_t *token);
 
 #endif /* ___TOKEN_H_INC___ */
@@ -0,0 +1,467 @@
+/**
+ * SmartCard-HSM PKCS#11 Module
+ *
+ * Copyright (c) 2013, CardContact Systems GmbH, Minden, Germany
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of CardContact Systems GmbH nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CardContact Systems GmbH BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file    verify.c
+ * @brief   Signature verification with public keys in the host
+ *
+ * Verification only needs the public key, so it is performed in the host
+ * without a round trip to the token.
+ */
+
+#include <string.h>
+
+#include <pkcs11/verify.h>
+
+
+
+#define MECH_RECOVER            1   /* Mechanism supports C_VerifyRecover */
+
+/**
+ * Mechanisms supported for verification in the host
+ */
+static const struct verifyMechanism {
+	CK_MECHANISM_TYPE mech;
+	CK_KEY_TYPE keyType;
+	int scheme;
+	CK_MECHANISM_TYPE hash;
+	int flags;
+} verifyMechanisms[] = {
+	{ CKM_RSA_X_509,            CKK_RSA, VERIFY_RAW,   0,           MECH_RECOVER },
+	{ CKM_RSA_PKCS,             CKK_RSA, VERIFY_PKCS1, 0,           MECH_RECOVER },
+	{ CKM_SHA1_RSA_PKCS,        CKK_RSA, VERIFY_PKCS1, CKM_SHA_1,   0 },
+	{ CKM_SHA224_RSA_PKCS,      CKK_RSA, VERIFY_PKCS1, CKM_SHA224,  0 },
+	{ CKM_SHA256_RSA_PKCS,      CKK_RSA, VERIFY_PKCS1, CKM_SHA256,  0 },
+	{ CKM_SHA384_RSA_PKCS,      CKK_RSA, VERIFY_PKCS1, CKM_SHA384,  0 },
+	{ CKM_SHA512_RSA_PKCS,      CKK_RSA, VERIFY_PKCS1, CKM_SHA512,  0 },
+	{ CKM_RSA_PKCS_PSS,         CKK_RSA, VERIFY_PSS,   0,           0 },
+	{ CKM_SHA1_RSA_PKCS_PSS,    CKK_RSA, VERIFY_PSS,   CKM_SHA_1,   0 },
+	{ CKM_SHA224_RSA_PKCS_PSS,  CKK_RSA, VERIFY_PSS,   CKM_SHA224,  0 },
+	{ CKM_SHA256_RSA_PKCS_PSS,  CKK_RSA, VERIFY_PSS,   CKM_SHA256,  0 },
+	{ CKM_SHA384_RSA_PKCS_PSS,  CKK_RSA, VERIFY_PSS,   CKM_SHA384,  0 },
+	{ CKM_SHA512_RSA_PKCS_PSS,  CKK_RSA, VERIFY_PSS,   CKM_SHA512,  0 },
+	{ CKM_ECDSA,                CKK_EC,  VERIFY_ECDSA, 0,           0 },
+	{ CKM_ECDSA_SHA1,           CKK_EC,  VERIFY_ECDSA, CKM_SHA_1,   0 },
+	{ CKM_ECDSA_SHA224,         CKK_EC,  VERIFY_ECDSA, CKM_SHA224,  0 },
+	{ CKM_ECDSA_SHA256,         CKK_EC,  VERIFY_ECDSA, CKM_SHA256,  0 },
+	{ CKM_ECDSA_SHA384,         CKK_EC,  VERIFY_ECDSA, CKM_SHA384,  0 },
+	{ CKM_ECDSA_SHA512,         CKK_EC,  VERIFY_ECDSA, CKM_SHA512,  0 }
+};
+
+
+
+static const struct verifyMechanism *findMechanism(CK_MECHANISM_TYPE mech)
+{
+	int i;
+
+	for (i = 0; i < sizeof(verifyMechanisms) / sizeof(*verifyMechanisms); i++) {
+		if (verifyMechanisms[i].mech == mech)
+			return &verifyMechanisms[i];
+	}
+	return NULL;
+}
+
+
+
+/**
+ * Return the list of mechanisms supported for verification
+ *
+ * @param pMechanismList Buffer receiving the list or NULL
+ * @param ulCount    The size of the buffer
+ * @return           The number of mechanisms
+ */
+int getVerifyMechanisms(CK_MECHANISM_TYPE_PTR pMechanismList, CK_ULONG ulCount)
+{
+	int i, count;
+
+	count = sizeof(verifyMechanisms) / sizeof(*verifyMechanisms);
+
+	for (i = 0; pMechanismList && (i < count) && (i < ulCount); i++) {
+		pMechanismList[i] = verifyMechanisms[i].mech;
+	}
+
+	return count;
+}
+
+
+
+/**
+ * Describe the verification support for a mechanism
+ *
+ * @param mech       The mechanism
+ * @param pInfo      Filled with key sizes and CKF_VERIFY / CKF_VERIFY_RECOVER
+ * @return           0 or -1 if the mechanism is not supported in the host
+ */
+int getVerifyMechanismInfo(CK_MECHANISM_TYPE mech, CK_MECHANISM_INFO_PTR pInfo)
+{
+	const struct verifyMechanism *vm = findMechanism(mech);
+
+	if (vm == NULL)
+		return -1;
+
+	pInfo->flags = CKF_VERIFY;
+
+	if (vm->flags & MECH_RECOVER)
+		pInfo->flags |= CKF_VERIFY_RECOVER;
+
+	if (vm->keyType == CKK_RSA) {
+		pInfo->ulMinKeySize = 512;
+		pInfo->ulMaxKeySize = BN_MAX_BITS;
+	} else {
+		pInfo->flags |= CKF_EC_F_P|CKF_EC_NAMEDCURVE|CKF_EC_ECPARAMETERS|CKF_EC_UNCOMPRESS;
+		pInfo->ulMinKeySize = 192;
+		pInfo->ulMaxKeySize = 521;
+	}
+	return 0;
+}
+
+
+
+/*
+ * Load modulus and exponent or curve and point from the key object
+ */
+static CK_RV loadKey(struct verifyContext *ctx, struct p11Object_t *object, CK_KEY_TYPE keyType)
+{
+	unsigned char *v1, *v2;
+	size_t l1, l2;
+
+	if (keyType == CKK_RSA) {
+		if ((getAttributeValue(object, CKA_MODULUS, &v1, &l1) < 0) ||
+			(getAttributeValue(object, CKA_PUBLIC_EXPONENT, &v2, &l2) < 0)) {
+			return CKR_KEY_TYPE_INCONSISTENT;
+		}
+
+		if (rsaInitPublicKey(&ctx->key.rsa, v1, l1, v2, l2) < 0) {
+			return CKR_KEY_SIZE_RANGE;
+		}
+	} else {
+		if ((getAttributeValue(object, CKA_EC_PARAMS, &v1, &l1) < 0) ||
+			(getAttributeValue(object, CKA_EC_POINT, &v2, &l2) < 0)) {
+			return CKR_KEY_TYPE_INCONSISTENT;
+		}
+
+		if (ecDecodeParams(&ctx->key.ec.curve, v1, l1) < 0) {
+			return CKR_KEY_SIZE_RANGE;
+		}
+
+		if (ecDecodePoint(&ctx->key.ec.curve, &ctx->key.ec.q, v2, l2) < 0) {
+			return CKR_KEY_TYPE_INCONSISTENT;
+		}
+	}
+	return CKR_OK;
+}
+
+
+
+/**
+ * Start a verification operation
+ *
+ * @param ctx        The context to initialize
+ * @param key        The public key object
+ * @param pMechanism The mechanism and parameter passed by the application
+ * @param recover    Called from C_VerifyRecoverInit
+ * @return           CKR_OK or a PKCS#11 error code
+ */
+CK_RV verifyInit(struct verifyContext *ctx, struct p11Object_t *key, CK_MECHANISM_PTR pMechanism, int recover)
+{
+	const struct verifyMechanism *vm;
+	CK_RSA_PKCS_PSS_PARAMS params;
+	CK_MECHANISM_TYPE pssHash;
+	CK_RV rv;
+
+	vm = findMechanism(pMechanism->mechanism);
+
+	if ((vm == NULL) || (recover && !(vm->flags & MECH_RECOVER))) {
+		return CKR_MECHANISM_INVALID;
+	}
+
+	if (getULongAttribute(key, CKA_CLASS, CK_UNAVAILABLE_INFORMATION) != CKO_PUBLIC_KEY) {
+		return CKR_KEY_FUNCTION_NOT_PERMITTED;
+	}
+
+	if (!getBooleanAttribute(key, recover ? CKA_VERIFY_RECOVER : CKA_VERIFY, 1)) {
+		return CKR_KEY_FUNCTION_NOT_PERMITTED;
+	}
+
+	if (getULongAttribute(key, CKA_KEY_TYPE, CK_UNAVAILABLE_INFORMATION) != vm->keyType) {
+		return CKR_KEY_TYPE_INCONSISTENT;
+	}
+
+	memset(ctx, 0, sizeof(*ctx));
+	ctx->mech = vm->mech;
+	ctx->scheme = vm->scheme;
+	ctx->recover = recover;
+	ctx->hash = vm->hash;
+
+	if (vm->scheme == VERIFY_PSS) {
+		if ((pMechanism->pParameter == NULL) || (pMechanism->ulParameterLen != sizeof(params))) {
+			return CKR_MECHANISM_PARAM_INVALID;
+		}
+
+		memcpy(&params, pMechanism->pParameter, sizeof(params));
+
+		// Hashing mechanisms must use the same hash in the parameter
+		pssHash = vm->hash ? vm->hash : params.hashAlg;
+
+		if ((params.hashAlg != pssHash) || (getDigestSize(pssHash) < 0)) {
+			return CKR_MECHANISM_PARAM_INVALID;
+		}
+
+		ctx->pssHash = pssHash;
+		ctx->mgfHash = getMGF1Hash(params.mgf);
+		ctx->saltLen = params.sLen;
+
+		if (ctx->mgfHash == 0) {
+			return CKR_MECHANISM_PARAM_INVALID;
+		}
+	}
+
+	rv = loadKey(ctx, key, vm->keyType);
+
+	if (rv != CKR_OK) {
+		return rv;
+	}
+
+	if (ctx->hash) {
+		digestInit(&ctx->digest, ctx->hash);
+	}
+
+	return CKR_OK;
+}
+
+
+
+/**
+ * Add data to the verification
+ *
+ * Data for mechanisms without hashing is collected up to the maximum key size.
+ * Excess data is rejected with CKR_DATA_LEN_RANGE when the signature is checked.
+ *
+ * @param ctx        The context
+ * @param data       The data
+ * @param len        The length of the data
+ */
+void verifyUpdate(struct verifyContext *ctx, const unsigned char *data, size_t len)
+{
+	if (ctx->hash) {
+		digestUpdate(&ctx->digest, data, len);
+		return;
+	}
+
+	if (len > sizeof(ctx->data) - ctx->dataLen) {
+		ctx->dataOverflow = 1;
+		return;
+	}
+
+	memcpy(ctx->data + ctx->dataLen, data, len);
+	ctx->dataLen += len;
+}
+
+
+
+/*
+ * Apply the RSA public key operation to the signature
+ */
+static CK_RV openSignature(struct verifyContext *ctx, const unsigned char *signature, size_t signatureLen, unsigned char *em)
+{
+	if (signatureLen != (size_t)ctx->key.rsa.size) {
+		return CKR_SIGNATURE_LEN_RANGE;
+	}
+
+	if (rsaPublic(&ctx->key.rsa, signature, signatureLen, em) < 0) {
+		return CKR_SIGNATURE_INVALID;
+	}
+
+	return CKR_OK;
+}
+
+
+
+/*
+ * Verify a RSA signature
+ */
+static CK_RV verifyRSA(struct verifyContext *ctx, const unsigned char *signature, size_t signatureLen)
+{
+	unsigned char em[RSA_MAX_BYTES], hash[DIGEST_MAX_SIZE];
+	const unsigned char *msg, *prefix, *t;
+	size_t k = ctx->key.rsa.size;
+	size_t msgLen, tLen, i;
+	int prefixLen;
+	CK_RV rv;
+
+	if (ctx->hash) {
+		msgLen = digestFinal(&ctx->digest, hash);
+		msg = hash;
+	} else {
+		msg = ctx->data;
+		msgLen = ctx->dataLen;
+
+		if (ctx->dataOverflow || (msgLen > k) ||
+			((ctx->scheme == VERIFY_PKCS1) && (msgLen > k - 11)) ||
+			((ctx->scheme == VERIFY_PSS) && (msgLen != (size_t)getDigestSize(ctx->pssHash)))) {
+			return CKR_DATA_LEN_RANGE;
+		}
+	}
+
+	rv = openSignature(ctx, signature, signatureLen, em);
+
+	if (rv != CKR_OK) {
+		return rv;
+	}
+
+	switch(ctx->scheme) {
+	case VERIFY_RAW:
+		// The data is compared as a big-endian number
+		for (i = 0; i < k - msgLen; i++) {
+			if (em[i] != 0) {
+				return CKR_SIGNATURE_INVALID;
+			}
+		}
+
+		if (memcmp(em + i, msg, msgLen)) {
+			return CKR_SIGNATURE_INVALID;
+		}
+		break;
+
+	case VERIFY_PKCS1:
+		if (pkcs1V15RemoveSignaturePadding(em, k, &t, &tLen) < 0) {
+			return CKR_SIGNATURE_INVALID;
+		}
+
+		// Hashing mechanisms expect the DigestInfo structure for the hash
+		if (ctx->hash) {
+			prefix = getDigestInfoPrefix(ctx->hash, &prefixLen);
+
+			if ((tLen != prefixLen + msgLen) || memcmp(t, prefix, prefixLen)) {
+				return CKR_SIGNATURE_INVALID;
+			}
+			t += prefixLen;
+			tLen -= prefixLen;
+		}
+
+		if ((tLen != msgLen) || memcmp(t, msg, msgLen)) {
+			return CKR_SIGNATURE_INVALID;
+		}
+		break;
+
+	case VERIFY_PSS:
+		if (pssVerify(em, ctx->key.rsa.bits, ctx->pssHash, ctx->mgfHash, msg, msgLen, ctx->saltLen) < 0) {
+			return CKR_SIGNATURE_INVALID;
+		}
+		break;
+	}
+
+	return CKR_OK;
+}
+
+
+
+/**
+ * Complete the verification and check the signature
+ *
+ * @param ctx        The context
+ * @param signature  The signature
+ * @param signatureLen The length of the signature
+ * @return           CKR_OK, CKR_SIGNATURE_INVALID, CKR_SIGNATURE_LEN_RANGE or CKR_DATA_LEN_RANGE
+ */
+CK_RV verifyFinal(struct verifyContext *ctx, const unsigned char *signature, size_t signatureLen)
+{
+	unsigned char hash[DIGEST_MAX_SIZE];
+	const unsigned char *msg;
+	size_t msgLen;
+
+	if (ctx->scheme != VERIFY_ECDSA) {
+		return verifyRSA(ctx, signature, signatureLen);
+	}
+
+	if (signatureLen != 2 * (size_t)ctx->key.ec.curve.orderSize) {
+		return CKR_SIGNATURE_LEN_RANGE;
+	}
+
+	if (ctx->hash) {
+		msgLen = digestFinal(&ctx->digest, hash);
+		msg = hash;
+	} else {
+		if (ctx->dataOverflow) {
+			return CKR_DATA_LEN_RANGE;
+		}
+		msg = ctx->data;
+		msgLen = ctx->dataLen;
+	}
+
+	if (ecdsaVerify(&ctx->key.ec.curve, &ctx->key.ec.q, msg, msgLen, signature, signatureLen) < 0) {
+		return CKR_SIGNATURE_INVALID;
+	}
+
+	return CKR_OK;
+}
+
+
+
+/**
+ * Recover the data from a signature
+ *
+ * If data is NULL, then only the length of the recovered data is returned.
+ *
+ * @param ctx        The context
+ * @param signature  The signature
+ * @param signatureLen The length of the signature
+ * @param data       Buffer receiving the recovered data or NULL
+ * @param dataLen    Size of buffer on input, length of recovered data on output
+ * @return           CKR_OK, CKR_BUFFER_TOO_SMALL, CKR_SIGNATURE_INVALID or CKR_SIGNATURE_LEN_RANGE
+ */
+CK_RV verifyRecover(struct verifyContext *ctx, const unsigned char *signature, size_t signatureLen, unsigned char *data, CK_ULONG_PTR dataLen)
+{
+	unsigned char em[RSA_MAX_BYTES];
+	const unsigned char *msg = em;
+	size_t msgLen = ctx->key.rsa.size;
+	CK_RV rv;
+
+	rv = openSignature(ctx, signature, signatureLen, em);
+
+	if (rv != CKR_OK) {
+		return rv;
+	}
+
+	if ((ctx->scheme == VERIFY_PKCS1) && (pkcs1V15RemoveSignaturePadding(em, msgLen, &msg, &msgLen) < 0)) {
+		return CKR_SIGNATURE_INVALID;
+	}
+
+	if (data == NULL) {
+		*dataLen = msgLen;
+		return CKR_OK;
+	}
+
+	if (*dataLen < msgLen) {
+		*dataLen = msgLen;
+		return CKR_BUFFER_TOO_SMALL;
+	}
+
+	memcpy(data, msg, msgLen);
+	*dataLen = msgLen;
+	return CKR_OK;
+}
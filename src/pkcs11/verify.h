@@ -0,0 +1,80 @@
+/**
+ * SmartCard-HSM PKCS#11 Module
+ *
+ * Copyright (c) 2013, CardContact Systems GmbH, Minden, Germany
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of CardContact Systems GmbH nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CardContact Systems GmbH BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file    verify.h
+ * @brief   Signature verification with public keys in the host
+ */
+
+#ifndef ___VERIFY_H_INC___
+#define ___VERIFY_H_INC___
+
+#include <pkcs11/cryptoki.h>
+#include <pkcs11/object.h>
+#include <pkcs11/digest.h>
+#include <pkcs11/rsa.h>
+#include <pkcs11/ecc.h>
+
+#define VERIFY_RAW              0
+#define VERIFY_PKCS1            1
+#define VERIFY_PSS              2
+#define VERIFY_ECDSA            3
+
+#define VERIFY_MAX_DATA         RSA_MAX_BYTES
+
+/**
+ * State of a verification operation
+ */
+struct verifyContext {
+	CK_MECHANISM_TYPE mech;           /**< The verification mechanism          */
+	int scheme;                       /**< One of the VERIFY_ constants        */
+	int recover;                      /**< Started with C_VerifyRecoverInit    */
+	CK_MECHANISM_TYPE hash;           /**< Hash calculated in the host or 0    */
+	CK_MECHANISM_TYPE pssHash;        /**< Hash from the PSS parameter         */
+	CK_MECHANISM_TYPE mgfHash;        /**< Hash for MGF1 from the PSS parameter */
+	size_t saltLen;                   /**< Salt length from the PSS parameter  */
+	struct digestContext digest;      /**< Hash over the data, if hash != 0    */
+	unsigned char data[VERIFY_MAX_DATA]; /**< Collected data, if hash == 0     */
+	size_t dataLen;                   /**< Length of the collected data        */
+	int dataOverflow;                 /**< More data passed than fits          */
+	union {
+		struct rsaPublicKey rsa;
+		struct {
+			struct ecCurve curve;
+			struct ecPoint q;
+		} ec;
+	} key;                            /**< The prepared public key             */
+};
+
+int getVerifyMechanisms(CK_MECHANISM_TYPE_PTR pMechanismList, CK_ULONG ulCount);
+int getVerifyMechanismInfo(CK_MECHANISM_TYPE mech, CK_MECHANISM_INFO_PTR pInfo);
+CK_RV verifyInit(struct verifyContext *ctx, struct p11Object_t *key, CK_MECHANISM_PTR pMechanism, int recover);
+void verifyUpdate(struct verifyContext *ctx, const unsigned char *data, size_t len);
+CK_RV verifyFinal(struct verifyContext *ctx, const unsigned char *signature, size_t signatureLen);
+CK_RV verifyRecover(struct verifyContext *ctx, const unsigned char *signature, size_t signatureLen, unsigned char *data, CK_ULONG_PTR dataLen);
+
+#endif /* ___VERIFY_H_INC___ */
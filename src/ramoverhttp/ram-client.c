@@ -34,6 +34,11 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <signal.h>
+
+#ifndef _WIN32
+#include <sys/time.h>
+#endif
 
 #ifdef __APPLE__
 #include <PCSC/wintypes.h>
@@ -43,6 +48,7 @@
 #endif
 
 #include <ramoverhttp/ramoverhttp.h>
+#include <common/thread.h>
 
 #ifdef WIN32
 #define alloca _alloca
@@ -52,6 +58,11 @@ static int optListReaders = 0;
 static char *optReader = NULL;
 static char *optURL = NULL;
 static int optVerbose = 0;
+static int optContinuous = 0;
+static int optAllReaders = 0;
+static int optCards = 0;
+
+static volatile int stopRequested = 0;
 
 
 struct localContext {
@@ -62,6 +73,24 @@ struct localContext {
 
 
 
+struct readerWorker {
+	struct localContext lctx;
+	struct ramEngine *engine;
+	THREAD thread;
+	int cards;
+	int failed;
+	double totalTime;
+	double minTime;
+	double maxTime;
+};
+
+
+
+static MUTEX cardCounterLock;
+static int cardCounter = 0;
+
+
+
 char *pcsc_error_to_string(const LONG error) {
 	static char strError[75];
 
@@ -192,6 +221,9 @@ void usage()
 	puts("ram-client [option] <URL>\n");
 	puts("  -r, --reader         Select reader name");
 	puts("  -l, --list-readers   List available card readers");
+	puts("  -c, --continuous     Process cards one after another, reusing the server connection");
+	puts("  -a, --all-readers    Process cards in all readers concurrently");
+	puts("  -n, --cards <n>      Stop after n cards in continuous mode");
 	puts("  -v, --verbose        Tell us what you do");
 }
 
@@ -213,6 +245,18 @@ void decodeArgs(int argc, char **argv)
 			argc--;
 		} else if (!strcmp(*argv, "--list-readers") || !strcmp(*argv, "-l")) {
 			optListReaders = 1;
+		} else if (!strcmp(*argv, "--continuous") || !strcmp(*argv, "-c")) {
+			optContinuous = 1;
+		} else if (!strcmp(*argv, "--all-readers") || !strcmp(*argv, "-a")) {
+			optAllReaders = 1;
+		} else if (!strcmp(*argv, "--cards") || !strcmp(*argv, "-n")) {
+			if (argc <= 0) {
+				printf("Argument for --cards missing\n");
+				exit(1);
+			}
+			argv++;
+			optCards = atoi(*argv);
+			argc--;
 		} else if (!strcmp(*argv, "--verbose") || !strcmp(*argv, "-v")) {
 			optVerbose = 1;
 		} else if (**argv == '-') {
@@ -342,21 +386,364 @@ static int reset(struct ramContext *ctx, unsigned char *atr, size_t *alen) {
 
 
 
+static double now() {
+#ifdef _WIN32
+	return GetTickCount() / 1000.0;
+#else
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1000000.0;
+#endif
+}
+
+
+
+static void onSignal(int sig) {
+	stopRequested = 1;
+}
+
+
+
+/**
+ * Count a processed card and request a stop once the number of cards given with --cards is reached
+ *
+ * @return the number of processed cards
+ */
+static int countCard() {
+	int cnt;
+
+	mutex_lock(&cardCounterLock);
+	cnt = ++cardCounter;
+	if (optCards && (cnt >= optCards))
+		stopRequested = 1;
+	mutex_unlock(&cardCounterLock);
+	return cnt;
+}
+
+
+
+/**
+ * Wait until the reader reaches the given state or a stop is requested
+ *
+ * @param lctx The local context with the reader name
+ * @param mask The state flag to wait for, either SCARD_STATE_EMPTY or SCARD_STATE_PRESENT
+ * @return SCARD_S_SUCCESS, SCARD_E_CANCELLED or a PC/SC error code
+ */
+static LONG waitForCardState(struct localContext *lctx, DWORD mask) {
+	SCARD_READERSTATE state;
+	LONG scrc;
+
+	memset(&state, 0, sizeof(state));
+	state.szReader = lctx->reader;
+	state.dwCurrentState = SCARD_STATE_UNAWARE;
+
+	while (1) {
+		scrc = SCardGetStatusChange(lctx->scardContext, 1000, &state, 1);
+
+		if (scrc == SCARD_S_SUCCESS) {
+			if (state.dwEventState & mask)
+				return SCARD_S_SUCCESS;
+			state.dwCurrentState = state.dwEventState & ~SCARD_STATE_CHANGED;
+		} else if (scrc != SCARD_E_TIMEOUT) {
+			return scrc;
+		}
+
+		if (stopRequested)
+			return SCARD_E_CANCELLED;
+	}
+}
+
+
+
+/**
+ * Wait until the card is removed and a new card is inserted
+ *
+ * @param lctx The local context with the reader name
+ * @return SCARD_S_SUCCESS or a PC/SC error code
+ */
+static LONG waitForNextCard(struct localContext *lctx) {
+	LONG scrc;
+
+	printf("Remove card\n");
+	scrc = waitForCardState(lctx, SCARD_STATE_EMPTY);
+
+	if (scrc != SCARD_S_SUCCESS)
+		return scrc;
+
+	printf("Insert next card\n");
+	return waitForCardState(lctx, SCARD_STATE_PRESENT);
+}
+
+
+
+/**
+ * Connect to the card in the reader and obtain the ATR
+ *
+ * @param lctx The local context with the reader name
+ * @param atr The buffer for the ATR
+ * @param atrlen The size of the buffer on input and the length of the ATR on output
+ * @return SCARD_S_SUCCESS or a PC/SC error code
+ */
+static LONG connectCard(struct localContext *lctx, unsigned char *atr, DWORD *atrlen) {
+	DWORD dwActiveProtocol, readernamelen, state, protocol;
+	LONG scrc;
+
+	scrc = SCardConnect(lctx->scardContext, lctx->reader, SCARD_SHARE_SHARED, SCARD_PROTOCOL_T1, &lctx->card, &dwActiveProtocol);
+
+	if (scrc != SCARD_S_SUCCESS) {
+		printf("Could not connect to card (%s)\n", pcsc_error_to_string(scrc));
+		return scrc;
+	}
+
+	readernamelen = 0;
+	scrc = SCardStatus(lctx->card, NULL, &readernamelen, &state, &protocol, atr, atrlen);
+
+	if (scrc != SCARD_S_SUCCESS) {
+		printf("Could not query card status (%s)\n", pcsc_error_to_string(scrc));
+		SCardDisconnect(lctx->card, SCARD_UNPOWER_CARD);
+	}
+
+	return scrc;
+}
+
+
+
+static void printResult(int rc) {
+	switch(rc) {
+	case RAME_OK:
+		printf("Completed\n");
+		break;
+	case RAME_OUT_OF_MEMORY:
+		printf("Out of memory error\n");
+		break;
+	case RAME_INVALID_TLV:
+		printf("Invalid TLV encoding in request from server\n");
+		break;
+	case RAME_INVALID_REQ:
+		printf("Server request invalid. Is the server URL a valid RAMOverHTTP end-point ?\n");
+		break;
+	case RAME_CARD_ERROR:
+		printf("Card communication error\n");
+		break;
+	case RAME_HOST_NOT_FOUND:
+		printf("Host not found\n");
+		break;
+	case RAME_INVALID_URL:
+		printf("URL is invalid or not found on server\n");
+		break;
+	case RAME_CONNECT_FAILED:
+		printf("Connection to host failed\n");
+		break;
+	case RAME_CURL_ERROR:
+		printf("Networking error\n");
+		break;
+	case RAME_NO_CONNECT:
+		printf("Server did not initiate connection to card. See server log for details\n");
+		break;
+	case RAME_SERVER_ABORT:
+		printf("Server aborted connection to card. See server log for details\n");
+		break;
+	case RAME_HTTP_CODE:
+		printf("Server send unexpected HTTP code\n");
+		break;
+	default:
+		printf("Error %d\n", rc);
+		break;
+	}
+}
+
+
+
+/**
+ * Process cards inserted into a single reader, performing the network exchange through the engine
+ *
+ * @param arg The reader worker structure
+ */
+static void *readerWorkerMain(void *arg) {
+	struct readerWorker *w = (struct readerWorker *)arg;
+	struct ramContext *ctx;
+	struct ramClient *client;
+	unsigned char atr[36];
+	DWORD atrlen;
+	double start, elapsed;
+	LONG scrc;
+	int rc, cnt;
+
+	scrc = SCardEstablishContext(SCARD_SCOPE_SYSTEM, NULL, NULL, &w->lctx.scardContext);
+
+	if (scrc != SCARD_S_SUCCESS) {
+		printf("%s: Could not establish context to PC/SC manager (%s)\n", w->lctx.reader, pcsc_error_to_string(scrc));
+		return NULL;
+	}
+
+	if (ramNewClient(&client) < 0) {
+		SCardReleaseContext(w->lctx.scardContext);
+		return NULL;
+	}
+
+	while (!stopRequested) {
+		if (waitForCardState(&w->lctx, SCARD_STATE_PRESENT) != SCARD_S_SUCCESS)
+			break;
+
+		atrlen = sizeof(atr);
+		if (connectCard(&w->lctx, atr, &atrlen) != SCARD_S_SUCCESS) {
+			waitForCardState(&w->lctx, SCARD_STATE_EMPTY);
+			continue;
+		}
+
+		start = now();
+
+		ramNewContext(&ctx);
+		ramSetClient(ctx, client);
+		ramSetSendApduHandler(ctx, sendApdu);
+		ramSetNotifyHandler(ctx, notify);
+		ramSetResetHandler(ctx, reset);
+		ramSetUserObject(ctx, (void *)&w->lctx);
+		ramSetURL(ctx, optURL);
+		ramSetATR(ctx, atr, atrlen);
+		rc = ramEngineConnect(w->engine, ctx);
+		ramFreeContext(&ctx);
+
+		SCardDisconnect(w->lctx.card, SCARD_UNPOWER_CARD);
+
+		elapsed = now() - start;
+		cnt = countCard();
+
+		if (rc == RAME_OK) {
+			if (!w->cards || (elapsed < w->minTime))
+				w->minTime = elapsed;
+			if (elapsed > w->maxTime)
+				w->maxTime = elapsed;
+			w->totalTime += elapsed;
+			w->cards++;
+			printf("%s: Card %d completed in %.2f s\n", w->lctx.reader, cnt, elapsed);
+		} else {
+			w->failed++;
+			printf("%s: Card %d failed after %.2f s, ", w->lctx.reader, cnt, elapsed);
+			printResult(rc);
+		}
+
+		waitForCardState(&w->lctx, SCARD_STATE_EMPTY);
+	}
+
+	ramFreeClient(&client);
+	SCardReleaseContext(w->lctx.scardContext);
+	return NULL;
+}
+
+
+
+static void *engineMain(void *arg) {
+	ramEngineRun((struct ramEngine *)arg);
+	return NULL;
+}
+
+
+
+/**
+ * Process cards in all readers concurrently until interrupted or the number of cards given with --cards is reached
+ *
+ * @param readers The multi-string list of reader names
+ * @return 0 if all cards were processed successfully
+ */
+static int processAllReaders(LPTSTR readers) {
+	struct readerWorker *workers;
+	struct ramEngine *engine;
+	THREAD engineThread;
+	LPTSTR p;
+	double start, elapsed, minTime, maxTime, totalTime;
+	int i, cnt, cards, failed;
+
+	cnt = 0;
+	for (p = readers; *p != '\0'; p += strlen(p) + 1)
+		cnt++;
+
+	workers = calloc(cnt, sizeof(struct readerWorker));
+	if (workers == NULL)
+		return RAME_OUT_OF_MEMORY;
+
+	if (ramNewEngine(&engine) < 0) {
+		free(workers);
+		return RAME_CURL_ERROR;
+	}
+
+	if (thread_create(&engineThread, engineMain, engine) != 0) {
+		ramFreeEngine(&engine);
+		free(workers);
+		return RAME_GENERAL_ERROR;
+	}
+
+	printf("Processing cards in %d readers, press Ctrl-C to stop\n", cnt);
+	start = now();
+
+	for (i = 0, p = readers; i < cnt; i++, p += strlen(p) + 1) {
+		workers[i].lctx.reader = p;
+		workers[i].engine = engine;
+		if (thread_create(&workers[i].thread, readerWorkerMain, &workers[i]) != 0) {
+			printf("%s: Could not start worker\n", p);
+			workers[i].engine = NULL;
+		}
+	}
+
+	for (i = 0; i < cnt; i++) {
+		if (workers[i].engine)
+			thread_join(&workers[i].thread);
+	}
+
+	elapsed = now() - start;
+
+	ramEngineStop(engine);
+	thread_join(&engineThread);
+	ramFreeEngine(&engine);
+
+	printf("\n%-40s %6s %6s %8s %8s %8s\n", "Reader", "Cards", "Failed", "Min[s]", "Avg[s]", "Max[s]");
+
+	cards = failed = 0;
+	minTime = maxTime = totalTime = 0;
+	for (i = 0; i < cnt; i++) {
+		struct readerWorker *w = &workers[i];
+
+		printf("%-40.40s %6d %6d %8.2f %8.2f %8.2f\n", w->lctx.reader, w->cards, w->failed,
+				w->minTime, w->cards ? w->totalTime / w->cards : 0.0, w->maxTime);
+
+		if (w->cards && (!cards || (w->minTime < minTime)))
+			minTime = w->minTime;
+		if (w->maxTime > maxTime)
+			maxTime = w->maxTime;
+		totalTime += w->totalTime;
+		cards += w->cards;
+		failed += w->failed;
+	}
+
+	printf("%-40s %6d %6d %8.2f %8.2f %8.2f\n", "Total", cards, failed,
+			minTime, cards ? totalTime / cards : 0.0, maxTime);
+	printf("\n%d cards in %.1f s, %.0f cards/hour\n", cards, elapsed, elapsed > 0 ? cards * 3600.0 / elapsed : 0.0);
+
+	free(workers);
+	return failed ? RAME_GENERAL_ERROR : RAME_OK;
+}
+
+
+
 int main(int argc, char **argv)
 {
 	struct ramContext *ctx;
+	struct ramClient *client;
 	struct localContext lctx;
 	DWORD cch = 0;
-	DWORD dwActiveProtocol;
 	LPTSTR readers = NULL;
 	LPTSTR p;
-	DWORD atrlen, readernamelen, state, protocol;
+	DWORD atrlen;
 	unsigned char atr[36];
 	LONG scrc;
 	int rc;
 
 	decodeArgs(argc, argv);
 
+	mutex_init(&cardCounterLock);
+	signal(SIGINT, onSignal);
+
 	scrc = SCardEstablishContext(SCARD_SCOPE_SYSTEM, NULL, NULL, &lctx.scardContext);
 
 	if (scrc != SCARD_S_SUCCESS) {
@@ -388,29 +775,43 @@ int main(int argc, char **argv)
 		}
 	}
 
+	if (optAllReaders) {
+		if (optURL == NULL) {
+			printf("No URL defined\n");
+			exit(1);
+		}
+		rc = processAllReaders(readers);
+		SCardReleaseContext(lctx.scardContext);
+		exit(rc == 0 ? 0 : 1);
+	}
+
 	if (!optReader)
 		optReader = readers;
 
 	lctx.reader = optReader;
 
-	scrc = SCardConnect(lctx.scardContext, lctx.reader, SCARD_SHARE_SHARED, SCARD_PROTOCOL_T1, &lctx.card, &dwActiveProtocol);
-
-	if (scrc) {
-		printf("Could not connect to card (%s)\n", pcsc_error_to_string(scrc));
+	atrlen = sizeof(atr);
+	if (connectCard(&lctx, atr, &atrlen) != SCARD_S_SUCCESS) {
 		exit(1);
 	}
 
-	readernamelen = 0;
-	atrlen = sizeof(atr);
-	scrc = SCardStatus(lctx.card, NULL, &readernamelen, &state, &protocol, atr, &atrlen);
+	if (optURL == NULL) {
+		printf("No URL defined\n");
+		SCardDisconnect(lctx.card, SCARD_UNPOWER_CARD);
+		SCardReleaseContext(lctx.scardContext);
+		exit(0);
+	}
 
-	if (scrc != SCARD_S_SUCCESS) {
-		printf("Could not query card status (%s)\n", pcsc_error_to_string(scrc));
+	// The client keeps the connection to the server open for the next card
+	rc = ramNewClient(&client);
+	if (rc < 0) {
+		printResult(rc);
 		exit(1);
 	}
 
-	if (optURL != NULL) {
+	while (1) {
 		ramNewContext(&ctx);
+		ramSetClient(ctx, client);
 		ramSetSendApduHandler(ctx, sendApdu);
 		ramSetNotifyHandler(ctx, notify);
 		ramSetResetHandler(ctx, reset);
@@ -419,56 +820,26 @@ int main(int argc, char **argv)
 		ramSetATR(ctx, atr, atrlen);
 		rc = ramConnect(ctx);
 		ramFreeContext(&ctx);
-	} else {
-		printf("No URL defined\n");
-		rc = 0;
-	}
 
-	SCardDisconnect(lctx.card, SCARD_UNPOWER_CARD);
-	SCardReleaseContext(lctx.scardContext);
+		SCardDisconnect(lctx.card, SCARD_UNPOWER_CARD);
 
-	switch(rc) {
-	case RAME_OK:
-		printf("Completed\n");
-		break;
-	case RAME_OUT_OF_MEMORY:
-		printf("Out of memory error\n");
-		break;
-	case RAME_INVALID_TLV:
-		printf("Invalid TLV encoding in request from server\n");
-		break;
-	case RAME_INVALID_REQ:
-		printf("Server request invalid. Is the server URL a valid RAMOverHTTP end-point ?\n");
-		break;
-	case RAME_CARD_ERROR:
-		printf("Card communication error\n");
-		break;
-	case RAME_HOST_NOT_FOUND:
-		printf("Host not found\n");
-		break;
-	case RAME_INVALID_URL:
-		printf("URL is invalid or not found on server\n");
-		break;
-	case RAME_CONNECT_FAILED:
-		printf("Connection to host failed\n");
-		break;
-	case RAME_CURL_ERROR:
-		printf("Networking error\n");
-		break;
-	case RAME_NO_CONNECT:
-		printf("Server did not initiate connection to card. See server log for details\n");
-		break;
-	case RAME_SERVER_ABORT:
-		printf("Server aborted connection to card. See server log for details\n");
-		break;
-	case RAME_HTTP_CODE:
-		printf("Server send unexpected HTTP code\n");
-		break;
-	default:
-		printf("Error %d\n", rc);
-		break;
+		printResult(rc);
+
+		countCard();
+
+		if (!optContinuous || stopRequested)
+			break;
+
+		if (waitForNextCard(&lctx) != SCARD_S_SUCCESS)
+			break;
+
+		atrlen = sizeof(atr);
+		if (connectCard(&lctx, atr, &atrlen) != SCARD_S_SUCCESS)
+			break;
 	}
 
+	ramFreeClient(&client);
+	SCardReleaseContext(lctx.scardContext);
+
 	exit(rc == 0 ? 0 : 1);
 }
-
@@ -40,6 +40,33 @@
 
 #include <curl/curl.h>
 
+#include <common/thread.h>
+
+
+
+/*
+ * A single HTTP exchange handed from a worker thread to the event loop of the engine
+ */
+struct ramTransfer {
+	CURL *curl;
+	CURLcode result;
+	int done;
+	struct ramTransfer *next;
+};
+
+
+
+struct ramEngine {
+	CURLM *multi;
+	MUTEX lock;
+	COND completed;				// Signaled when a transfer completes
+	struct ramTransfer *queue;	// Transfers waiting to be added to the multi handle
+	struct ramTransfer **tail;
+	struct ramTransfer *running;	// Transfers in the multi handle
+	int active;					// Number of transfers in the multi handle
+	int stop;
+};
+
 
 
 /**
@@ -104,29 +131,6 @@ static int addByteBuffer(struct ramByteBuffer *bb, unsigned char *data, size_t l
 
 
 
-/**
- * Insert bytes at the beginning of the byte buffer
- *
- * @param bb The byte buffer structure
- * @param data The data to insert
- * @param len The length of the data to insert
- * @return 0 or error code
- */
-static int insertByteBuffer(struct ramByteBuffer *bb, unsigned char *data, size_t len) {
-	int rc;
-
-	rc = adjustByteBuffer(bb, len);
-	if (rc < 0)
-		return rc;
-
-	memmove(bb->buffer + len, bb->buffer, bb->len);
-	memcpy(bb->buffer, data, len);
-	bb->len += len;
-	return 0;
-}
-
-
-
 /**
  * Clear the byte buffer
  *
@@ -254,6 +258,104 @@ static int tlvNext(unsigned char **ref, size_t *reflen, int *tag, size_t *length
 
 
 
+/**
+ * Decode tag and length of a TLV object that may not yet be completely received
+ *
+ * @param p         Pointer to first byte of tag
+ * @param avail     Number of bytes available
+ * @param tag       Pointer to variable updated with the tag value
+ * @param hlen      Pointer to variable updated with the length of tag and length field
+ * @param length    Pointer to variable updated with the length value
+ * @return          1 if decoded, 0 if more data is required or RAME_INVALID_TLV
+ */
+static int tlvHeader(unsigned char *p, size_t avail, int *tag, size_t *hlen, size_t *length)
+{
+	size_t c;
+
+	if (avail < 2)
+		return 0;
+
+	*tag = p[0];
+
+	if (!(p[1] & 0x80)) {
+		*hlen = 2;
+		*length = p[1];
+		return 1;
+	}
+
+	c = p[1] & 0x7F;
+	if ((c == 0) || (c > 2))
+		return RAME_INVALID_TLV;
+
+	if (avail < 2 + c)
+		return 0;
+
+	*length = p[2];
+	if (c == 2)
+		*length = (*length << 8) | p[3];
+
+	*hlen = 2 + c;
+	return 1;
+}
+
+
+
+/**
+ * Start a new template in the write buffer
+ *
+ * Space for the tag and length of the template is reserved at the beginning of
+ * the buffer, so that finishTemplate() can add the header without moving the content.
+ *
+ * @param ctx The initialized context
+ */
+static void beginTemplate(struct ramContext *ctx) {
+	clearByteBuffer(&ctx->writebuffer);
+	ctx->writebuffer.len = RAM_TEMPL_HEADER;
+	ctx->writeoffset = 0;
+}
+
+
+
+/**
+ * Move the finished template from the write buffer to the post buffer
+ *
+ * CURL references the posted data until the transfer completes, while the streaming
+ * parser already encodes the next template in the write call-back. Both templates
+ * therefore live in separate buffers, which are exchanged between transfers.
+ *
+ * @param ctx The initialized context
+ */
+static void swapTemplate(struct ramContext *ctx) {
+	struct ramByteBuffer bb;
+
+	bb = ctx->postbuffer;
+	ctx->postbuffer = ctx->writebuffer;
+	ctx->writebuffer = bb;
+	ctx->postoffset = ctx->writeoffset;
+	ctx->writeoffset = 0;
+}
+
+
+
+/**
+ * Encode tag and length of the template into the reserved space in front of the content
+ *
+ * @param ctx The initialized context
+ * @param tag The template tag
+ */
+static void finishTemplate(struct ramContext *ctx, unsigned char tag) {
+	unsigned char tmp[4];
+	size_t ll;
+
+	tmp[0] = tag;
+	ll = tlvEncodeLength(tmp + 1, ctx->writebuffer.len - RAM_TEMPL_HEADER) + 1;
+
+	ctx->writeoffset = RAM_TEMPL_HEADER - ll;
+	memcpy(ctx->writebuffer.buffer + ctx->writeoffset, tmp, ll);
+}
+
+
+
 /**
  * Encode a response object with the given tag and data value
  *
@@ -289,19 +391,16 @@ static int encodeResponse(struct ramContext *ctx, unsigned char tag, unsigned ch
  * @return 0 or error code
  */
 static int makeInitiationRequest(struct ramContext *ctx) {
-	unsigned char tmp[4];
 	int rc;
-	size_t ll;
+
+	beginTemplate(ctx);
 
 	rc = encodeResponse(ctx, RAM_RESET, ctx->atr, ctx->atrlen);
 	if (rc < 0)
 		return rc;
 
-	tmp[0] = RAM_INIT_TEMPL;
-	ll = tlvEncodeLength(tmp + 1, ctx->writebuffer.len);
-	rc = insertByteBuffer(&ctx->writebuffer, tmp, ll + 1);
-
-	return rc;
+	finishTemplate(ctx, RAM_INIT_TEMPL);
+	return 0;
 }
 
 
@@ -437,58 +536,164 @@ static int encodeInteger(unsigned char *p, int v) {
 
 
 /**
- * Process requests received from the server
+ * Process a single object from the request template
  *
  * @param ctx The initialized context
+ * @param tag The tag of the object
+ * @param v The value field
+ * @param tl The length of the value field
  * @return 0 or error code
  */
-static int processRequests(struct ramContext *ctx) {
-	unsigned char *p,*v;
-	unsigned char tmp[4];
-	size_t len,tl;
-	int tag,rc,rrc,apducnt;
+static int processRequest(struct ramContext *ctx, int tag, unsigned char *v, size_t tl) {
+	int rc = 0;
 
-	p = ctx->readbuffer.buffer;
+	switch(tag) {
+	case RAM_CAPDU:
+		rc = processSendApdu(ctx, v, tl);
+		if (rc == 0)
+			ctx->parser.apducnt++;
+		break;
+	case RAM_RESET:
+		rc = processReset(ctx);
+		break;
+	case RAM_NOTIFY:
+		rc = processNotify(ctx, v, tl);
+		break;
+	}
+	return rc;
+}
 
-	if (*p != RAM_REQ_TEMPL)
-		return RAME_INVALID_REQ;
 
-	p++;
-	len = tlvLength(&p);
-	if ((p - ctx->readbuffer.buffer + len) > ctx->readbuffer.len)
-		return RAME_INVALID_REQ;
 
-	rc = 0;
-	apducnt = 0;
-	while (!rc && ((rc = tlvNext(&p, &len, &tag, &tl, &v)) > 0)) {
-		switch(tag) {
-		case RAM_CAPDU:
-			rc = processSendApdu(ctx, v, tl);
+/**
+ * Reset the parser for the next response from the server
+ *
+ * @param ctx The initialized context
+ */
+static void resetParser(struct ramContext *ctx) {
+	ctx->parser.state = RAM_PARSE_TEMPLATE;
+	ctx->parser.pos = 0;
+	ctx->parser.remaining = 0;
+	ctx->parser.rc = 0;
+	ctx->parser.apducnt = 0;
+}
+
+
+
+/**
+ * Process all requests completely contained in the read buffer
+ *
+ * The function is called whenever data was added to the read buffer. Objects are
+ * processed in place as soon as they are complete, so that card processing overlaps
+ * with the transfer of the remaining request template. Once the request template
+ * header was received, a new response template is started in the write buffer.
+ *
+ * After an error, further requests are skipped but parsed, so that the server
+ * can be notified in the response template.
+ *
+ * @param ctx The initialized context
+ */
+static void parseRequests(struct ramContext *ctx) {
+	struct ramParser *ps = &ctx->parser;
+	struct ramByteBuffer *rb = &ctx->readbuffer;
+	unsigned char *p;
+	size_t avail, hl, tl;
+	int tag, rc;
+
+	while ((ps->state == RAM_PARSE_TEMPLATE) || (ps->state == RAM_PARSE_REQUESTS)) {
+		p = rb->buffer + ps->pos;
+		avail = rb->len - ps->pos;
+
+		if (ps->state == RAM_PARSE_TEMPLATE) {
+			rc = tlvHeader(p, avail, &tag, &hl, &tl);
 			if (rc == 0)
-				apducnt++;
-			break;
-		case RAM_RESET:
-			rc = processReset(ctx);
+				break;
+
+			if ((rc < 0) || (tag != RAM_REQ_TEMPL)) {
+				ps->rc = RAME_INVALID_REQ;
+				ps->state = RAM_PARSE_ERROR;
+				break;
+			}
+
+			ps->pos += hl;
+			ps->remaining = tl;
+			ps->state = RAM_PARSE_REQUESTS;
+			beginTemplate(ctx);
+			continue;
+		}
+
+		if (ps->remaining == 0) {
+			ps->state = RAM_PARSE_DONE;
 			break;
-		case RAM_NOTIFY:
-			rc = processNotify(ctx, v, tl);
+		}
+
+		if (avail > ps->remaining)
+			avail = ps->remaining;
+
+		rc = tlvHeader(p, avail, &tag, &hl, &tl);
+
+		if ((rc < 0) || ((rc == 0) && (avail == ps->remaining)) || ((rc > 0) && (hl + tl > ps->remaining))) {
+			if (!ps->rc)
+				ps->rc = RAME_INVALID_TLV;
+			ps->state = RAM_PARSE_INVALID;
 			break;
 		}
+
+		if ((rc == 0) || (hl + tl > avail))
+			break;						// Wait for more data
+
+		if (!ps->rc)
+			ps->rc = processRequest(ctx, tag, p + hl, tl);
+
+		ps->pos += hl + tl;
+		ps->remaining -= hl + tl;
+	}
+
+	// Move a partially received object to the front, rather than growing the buffer
+	if (ps->pos && ((ps->pos == rb->len) || (ps->pos >= (rb->size >> 1)))) {
+		memmove(rb->buffer, rb->buffer + ps->pos, rb->len - ps->pos);
+		rb->len -= ps->pos;
+		ps->pos = 0;
+	}
+}
+
+
+
+/**
+ * Complete processing of requests after the response was received and
+ * encode the response template
+ *
+ * @param ctx The initialized context
+ * @return 0 or error code
+ */
+static int completeRequests(struct ramContext *ctx) {
+	unsigned char tmp[4];
+	size_t len;
+	int rc;
+
+	parseRequests(ctx);
+
+	switch(ctx->parser.state) {
+	case RAM_PARSE_DONE:
+	case RAM_PARSE_INVALID:
+		break;
+	case RAM_PARSE_ERROR:
+		return ctx->parser.rc;
+	default:
+		return RAME_INVALID_REQ;		// Request template truncated
 	}
 
 	// Even if processing is aborted, we encode a response template to notify the server
 
 	// Number of processed APDUs
-	tl = encodeInteger(tmp, apducnt);
-	rrc = encodeResponse(ctx, RAM_NUM_APDU, tmp, tl);
-	if (rrc < 0)
-		return rrc;
+	len = encodeInteger(tmp, ctx->parser.apducnt);
+	rc = encodeResponse(ctx, RAM_NUM_APDU, tmp, len);
+	if (rc < 0)
+		return rc;
 
-	tmp[0] = RAM_RES_TEMPL;
-	len = tlvEncodeLength(tmp + 1, ctx->writebuffer.len);
-	insertByteBuffer(&ctx->writebuffer, tmp, len + 1);
+	finishTemplate(ctx, RAM_RES_TEMPL);
 
-	return rc;
+	return ctx->parser.rc;
 }
 
 
@@ -496,6 +701,9 @@ static int processRequests(struct ramContext *ctx) {
 /**
  * CURL call-back to process data send by the server
  *
+ * If the session is not run by an engine, then requests are processed as soon as they
+ * are received. The request to the server has been send completely at this point.
+ *
  * @param buffer The data received
  * @param size The size of a single elements
  * @param nmemb The number of elements
@@ -505,36 +713,160 @@ static int processRequests(struct ramContext *ctx) {
 static size_t write_data(void *buffer, size_t size, size_t nmemb, void *userp) {
 	struct ramContext *c = (struct ramContext *)userp;
 	size_t len = size * nmemb;
+	long httpcode;
 
 	if (addByteBuffer(&c->readbuffer, buffer, len) < 0)
 		return 0;
 
+	if (c->parser.streaming) {
+		httpcode = 0;
+		curl_easy_getinfo((CURL *)c->parser.curl, CURLINFO_RESPONSE_CODE, &httpcode);
+
+		if (httpcode == 200)
+			parseRequests(c);
+	}
+
 	return len;
 }
 
 
 
 /**
- * Establish a connection to the RAM server at the given URL and process
- * requests until the server closed the connection
+ * Create the CURL handle and set the options shared by all sessions
  *
- * Before calling ramConnect(), the context must be created with
- * ramNewContext(),  * the card's ATR must be set using ramSetATR() and the
- * server must be set using ramSetURL().
+ * The handle keeps the connection cache, the DNS cache and the TLS session
+ * cache, so that subsequent sessions to the same server reuse an established
+ * connection or at least resume the TLS session.
  *
- * The function uses the call-back functions set with ramSetSendApduHandler(),
- * ramSetResetHandler() and ramSetNotifyHandler() to perform the request card
- *  operations or notification.
+ * @param client The client structure
+ * @return 0 or error code
+ */
+static int initClient(struct ramClient *client) {
+	static const char *headers[] = {
+		"Content-Type: application/org.openscdp-content-mgt-response;version=1.0",
+		"Accept: */*",
+		"X-Admin-Protocol: globalplatform-remote-admin/1.0"
+	};
+	struct curl_slist *list;
+	CURL *curl;
+	int i;
+
+	curl = curl_easy_init();
+	if (curl == NULL)
+		return RAME_CURL_ERROR;
+
+	client->headers = NULL;
+	for (i = 0; i < (int)(sizeof(headers) / sizeof(*headers)); i++) {
+		list = curl_slist_append(client->headers, headers[i]);
+
+		if (list == NULL) {
+			curl_slist_free_all(client->headers);
+			client->headers = NULL;
+			curl_easy_cleanup(curl);
+			return RAME_OUT_OF_MEMORY;
+		}
+		client->headers = list;
+	}
+
+	curl_easy_setopt(curl, CURLOPT_HTTPHEADER, client->headers);
+	curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_data);
+	curl_easy_setopt(curl, CURLOPT_COOKIEFILE, "");
+	curl_easy_setopt(curl, CURLOPT_TIMEOUT, 20L);
+
+#if LIBCURL_VERSION_NUM >= 0x071900
+	// Keep idle connections between cards alive in NAT gateways and firewalls
+	curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+	curl_easy_setopt(curl, CURLOPT_TCP_KEEPIDLE, 30L);
+	curl_easy_setopt(curl, CURLOPT_TCP_KEEPINTVL, 15L);
+#endif
+
+#if LIBCURL_VERSION_NUM >= 0x072F00
+	// Use HTTP/2 if the server offers it during the TLS handshake
+	curl_easy_setopt(curl, CURLOPT_HTTP_VERSION, (long)CURL_HTTP_VERSION_2TLS);
+#endif
+
+	client->curl = curl;
+	return 0;
+}
+
+
+
+/**
+ * Release the CURL handle and header list
  *
- * In order to obtain caller specific data in the call-back, you can register
- * a user object using ramSetUserObject(). In the call-back the user object
- * can be received with ramGetUserObject().
+ * @param client The client structure
+ */
+static void releaseClient(struct ramClient *client) {
+	if (client->curl) {
+		curl_easy_cleanup((CURL *)client->curl);
+		client->curl = NULL;
+	}
+	if (client->headers) {
+		curl_slist_free_all(client->headers);
+		client->headers = NULL;
+	}
+}
+
+
+
+/**
+ * Wake up the event loop waiting for network events
+ *
+ * @param engine The engine
+ */
+static void wakeupEngine(struct ramEngine *engine) {
+#if LIBCURL_VERSION_NUM >= 0x074400
+	curl_multi_wakeup(engine->multi);
+#endif
+}
+
+
+
+/**
+ * Pass the transfer to the event loop of the engine and wait for completion
+ *
+ * @param engine The running engine
+ * @param curl The prepared CURL handle
+ * @return The CURL result code of the transfer
+ */
+static CURLcode enginePerform(struct ramEngine *engine, CURL *curl) {
+	struct ramTransfer transfer;
+
+	transfer.curl = curl;
+	transfer.result = CURLE_OK;
+	transfer.done = 0;
+	transfer.next = NULL;
+
+	mutex_lock(&engine->lock);
+
+	if (engine->stop) {
+		mutex_unlock(&engine->lock);
+		return CURLE_ABORTED_BY_CALLBACK;
+	}
+
+	*engine->tail = &transfer;
+	engine->tail = &transfer.next;
+	wakeupEngine(engine);
+
+	while (!transfer.done)
+		cond_wait(&engine->completed, &engine->lock);
+
+	mutex_unlock(&engine->lock);
+	return transfer.result;
+}
+
+
+
+/**
+ * Process a RAM session with the server, performing HTTP exchanges either
+ * directly or through the event loop of the engine
  *
  * @param ctx The initialized context
+ * @param engine The engine or NULL for a blocking transfer
  * @return 0 or error code
  */
-int ramConnect(struct ramContext *ctx) {
-	struct curl_slist *headers=NULL;
+static int runSession(struct ramContext *ctx, struct ramEngine *engine) {
+	struct ramClient localClient, *client;
 	CURLcode res;
 	long httpcode;
 	int rc,excnt;
@@ -546,29 +878,40 @@ int ramConnect(struct ramContext *ctx) {
 	if (!ctx->atr || !ctx->atrlen)
 		return RAME_GENERAL_ERROR;
 
-	curl = curl_easy_init();
+	client = ctx->client;
+	if (client == NULL) {
+		client = &localClient;
+		rc = initClient(client);
+		if (rc < 0)
+			return rc;
+	}
+
+	curl = (CURL *)client->curl;
 	curl_easy_setopt(curl, CURLOPT_URL, ctx->URL);
+	curl_easy_setopt(curl, CURLOPT_WRITEDATA, ctx);
 
-	headers = curl_slist_append(headers, "Content-Type: application/org.openscdp-content-mgt-response;version=1.0");
-	headers = curl_slist_append(headers, "Accept: */*");
-	headers = curl_slist_append(headers, "X-Admin-Protocol: globalplatform-remote-admin/1.0");
+	// With an engine the call-back runs in the event loop, which must not be blocked by the card
+	ctx->parser.curl = curl;
+	ctx->parser.streaming = (engine == NULL);
 
-	curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-	curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_data);
-	curl_easy_setopt(curl, CURLOPT_WRITEDATA, ctx);
-	curl_easy_setopt(curl, CURLOPT_COOKIEFILE, "");
-	curl_easy_setopt(curl, CURLOPT_TIMEOUT, 20L);
+	// Each session starts without cookies, in particular without the session id of a previous card
+	curl_easy_setopt(curl, CURLOPT_COOKIELIST, "ALL");
 
-	clearByteBuffer(&ctx->writebuffer);
 	makeInitiationRequest(ctx);
 
 	rc = 0;
 	excnt = 0;		// Counter number of received requests
 	do {
-		curl_easy_setopt(curl, CURLOPT_POSTFIELDS, (void *)ctx->writebuffer.buffer);
-		curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, (long)ctx->writebuffer.len);
+		swapTemplate(ctx);
+		curl_easy_setopt(curl, CURLOPT_POSTFIELDS, (void *)(ctx->postbuffer.buffer + ctx->postoffset));
+		curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, (long)(ctx->postbuffer.len - ctx->postoffset));
 
-		res = curl_easy_perform(curl);
+		resetParser(ctx);
+
+		if (engine)
+			res = enginePerform(engine, curl);
+		else
+			res = curl_easy_perform(curl);
 
 		switch(res) {
 		case CURLE_OK:
@@ -587,11 +930,12 @@ int ramConnect(struct ramContext *ctx) {
 			break;
 		}
 
-		curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &httpcode);
+		httpcode = 0;
+		if (res == CURLE_OK)
+			curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &httpcode);
 
 		if (httpcode == 200) {
-			clearByteBuffer(&ctx->writebuffer);
-			rc = processRequests(ctx);
+			rc = completeRequests(ctx);
 			clearByteBuffer(&ctx->readbuffer);
 			if ((rc != 0) && (rc != RAME_CARD_ERROR))
 				break;
@@ -606,6 +950,7 @@ int ramConnect(struct ramContext *ctx) {
 		else
 			rc = RAME_NO_CONNECT;
 		break;
+	case 0:				// No response, keep error from transfer
 	case 200:			// New request, but aborted
 	case 204:			// Completed
 		break;
@@ -617,12 +962,43 @@ int ramConnect(struct ramContext *ctx) {
 		rc = RAME_HTTP_CODE;
 	}
 
-	curl_easy_cleanup(curl);
+	if (client == &localClient)
+		releaseClient(client);
+
 	return rc;
 }
 
 
 
+/**
+ * Establish a connection to the RAM server at the given URL and process
+ * requests until the server closed the connection
+ *
+ * Before calling ramConnect(), the context must be created with
+ * ramNewContext(),  * the card's ATR must be set using ramSetATR() and the
+ * server must be set using ramSetURL().
+ *
+ * The function uses the call-back functions set with ramSetSendApduHandler(),
+ * ramSetResetHandler() and ramSetNotifyHandler() to perform the request card
+ *  operations or notification.
+ *
+ * In order to obtain caller specific data in the call-back, you can register
+ * a user object using ramSetUserObject(). In the call-back the user object
+ * can be received with ramGetUserObject().
+ *
+ * If a client was assigned with ramSetClient(), then the connection to the
+ * server is reused from a previous session. Otherwise a new connection is
+ * established and closed when the function returns.
+ *
+ * @param ctx The initialized context
+ * @return 0 or error code
+ */
+int ramConnect(struct ramContext *ctx) {
+	return runSession(ctx, NULL);
+}
+
+
+
 /**
  * Force closing a connection if an unrecoverable local error occurred (e.g. card removed)
  *
@@ -654,6 +1030,303 @@ void ramForceClose(struct ramContext *ctx, char *msg) {
 
 
 
+/**
+ * Allocate and initialize a new client.
+ *
+ * A client keeps the connection to the server open between sessions. It is
+ * assigned to one or more contexts with ramSetClient() and must be released
+ * with ramFreeClient() after the last session completed. A client must not be
+ * used by more than one thread at a time.
+ *
+ * @param client A pointer to the client pointer.
+ * @return 0 or error code
+ */
+int ramNewClient(struct ramClient **client) {
+	int rc;
+	struct ramClient *c;
+
+	c = (struct ramClient *)calloc(1, sizeof(struct ramClient));
+	if (c == NULL)
+		return RAME_OUT_OF_MEMORY;
+
+	rc = initClient(c);
+	if (rc < 0) {
+		free(c);
+		return rc;
+	}
+
+	*client = c;
+	return 0;
+}
+
+
+
+/**
+ * Release client and close any open connection.
+ *
+ * @param client A pointer to the client pointer.
+ */
+void ramFreeClient(struct ramClient **client) {
+	releaseClient(*client);
+
+	free(*client);
+	*client = NULL;
+}
+
+
+
+/**
+ * Allocate and initialize a new engine.
+ *
+ * The engine performs the HTTP exchanges of many concurrent sessions in a single
+ * event loop using a libcurl multi handle. The event loop is run by ramEngineRun(),
+ * usually in a dedicated thread. Sessions are started with ramEngineConnect() from
+ * worker threads, typically one per card reader. The worker thread is blocked while
+ * the exchange is in transfer and performs the card operations itself, so that network
+ * waits of one card overlap with card processing of others.
+ *
+ * Connections to the server are kept in the connection cache of the multi handle and
+ * shared by all sessions.
+ *
+ * @param engine A pointer to the engine pointer.
+ * @return 0 or error code
+ */
+int ramNewEngine(struct ramEngine **engine) {
+	struct ramEngine *e;
+
+	e = (struct ramEngine *)calloc(1, sizeof(struct ramEngine));
+	if (e == NULL)
+		return RAME_OUT_OF_MEMORY;
+
+	curl_global_init(CURL_GLOBAL_ALL);
+
+	e->multi = curl_multi_init();
+	if (e->multi == NULL) {
+		free(e);
+		return RAME_CURL_ERROR;
+	}
+
+	if (mutex_init(&e->lock) != 0) {
+		curl_multi_cleanup(e->multi);
+		free(e);
+		return RAME_GENERAL_ERROR;
+	}
+
+	if (cond_init(&e->completed) != 0) {
+		mutex_destroy(&e->lock);
+		curl_multi_cleanup(e->multi);
+		free(e);
+		return RAME_GENERAL_ERROR;
+	}
+
+	e->tail = &e->queue;
+	*engine = e;
+	return 0;
+}
+
+
+
+/**
+ * Release engine.
+ *
+ * The event loop must have returned from ramEngineRun().
+ *
+ * @param engine A pointer to the engine pointer.
+ */
+void ramFreeEngine(struct ramEngine **engine) {
+	struct ramEngine *e = *engine;
+
+	curl_multi_cleanup(e->multi);
+	cond_destroy(&e->completed);
+	mutex_destroy(&e->lock);
+
+	free(e);
+	*engine = NULL;
+
+	curl_global_cleanup();
+}
+
+
+
+/**
+ * Complete a transfer and wake up the waiting worker thread
+ *
+ * @param engine The engine
+ * @param transfer The transfer
+ * @param result The CURL result code
+ */
+static void completeTransfer(struct ramEngine *engine, struct ramTransfer *transfer, CURLcode result) {
+	mutex_lock(&engine->lock);
+	transfer->result = result;
+	transfer->done = 1;
+	cond_broadcast(&engine->completed);
+	mutex_unlock(&engine->lock);
+}
+
+
+
+/**
+ * Remove a completed transfer from the list of running transfers
+ *
+ * @param engine The engine
+ * @param transfer The transfer
+ */
+static void removeTransfer(struct ramEngine *engine, struct ramTransfer *transfer) {
+	struct ramTransfer **p;
+
+	for (p = &engine->running; *p; p = &(*p)->next) {
+		if (*p == transfer) {
+			*p = transfer->next;
+			break;
+		}
+	}
+	curl_multi_remove_handle(engine->multi, transfer->curl);
+	engine->active--;
+}
+
+
+
+/**
+ * Stop the engine after a failure of the event loop and fail all running and
+ * queued transfers, so that the waiting worker threads return
+ *
+ * @param engine The engine
+ */
+static void abortEngine(struct ramEngine *engine) {
+	struct ramTransfer *transfer, *list;
+
+	while ((transfer = engine->running) != NULL) {
+		removeTransfer(engine, transfer);
+		completeTransfer(engine, transfer, CURLE_ABORTED_BY_CALLBACK);
+	}
+
+	mutex_lock(&engine->lock);
+	engine->stop = 1;
+	list = engine->queue;
+	engine->queue = NULL;
+	engine->tail = &engine->queue;
+	mutex_unlock(&engine->lock);
+
+	while ((transfer = list) != NULL) {
+		list = transfer->next;
+		completeTransfer(engine, transfer, CURLE_ABORTED_BY_CALLBACK);
+	}
+}
+
+
+
+/**
+ * Run the event loop of the engine until ramEngineStop() is called and all
+ * pending transfers completed
+ *
+ * If the event loop fails, then all pending transfers fail, the engine is stopped
+ * and RAME_CURL_ERROR is returned.
+ *
+ * @param engine The initialized engine
+ * @return 0 or error code
+ */
+int ramEngineRun(struct ramEngine *engine) {
+	struct ramTransfer *transfer, *list;
+	CURLMsg *msg;
+	CURLMcode mc;
+	CURLcode result;
+	int running, msgs;
+
+	while (1) {
+		mutex_lock(&engine->lock);
+		list = engine->queue;
+		engine->queue = NULL;
+		engine->tail = &engine->queue;
+
+		if (engine->stop && !list && !engine->active) {
+			mutex_unlock(&engine->lock);
+			break;
+		}
+		mutex_unlock(&engine->lock);
+
+		while ((transfer = list) != NULL) {
+			list = transfer->next;
+			curl_easy_setopt(transfer->curl, CURLOPT_PRIVATE, (void *)transfer);
+			mc = curl_multi_add_handle(engine->multi, transfer->curl);
+
+			if (mc != CURLM_OK) {
+				completeTransfer(engine, transfer, CURLE_FAILED_INIT);
+			} else {
+				transfer->next = engine->running;
+				engine->running = transfer;
+				engine->active++;
+			}
+		}
+
+		mc = curl_multi_perform(engine->multi, &running);
+		if (mc != CURLM_OK) {
+			abortEngine(engine);
+			return RAME_CURL_ERROR;
+		}
+
+		while ((msg = curl_multi_info_read(engine->multi, &msgs)) != NULL) {
+			if (msg->msg != CURLMSG_DONE)
+				continue;
+
+			curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, (char **)&transfer);
+			result = msg->data.result;
+			removeTransfer(engine, transfer);
+			completeTransfer(engine, transfer, result);
+		}
+
+#if LIBCURL_VERSION_NUM >= 0x074400
+		mc = curl_multi_poll(engine->multi, NULL, 0, 1000, NULL);
+#else
+		// No way to wake up the loop, so poll the queue in short intervals
+		mc = curl_multi_wait(engine->multi, NULL, 0, 10, NULL);
+#endif
+		if (mc != CURLM_OK) {
+			abortEngine(engine);
+			return RAME_CURL_ERROR;
+		}
+	}
+
+	return 0;
+}
+
+
+
+/**
+ * Stop the event loop of the engine
+ *
+ * Transfers already queued are completed. Sessions trying further exchanges fail with
+ * RAME_CURL_ERROR. Call after all worker threads completed their sessions.
+ *
+ * @param engine The running engine
+ */
+void ramEngineStop(struct ramEngine *engine) {
+	mutex_lock(&engine->lock);
+	engine->stop = 1;
+	wakeupEngine(engine);
+	mutex_unlock(&engine->lock);
+}
+
+
+
+/**
+ * Establish a connection to the RAM server and process requests until the server
+ * closed the connection, performing the HTTP exchanges in the event loop of the engine
+ *
+ * The function is the equivalent to ramConnect() and blocks the calling thread until the
+ * session completes. The call-backs are called in the context of the calling thread. Each
+ * context shall have a separate client assigned with ramSetClient(), so that the connection
+ * state of a reader is retained across sessions.
+ *
+ * @param engine The running engine
+ * @param ctx The initialized context
+ * @return 0 or error code
+ */
+int ramEngineConnect(struct ramEngine *engine, struct ramContext *ctx) {
+	return runSession(ctx, engine);
+}
+
+
+
 /**
  * Allocate and initialize a new context.
  *
@@ -682,6 +1355,12 @@ int ramNewContext(struct ramContext **ctx) {
 		return rc;
 	}
 
+	rc = initByteBuffer(&c->postbuffer, 512);
+	if (rc < 0) {
+		ramFreeContext(&c);
+		return rc;
+	}
+
 	*ctx = c;
 	return 0;
 }
@@ -697,6 +1376,7 @@ int ramNewContext(struct ramContext **ctx) {
 void ramFreeContext(struct ramContext **ctx) {
 	freeByteBuffer(&(*ctx)->readbuffer);
 	freeByteBuffer(&(*ctx)->writebuffer);
+	freeByteBuffer(&(*ctx)->postbuffer);
 
 	free(*ctx);
 	*ctx = NULL;
@@ -704,6 +1384,20 @@ void ramFreeContext(struct ramContext **ctx) {
 
 
 
+/**
+ * Set client used to connect to the server
+ *
+ * The code does not copy the client.
+ *
+ * @param ctx The initialized context
+ * @param client The client created with ramNewClient()
+ */
+void ramSetClient(struct ramContext *ctx, struct ramClient *client) {
+	ctx->client = client;
+}
+
+
+
 /**
  * Set user object for call-back functions
  *
@@ -74,6 +74,7 @@ extern "C" {
 
 
 struct ramContext;
+struct ramEngine;
 
 typedef int (*ramSendApdu_t) (struct ramContext *, unsigned char *, size_t , unsigned char *, size_t *);
 typedef int (*ramReset_t) (struct ramContext *, unsigned char *, size_t *);
@@ -89,13 +90,47 @@ struct ramByteBuffer {
 
 
 
+struct ramClient {
+	void *curl;					// CURL easy handle kept across sessions
+	struct curl_slist *headers;	// Request headers used by the handle
+};
+
+
+
+/* Space reserved for tag and length of a template in the write buffer */
+#define RAM_TEMPL_HEADER	4
+
+/* Parser states */
+#define RAM_PARSE_TEMPLATE	0			/** Waiting for request template header */
+#define RAM_PARSE_REQUESTS	1			/** Parsing objects in request template */
+#define RAM_PARSE_DONE		2			/** Request template completely processed */
+#define RAM_PARSE_INVALID	3			/** Invalid object in request template */
+#define RAM_PARSE_ERROR		4			/** No valid request template */
+
+struct ramParser {
+	int state;					// Parser state
+	size_t pos;					// Offset of next unparsed byte in read buffer
+	size_t remaining;			// Remaining bytes in request template
+	int rc;						// First error during processing
+	int apducnt;				// Number of successfully processed APDUs
+	int streaming;				// Process requests while receiving
+	void *curl;					// CURL handle performing the transfer
+};
+
+
+
 struct ramContext {
+	struct ramClient *client;
 	char *URL;
 	unsigned char *atr;
 	size_t atrlen;
 	void *userObject;
 	struct ramByteBuffer readbuffer;
 	struct ramByteBuffer writebuffer;
+	size_t writeoffset;			// Start of template in write buffer
+	struct ramByteBuffer postbuffer;	// Template send in the running HTTP exchange
+	size_t postoffset;			// Start of template in post buffer
+	struct ramParser parser;
 	ramSendApdu_t sendApdu;
 	ramReset_t reset;
 	ramNotify_t notify;
@@ -103,8 +138,11 @@ struct ramContext {
 
 
 
+int ramNewClient(struct ramClient **);
+void ramFreeClient(struct ramClient **);
 int ramNewContext(struct ramContext **);
 void ramFreeContext(struct ramContext **);
+void ramSetClient(struct ramContext *, struct ramClient *);
 void ramSetUserObject(struct ramContext *, void *);
 void *ramGetUserObject(struct ramContext *);
 void ramSetURL(struct ramContext *, char *);
@@ -115,6 +153,12 @@ void ramSetNotifyHandler(struct ramContext *, ramNotify_t);
 int ramConnect(struct ramContext *);
 void ramForceClose(struct ramContext *, char *msg);
 
+int ramNewEngine(struct ramEngine **);
+void ramFreeEngine(struct ramEngine **);
+int ramEngineRun(struct ramEngine *);
+void ramEngineStop(struct ramEngine *);
+int ramEngineConnect(struct ramEngine *, struct ramContext *);
+
 /* Support for C++ compiler ----------------------------------------------- */
 
 #ifdef __cplusplus
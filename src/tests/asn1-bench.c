@@ -0,0 +1,391 @@
+/**
+ * SmartCard-HSM PKCS#11 Module
+ *
+ * Copyright (c) 2013, CardContact Systems GmbH, Minden, Germany
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of CardContact Systems GmbH nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CardContact Systems GmbH BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file asn1-bench.c
+ * @brief Microbenchmark for decoding certificates and PKCS#15 descriptions
+ *
+ * The program decodes the issuer, subject, serial number and public key of a
+ * certificate using a sequential asn1Validate() / asn1Next() walk per field
+ * and using a single asn1Index() pass. It also measures the throughput of the
+ * PKCS#15 private key and certificate description decoder.
+ *
+ * Usage: asn1-bench [iterations]
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include <pkcs11/asn1.h>
+#include <pkcs11/pkcs15.h>
+
+
+
+/* PKCS#15 private key description for a RSA 2048 key */
+static unsigned char prkd[] = {
+	0x30, 0x46, 0x30, 0x17, 0x0C, 0x11, 0x42, 0x65, 0x6E, 0x63, 0x68, 0x6D, 0x61, 0x72, 0x6B, 0x20,
+	0x52, 0x53, 0x41, 0x20, 0x4B, 0x65, 0x79, 0x03, 0x02, 0x07, 0x80, 0x30, 0x1D, 0x04, 0x14, 0x01,
+	0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0x10, 0x11,
+	0x12, 0x13, 0x14, 0x03, 0x02, 0x05, 0x60, 0x02, 0x01, 0x01, 0xA1, 0x0C, 0x30, 0x0A, 0x30, 0x04,
+	0x04, 0x02, 0xCE, 0x01, 0x02, 0x02, 0x08, 0x00
+};
+
+
+
+/* PKCS#15 certificate description */
+static unsigned char cd[] = {
+	0x30, 0x3B, 0x30, 0x17, 0x0C, 0x15, 0x42, 0x65, 0x6E, 0x63, 0x68, 0x6D, 0x61, 0x72, 0x6B, 0x20,
+	0x43, 0x65, 0x72, 0x74, 0x69, 0x66, 0x69, 0x63, 0x61, 0x74, 0x65, 0x30, 0x16, 0x04, 0x14, 0x01,
+	0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0x10, 0x11,
+	0x12, 0x13, 0x14, 0xA1, 0x08, 0x30, 0x06, 0x30, 0x04, 0x04, 0x02, 0xCA, 0x01
+};
+
+
+
+/* Self-signed RSA 2048 certificate with extensions */
+static unsigned char cert[] = {
+	0x30, 0x82, 0x03, 0xF1, 0x30, 0x82, 0x02, 0xD9, 0xA0, 0x03, 0x02, 0x01, 0x02, 0x02, 0x14, 0x3F,
+	0xC0, 0xBA, 0xCF, 0xE7, 0xA1, 0xCB, 0xE6, 0x8A, 0xBC, 0x94, 0x48, 0x53, 0xC6, 0x2D, 0x65, 0x94,
+	0x2E, 0xBC, 0xF5, 0x30, 0x0D, 0x06, 0x09, 0x2A, 0x86, 0x48, 0x86, 0xF7, 0x0D, 0x01, 0x01, 0x0B,
+	0x05, 0x00, 0x30, 0x61, 0x31, 0x0B, 0x30, 0x09, 0x06, 0x03, 0x55, 0x04, 0x06, 0x13, 0x02, 0x44,
+	0x45, 0x31, 0x21, 0x30, 0x1F, 0x06, 0x03, 0x55, 0x04, 0x0A, 0x0C, 0x18, 0x43, 0x61, 0x72, 0x64,
+	0x43, 0x6F, 0x6E, 0x74, 0x61, 0x63, 0x74, 0x20, 0x53, 0x79, 0x73, 0x74, 0x65, 0x6D, 0x73, 0x20,
+	0x47, 0x6D, 0x62, 0x48, 0x31, 0x0D, 0x30, 0x0B, 0x06, 0x03, 0x55, 0x04, 0x0B, 0x0C, 0x04, 0x54,
+	0x65, 0x73, 0x74, 0x31, 0x20, 0x30, 0x1E, 0x06, 0x03, 0x55, 0x04, 0x03, 0x0C, 0x17, 0x53, 0x6D,
+	0x61, 0x72, 0x74, 0x43, 0x61, 0x72, 0x64, 0x2D, 0x48, 0x53, 0x4D, 0x20, 0x42, 0x65, 0x6E, 0x63,
+	0x68, 0x6D, 0x61, 0x72, 0x6B, 0x30, 0x1E, 0x17, 0x0D, 0x32, 0x36, 0x31, 0x30, 0x31, 0x38, 0x31,
+	0x34, 0x33, 0x34, 0x32, 0x32, 0x5A, 0x17, 0x0D, 0x32, 0x37, 0x31, 0x30, 0x31, 0x38, 0x31, 0x34,
+	0x33, 0x34, 0x32, 0x32, 0x5A, 0x30, 0x61, 0x31, 0x0B, 0x30, 0x09, 0x06, 0x03, 0x55, 0x04, 0x06,
+	0x13, 0x02, 0x44, 0x45, 0x31, 0x21, 0x30, 0x1F, 0x06, 0x03, 0x55, 0x04, 0x0A, 0x0C, 0x18, 0x43,
+	0x61, 0x72, 0x64, 0x43, 0x6F, 0x6E, 0x74, 0x61, 0x63, 0x74, 0x20, 0x53, 0x79, 0x73, 0x74, 0x65,
+	0x6D, 0x73, 0x20, 0x47, 0x6D, 0x62, 0x48, 0x31, 0x0D, 0x30, 0x0B, 0x06, 0x03, 0x55, 0x04, 0x0B,
+	0x0C, 0x04, 0x54, 0x65, 0x73, 0x74, 0x31, 0x20, 0x30, 0x1E, 0x06, 0x03, 0x55, 0x04, 0x03, 0x0C,
+	0x17, 0x53, 0x6D, 0x61, 0x72, 0x74, 0x43, 0x61, 0x72, 0x64, 0x2D, 0x48, 0x53, 0x4D, 0x20, 0x42,
+	0x65, 0x6E, 0x63, 0x68, 0x6D, 0x61, 0x72, 0x6B, 0x30, 0x82, 0x01, 0x22, 0x30, 0x0D, 0x06, 0x09,
+	0x2A, 0x86, 0x48, 0x86, 0xF7, 0x0D, 0x01, 0x01, 0x01, 0x05, 0x00, 0x03, 0x82, 0x01, 0x0F, 0x00,
+	0x30, 0x82, 0x01, 0x0A, 0x02, 0x82, 0x01, 0x01, 0x00, 0xA7, 0x12, 0xFD, 0x9D, 0x83, 0xB8, 0xCC,
+	0x8A, 0xF4, 0x0F, 0xC2, 0x15, 0x75, 0x14, 0xBA, 0x94, 0xBF, 0xAD, 0xF0, 0x37, 0x74, 0xD4, 0x45,
+	0x6C, 0x9A, 0x90, 0x51, 0x3B, 0xE4, 0x40, 0x0A, 0xE8, 0xAC, 0x70, 0x4B, 0xE8, 0x56, 0x3E, 0x0F,
+	0x6B, 0xB4, 0xA2, 0x21, 0xB6, 0x52, 0x71, 0xF1, 0x4B, 0x10, 0xF3, 0x84, 0xE5, 0xF5, 0x45, 0x4B,
+	0xB9, 0x19, 0xD8, 0xFF, 0xE8, 0x12, 0xDE, 0x5F, 0x8B, 0x33, 0x96, 0xE1, 0xC9, 0xE6, 0x55, 0xEA,
+	0xB7, 0xF0, 0x52, 0x80, 0x2C, 0xD3, 0x14, 0x27, 0x90, 0xE8, 0x80, 0xF2, 0xDB, 0x0E, 0x5B, 0xA1,
+	0xD5, 0x55, 0xC7, 0xB6, 0xC6, 0x3E, 0x60, 0x58, 0x92, 0x97, 0x2C, 0xE6, 0xFC, 0x52, 0xBE, 0xC4,
+	0x62, 0x6E, 0xF9, 0x19, 0x98, 0xF0, 0xB9, 0x40, 0xAC, 0xB5, 0x3F, 0xBC, 0x43, 0xE9, 0xEA, 0xA1,
+	0x45, 0xB3, 0xA4, 0xF5, 0x30, 0x96, 0xDF, 0x6F, 0x35, 0x23, 0xE3, 0x61, 0xA7, 0x4F, 0x6A, 0xB1,
+	0x07, 0x24, 0x6D, 0xAF, 0x6F, 0xD3, 0xBC, 0xC8, 0x6A, 0x12, 0xF3, 0xE5, 0xBB, 0xB5, 0xCF, 0x34,
+	0x7E, 0xE9, 0x13, 0x24, 0xD4, 0x00, 0x60, 0x58, 0x3B, 0x43, 0xFF, 0xED, 0xB5, 0x0A, 0x5F, 0x2A,
+	0x2B, 0xF2, 0x0D, 0x97, 0xCF, 0xAC, 0xAA, 0x7B, 0xF9, 0x58, 0x49, 0xB1, 0x8B, 0xA6, 0x2A, 0xAB,
+	0x6C, 0x62, 0xE4, 0xFA, 0x78, 0x02, 0xD0, 0x1E, 0x27, 0xE2, 0x64, 0x71, 0x4A, 0x32, 0x85, 0x86,
+	0xB8, 0x2F, 0x4D, 0x8D, 0x35, 0x1E, 0x3D, 0xAA, 0xBF, 0xE4, 0xA2, 0x43, 0x87, 0xF9, 0x96, 0xD0,
+	0x4F, 0x5F, 0x44, 0xC2, 0xCE, 0x30, 0xAC, 0x90, 0xED, 0x5C, 0xA4, 0x17, 0xEE, 0x32, 0xF4, 0x04,
+	0xDB, 0xC6, 0x9F, 0xF4, 0x90, 0xB1, 0x40, 0x84, 0x96, 0xE1, 0x10, 0x19, 0xFF, 0xAD, 0xFB, 0x33,
+	0x5B, 0x34, 0x00, 0xA1, 0xE0, 0xFF, 0x5B, 0xAE, 0x85, 0x02, 0x03, 0x01, 0x00, 0x01, 0xA3, 0x81,
+	0xA0, 0x30, 0x81, 0x9D, 0x30, 0x1D, 0x06, 0x03, 0x55, 0x1D, 0x0E, 0x04, 0x16, 0x04, 0x14, 0x17,
+	0x79, 0x16, 0x5E, 0x49, 0x01, 0x25, 0xF3, 0xE2, 0x4A, 0x5E, 0xCA, 0xBA, 0xAF, 0xE5, 0x28, 0x10,
+	0x68, 0x8C, 0xD6, 0x30, 0x1F, 0x06, 0x03, 0x55, 0x1D, 0x23, 0x04, 0x18, 0x30, 0x16, 0x80, 0x14,
+	0x17, 0x79, 0x16, 0x5E, 0x49, 0x01, 0x25, 0xF3, 0xE2, 0x4A, 0x5E, 0xCA, 0xBA, 0xAF, 0xE5, 0x28,
+	0x10, 0x68, 0x8C, 0xD6, 0x30, 0x0F, 0x06, 0x03, 0x55, 0x1D, 0x13, 0x01, 0x01, 0xFF, 0x04, 0x05,
+	0x30, 0x03, 0x01, 0x01, 0xFF, 0x30, 0x0E, 0x06, 0x03, 0x55, 0x1D, 0x0F, 0x01, 0x01, 0xFF, 0x04,
+	0x04, 0x03, 0x02, 0x05, 0xA0, 0x30, 0x1D, 0x06, 0x03, 0x55, 0x1D, 0x25, 0x04, 0x16, 0x30, 0x14,
+	0x06, 0x08, 0x2B, 0x06, 0x01, 0x05, 0x05, 0x07, 0x03, 0x02, 0x06, 0x08, 0x2B, 0x06, 0x01, 0x05,
+	0x05, 0x07, 0x03, 0x04, 0x30, 0x1B, 0x06, 0x03, 0x55, 0x1D, 0x11, 0x04, 0x14, 0x30, 0x12, 0x81,
+	0x10, 0x74, 0x65, 0x73, 0x74, 0x40, 0x65, 0x78, 0x61, 0x6D, 0x70, 0x6C, 0x65, 0x2E, 0x63, 0x6F,
+	0x6D, 0x30, 0x0D, 0x06, 0x09, 0x2A, 0x86, 0x48, 0x86, 0xF7, 0x0D, 0x01, 0x01, 0x0B, 0x05, 0x00,
+	0x03, 0x82, 0x01, 0x01, 0x00, 0x02, 0xE6, 0xE3, 0xDE, 0xDE, 0x8B, 0x2D, 0xC3, 0xA1, 0xEC, 0xB2,
+	0x09, 0x17, 0x81, 0x66, 0x20, 0xE7, 0x1B, 0xBB, 0xA2, 0x0F, 0xB4, 0xD0, 0x81, 0x86, 0x40, 0x49,
+	0xF4, 0x4A, 0x8E, 0xCC, 0x9A, 0x73, 0xD0, 0xA2, 0x30, 0x33, 0x52, 0x90, 0x0B, 0x85, 0x31, 0x2A,
+	0xDC, 0x28, 0xE7, 0x8B, 0xFF, 0x98, 0xE8, 0x7C, 0xEA, 0x06, 0x85, 0x86, 0x5B, 0x80, 0xAC, 0xD3,
+	0x77, 0x2F, 0x95, 0x19, 0x2A, 0x8F, 0x2C, 0xF0, 0x45, 0x8C, 0x66, 0xC8, 0x67, 0x9A, 0xB3, 0x96,
+	0xA9, 0xCD, 0x35, 0x18, 0x1D, 0x12, 0x96, 0xBE, 0xF9, 0x8D, 0xBA, 0xC1, 0xB3, 0x98, 0xFE, 0xA2,
+	0x0D, 0xA4, 0x6A, 0x5F, 0xC6, 0x4D, 0xF7, 0xD6, 0x66, 0x4E, 0x26, 0x94, 0x39, 0x9A, 0xED, 0x5B,
+	0x67, 0x68, 0x74, 0x2A, 0xA1, 0xF0, 0xEE, 0x5E, 0x9E, 0xE5, 0x8A, 0x72, 0xB4, 0xF2, 0x9C, 0x5E,
+	0xB4, 0x56, 0x4C, 0xD3, 0xFF, 0xB5, 0xE5, 0xBA, 0xE2, 0x57, 0x83, 0x53, 0x2B, 0x47, 0xA2, 0x1B,
+	0x46, 0xC9, 0xD1, 0x09, 0xAA, 0x70, 0x8A, 0x40, 0x8A, 0x7F, 0xF0, 0xB9, 0xF0, 0x28, 0x31, 0x96,
+	0x47, 0x39, 0x19, 0xF5, 0xF6, 0xF9, 0x87, 0xF4, 0x1E, 0x08, 0x3B, 0xDC, 0x6E, 0x2B, 0x53, 0xA5,
+	0x7A, 0x68, 0xE8, 0x7F, 0xD0, 0x43, 0x30, 0xD4, 0x63, 0xE2, 0xE3, 0x56, 0xB0, 0xD5, 0xB2, 0xC2,
+	0xCE, 0xC2, 0x37, 0x5D, 0x48, 0x87, 0xFB, 0x18, 0xF1, 0xD9, 0x7B, 0xAE, 0x0B, 0x86, 0x00, 0x2D,
+	0xFF, 0x28, 0x96, 0xF3, 0xA5, 0x09, 0x4E, 0x34, 0xB4, 0x3A, 0x63, 0x0E, 0xEC, 0x4B, 0x60, 0x26,
+	0xF2, 0xBC, 0x0A, 0x06, 0x8B, 0x1F, 0x73, 0xA8, 0xB5, 0xFB, 0xC7, 0x3A, 0x94, 0x5B, 0xDF, 0x1A,
+	0xDC, 0xD9, 0xBD, 0x34, 0x14, 0x3E, 0x2C, 0x1B, 0xFB, 0x27, 0x57, 0x98, 0xDF, 0x69, 0x50, 0xB5,
+	0x07, 0xD7, 0xBF, 0x58, 0x33
+};
+
+
+
+struct certFields {
+	unsigned char *serial;
+	int serialLen;
+	unsigned char *issuer;
+	int issuerLen;
+	unsigned char *subject;
+	int subjectLen;
+	unsigned char *spki;
+	int spkiLen;
+};
+
+
+
+static double now() {
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+
+
+/*
+ * Walk from the start of the certificate to the TBSCertificate and skip the
+ * optional version field, as done for each requested field before the index
+ */
+static int enterTBSCertificate(unsigned char *cert, int certlen, unsigned char **cursor, int *buflen)
+{
+	unsigned char *value, *po;
+	int tag, length, len;
+
+	*cursor = cert;
+	*buflen = certlen;
+
+	if (asn1Validate(*cursor, *buflen)) {
+		return -1;
+	}
+
+	if (!asn1Next(cursor, buflen, &tag, &length, &value)) {		// Certificate
+		return -1;
+	}
+
+	*cursor = value;
+	*buflen = length;
+
+	if (!asn1Next(cursor, buflen, &tag, &length, &value)) {		// TBSCertificate
+		return -1;
+	}
+
+	*cursor = value;
+	*buflen = length;
+
+	po = *cursor;
+	len = *buflen;
+
+	if (!asn1Next(&po, &len, &tag, &length, &value)) {
+		return -1;
+	}
+
+	if (tag == 0xA0) {							// Skip version
+		*cursor = po;
+		*buflen = len;
+	}
+
+	return 0;
+}
+
+
+
+/*
+ * Return the encoding of the nth field after the optional version
+ */
+static int legacyField(unsigned char *cert, int certlen, int n, unsigned char **field, int *fieldlen)
+{
+	unsigned char *cursor, *value, *po;
+	int buflen, tag, length;
+
+	if (enterTBSCertificate(cert, certlen, &cursor, &buflen) < 0) {
+		return -1;
+	}
+
+	do	{
+		po = cursor;
+		if (!asn1Next(&cursor, &buflen, &tag, &length, &value)) {
+			return -1;
+		}
+	} while (n--);
+
+	*field = po;
+	*fieldlen = (int)(value - po) + length;
+	return 0;
+}
+
+
+
+/*
+ * Decode all fields with one validation and walk for issuer, subject and
+ * serial number and another for the public key, like the previous
+ * populateIssuerSubjectSerial() and getSubjectPublicKeyInfo()
+ */
+static int decodeLegacy(unsigned char *cert, int certlen, struct certFields *f)
+{
+	if (legacyField(cert, certlen, 0, &f->serial, &f->serialLen) < 0) {
+		return -1;
+	}
+
+	if (legacyField(cert, certlen, 2, &f->issuer, &f->issuerLen) < 0) {
+		return -1;
+	}
+
+	if (legacyField(cert, certlen, 4, &f->subject, &f->subjectLen) < 0) {
+		return -1;
+	}
+
+	if (legacyField(cert, certlen, 5, &f->spki, &f->spkiLen) < 0) {
+		return -1;
+	}
+
+	return 0;
+}
+
+
+
+static int indexField(unsigned char *cert, struct asn1Node *nodes, int count, int tbs, int n, unsigned char **field, int *fieldlen)
+{
+	int i;
+
+	i = asn1IndexChild(nodes, count, tbs, n);
+
+	if (i < 0) {
+		return -1;
+	}
+
+	*field = cert + nodes[i].offset;
+	*fieldlen = nodes[i].value - nodes[i].offset + nodes[i].length;
+	return 0;
+}
+
+
+
+/*
+ * Decode all fields from a single index of the certificate
+ */
+static int decodeIndexed(unsigned char *cert, int certlen, struct certFields *f)
+{
+	struct asn1Node nodes[32];
+	int count, tbs, first, i;
+
+	count = asn1Index(cert, certlen, 2, nodes, 32);
+
+	if (count <= 0) {
+		return -1;
+	}
+
+	tbs = asn1IndexChild(nodes, count, 0, 0);
+	i = asn1IndexChild(nodes, count, tbs, 0);
+
+	if (i < 0) {
+		return -1;
+	}
+
+	first = nodes[i].tag == 0xA0 ? 1 : 0;
+
+	if ((indexField(cert, nodes, count, tbs, first, &f->serial, &f->serialLen) < 0) ||
+		(indexField(cert, nodes, count, tbs, first + 2, &f->issuer, &f->issuerLen) < 0) ||
+		(indexField(cert, nodes, count, tbs, first + 4, &f->subject, &f->subjectLen) < 0) ||
+		(indexField(cert, nodes, count, tbs, first + 5, &f->spki, &f->spkiLen) < 0)) {
+		return -1;
+	}
+
+	return 0;
+}
+
+
+
+static void report(char *name, int iterations, double elapsed)
+{
+	printf("%-32s %8d in %7.3f s, %10.0f/s\n", name, iterations, elapsed, iterations / elapsed);
+}
+
+
+
+int main(int argc, char **argv)
+{
+	struct p15PrivateKeyDescription *p15prkd;
+	struct p15CertificateDescription *p15cd;
+	struct certFields legacy, indexed;
+	double start, tlegacy, tindexed;
+	int iterations, i;
+
+	iterations = argc > 1 ? atoi(argv[1]) : 10000;
+
+	if (iterations <= 0) {
+		printf("Usage: asn1-bench [iterations]\n");
+		return 1;
+	}
+
+	if ((decodeLegacy(cert, sizeof(cert), &legacy) < 0) || (decodeIndexed(cert, sizeof(cert), &indexed) < 0)) {
+		printf("Certificate decoding failed\n");
+		return 1;
+	}
+
+	if (memcmp(&legacy, &indexed, sizeof(legacy))) {
+		printf("Fields decoded with index differ from sequential walk\n");
+		return 1;
+	}
+
+	start = now();
+	for (i = 0; i < iterations; i++) {
+		if (decodeLegacy(cert, sizeof(cert), &legacy) < 0) {
+			printf("Certificate decoding failed\n");
+			return 1;
+		}
+	}
+	tlegacy = now() - start;
+	report("Certificate, sequential walk", iterations, tlegacy);
+
+	start = now();
+	for (i = 0; i < iterations; i++) {
+		if (decodeIndexed(cert, sizeof(cert), &indexed) < 0) {
+			printf("Certificate decoding failed\n");
+			return 1;
+		}
+	}
+	tindexed = now() - start;
+	report("Certificate, index", iterations, tindexed);
+
+	printf("Speedup %.1f\n", tlegacy / tindexed);
+
+	start = now();
+	for (i = 0; i < iterations; i++) {
+		if (decodePrivateKeyDescription(prkd, sizeof(prkd), &p15prkd) < 0) {
+			printf("Private key description decoding failed\n");
+			return 1;
+		}
+		freePrivateKeyDescription(&p15prkd);
+	}
+	report("Private key description", iterations, now() - start);
+
+	start = now();
+	for (i = 0; i < iterations; i++) {
+		if (decodeCertificateDescription(cd, sizeof(cd), &p15cd) < 0) {
+			printf("Certificate description decoding failed\n");
+			return 1;
+		}
+		freeCertificatePrivateKeyDescription(&p15cd);
+	}
+	report("Certificate description", iterations, now() - start);
+
+	return 0;
+}
@@ -0,0 +1,380 @@
+/**
+ * SmartCard-HSM PKCS#11 Module
+ *
+ * Copyright (c) 2013, CardContact Systems GmbH, Minden, Germany
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of CardContact Systems GmbH nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CardContact Systems GmbH BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file async-sign-client.c
+ * @brief Sample event loop using the asynchronous vendor extension
+ *
+ * A single thread keeps a configurable number of signature operations in flight.
+ * It waits with poll() for the descriptor returned by SC_GetAsyncEventDescriptor(),
+ * collects completions and submits new requests as slots in the window become free.
+ * The same pattern applies to epoll or the event loop of a server.
+ *
+ * Usage: async-sign-client [--module <lib>] [--slot <id>] [--pin <pin>] [--requests <n>] [--depth <n>]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <poll.h>
+#include <dlfcn.h>
+#include <sys/time.h>
+
+#include <pkcs11/cryptoki.h>
+#include <pkcs11/p11vendor.h>
+
+#define P11LIBNAME "/usr/local/lib/libsc-hsm-pkcs11.so"
+
+#define MAX_DEPTH		256
+
+static char *optModule = P11LIBNAME;
+static long optSlotId = -1;
+static char *optPin = "648219";
+static int optRequests = 1000;
+static int optDepth = 32;
+
+
+
+/**
+ * Request in the window of outstanding operations
+ */
+struct request {
+	CK_ULONG ticket;                  /**< Ticket or 0 if slot is free         */
+	CK_BYTE data[32];                 /**< Hash to be signed                   */
+	CK_BYTE signature[512];           /**< Buffer for the signature            */
+};
+
+
+
+static double now() {
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+
+
+static void usage()
+{
+	printf("Usage: async-sign-client [--module <lib>] [--slot <id>] [--pin <pin>] [--requests <n>] [--depth <n>]\n");
+	exit(1);
+}
+
+
+
+static void decodeArgs(int argc, char **argv)
+{
+	argv++;
+	argc--;
+
+	while (argc > 0) {
+		if (argc < 2)
+			usage();
+
+		if (!strcmp(*argv, "--module")) {
+			optModule = argv[1];
+		} else if (!strcmp(*argv, "--slot")) {
+			optSlotId = atol(argv[1]);
+		} else if (!strcmp(*argv, "--pin")) {
+			optPin = argv[1];
+		} else if (!strcmp(*argv, "--requests")) {
+			optRequests = atoi(argv[1]);
+		} else if (!strcmp(*argv, "--depth")) {
+			optDepth = atoi(argv[1]);
+		} else {
+			usage();
+		}
+		argv += 2;
+		argc -= 2;
+	}
+
+	if ((optDepth < 1) || (optDepth > MAX_DEPTH)) {
+		printf("Depth must be between 1 and %d\n", MAX_DEPTH);
+		exit(1);
+	}
+}
+
+
+
+/*
+ * Select the slot given with --slot or the first slot with a token
+ */
+static CK_RV selectSlot(CK_FUNCTION_LIST_PTR p11, CK_SLOT_ID *slotid)
+{
+	CK_SLOT_ID slots[64];
+	CK_ULONG count = sizeof(slots) / sizeof(*slots);
+	CK_RV rc;
+
+	if (optSlotId != -1) {
+		*slotid = optSlotId;
+		return CKR_OK;
+	}
+
+	rc = p11->C_GetSlotList(CK_TRUE, slots, &count);
+
+	if (rc != CKR_OK)
+		return rc;
+
+	if (count == 0)
+		return CKR_TOKEN_NOT_PRESENT;
+
+	*slotid = slots[0];
+	return CKR_OK;
+}
+
+
+
+/*
+ * Find the first private key usable for signing and select a mechanism for a SHA-256 hash
+ */
+static CK_RV findSigningKey(CK_FUNCTION_LIST_PTR p11, CK_SESSION_HANDLE session, CK_OBJECT_HANDLE *hKey, CK_MECHANISM *mech)
+{
+	CK_OBJECT_CLASS class = CKO_PRIVATE_KEY;
+	CK_BBOOL _true = CK_TRUE;
+	CK_KEY_TYPE keyType;
+	CK_ATTRIBUTE template[] = {
+			{ CKA_CLASS, &class, sizeof(class) },
+			{ CKA_SIGN, &_true, sizeof(_true) }
+	};
+	CK_ATTRIBUTE attr = { CKA_KEY_TYPE, &keyType, sizeof(keyType) };
+	CK_ULONG count;
+	CK_RV rc;
+
+	rc = p11->C_FindObjectsInit(session, template, sizeof(template) / sizeof(*template));
+
+	if (rc != CKR_OK)
+		return rc;
+
+	rc = p11->C_FindObjects(session, hKey, 1, &count);
+	p11->C_FindObjectsFinal(session);
+
+	if (rc != CKR_OK)
+		return rc;
+
+	if (count == 0)
+		return CKR_KEY_HANDLE_INVALID;
+
+	rc = p11->C_GetAttributeValue(session, *hKey, &attr, 1);
+
+	if (rc != CKR_OK)
+		return rc;
+
+	memset(mech, 0, sizeof(*mech));
+	mech->mechanism = keyType == CKK_EC ? CKM_ECDSA : CKM_RSA_PKCS;
+
+	return CKR_OK;
+}
+
+
+
+/*
+ * Submit a new request into a free slot of the window
+ */
+static CK_RV submit(SC_VENDOR_FUNCTION_LIST_PTR vendor, CK_SESSION_HANDLE session, CK_OBJECT_HANDLE hKey,
+		CK_MECHANISM *mech, struct request *req, int seqno)
+{
+	CK_ULONG len;
+
+	// Random looking hash, prefixed with a DigestInfo for RSA would be typical
+	memset(req->data, 0, sizeof(req->data));
+	sprintf((char *)req->data, "Request %d", seqno);
+	len = mech->mechanism == CKM_ECDSA ? 32 : 20;
+
+	return vendor->SC_SignAsync(session, mech, hKey, req->data, len, req->signature, sizeof(req->signature), &req->ticket);
+}
+
+
+
+int main(int argc, char *argv[])
+{
+	CK_RV (*C_GetFunctionList)(CK_FUNCTION_LIST_PTR_PTR);
+	SC_GetVendorFunctionList_t SC_GetVendorFunctionList;
+	CK_FUNCTION_LIST_PTR p11;
+	SC_VENDOR_FUNCTION_LIST_PTR vendor;
+	CK_C_INITIALIZE_ARGS initArgs;
+	CK_SLOT_ID slotid;
+	CK_SESSION_HANDLE session;
+	CK_OBJECT_HANDLE hKey;
+	CK_MECHANISM mech;
+	SC_ASYNC_COMPLETION completions[MAX_DEPTH];
+	SC_SLOT_STATISTICS before, after;
+	struct request *window;
+	struct pollfd pfd;
+	CK_ULONG count, i;
+	int fd, j, submitted, completed, failed, inflight;
+	double start, elapsed;
+	void *dlhandle;
+	CK_RV rc;
+
+	decodeArgs(argc, argv);
+
+	dlhandle = dlopen(optModule, RTLD_NOW);
+
+	if (!dlhandle) {
+		printf("dlopen failed with %s\n", dlerror());
+		exit(1);
+	}
+
+	C_GetFunctionList = (CK_RV (*)(CK_FUNCTION_LIST_PTR_PTR))dlsym(dlhandle, "C_GetFunctionList");
+	SC_GetVendorFunctionList = (SC_GetVendorFunctionList_t)dlsym(dlhandle, "SC_GetVendorFunctionList");
+
+	if (!C_GetFunctionList || !SC_GetVendorFunctionList) {
+		printf("Module does not provide the vendor extensions\n");
+		exit(1);
+	}
+
+	(*C_GetFunctionList)(&p11);
+	(*SC_GetVendorFunctionList)(&vendor);
+
+	if ((vendor->version.major != SC_VENDOR_VERSION_MAJOR) || (vendor->version.minor < 2)) {
+		printf("Module does not support asynchronous operations\n");
+		exit(1);
+	}
+
+	memset(&initArgs, 0, sizeof(initArgs));
+	initArgs.flags = CKF_OS_LOCKING_OK;
+
+	rc = p11->C_Initialize(&initArgs);
+
+	if (rc != CKR_OK) {
+		printf("C_Initialize failed with %lx\n", rc);
+		exit(1);
+	}
+
+	rc = selectSlot(p11, &slotid);
+
+	if (rc == CKR_OK)
+		rc = p11->C_OpenSession(slotid, CKF_RW_SESSION | CKF_SERIAL_SESSION, NULL, NULL, &session);
+
+	if (rc == CKR_OK) {
+		rc = p11->C_Login(session, CKU_USER, (CK_UTF8CHAR_PTR)optPin, strlen(optPin));
+		if (rc == CKR_USER_ALREADY_LOGGED_IN)
+			rc = CKR_OK;
+	}
+
+	if (rc == CKR_OK)
+		rc = findSigningKey(p11, session, &hKey, &mech);
+
+	if (rc == CKR_OK)
+		rc = vendor->SC_GetAsyncEventDescriptor(&fd);
+
+	if (rc != CKR_OK) {
+		printf("Preparing session failed with %lx\n", rc);
+		p11->C_Finalize(NULL);
+		exit(1);
+	}
+
+	window = (struct request *)calloc(optDepth, sizeof(struct request));
+
+	if (window == NULL) {
+		printf("Out of memory\n");
+		exit(1);
+	}
+
+	vendor->SC_GetSlotStatistics(slotid, &before);
+
+	printf("Signing %d requests with %s on slot %lu, %d in flight\n", optRequests,
+			mech.mechanism == CKM_ECDSA ? "CKM_ECDSA" : "CKM_RSA_PKCS", slotid, optDepth);
+
+	submitted = completed = failed = inflight = 0;
+	start = now();
+
+	while (completed < optRequests) {
+		// Fill the window
+		for (j = 0; (j < optDepth) && (submitted < optRequests); j++) {
+			if (window[j].ticket)
+				continue;
+
+			rc = submit(vendor, session, hKey, &mech, &window[j], submitted);
+
+			if (rc != CKR_OK) {
+				printf("SC_SignAsync failed with %lx\n", rc);
+				optRequests = submitted;
+				break;
+			}
+			submitted++;
+			inflight++;
+		}
+
+		if (inflight == 0)
+			break;
+
+		pfd.fd = fd;
+		pfd.events = POLLIN;
+		pfd.revents = 0;
+
+		if (poll(&pfd, 1, 10000) <= 0) {
+			printf("No completion within 10 seconds\n");
+			break;
+		}
+
+		rc = vendor->SC_GetAsyncCompletions(completions, optDepth, &count);
+
+		for (i = 0; (rc == CKR_OK) && (i < count); i++) {
+			for (j = 0; (j < optDepth) && (window[j].ticket != completions[i].ulTicket); j++)
+				;
+
+			if (j == optDepth) {
+				printf("Unknown ticket %lu\n", completions[i].ulTicket);
+				continue;
+			}
+
+			if (completions[i].rv != CKR_OK) {
+				if (!failed)
+					printf("Request with ticket %lu failed with %lx\n", completions[i].ulTicket, completions[i].rv);
+				failed++;
+			}
+
+			window[j].ticket = 0;
+			inflight--;
+			completed++;
+		}
+	}
+
+	elapsed = now() - start;
+
+	vendor->SC_GetSlotStatistics(slotid, &after);
+
+	printf("%d signatures, %d failed in %.2lf seconds: %.1lf signatures/s\n", completed, failed, elapsed,
+			elapsed > 0 ? completed / elapsed : 0.0);
+
+	if (after.ulBusyTime + after.ulIdleTime > before.ulBusyTime + before.ulIdleTime) {
+		printf("Card utilisation %.1lf%%, %lu commands, max queue %lu\n",
+				100.0 * (after.ulBusyTime - before.ulBusyTime) /
+				(after.ulBusyTime + after.ulIdleTime - before.ulBusyTime - before.ulIdleTime),
+				after.ulCommands - before.ulCommands, after.ulMaxQueueLength);
+	}
+
+	free(window);
+
+	p11->C_CloseSession(session);
+	p11->C_Finalize(NULL);
+	dlclose(dlhandle);
+
+	return failed ? 1 : 0;
+}
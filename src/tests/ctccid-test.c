@@ -36,6 +36,13 @@
 #include <stdlib.h>
 
 #include <ctccid/ctapi.h>
+#include <ctccid/ccid_emu.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/time.h>
+#endif
 
 #ifndef _WIN32
 #define PIN (unsigned char *)"648219"
@@ -603,6 +610,278 @@ int TestEjectICC(int ctn)
 
 
 
+/*
+ * Return wall clock time in seconds
+ */
+static double Now()
+{
+#ifdef _WIN32
+	return GetTickCount() / 1000.0;
+#else
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1000000.0;
+#endif
+}
+
+
+
+/*
+ * Emulated card returning the data field of the command APDU followed by 9000
+ *
+ */
+
+static int EchoCard(void *context, unsigned int lc, unsigned char *cmd, unsigned int *lr, unsigned char *rsp)
+{
+	unsigned int len, ofs;
+
+	len = 0;
+	ofs = 5;
+
+	if (lc > 5) {
+		if (cmd[4]) {
+			len = cmd[4];
+		} else if (lc > 7) {
+			len = (cmd[5] << 8) | cmd[6];
+			ofs = 7;
+		}
+	}
+
+	if ((ofs + len > lc) || (len + 2 > *lr)) {
+		rsp[0] = 0x67;
+		rsp[1] = 0x00;
+		*lr = 2;
+		return 0;
+	}
+
+	memcpy(rsp, cmd + ofs, len);
+	rsp[len] = 0x90;
+	rsp[len + 1] = 0x00;
+	*lr = len + 2;
+	return 0;
+}
+
+
+
+/*
+ * Exchange APDUs of varying size with an emulated reader and check the echoed data
+ *
+ * Returns : 0 if all responses were correct, -1 otherwise
+ */
+
+static int TestEmulatorScenario(char *name, ccidEmuConfig_t *config, int iterations, int maxlen)
+{
+	static int sizes[] = { 0, 1, 16, 200, 254, 255, 256, 600, 1000, 2048, 4000 };
+	unsigned char cmd[4096], rsp[4096], Brsp[260];
+	unsigned short SW1SW2, lr;
+	unsigned char dad, sad;
+	ccidEmuStatistics_t stats;
+	ccidEmuConfig_t cfg;
+	double start, elapsed;
+	long bytes;
+	int rc, i, j, len, failed;
+
+	cfg = *config;
+	if (!cfg.card && !cfg.script) {
+		cfg.card = EchoCard;
+	}
+
+	ccidEmuEnable(&cfg);
+
+	failed = 0;
+	bytes = 0;
+
+	rc = CT_init(0, 0);
+
+	if (rc < 0) {
+		printf("%-32s: CT_init failed, rc=%i\n", name, rc);
+		ccidEmuDisable();
+		return -1;
+	}
+
+	dad = 1;
+	sad = 2;
+	lr = sizeof(Brsp);
+	rc = CT_data(0, &dad, &sad, sizeof(requesticc), requesticc, &lr, Brsp);
+
+	if ((rc < 0) || (lr < 2) || (Brsp[lr - 2] != 0x90)) {
+		printf("%-32s: REQUEST ICC failed, rc=%i\n", name, rc);
+		CT_close(0);
+		ccidEmuDisable();
+		return -1;
+	}
+
+	ccidEmuResetStatistics();
+	start = Now();
+
+	for (i = 0; i < iterations; i++) {
+		len = sizes[i % (sizeof(sizes) / sizeof(sizes[0]))];
+
+		if (len > maxlen) {
+			len = maxlen;
+		}
+
+		for (j = 0; j < len; j++) {
+			cmd[j] = (unsigned char)(i + j);
+		}
+
+		rc = ProcessAPDU(0, 0, 0x80, 0xEC, 0x00, 0x00,
+						 len, cmd,
+						 65536, rsp, sizeof(rsp), &SW1SW2);
+
+		if ((rc != len) || (SW1SW2 != 0x9000) || memcmp(cmd, rsp, len)) {
+			printf("%-32s: APDU %d with %d bytes failed, rc=%i, SW1SW2=%04X\n", name, i, len, rc, SW1SW2);
+			failed++;
+			continue;
+		}
+
+		bytes += 2 * len;
+	}
+
+	elapsed = Now() - start;
+	ccidEmuGetStatistics(&stats);
+
+	CT_close(0);
+	ccidEmuDisable();
+
+	if (elapsed <= 0) {
+		elapsed = 0.000001;
+	}
+
+	printf("%-32s: %s %5d APDUs %8.1f APDU/s %8.1f kB/s - USB %lu, blocks %lu/%lu, retransmit %lu, WTX %lu, TE %lu, resync %lu\n",
+		   name, failed ? "FAILED" : "OK    ", iterations,
+		   iterations / elapsed, bytes / elapsed / 1024,
+		   stats.usbTransfers, stats.blocksReceived, stats.blocksSent,
+		   stats.retransmissions, stats.wtxRequests, stats.timeExtensions, stats.resyncs);
+
+	return failed ? -1 : 0;
+}
+
+
+
+/*
+ * Attach and detach emulated readers and check the port list reported by CT_list
+ *
+ */
+
+static int TestReaderList()
+{
+	ccidEmuConfig_t config;
+	unsigned short ports[4], count, lr;
+	unsigned char dad, sad, rsp[260];
+	int rc, failed = 0;
+
+	printf("Reader list: ");
+
+	memset(&config, 0, sizeof(config));
+	config.readers = 3;
+	ccidEmuEnable(&config);
+
+	count = 2;
+	rc = CT_list(ports, &count);
+	if ((rc != ERR_MEMORY) || (count != 3)) {
+		printf("too small list not detected, rc=%d count=%d ", rc, count);
+		failed = 1;
+	}
+
+	count = 4;
+	rc = CT_list(ports, &count);
+	if ((rc != OK) || (count != 3) || (ports[0] != 0) || (ports[2] != 2)) {
+		printf("expected 3 ports, rc=%d count=%d ", rc, count);
+		failed = 1;
+	}
+
+	dad = 1;
+	sad = 2;
+	lr = sizeof(rsp);
+	if ((CT_init(2, 2) != OK) || (CT_data(2, &dad, &sad, 4, (unsigned char *) "\x20\x13\x01\x80", &lr, rsp) != OK)) {
+		printf("reader at port 2 not working ");
+		failed = 1;
+	}
+
+	ccidEmuSetReaders(1);
+
+	count = 4;
+	rc = CT_list(ports, &count);
+	if ((rc != OK) || (count != 1)) {
+		printf("detach not reported, rc=%d count=%d ", rc, count);
+		failed = 1;
+	}
+
+	dad = 1;
+	sad = 2;
+	lr = sizeof(rsp);
+	if (CT_data(2, &dad, &sad, 4, (unsigned char *) "\x20\x13\x01\x80", &lr, rsp) == OK) {
+		printf("detached reader still responding ");
+		failed = 1;
+	}
+
+	CT_close(2);
+	ccidEmuDisable();
+
+	printf("%s\n", failed ? "failed" : "passed");
+	return failed;
+}
+
+
+
+/*
+ * Run the regression and throughput tests against emulated readers
+ *
+ */
+
+static int TestEmulator(int iterations)
+{
+	ccidEmuConfig_t config;
+	int failed = 0;
+
+	printf("\n- Emulated CCID reader ------------------\n\n");
+
+	failed |= TestReaderList();
+
+	memset(&config, 0, sizeof(config));
+	failed |= TestEmulatorScenario("T=1", &config, iterations, 4000);
+
+	memset(&config, 0, sizeof(config));
+	config.ifsd = 254;
+	failed |= TestEmulatorScenario("T=1, IFSD 254", &config, iterations, 4000);
+
+	memset(&config, 0, sizeof(config));
+	config.edcErrorInterval = 5;
+	failed |= TestEmulatorScenario("T=1, EDC errors", &config, iterations, 4000);
+
+	memset(&config, 0, sizeof(config));
+	config.wtxInterval = 3;
+	config.wtxMultiplier = 2;
+	failed |= TestEmulatorScenario("T=1, WTX", &config, iterations, 4000);
+
+	memset(&config, 0, sizeof(config));
+	config.timeExtensions = 2;
+	failed |= TestEmulatorScenario("T=1, CCID time extension", &config, iterations, 4000);
+
+	/* The host only repeats the last block after a resynchronisation, so keep commands unchained */
+	memset(&config, 0, sizeof(config));
+	config.sequenceErrorInterval = 7;
+	failed |= TestEmulatorScenario("T=1, resynchronisation", &config, iterations, 200);
+
+	memset(&config, 0, sizeof(config));
+	config.apduLevel = 1;
+	failed |= TestEmulatorScenario("APDU level", &config, iterations, 4000);
+
+	/* Approximate timing of a SmartCard-HSM at 115200 baud behind a full speed reader */
+	memset(&config, 0, sizeof(config));
+	config.ifsd = 254;
+	config.usbLatency = 125;
+	config.byteTime = 87;
+	config.processingTime = 1000;
+	failed |= TestEmulatorScenario("T=1, timed", &config, iterations / 10 + 1, 4000);
+
+	return failed;
+}
+
+
+
 #define MAXPORT 2
 
 /*
@@ -612,13 +891,30 @@ int TestEjectICC(int ctn)
  *  1 card reader connected, memory card in
  *  2 card reader connected, microprocessor card in
  *
+ * Use -e [iterations] to run all tests against emulated readers without hardware.
+ *
  */
 
 int main(int argc, char **argv)
 
 {
 	unsigned int i;
-	int ctns[MAXPORT],rc;
+	int ctns[MAXPORT],rc,emulate,iterations;
+	ccidEmuConfig_t config;
+
+	emulate = 0;
+	iterations = 1000;
+
+	if ((argc > 1) && !strcmp(argv[1], "-e")) {
+		emulate = 1;
+		if (argc > 2) {
+			iterations = atoi(argv[2]);
+		}
+
+		memset(&config, 0, sizeof(config));
+		config.readers = MAXPORT;
+		ccidEmuEnable(&config);
+	}
 
 	for (i = 0; i < MAXPORT; i++) {
 		ctns[i] = -1;
@@ -677,5 +973,13 @@ int main(int argc, char **argv)
 		}
 	}
 
+	if (emulate) {
+		ccidEmuDisable();
+		if (TestEmulator(iterations)) {
+			printf("\nEmulator tests failed\n");
+			return 1;
+		}
+	}
+
 	return 0;
 }
@@ -0,0 +1,230 @@
+/**
+ * SmartCard-HSM PKCS#11 Module
+ *
+ * Copyright (c) 2013, CardContact Systems GmbH, Minden, Germany
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of CardContact Systems GmbH nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CardContact Systems GmbH BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file digest-bench.c
+ * @brief Throughput benchmark for the host hash implementation
+ *
+ * The program checks the known answers for all supported hash mechanisms and
+ * compares the throughput of the portable compression functions with the
+ * functions selected for the CPU.
+ *
+ * Usage: digest-bench [megabytes]
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include <pkcs11/digest.h>
+
+
+
+struct knownAnswer {
+	CK_MECHANISM_TYPE mech;
+	char *name;
+	char *hash;
+};
+
+/* Hash values of "abc" from FIPS 180-4 examples */
+static struct knownAnswer knownAnswers[] = {
+	{ CKM_SHA_1, "SHA-1", "a9993e364706816aba3e25717850c26c9cd0d89d" },
+	{ CKM_SHA224, "SHA-224", "23097d223405d8228642a477bda255b32aadbce4bda0b3f7e36c9da7" },
+	{ CKM_SHA256, "SHA-256", "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad" },
+	{ CKM_SHA384, "SHA-384", "cb00753f45a35e8bb5a03d699ac65007272c32ab0eded163"
+							 "1a8b605a43ff5bed8086072ba1e7cc2358baeca134c825a7" },
+	{ CKM_SHA512, "SHA-512", "ddaf35a193617abacc417349ae20413112e6fa4e89a97ea20a9eeee64b55d39a"
+							 "2192992a274fc1a836ba3c23a3feebbd454d4423643ce80e2a9ac94fa54ca49f" }
+};
+
+#define NUMBER_OF_ALGORITHMS	(sizeof(knownAnswers) / sizeof(*knownAnswers))
+
+
+
+static double now() {
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+
+
+static void selectEngine(int generic)
+{
+	if (generic) {
+#ifdef _WIN32
+		_putenv("PKCS11_DIGEST_GENERIC=1");
+#else
+		setenv("PKCS11_DIGEST_GENERIC", "1", 1);
+#endif
+	} else {
+#ifdef _WIN32
+		_putenv("PKCS11_DIGEST_GENERIC=");
+#else
+		unsetenv("PKCS11_DIGEST_GENERIC");
+#endif
+	}
+
+	initDigestEngine();
+}
+
+
+
+static int checkKnownAnswer(struct knownAnswer *ka)
+{
+	unsigned char hash[DIGEST_MAX_SIZE];
+	char hex[2 * DIGEST_MAX_SIZE + 1];
+	int len, i;
+
+	len = digest(ka->mech, (unsigned char *)"abc", 3, hash);
+
+	for (i = 0; i < len; i++) {
+		sprintf(hex + 2 * i, "%02x", hash[i]);
+	}
+
+	if ((len <= 0) || strcmp(hex, ka->hash)) {
+		printf("%s known answer test failed\n", ka->name);
+		return -1;
+	}
+	return 0;
+}
+
+
+
+/*
+ * Hash the buffer with varying splits and compare with the single call result
+ */
+static int checkIncremental(CK_MECHANISM_TYPE mech, unsigned char *data, int len)
+{
+	struct digestContext ctx;
+	unsigned char ref[DIGEST_MAX_SIZE], hash[DIGEST_MAX_SIZE];
+	int ofs, n, size;
+
+	size = digest(mech, data, len, ref);
+
+	for (n = 1; n < 300; n += 7) {
+		digestInit(&ctx, mech);
+		for (ofs = 0; ofs < len; ofs += n) {
+			digestUpdate(&ctx, data + ofs, ofs + n > len ? len - ofs : n);
+		}
+		digestFinal(&ctx, hash);
+
+		if (memcmp(ref, hash, size)) {
+			return -1;
+		}
+	}
+	return 0;
+}
+
+
+
+static double measure(CK_MECHANISM_TYPE mech, unsigned char *data, int len, int megabytes)
+{
+	unsigned char hash[DIGEST_MAX_SIZE];
+	double start;
+	int i, rounds;
+
+	rounds = megabytes * (1024 * 1024 / len);
+
+	start = now();
+	for (i = 0; i < rounds; i++) {
+		digest(mech, data, len, hash);
+	}
+	return (double)rounds * len / (1024 * 1024) / (now() - start);
+}
+
+
+
+int main(int argc, char **argv)
+{
+	unsigned char *data, ref[NUMBER_OF_ALGORITHMS][DIGEST_MAX_SIZE], hash[DIGEST_MAX_SIZE];
+	double generic, selected;
+	int megabytes, len, i;
+
+	megabytes = argc > 1 ? atoi(argv[1]) : 64;
+
+	if (megabytes <= 0) {
+		printf("Usage: digest-bench [megabytes]\n");
+		return 1;
+	}
+
+	len = 64 * 1024;
+	data = malloc(len);
+
+	if (data == NULL) {
+		printf("Out of memory\n");
+		return 1;
+	}
+
+	for (i = 0; i < len; i++) {
+		data[i] = (unsigned char)(i * 31 + (i >> 8));
+	}
+
+	selectEngine(1);
+
+	for (i = 0; i < NUMBER_OF_ALGORITHMS; i++) {
+		if (checkKnownAnswer(&knownAnswers[i]) < 0) {
+			return 1;
+		}
+		digest(knownAnswers[i].mech, data, len, ref[i]);
+	}
+
+	selectEngine(0);
+
+	for (i = 0; i < NUMBER_OF_ALGORITHMS; i++) {
+		if ((checkKnownAnswer(&knownAnswers[i]) < 0) ||
+			(checkIncremental(knownAnswers[i].mech, data, 4096) < 0)) {
+			return 1;
+		}
+
+		digest(knownAnswers[i].mech, data, len, hash);
+
+		if (memcmp(ref[i], hash, getDigestSize(knownAnswers[i].mech))) {
+			printf("%s %s differs from generic implementation\n", knownAnswers[i].name,
+				getDigestImplementation(knownAnswers[i].mech));
+			return 1;
+		}
+	}
+
+	printf("%-8s %-24s %12s %12s %8s\n", "", "Implementation", "Generic", "Selected", "Speedup");
+
+	for (i = 0; i < NUMBER_OF_ALGORITHMS; i++) {
+		selectEngine(1);
+		generic = measure(knownAnswers[i].mech, data, len, megabytes);
+
+		selectEngine(0);
+		selected = measure(knownAnswers[i].mech, data, len, megabytes);
+
+		printf("%-8s %-24s %7.1f MB/s %7.1f MB/s %7.1fx\n", knownAnswers[i].name,
+			getDigestImplementation(knownAnswers[i].mech), generic, selected, selected / generic);
+	}
+
+	free(data);
+	return 0;
+}
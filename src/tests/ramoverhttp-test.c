@@ -0,0 +1,1025 @@
+/**
+ * RAMoverHTTP Client
+ *
+ * Copyright (c) 2016, CardContact Systems GmbH, Minden, Germany
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of CardContact Systems GmbH nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CardContact Systems GmbH BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file ramoverhttp-test.c
+ * @brief Mock RAMoverHTTP server and load test for the RAMoverHTTP client
+ *
+ * The program runs a minimal HTTP server that replays an APDU script using the
+ * RAMoverHTTP protocol. By default it also runs concurrent client sessions
+ * against the server, using a stub card that answers every APDU with 9000.
+ *
+ * Script format, one command per line:
+ *
+ *   # comment
+ *   capdu <hex>           Send command APDU
+ *   reset                 Request a card reset
+ *   notify <id> <text>    Send notification message
+ *   send                  Complete request template and send to client
+ *   timeout               Answer with HTTP 504 instead of the next request
+ *
+ * Without a script, a request template with --batch GET CHALLENGE commands is
+ * repeated until --apdus commands have been send.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include <ramoverhttp/ramoverhttp.h>
+
+#define STEP_TEMPLATE	0
+#define STEP_TIMEOUT	1
+
+#define MAX_HEADER		4096
+
+struct scriptStep {
+	int type;
+	unsigned char *data;		// Encoded request template
+	size_t len;
+	int apdus;					// Number of C-APDUs in template
+};
+
+struct session {
+	int id;
+	int step;
+	int expectedApdus;
+	struct session *next;
+};
+
+struct serverStatistics {
+	int sessions;
+	int completed;
+	int aborted;
+	int timeouts;
+	int errors;
+	int requests;
+	int apdus;
+	long bytesIn;
+	long bytesOut;
+};
+
+static int optPort = 8088;
+static char *optScript = NULL;
+static int optApdus = 100;
+static int optBatch = 10;
+static int optLatency = 0;
+static int optServerOnly = 0;
+static int optClients = 1;
+static int optRounds = 10;
+static int optCardDelay = 0;
+static int optEngine = 0;
+static int optCloseAfter = 0;
+static int optVerbose = 0;
+
+static struct scriptStep *script = NULL;
+static int scriptSteps = 0;
+
+static pthread_mutex_t serverLock = PTHREAD_MUTEX_INITIALIZER;
+static struct session *sessions = NULL;
+static int sessionCounter = 0;
+static struct serverStatistics stats;
+
+static volatile int stopRequested = 0;
+
+
+
+static double now() {
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+
+
+static void onSignal(int sig) {
+	stopRequested = 1;
+}
+
+
+
+/*
+ * Encode a TLV object into buffer, which must have 4 bytes more than the value
+ */
+static size_t encodeTLV(unsigned char *p, int tag, unsigned char *value, size_t len) {
+	unsigned char *s = p;
+
+	*p++ = tag;
+	if (len >= 256) {
+		*p++ = 0x82;
+		*p++ = (unsigned char)(len >> 8);
+		*p++ = (unsigned char)len;
+	} else if (len >= 128) {
+		*p++ = 0x81;
+		*p++ = (unsigned char)len;
+	} else {
+		*p++ = (unsigned char)len;
+	}
+	if (value)
+		memmove(p, value, len);
+	return p - s + len;
+}
+
+
+
+/*
+ * Decode tag and length, returning the pointer to the value or NULL if invalid
+ */
+static unsigned char *decodeTLV(unsigned char *p, unsigned char *end, int *tag, size_t *len) {
+	int c;
+
+	if (end - p < 2)
+		return NULL;
+
+	*tag = *p++;
+	*len = *p++;
+
+	if (*len & 0x80) {
+		c = *len & 0x7F;
+		if ((c < 1) || (c > 2) || (end - p < c))
+			return NULL;
+		*len = 0;
+		while (c--)
+			*len = (*len << 8) | *p++;
+	}
+
+	if ((size_t)(end - p) < *len)
+		return NULL;
+
+	return p;
+}
+
+
+
+/*
+ * Collect objects for the request template currently being build
+ */
+struct templateBuilder {
+	unsigned char buffer[65536];
+	size_t len;
+	int apdus;
+};
+
+
+
+static int addStep(int type, struct templateBuilder *tb) {
+	struct scriptStep *s;
+
+	s = realloc(script, (scriptSteps + 1) * sizeof(struct scriptStep));
+	if (s == NULL)
+		return -1;
+	script = s;
+	s = &script[scriptSteps++];
+
+	memset(s, 0, sizeof(*s));
+	s->type = type;
+
+	if (type == STEP_TEMPLATE) {
+		s->data = malloc(tb->len + 4);
+		if (s->data == NULL)
+			return -1;
+		s->len = encodeTLV(s->data, RAM_REQ_TEMPL, tb->buffer, tb->len);
+		s->apdus = tb->apdus;
+		tb->len = 0;
+		tb->apdus = 0;
+	}
+	return 0;
+}
+
+
+
+static int addObject(struct templateBuilder *tb, int tag, unsigned char *value, size_t len) {
+	if (tb->len + len + 4 > sizeof(tb->buffer))
+		return -1;
+	tb->len += encodeTLV(tb->buffer + tb->len, tag, value, len);
+	if (tag == RAM_CAPDU)
+		tb->apdus++;
+	return 0;
+}
+
+
+
+static int addNotify(struct templateBuilder *tb, int id, char *msg) {
+	unsigned char buf[1024], *p;
+	size_t len;
+
+	len = strlen(msg);
+	if (len > sizeof(buf) - 16)
+		len = sizeof(buf) - 16;
+
+	p = buf;
+	*p++ = RAM_INT;
+	*p++ = 4;
+	*p++ = (unsigned char)(id >> 24);
+	*p++ = (unsigned char)(id >> 16);
+	*p++ = (unsigned char)(id >> 8);
+	*p++ = (unsigned char)id;
+	p += encodeTLV(p, RAM_UTF8, (unsigned char *)msg, len);
+
+	return addObject(tb, RAM_NOTIFY, buf, p - buf);
+}
+
+
+
+static int decodeHex(char *str, unsigned char *buf, size_t size) {
+	size_t len = 0;
+	unsigned int v;
+
+	while (*str) {
+		if (isspace((unsigned char)*str)) {
+			str++;
+			continue;
+		}
+		if ((len >= size) || (sscanf(str, "%2x", &v) != 1) || !isxdigit((unsigned char)str[1]))
+			return -1;
+		buf[len++] = (unsigned char)v;
+		str += 2;
+	}
+	return (int)len;
+}
+
+
+
+static int loadScript(char *filename) {
+	struct templateBuilder *tb;
+	unsigned char apdu[4096];
+	char line[8192], *p, *arg;
+	int lineno, rc, id;
+	FILE *fp;
+
+	fp = fopen(filename, "r");
+	if (fp == NULL) {
+		printf("Can not open script %s (%s)\n", filename, strerror(errno));
+		return -1;
+	}
+
+	tb = calloc(1, sizeof(struct templateBuilder));
+	if (tb == NULL) {
+		fclose(fp);
+		return -1;
+	}
+
+	rc = 0;
+	lineno = 0;
+	while (!rc && fgets(line, sizeof(line), fp)) {
+		lineno++;
+		line[strcspn(line, "\r\n")] = 0;
+
+		for (p = line; isspace((unsigned char)*p); p++);
+		if ((*p == 0) || (*p == '#'))
+			continue;
+
+		for (arg = p; *arg && !isspace((unsigned char)*arg); arg++);
+		if (*arg)
+			*arg++ = 0;
+		while (isspace((unsigned char)*arg))
+			arg++;
+
+		if (!strcmp(p, "capdu")) {
+			rc = decodeHex(arg, apdu, sizeof(apdu));
+			if (rc >= 4)
+				rc = addObject(tb, RAM_CAPDU, apdu, rc);
+			else
+				rc = -1;
+		} else if (!strcmp(p, "reset")) {
+			rc = addObject(tb, RAM_RESET, NULL, 0);
+		} else if (!strcmp(p, "notify")) {
+			id = strtol(arg, &arg, 10);
+			while (isspace((unsigned char)*arg))
+				arg++;
+			rc = addNotify(tb, id, arg);
+		} else if (!strcmp(p, "send")) {
+			rc = addStep(STEP_TEMPLATE, tb);
+		} else if (!strcmp(p, "timeout")) {
+			if (tb->len)
+				rc = addStep(STEP_TEMPLATE, tb);
+			if (!rc)
+				rc = addStep(STEP_TIMEOUT, tb);
+		} else {
+			rc = -1;
+		}
+
+		if (rc < 0) {
+			printf("%s(%d): Invalid command\n", filename, lineno);
+		} else {
+			rc = 0;
+		}
+	}
+
+	if (!rc && tb->len)
+		rc = addStep(STEP_TEMPLATE, tb);
+
+	free(tb);
+	fclose(fp);
+	return rc;
+}
+
+
+
+static int generateScript() {
+	struct templateBuilder *tb;
+	int i, rc = 0;
+
+	tb = calloc(1, sizeof(struct templateBuilder));
+	if (tb == NULL)
+		return -1;
+
+	for (i = 0; !rc && (i < optApdus); i++) {
+		rc = addObject(tb, RAM_CAPDU, (unsigned char *)"\x00\x84\x00\x00\x08", 5);
+		if (!rc && ((tb->apdus == optBatch) || (i == optApdus - 1)))
+			rc = addStep(STEP_TEMPLATE, tb);
+	}
+
+	if (!rc) {
+		rc = addNotify(tb, 1, "Script completed");
+		if (!rc)
+			rc = addStep(STEP_TEMPLATE, tb);
+	}
+
+	free(tb);
+	return rc;
+}
+
+
+
+/*
+ * Locate the session for the cookie, removing it if remove is set. Must be called with serverLock locked.
+ */
+static struct session *findSession(int id, int remove) {
+	struct session **sp, *s;
+
+	for (sp = &sessions; *sp; sp = &(*sp)->next) {
+		if ((*sp)->id == id) {
+			s = *sp;
+			if (remove)
+				*sp = s->next;
+			return s;
+		}
+	}
+	return NULL;
+}
+
+
+
+/*
+ * Validate a response template from the client
+ *
+ * @return 1 if the client closed the session, 0 if valid or -1 if invalid
+ */
+static int checkResponse(unsigned char *body, size_t len, int expectedApdus, int *rapdus) {
+	unsigned char *p, *end, *v;
+	int tag, numapdu, closed;
+	size_t tl;
+
+	*rapdus = 0;
+	end = body + len;
+	p = decodeTLV(body, end, &tag, &tl);
+	if ((p == NULL) || (tag != RAM_RES_TEMPL) || (p + tl != end))
+		return -1;
+
+	numapdu = -1;
+	closed = 0;
+	while (p < end) {
+		v = decodeTLV(p, end, &tag, &tl);
+		if (v == NULL)
+			return -1;
+		p = v + tl;
+
+		switch(tag) {
+		case RAM_RAPDU:
+			(*rapdus)++;
+			break;
+		case RAM_NUM_APDU:
+			numapdu = 0;
+			while (tl--)
+				numapdu = (numapdu << 8) | *v++;
+			break;
+		case RAM_CLOSE:
+			closed = 1;
+			break;
+		}
+	}
+
+	if (closed)
+		return 1;
+
+	if ((numapdu != *rapdus) || (numapdu != expectedApdus))
+		return -1;
+
+	return 0;
+}
+
+
+
+/*
+ * Process a POST request and determine the response
+ *
+ * @return the HTTP status code
+ */
+static int processPost(int *sessionId, unsigned char *body, size_t len, unsigned char **rsp, size_t *rsplen) {
+	struct session *s;
+	struct scriptStep *step;
+	int rc, rapdus, code;
+
+	*rsp = NULL;
+	*rsplen = 0;
+
+	pthread_mutex_lock(&serverLock);
+
+	stats.requests++;
+	stats.bytesIn += len;
+
+	s = *sessionId ? findSession(*sessionId, 0) : NULL;
+
+	if (s == NULL) {
+		if ((len < 2) || (body[0] != RAM_INIT_TEMPL)) {
+			stats.errors++;
+			pthread_mutex_unlock(&serverLock);
+			return 400;
+		}
+		s = calloc(1, sizeof(struct session));
+		if (s == NULL) {
+			pthread_mutex_unlock(&serverLock);
+			return 500;
+		}
+		s->id = ++sessionCounter;
+		s->next = sessions;
+		sessions = s;
+		*sessionId = s->id;
+		stats.sessions++;
+	} else {
+		rc = checkResponse(body, len, s->expectedApdus, &rapdus);
+		stats.apdus += rapdus;
+
+		if (rc < 0) {
+			stats.errors++;
+			if (optVerbose)
+				printf("Session %d: Invalid response template\n", s->id);
+		}
+
+		if (rc == 1) {
+			stats.aborted++;
+			findSession(s->id, 1);
+			free(s);
+			pthread_mutex_unlock(&serverLock);
+			return 204;
+		}
+	}
+
+	if (s->step >= scriptSteps) {
+		stats.completed++;
+		findSession(s->id, 1);
+		free(s);
+		pthread_mutex_unlock(&serverLock);
+		return 204;
+	}
+
+	step = &script[s->step++];
+
+	if (step->type == STEP_TIMEOUT) {
+		stats.timeouts++;
+		findSession(s->id, 1);
+		free(s);
+		code = 504;
+	} else {
+		s->expectedApdus = step->apdus;
+		*rsp = step->data;
+		*rsplen = step->len;
+		stats.bytesOut += step->len;
+		code = 200;
+	}
+
+	pthread_mutex_unlock(&serverLock);
+	return code;
+}
+
+
+
+static int sendAll(int fd, void *data, size_t len) {
+	unsigned char *p = data;
+	ssize_t n;
+
+	while (len > 0) {
+		n = send(fd, p, len, 0);
+		if (n <= 0)
+			return -1;
+		p += n;
+		len -= n;
+	}
+	return 0;
+}
+
+
+
+static char *findHeader(char *headers, char *name) {
+	size_t nl = strlen(name);
+	char *p;
+
+	for (p = strstr(headers, "\r\n"); p; p = strstr(p, "\r\n")) {
+		p += 2;
+		if (!strncasecmp(p, name, nl) && (p[nl] == ':')) {
+			p += nl + 1;
+			while (*p == ' ')
+				p++;
+			return p;
+		}
+	}
+	return NULL;
+}
+
+
+
+/*
+ * Serve HTTP/1.1 requests on a connection until the client closes it
+ */
+static void *connectionMain(void *arg) {
+	int fd = (int)(long)arg;
+	char hdr[MAX_HEADER + 1], out[256], *p, *eoh;
+	unsigned char *body, *rsp;
+	size_t hlen, blen, have, rsplen;
+	ssize_t n;
+	int code, sessionId, keepAlive;
+
+	hlen = 0;
+	body = NULL;
+	keepAlive = 1;
+
+	while (keepAlive && !stopRequested) {
+		// Read request header, which may already be partially in the buffer
+		eoh = NULL;
+		while (!(eoh = (hlen ? strstr(hdr, "\r\n\r\n") : NULL))) {
+			if (hlen >= MAX_HEADER)
+				goto done;
+			n = recv(fd, hdr + hlen, MAX_HEADER - hlen, 0);
+			if (n <= 0)
+				goto done;
+			hlen += n;
+			hdr[hlen] = 0;
+		}
+		*eoh = 0;
+		eoh += 4;
+
+		if (strncmp(hdr, "POST ", 5))
+			goto done;
+
+		p = findHeader(hdr, "Content-Length");
+		blen = p ? strtoul(p, NULL, 10) : 0;
+
+		p = findHeader(hdr, "Connection");
+		keepAlive = !(p && !strncasecmp(p, "close", 5));
+
+		p = findHeader(hdr, "Cookie");
+		sessionId = 0;
+		if (p && (p = strstr(p, "RAMSESSION=")))
+			sessionId = atoi(p + 11);
+
+		p = findHeader(hdr, "Expect");
+		if (p && !strncasecmp(p, "100-continue", 12)) {
+			if (sendAll(fd, "HTTP/1.1 100 Continue\r\n\r\n", 25) < 0)
+				goto done;
+		}
+
+		body = realloc(body, blen + 1);
+		if (body == NULL)
+			goto done;
+
+		have = hlen - (eoh - hdr);
+		if (have > blen)
+			have = blen;
+		memcpy(body, eoh, have);
+
+		// Keep data following the body for the next request
+		memmove(hdr, eoh + have, hlen - (eoh - hdr) - have);
+		hlen = hlen - (eoh - hdr) - have;
+		hdr[hlen] = 0;
+
+		while (have < blen) {
+			n = recv(fd, body + have, blen - have, 0);
+			if (n <= 0)
+				goto done;
+			have += n;
+		}
+
+		code = processPost(&sessionId, body, blen, &rsp, &rsplen);
+
+		if (optLatency)
+			usleep(optLatency * 1000);
+
+		if (code == 200) {
+			n = snprintf(out, sizeof(out),
+					"HTTP/1.1 200 OK\r\n"
+					"Content-Type: application/org.openscdp-content-mgt-request;version=1.0\r\n"
+					"Set-Cookie: RAMSESSION=%d\r\n"
+					"Content-Length: %lu\r\n\r\n",
+					sessionId, (unsigned long)rsplen);
+		} else {
+			n = snprintf(out, sizeof(out),
+					"HTTP/1.1 %d %s\r\nContent-Length: 0\r\n\r\n",
+					code, code == 204 ? "No Content" : code == 504 ? "Gateway Timeout" : "Error");
+		}
+
+		if ((sendAll(fd, out, n) < 0) || (rsplen && (sendAll(fd, rsp, rsplen) < 0)))
+			goto done;
+	}
+
+done:
+	free(body);
+	close(fd);
+	return NULL;
+}
+
+
+
+static void *serverMain(void *arg) {
+	int lfd = (int)(long)arg, fd, one = 1;
+	struct timeval tv;
+	pthread_t thread;
+	fd_set fds;
+
+	while (!stopRequested) {
+		FD_ZERO(&fds);
+		FD_SET(lfd, &fds);
+		tv.tv_sec = 0;
+		tv.tv_usec = 200000;
+
+		if (select(lfd + 1, &fds, NULL, NULL, &tv) <= 0)
+			continue;
+
+		fd = accept(lfd, NULL, NULL);
+		if (fd < 0)
+			continue;
+
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+		if (pthread_create(&thread, NULL, connectionMain, (void *)(long)fd) != 0) {
+			close(fd);
+			continue;
+		}
+		pthread_detach(thread);
+	}
+	close(lfd);
+	return NULL;
+}
+
+
+
+static int startServer(pthread_t *thread) {
+	struct sockaddr_in addr;
+	int fd, one = 1;
+
+	fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (fd < 0)
+		return -1;
+
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = htons(optPort);
+
+	if ((bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) || (listen(fd, 64) < 0)) {
+		printf("Can not listen on port %d (%s)\n", optPort, strerror(errno));
+		close(fd);
+		return -1;
+	}
+
+	return pthread_create(thread, NULL, serverMain, (void *)(long)fd);
+}
+
+
+
+/*
+ * Stub card, answering GET CHALLENGE with the requested number of bytes and everything else with 9000
+ */
+static int stubSendApdu(struct ramContext *ctx, unsigned char *capdu, size_t clen, unsigned char *rapdu, size_t *rlen) {
+	int *apducnt = (int *)ramGetUserObject(ctx);
+	size_t len = 0;
+
+	if (optCloseAfter && (++(*apducnt) > optCloseAfter)) {
+		ramForceClose(ctx, "Card removed");
+		return RAME_CARD_ERROR;
+	}
+
+	if (optCardDelay)
+		usleep(optCardDelay);
+
+	if ((clen == 5) && (capdu[1] == 0x84)) {
+		len = capdu[4];
+		memset(rapdu, 0x5A, len);
+	}
+	rapdu[len++] = 0x90;
+	rapdu[len++] = 0x00;
+	*rlen = len;
+	return 0;
+}
+
+
+
+static int stubReset(struct ramContext *ctx, unsigned char *atr, size_t *alen) {
+	static unsigned char stubATR[] = { 0x3B,0xFE,0x18,0x00,0x00,0x81,0x31,0xFE,0x45,0x80,0x31,0x81,0x54,0x48,0x53,0x4D,0x31,0x73,0x80,0x21,0x40,0x81,0x07,0xFA };
+
+	memcpy(atr, stubATR, sizeof(stubATR));
+	*alen = sizeof(stubATR);
+	return 0;
+}
+
+
+
+static int stubNotify(struct ramContext *ctx, int msgid, char *msg) {
+	if (optVerbose)
+		printf("(%d) %s\n", msgid, msg);
+	return 0;
+}
+
+
+
+struct clientWorker {
+	pthread_t thread;
+	struct ramEngine *engine;
+	char *url;
+	int sessions;
+	int failed;
+};
+
+
+
+static void *clientMain(void *arg) {
+	static unsigned char atr[] = { 0x3B,0xFE,0x18,0x00,0x00,0x81,0x31,0xFE,0x45,0x80,0x31,0x81,0x54,0x48,0x53,0x4D,0x31,0x73,0x80,0x21,0x40,0x81,0x07,0xFA };
+	struct clientWorker *w = (struct clientWorker *)arg;
+	struct ramContext *ctx;
+	struct ramClient *client;
+	int i, rc, apducnt;
+
+	if (ramNewClient(&client) < 0) {
+		w->failed = optRounds;
+		return NULL;
+	}
+
+	for (i = 0; (i < optRounds) && !stopRequested; i++) {
+		ramNewContext(&ctx);
+		ramSetClient(ctx, client);
+		ramSetSendApduHandler(ctx, stubSendApdu);
+		ramSetResetHandler(ctx, stubReset);
+		ramSetNotifyHandler(ctx, stubNotify);
+		ramSetUserObject(ctx, &apducnt);
+		ramSetURL(ctx, w->url);
+		ramSetATR(ctx, atr, sizeof(atr));
+		apducnt = 0;
+
+		if (w->engine)
+			rc = ramEngineConnect(w->engine, ctx);
+		else
+			rc = ramConnect(ctx);
+
+		ramFreeContext(&ctx);
+
+		w->sessions++;
+		if (rc != RAME_OK) {
+			w->failed++;
+			if (optVerbose)
+				printf("Session failed with %d\n", rc);
+		}
+	}
+
+	ramFreeClient(&client);
+	return NULL;
+}
+
+
+
+static void *engineMain(void *arg) {
+	ramEngineRun((struct ramEngine *)arg);
+	return NULL;
+}
+
+
+
+static int runClients(double *elapsed, int *sessionCount, int *failedCount) {
+	struct clientWorker *workers;
+	struct ramEngine *engine = NULL;
+	pthread_t engineThread;
+	char url[64];
+	double start;
+	int i;
+
+	snprintf(url, sizeof(url), "http://127.0.0.1:%d/", optPort);
+
+	workers = calloc(optClients, sizeof(struct clientWorker));
+	if (workers == NULL)
+		return -1;
+
+	if (optEngine) {
+		if (ramNewEngine(&engine) < 0) {
+			free(workers);
+			return -1;
+		}
+		pthread_create(&engineThread, NULL, engineMain, engine);
+	}
+
+	start = now();
+
+	for (i = 0; i < optClients; i++) {
+		workers[i].engine = engine;
+		workers[i].url = url;
+		pthread_create(&workers[i].thread, NULL, clientMain, &workers[i]);
+	}
+
+	*sessionCount = 0;
+	*failedCount = 0;
+	for (i = 0; i < optClients; i++) {
+		pthread_join(workers[i].thread, NULL);
+		*sessionCount += workers[i].sessions;
+		*failedCount += workers[i].failed;
+	}
+
+	*elapsed = now() - start;
+
+	if (engine) {
+		ramEngineStop(engine);
+		pthread_join(engineThread, NULL);
+		ramFreeEngine(&engine);
+	}
+
+	free(workers);
+	return 0;
+}
+
+
+
+static void printServerStatistics(double elapsed) {
+	pthread_mutex_lock(&serverLock);
+	printf("Server: %d sessions (%d completed, %d aborted, %d timeouts), %d requests, %d errors\n",
+			stats.sessions, stats.completed, stats.aborted, stats.timeouts, stats.requests, stats.errors);
+	printf("        %d APDUs, %ld bytes received, %ld bytes send\n", stats.apdus, stats.bytesIn, stats.bytesOut);
+	if (elapsed > 0) {
+		printf("        %.1f sessions/s, %.1f requests/s, %.0f APDU/s in %.2f s\n",
+				stats.completed / elapsed, stats.requests / elapsed, stats.apdus / elapsed, elapsed);
+	}
+	pthread_mutex_unlock(&serverLock);
+}
+
+
+
+static void usage() {
+	puts("ramoverhttp-test [option]\n");
+	puts("  -p, --port <n>        Listen on localhost port (default 8088)");
+	puts("  -f, --script <file>   Replay APDU script");
+	puts("  -n, --apdus <n>       Number of APDUs in generated script (default 100)");
+	puts("  -b, --batch <n>       Number of APDUs per request template in generated script (default 10)");
+	puts("  -l, --latency <ms>    Delay each response by ms milliseconds");
+	puts("  -s, --server          Run server only, e.g. to test ram-client");
+	puts("  -c, --clients <n>     Number of concurrent client sessions (default 1)");
+	puts("  -r, --rounds <n>      Number of sessions per client (default 10)");
+	puts("  -d, --card-delay <us> Delay of the stub card for each APDU in microseconds");
+	puts("  -x, --close-after <n> Let the stub card fail and close the session after n APDUs");
+	puts("  -e, --engine          Run client sessions through the curl multi engine");
+	puts("  -v, --verbose         Tell us what you do");
+}
+
+
+
+static int intArg(int *argc, char ***argv) {
+	if (*argc <= 0) {
+		printf("Argument for %s missing\n", **argv);
+		exit(1);
+	}
+	(*argv)++;
+	(*argc)--;
+	return atoi(**argv);
+}
+
+
+
+static void decodeArgs(int argc, char **argv) {
+	argv++;
+	argc--;
+
+	while (argc--) {
+		if (!strcmp(*argv, "--port") || !strcmp(*argv, "-p")) {
+			optPort = intArg(&argc, &argv);
+		} else if (!strcmp(*argv, "--script") || !strcmp(*argv, "-f")) {
+			if (argc <= 0) {
+				printf("Argument for --script missing\n");
+				exit(1);
+			}
+			argv++;
+			argc--;
+			optScript = *argv;
+		} else if (!strcmp(*argv, "--apdus") || !strcmp(*argv, "-n")) {
+			optApdus = intArg(&argc, &argv);
+		} else if (!strcmp(*argv, "--batch") || !strcmp(*argv, "-b")) {
+			optBatch = intArg(&argc, &argv);
+		} else if (!strcmp(*argv, "--latency") || !strcmp(*argv, "-l")) {
+			optLatency = intArg(&argc, &argv);
+		} else if (!strcmp(*argv, "--server") || !strcmp(*argv, "-s")) {
+			optServerOnly = 1;
+		} else if (!strcmp(*argv, "--clients") || !strcmp(*argv, "-c")) {
+			optClients = intArg(&argc, &argv);
+		} else if (!strcmp(*argv, "--rounds") || !strcmp(*argv, "-r")) {
+			optRounds = intArg(&argc, &argv);
+		} else if (!strcmp(*argv, "--card-delay") || !strcmp(*argv, "-d")) {
+			optCardDelay = intArg(&argc, &argv);
+		} else if (!strcmp(*argv, "--close-after") || !strcmp(*argv, "-x")) {
+			optCloseAfter = intArg(&argc, &argv);
+		} else if (!strcmp(*argv, "--engine") || !strcmp(*argv, "-e")) {
+			optEngine = 1;
+		} else if (!strcmp(*argv, "--verbose") || !strcmp(*argv, "-v")) {
+			optVerbose = 1;
+		} else {
+			printf("Unknown argument %s\n", *argv);
+			usage();
+			exit(1);
+		}
+		argv++;
+	}
+
+	if ((optBatch < 1) || (optClients < 1)) {
+		usage();
+		exit(1);
+	}
+}
+
+
+
+int main(int argc, char **argv) {
+	pthread_t serverThread;
+	double start, elapsed;
+	int sessionCount, failedCount, rc;
+
+	decodeArgs(argc, argv);
+
+	signal(SIGINT, onSignal);
+	signal(SIGPIPE, SIG_IGN);
+
+	rc = optScript ? loadScript(optScript) : generateScript();
+	if (rc < 0) {
+		printf("Could not create script\n");
+		return 1;
+	}
+
+	if (startServer(&serverThread) != 0)
+		return 1;
+
+	start = now();
+
+	if (optServerOnly) {
+		printf("Serving %d request templates at http://127.0.0.1:%d/, press Ctrl-C to stop\n", scriptSteps, optPort);
+		while (!stopRequested)
+			usleep(200000);
+		printServerStatistics(now() - start);
+		return 0;
+	}
+
+	rc = runClients(&elapsed, &sessionCount, &failedCount);
+
+	stopRequested = 1;
+	pthread_join(serverThread, NULL);
+
+	if (rc < 0) {
+		printf("Could not start clients\n");
+		return 1;
+	}
+
+	printServerStatistics(elapsed);
+	printf("Client: %d sessions, %d failed, %d clients%s, %.1f sessions/s\n",
+			sessionCount, failedCount, optClients, optEngine ? " using engine" : "",
+			elapsed > 0 ? sessionCount / elapsed : 0.0);
+
+	return (failedCount || stats.errors) ? 1 : 0;
+}
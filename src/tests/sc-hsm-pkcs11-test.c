@@ -118,6 +118,7 @@ void usleep(unsigned int usec)
 
 
 #include <pkcs11/cryptoki.h>
+#include <pkcs11/p11vendor.h>
 
 struct id2name_t {
 	unsigned long       id;
@@ -318,6 +319,7 @@ struct thread_data {
 	CK_SLOT_ID slotid;
 	CK_FUNCTION_LIST_PTR p11;
 	int iterations;
+	long objects;
 };
 
 
@@ -597,6 +599,133 @@ int findObject(CK_FUNCTION_LIST_PTR p11, CK_SESSION_HANDLE session, CK_ATTRIBUTE
 
 
 
+/*
+ * Verify a signature with the public key matching the private key by CKA_ID
+ */
+int testVerify(CK_FUNCTION_LIST_PTR p11, CK_SESSION_HANDLE session, CK_OBJECT_HANDLE hPrivateKey, CK_MECHANISM_PTR mech, char *tbs, CK_BYTE_PTR signature, CK_ULONG len)
+{
+	CK_OBJECT_CLASS class = CKO_PUBLIC_KEY;
+	CK_BYTE id[256];
+	CK_ATTRIBUTE template[] = {
+			{ CKA_CLASS, &class, sizeof(class) },
+			{ CKA_ID, id, sizeof(id) }
+	};
+	CK_OBJECT_HANDLE hnd;
+	char namebuf[40]; /* each thread need its own buffer */
+	int rc;
+
+	rc = p11->C_GetAttributeValue(session, hPrivateKey, &template[1], 1);
+
+	if (rc != CKR_OK) {
+		return rc;
+	}
+
+	rc = findObject(p11, session, (CK_ATTRIBUTE_PTR)&template, sizeof(template) / sizeof(CK_ATTRIBUTE), 0, &hnd);
+
+	if (rc != CKR_OK) {
+		printf("No public key found for verification\n");
+		return CKR_OK;
+	}
+
+	rc = p11->C_VerifyInit(session, mech, hnd);
+	printf("C_VerifyInit - %s : %s\n", id2name(p11CKRName, rc, 0, namebuf), verdict(rc == CKR_OK));
+
+	rc = p11->C_Verify(session, (CK_BYTE_PTR)tbs, strlen(tbs), signature, len);
+	printf("C_Verify - %s : %s\n", id2name(p11CKRName, rc, 0, namebuf), verdict(rc == CKR_OK));
+
+	rc = p11->C_VerifyInit(session, mech, hnd);
+	printf("C_VerifyInit - Multipart - %s : %s\n", id2name(p11CKRName, rc, 0, namebuf), verdict(rc == CKR_OK));
+
+	rc = p11->C_VerifyUpdate(session, (CK_BYTE_PTR)tbs, 6);
+	printf("C_VerifyUpdate (Part #1) - %s : %s\n", id2name(p11CKRName, rc, 0, namebuf), verdict(rc == CKR_OK));
+
+	rc = p11->C_VerifyUpdate(session, (CK_BYTE_PTR)tbs + 6, strlen(tbs) - 6);
+	printf("C_VerifyUpdate (Part #2) - %s : %s\n", id2name(p11CKRName, rc, 0, namebuf), verdict(rc == CKR_OK));
+
+	rc = p11->C_VerifyFinal(session, signature, len);
+	printf("C_VerifyFinal - %s : %s\n", id2name(p11CKRName, rc, 0, namebuf), verdict(rc == CKR_OK));
+
+	rc = p11->C_VerifyInit(session, mech, hnd);
+	printf("C_VerifyInit - %s : %s\n", id2name(p11CKRName, rc, 0, namebuf), verdict(rc == CKR_OK));
+
+	signature[len / 2] ^= 0x01;
+	rc = p11->C_Verify(session, (CK_BYTE_PTR)tbs, strlen(tbs), signature, len);
+	signature[len / 2] ^= 0x01;
+	printf("C_Verify (Modified signature) - %s : %s\n", id2name(p11CKRName, rc, 0, namebuf), verdict(rc == CKR_SIGNATURE_INVALID));
+
+	return CKR_OK;
+}
+
+
+
+int testHostHashedSigning(CK_FUNCTION_LIST_PTR p11, CK_SESSION_HANDLE session, CK_OBJECT_HANDLE hnd, CK_MECHANISM_TYPE mechType)
+{
+	CK_MECHANISM mech = { mechType, 0, 0 };
+	char *tbs = "Hello World";
+	CK_BYTE signature[512];
+	CK_ULONG len;
+	char namebuf[40]; /* each thread need its own buffer */
+	int rc;
+
+	rc = p11->C_SignInit(session, &mech, hnd);
+	printf("C_SignInit (Mechanism %08lX) - %s : %s\n", mechType, id2name(p11CKRName, rc, 0, namebuf), verdict(rc == CKR_OK));
+
+	if (rc != CKR_OK)
+		return rc;
+
+	rc = p11->C_SignUpdate(session, (CK_BYTE_PTR)tbs, 6);
+	printf("C_SignUpdate (Part #1) - %s : %s\n", id2name(p11CKRName, rc, 0, namebuf), verdict(rc == CKR_OK));
+
+	rc = p11->C_SignUpdate(session, (CK_BYTE_PTR)tbs + 6, strlen(tbs) - 6);
+	printf("C_SignUpdate (Part #2) - %s : %s\n", id2name(p11CKRName, rc, 0, namebuf), verdict(rc == CKR_OK));
+
+	len = sizeof(signature);
+	rc = p11->C_SignFinal(session, signature, &len);
+	printf("C_SignFinal - %s : %s\n", id2name(p11CKRName, rc, 0, namebuf), verdict(rc == CKR_OK));
+
+	if (rc == CKR_OK)
+		testVerify(p11, session, hnd, &mech, tbs, signature, len);
+
+	return rc;
+}
+
+
+
+/*
+ * Sign a message spanning several hash blocks, so that a token hashing in the host
+ * either transfers the complete hash or performs the last round on the card
+ */
+int testLongDataSigning(CK_FUNCTION_LIST_PTR p11, CK_SESSION_HANDLE session, CK_OBJECT_HANDLE hnd, CK_MECHANISM_TYPE mechType)
+{
+	CK_MECHANISM mech = { mechType, 0, 0 };
+	char tbs[301];
+	CK_BYTE signature[512];
+	CK_ULONG len;
+	char namebuf[40]; /* each thread need its own buffer */
+	int rc, i;
+
+	for (i = 0; i < sizeof(tbs) - 1; i++)
+		tbs[i] = 'A' + i % 26;
+	tbs[i] = 0;
+
+	rc = p11->C_SignInit(session, &mech, hnd);
+	printf("C_SignInit (Mechanism %08lX) - %s : %s\n", mechType, id2name(p11CKRName, rc, 0, namebuf), verdict(rc == CKR_OK));
+
+	if (rc != CKR_OK)
+		return rc;
+
+	len = sizeof(signature);
+	rc = p11->C_Sign(session, (CK_BYTE_PTR)tbs, strlen(tbs), signature, &len);
+	printf("C_Sign (%d bytes) - %s : %s\n", (int)strlen(tbs), id2name(p11CKRName, rc, 0, namebuf), verdict(rc == CKR_OK));
+
+	if (rc == CKR_OK)
+		testVerify(p11, session, hnd, &mech, tbs, signature, len);
+
+	return rc;
+}
+
+
+
 int testRSASigning(CK_FUNCTION_LIST_PTR p11, CK_SLOT_ID slotid, int id)
 {
 	CK_SESSION_HANDLE session;
@@ -666,6 +795,8 @@ int testRSASigning(CK_FUNCTION_LIST_PTR p11, CK_SLOT_ID slotid, int id)
 		if (rc == CKR_OK) {
 			bin2str(scr, sizeof(scr), signature, len);
 			printf("Signature:\n%s\n", scr);
+
+			testVerify(p11, session, hnd, &mech, tbs, signature, len);
 		}
 
 		rc = p11->C_SignInit(session, &mech, hnd);
@@ -726,6 +857,11 @@ int testRSASigning(CK_FUNCTION_LIST_PTR p11, CK_SLOT_ID slotid, int id)
 			printf("Signature:\n%s\n", scr);
 		}
 
+		testHostHashedSigning(p11, session, hnd, CKM_SHA384_RSA_PKCS);
+		testHostHashedSigning(p11, session, hnd, CKM_SHA512_RSA_PKCS);
+		testHostHashedSigning(p11, session, hnd, CKM_SHA512_RSA_PKCS_PSS);
+		testLongDataSigning(p11, session, hnd, CKM_SHA256_RSA_PKCS);
+
 		keyno++;
 	}
 
@@ -737,6 +873,169 @@ out:
 
 
 
+int testSignBatch(CK_FUNCTION_LIST_PTR p11, SC_VENDOR_FUNCTION_LIST_PTR vendor, CK_SLOT_ID slotid)
+{
+	CK_SESSION_HANDLE session;
+	CK_OBJECT_CLASS class = CKO_PRIVATE_KEY;
+	CK_KEY_TYPE keyType = CKK_RSA;
+	CK_BBOOL _true = CK_TRUE;
+	CK_ATTRIBUTE template[] = {
+			{ CKA_CLASS, &class, sizeof(class) },
+			{ CKA_KEY_TYPE, &keyType, sizeof(keyType) },
+			{ CKA_SIGN, &_true, sizeof(_true) }
+	};
+	CK_OBJECT_HANDLE hnd;
+	CK_MECHANISM mech = { CKM_SHA256_RSA_PKCS, 0, 0 };
+	char *tbs[] = { "Hello World", "Hello Batch", "Hello Again", "Hello Last" };
+	CK_BYTE signature[4][512];
+	SC_SIGN_BATCH_ITEM items[4];
+	char scr[1024];
+	int rc, i;
+
+	rc = p11->C_OpenSession(slotid, CKF_RW_SESSION | CKF_SERIAL_SESSION, NULL, NULL, &session);
+	printf("C_OpenSession (Slot=%ld) - %s : %s\n", slotid, id2name(p11CKRName, rc, 0, namebuf), verdict(rc == CKR_OK));
+
+	if (rc != CKR_OK)
+		return rc;
+
+	rc = p11->C_Login(session, CKU_USER, pin, pinlen);
+	printf("C_Login User (Slot=%ld) - %s : %s\n", slotid, id2name(p11CKRName, rc, 0, namebuf), verdict(rc == CKR_OK || rc == CKR_USER_ALREADY_LOGGED_IN));
+
+	if (rc != CKR_OK && rc != CKR_USER_ALREADY_LOGGED_IN)
+		goto out;
+
+	rc = findObject(p11, session, (CK_ATTRIBUTE_PTR)&template, sizeof(template) / sizeof(CK_ATTRIBUTE), 0, &hnd);
+
+	if (rc != CKR_OK) {
+		printf("No RSA key found (Slot=%ld)\n", slotid);
+		rc = CKR_OK;
+		goto out;
+	}
+
+	for (i = 0; i < 4; i++) {
+		items[i].pData = (CK_BYTE_PTR)tbs[i];
+		items[i].ulDataLen = strlen(tbs[i]);
+		items[i].pSignature = signature[i];
+		items[i].ulSignatureLen = sizeof(signature[i]);
+		items[i].rv = CKR_GENERAL_ERROR;
+	}
+
+	// Query length for first item and use a buffer too small for the second
+	items[0].pSignature = NULL;
+	items[1].ulSignatureLen = 1;
+
+	rc = vendor->SC_SignBatch(session, &mech, hnd, items, 4);
+	printf("SC_SignBatch (Session %ld, Slot=%ld) - %s : %s\n", session, slotid, id2name(p11CKRName, rc, 0, namebuf), verdict(rc == CKR_OK));
+
+	if (rc != CKR_OK)
+		goto out;
+
+	printf("Item #0 - %s : %s\n", id2name(p11CKRName, items[0].rv, 0, namebuf), verdict(items[0].rv == CKR_OK));
+	printf("Signature size = %lu\n", items[0].ulSignatureLen);
+	printf("Item #1 - %s : %s\n", id2name(p11CKRName, items[1].rv, 0, namebuf), verdict(items[1].rv == CKR_BUFFER_TOO_SMALL));
+
+	for (i = 2; i < 4; i++) {
+		printf("Item #%d - %s : %s\n", i, id2name(p11CKRName, items[i].rv, 0, namebuf), verdict(items[i].rv == CKR_OK && items[i].ulSignatureLen == items[0].ulSignatureLen));
+
+		if (items[i].rv == CKR_OK) {
+			bin2str(scr, sizeof(scr), items[i].pSignature, items[i].ulSignatureLen);
+			printf("Signature:\n%s\n", scr);
+		}
+	}
+
+	rc = p11->C_SignInit(session, &mech, hnd);
+	printf("C_SignInit (Session %ld, Slot=%ld) - %s : %s\n", session, slotid, id2name(p11CKRName, rc, 0, namebuf), verdict(rc == CKR_OK));
+
+	rc = vendor->SC_SignBatch(session, &mech, hnd, items, 4);
+	printf("SC_SignBatch with active operation (Session %ld, Slot=%ld) - %s : %s\n", session, slotid, id2name(p11CKRName, rc, 0, namebuf), verdict(rc == CKR_OPERATION_ACTIVE));
+
+out:
+	p11->C_CloseSession(session);
+
+	return rc;
+}
+
+
+
+int testDigest(CK_FUNCTION_LIST_PTR p11, CK_SESSION_HANDLE session)
+{
+	CK_MECHANISM mech = { CKM_SHA256, 0, 0 };
+	CK_MECHANISM badmech = { CKM_MD5, 0, 0 };
+	CK_BYTE hash[64];
+	CK_ULONG len;
+	// SHA-256 of "Hello World"
+	CK_BYTE ref[] = {
+		0xA5, 0x91, 0xA6, 0xD4, 0x0B, 0xF4, 0x20, 0x40, 0x4A, 0x01, 0x17, 0x33, 0xCF, 0xB7, 0xB1, 0x90,
+		0xD6, 0x2C, 0x65, 0xBF, 0x0B, 0xCD, 0xA3, 0x2B, 0x57, 0xB2, 0x77, 0xD9, 0xAD, 0x9F, 0x14, 0x6E
+	};
+	char *tbs = "Hello World";
+	int rc;
+
+	rc = p11->C_DigestInit(session, &badmech);
+	printf("C_DigestInit (CKM_MD5) - %s : %s\n", id2name(p11CKRName, rc, 0, namebuf), verdict(rc == CKR_MECHANISM_INVALID));
+
+	rc = p11->C_DigestInit(session, &mech);
+	printf("C_DigestInit (CKM_SHA256) - %s : %s\n", id2name(p11CKRName, rc, 0, namebuf), verdict(rc == CKR_OK));
+
+	if (rc != CKR_OK)
+		return rc;
+
+	rc = p11->C_Digest(session, (CK_BYTE_PTR)tbs, strlen(tbs), NULL, &len);
+	printf("C_Digest (Length) - %s : %s\n", id2name(p11CKRName, rc, 0, namebuf), verdict(rc == CKR_OK && len == sizeof(ref)));
+
+	rc = p11->C_Digest(session, (CK_BYTE_PTR)tbs, strlen(tbs), hash, &len);
+	printf("C_Digest - %s : %s\n", id2name(p11CKRName, rc, 0, namebuf), verdict(rc == CKR_OK && len == sizeof(ref) && !memcmp(hash, ref, sizeof(ref))));
+
+	rc = p11->C_DigestInit(session, &mech);
+	printf("C_DigestInit (CKM_SHA256) - %s : %s\n", id2name(p11CKRName, rc, 0, namebuf), verdict(rc == CKR_OK));
+
+	rc = p11->C_DigestUpdate(session, (CK_BYTE_PTR)tbs, 6);
+	printf("C_DigestUpdate - %s : %s\n", id2name(p11CKRName, rc, 0, namebuf), verdict(rc == CKR_OK));
+
+	rc = p11->C_DigestUpdate(session, (CK_BYTE_PTR)tbs + 6, strlen(tbs) - 6);
+	printf("C_DigestUpdate - %s : %s\n", id2name(p11CKRName, rc, 0, namebuf), verdict(rc == CKR_OK));
+
+	len = 1;
+	rc = p11->C_DigestFinal(session, hash, &len);
+	printf("C_DigestFinal (Buffer too small) - %s : %s\n", id2name(p11CKRName, rc, 0, namebuf), verdict(rc == CKR_BUFFER_TOO_SMALL && len == sizeof(ref)));
+
+	rc = p11->C_DigestFinal(session, hash, &len);
+	printf("C_DigestFinal - %s : %s\n", id2name(p11CKRName, rc, 0, namebuf), verdict(rc == CKR_OK && !memcmp(hash, ref, sizeof(ref))));
+
+	rc = p11->C_DigestFinal(session, hash, &len);
+	printf("C_DigestFinal (Not initialized) - %s : %s\n", id2name(p11CKRName, rc, 0, namebuf), verdict(rc == CKR_OPERATION_NOT_INITIALIZED));
+
+	return CKR_OK;
+}
+
+
+
+int testRandom(CK_FUNCTION_LIST_PTR p11, CK_SESSION_HANDLE session)
+{
+	CK_BYTE rnd1[32], rnd2[32], large[100000];
+	CK_BYTE seed[] = "Application provided seed";
+	int rc;
+
+	rc = p11->C_GenerateRandom(session, rnd1, sizeof(rnd1));
+	printf("C_GenerateRandom - %s : %s\n", id2name(p11CKRName, rc, 0, namebuf), verdict(rc == CKR_OK));
+
+	if (rc != CKR_OK)
+		return rc;
+
+	rc = p11->C_GenerateRandom(session, rnd2, sizeof(rnd2));
+	printf("C_GenerateRandom - %s : %s\n", id2name(p11CKRName, rc, 0, namebuf), verdict(rc == CKR_OK && memcmp(rnd1, rnd2, sizeof(rnd1))));
+
+	rc = p11->C_SeedRandom(session, seed, sizeof(seed));
+	printf("C_SeedRandom - %s : %s\n", id2name(p11CKRName, rc, 0, namebuf), verdict(rc == CKR_OK));
+
+	rc = p11->C_GenerateRandom(session, large, sizeof(large));
+	printf("C_GenerateRandom (Large) - %s : %s\n", id2name(p11CKRName, rc, 0, namebuf), verdict(rc == CKR_OK));
+
+	return CKR_OK;
+}
+
+
+
 int testECSigning(CK_FUNCTION_LIST_PTR p11, CK_SLOT_ID slotid, int id)
 {
 	CK_SESSION_HANDLE session;
@@ -793,6 +1092,14 @@ int testECSigning(CK_FUNCTION_LIST_PTR p11, CK_SLOT_ID slotid, int id)
 
 		bin2str(scr, sizeof(scr), signature, len);
 		printf("Signature:\n%s\n", scr);
+
+		if (rc == CKR_OK)
+			testVerify(p11, session, hnd, &mech, tbs, signature, len);
+
+		testHostHashedSigning(p11, session, hnd, CKM_ECDSA_SHA256);
+		testHostHashedSigning(p11, session, hnd, CKM_ECDSA_SHA384);
+		testHostHashedSigning(p11, session, hnd, CKM_ECDSA_SHA512);
+
 		keyno++;
 	}
 
@@ -952,6 +1259,334 @@ void testSigningMultiThreading(CK_FUNCTION_LIST_PTR p11)
 
 
 
+#ifndef _WIN32
+void*
+#else
+DWORD WINAPI
+#endif
+OpenSessionThread(void *arg) {
+
+	struct thread_data *d;
+	CK_SESSION_HANDLE session;
+	CK_OBJECT_HANDLE hnd[16];
+	CK_ULONG count, total;
+	int rc;
+	char namebuf[40]; /* each thread need its own buffer */
+
+	d = (struct thread_data *) arg;
+
+	rc = d->p11->C_OpenSession(d->slotid, CKF_RW_SESSION | CKF_SERIAL_SESSION, NULL, NULL, &session);
+	printf("C_OpenSession (Thread %i, Slot=%ld) - %s : %s\n", d->thread_id, d->slotid, id2name(p11CKRName, rc, 0, namebuf), verdict(rc == CKR_OK));
+
+	if (rc != CKR_OK)
+		return 0;
+
+	rc = d->p11->C_FindObjectsInit(session, NULL, 0);
+	printf("C_FindObjectsInit (Thread %i, Session %ld, Slot=%ld) - %s : %s\n", d->thread_id, session, d->slotid, id2name(p11CKRName, rc, 0, namebuf), verdict(rc == CKR_OK));
+
+	total = 0;
+	while (rc == CKR_OK) {
+		rc = d->p11->C_FindObjects(session, hnd, sizeof(hnd) / sizeof(*hnd), &count);
+		if ((rc != CKR_OK) || (count == 0))
+			break;
+		total += count;
+	}
+
+	d->p11->C_FindObjectsFinal(session);
+	printf("C_FindObjects (Thread %i, Session %ld, Slot=%ld) found %lu objects - %s : %s\n", d->thread_id, session, d->slotid, total, id2name(p11CKRName, rc, 0, namebuf), verdict(rc == CKR_OK));
+
+	d->p11->C_CloseSession(session);
+	d->objects = (long)total;
+	return 0;
+}
+
+
+
+/*
+ * Open sessions concurrently on all slots with a token before any object was loaded, so that
+ * the primary and virtual slots of a card load their objects in parallel. Two threads per slot
+ * must find the same number of objects.
+ */
+void testOpenSessionMultiThreading(CK_FUNCTION_LIST_PTR p11)
+{
+	CK_ULONG slots, i;
+	CK_SLOT_ID_PTR slotlist;
+	pthread_t threads[NUM_THREADS];
+	pthread_attr_t attr;
+	void *status;
+	struct thread_data data[NUM_THREADS];
+	int rc, nothreads;
+	long t;
+
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
+
+	rc = p11->C_GetSlotList(TRUE, NULL, &slots);
+
+	if ((rc != CKR_OK) || (slots == 0))
+		return;
+
+	slotlist = (CK_SLOT_ID_PTR) malloc(sizeof(CK_SLOT_ID) * slots);
+
+	rc = p11->C_GetSlotList(TRUE, slotlist, &slots);
+	printf("C_GetSlotList - %s : %s\n", id2name(p11CKRName, rc, 0, namebuf), verdict(rc == CKR_OK));
+
+	nothreads = 0;
+	for (i = 0; (rc == CKR_OK) && (i < slots) && (nothreads + 2 <= NUM_THREADS); i++) {
+		if ((optSlotId != -1) && (optSlotId != slotlist[i]))
+			continue;
+
+		for (t = nothreads; t < nothreads + 2; t++) {
+			data[t].p11 = p11;
+			data[t].slotid = slotlist[i];
+			data[t].thread_id = t;
+			data[t].objects = -1;
+
+			rc = pthread_create(&threads[t], &attr, OpenSessionThread, (void *)&data[t]);
+
+			if (rc) {
+				printf("ERROR; return code from pthread_create() is %d\n", rc);
+				exit(1);
+			}
+		}
+		nothreads += 2;
+	}
+
+	pthread_attr_destroy(&attr);
+
+	for (t = 0; t < nothreads; t++) {
+		rc = pthread_join(threads[t], &status);
+
+		if (rc) {
+			printf("ERROR; return code from pthread_join() is %d\n", rc);
+			exit(1);
+		}
+	}
+
+	for (t = 0; t < nothreads; t += 2) {
+		printf("Objects in slot %ld (Thread %ld and %ld) : %s\n", data[t].slotid, t, t + 1, verdict((data[t].objects >= 0) && (data[t].objects == data[t + 1].objects)));
+	}
+
+	free(slotlist);
+}
+
+
+
+/*
+ * Encrypt a secret with the public key in the host and decrypt it with the matching private key
+ */
+int testRSADecryptionRoundtrip(CK_FUNCTION_LIST_PTR p11, CK_SLOT_ID slotid, int id)
+{
+	CK_SESSION_HANDLE session;
+	CK_OBJECT_CLASS class = CKO_PRIVATE_KEY;
+	CK_KEY_TYPE keyType = CKK_RSA;
+	CK_BBOOL _true = CK_TRUE;
+	CK_ATTRIBUTE template[] = {
+			{ CKA_CLASS, &class, sizeof(class) },
+			{ CKA_KEY_TYPE, &keyType, sizeof(keyType) },
+			{ CKA_DECRYPT, &_true, sizeof(_true) }
+	};
+	CK_BYTE keyid[64];
+	CK_ATTRIBUTE idtemplate[] = {
+			{ CKA_ID, keyid, sizeof(keyid) }
+	};
+	CK_ATTRIBUTE pubtemplate[] = {
+			{ CKA_CLASS, &class, sizeof(class) },
+			{ CKA_ID, keyid, 0 }
+	};
+	CK_OBJECT_HANDLE hnd, pubhnd;
+	CK_MECHANISM mech = { CKM_RSA_PKCS, 0, 0 };
+	char *secret = "Session key to be wrapped";
+	CK_BYTE plain[512], cryptogram[512];
+	CK_ULONG len, clen;
+	int rc;
+	char namebuf[40]; /* each thread need its own buffer */
+
+	rc = p11->C_OpenSession(slotid, CKF_RW_SESSION | CKF_SERIAL_SESSION, NULL, NULL, &session);
+	printf("C_OpenSession (Thread %i, Slot=%ld) - %s : %s\n", id, slotid, id2name(p11CKRName, rc, 0, namebuf), verdict(rc == CKR_OK));
+
+	if (rc != CKR_OK)
+		return rc;
+
+	rc = p11->C_Login(session, CKU_USER, pin, pinlen);
+	printf("C_Login User (Thread %i, Slot=%ld) - %s : %s\n", id, slotid, id2name(p11CKRName, rc, 0, namebuf), verdict(rc == CKR_OK || rc == CKR_USER_ALREADY_LOGGED_IN));
+
+	if (rc != CKR_OK && rc != CKR_USER_ALREADY_LOGGED_IN)
+		goto out;
+
+	rc = findObject(p11, session, (CK_ATTRIBUTE_PTR)&template, sizeof(template) / sizeof(CK_ATTRIBUTE), 0, &hnd);
+
+	if (rc != CKR_OK) {
+		printf("No decryption key found (Thread %i, Session %ld, Slot=%ld)\n", id, session, slotid);
+		rc = CKR_OK;
+		goto out;
+	}
+
+	rc = p11->C_GetAttributeValue(session, hnd, idtemplate, 1);
+
+	if (rc != CKR_OK) {
+		printf("C_GetAttributeValue (Thread %i, Session %ld, Slot=%ld) - %s : %s\n", id, session, slotid, id2name(p11CKRName, rc, 0, namebuf), verdict(rc == CKR_OK));
+		goto out;
+	}
+
+	class = CKO_PUBLIC_KEY;
+	pubtemplate[1].ulValueLen = idtemplate[0].ulValueLen;
+	rc = findObject(p11, session, (CK_ATTRIBUTE_PTR)&pubtemplate, sizeof(pubtemplate) / sizeof(CK_ATTRIBUTE), 0, &pubhnd);
+
+	if (rc != CKR_OK) {
+		printf("No public key found (Thread %i, Session %ld, Slot=%ld)\n", id, session, slotid);
+		rc = CKR_OK;
+		goto out;
+	}
+
+	rc = p11->C_EncryptInit(session, &mech, pubhnd);
+	printf("C_EncryptInit (Thread %i, Session %ld, Slot=%ld) - %s : %s\n", id, session, slotid, id2name(p11CKRName, rc, 0, namebuf), verdict(rc == CKR_OK));
+
+	clen = sizeof(cryptogram);
+	rc = p11->C_Encrypt(session, (CK_BYTE_PTR)secret, strlen(secret), cryptogram, &clen);
+	printf("C_Encrypt (Thread %i, Session %ld, Slot=%ld) - %s : %s\n", id, session, slotid, id2name(p11CKRName, rc, 0, namebuf), verdict(rc == CKR_OK));
+
+	if (rc != CKR_OK)
+		goto out;
+
+	rc = p11->C_DecryptInit(session, &mech, hnd);
+	printf("C_DecryptInit (Thread %i, Session %ld, Slot=%ld) - %s : %s\n", id, session, slotid, id2name(p11CKRName, rc, 0, namebuf), verdict(rc == CKR_OK));
+
+	len = sizeof(plain);
+	rc = p11->C_Decrypt(session, cryptogram, clen, plain, &len);
+	printf("C_Decrypt (Thread %i, Session %ld, Slot=%ld) - %s : %s\n", id, session, slotid, id2name(p11CKRName, rc, 0, namebuf), verdict((rc == CKR_OK) && (len == strlen(secret)) && !memcmp(plain, secret, len)));
+
+	out:
+		p11->C_CloseSession(session);
+	return rc;
+}
+
+
+
+#ifndef _WIN32
+void*
+#else
+DWORD WINAPI
+#endif
+DecryptThread(void *arg) {
+
+	struct thread_data *d;
+	int rc;
+
+	d = (struct thread_data *) arg;
+
+	rc = CKR_OK;
+	while (d->iterations && rc == CKR_OK) {
+		rc = testRSADecryptionRoundtrip(d->p11, d->slotid, d->thread_id);
+		d->iterations--;
+	}
+
+	d->iterations = 0;
+	return 0;
+}
+
+
+
+/*
+ * Run signing and decryption concurrently on all slots with a token, e.g. on the QES and the
+ * PKI application of a card presented in a primary and a virtual slot
+ */
+void testDecryptSigningMultiThreading(CK_FUNCTION_LIST_PTR p11)
+{
+	CK_ULONG slots, i;
+	CK_SLOT_ID_PTR slotlist;
+	pthread_t threads[NUM_THREADS];
+	pthread_attr_t attr;
+	void *status;
+	struct thread_data data[NUM_THREADS];
+	int rc, nothreads;
+	long t;
+
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
+
+	rc = p11->C_GetSlotList(TRUE, NULL, &slots);
+
+	if ((rc != CKR_OK) || (slots == 0))
+		return;
+
+	slotlist = (CK_SLOT_ID_PTR) malloc(sizeof(CK_SLOT_ID) * slots);
+
+	rc = p11->C_GetSlotList(TRUE, slotlist, &slots);
+	printf("C_GetSlotList - %s : %s\n", id2name(p11CKRName, rc, 0, namebuf), verdict(rc == CKR_OK));
+
+	nothreads = 0;
+	for (i = 0; (rc == CKR_OK) && (i < slots) && (nothreads + 2 <= NUM_THREADS); i++) {
+		if ((optSlotId != -1) && (optSlotId != slotlist[i]))
+			continue;
+
+		for (t = nothreads; t < nothreads + 2; t++) {
+			data[t].p11 = p11;
+			data[t].slotid = slotlist[i];
+			data[t].thread_id = t;
+			data[t].iterations = optIteration;
+
+			rc = pthread_create(&threads[t], &attr, t & 1 ? DecryptThread : SignThread, (void *)&data[t]);
+
+			if (rc) {
+				printf("ERROR; return code from pthread_create() is %d\n", rc);
+				exit(1);
+			}
+		}
+		nothreads += 2;
+	}
+
+	pthread_attr_destroy(&attr);
+
+	for (t = 0; t < nothreads; t++) {
+		rc = pthread_join(threads[t], &status);
+
+		if (rc) {
+			printf("ERROR; return code from pthread_join() is %d\n", rc);
+			exit(1);
+		}
+
+		printf("Thread %ld completed\n", t);
+	}
+
+	free(slotlist);
+}
+
+
+
+void printSlotStatistics(CK_FUNCTION_LIST_PTR p11, SC_VENDOR_FUNCTION_LIST_PTR vendor)
+{
+	CK_RV rc;
+	CK_ULONG slots, i;
+	CK_SLOT_ID_PTR slotlist;
+	SC_SLOT_STATISTICS stats;
+
+	rc = p11->C_GetSlotList(TRUE, NULL, &slots);
+
+	if ((rc != CKR_OK) || (slots == 0))
+		return;
+
+	slotlist = (CK_SLOT_ID_PTR) malloc(sizeof(CK_SLOT_ID) * slots);
+
+	rc = p11->C_GetSlotList(TRUE, slotlist, &slots);
+
+	for (i = 0; (rc == CKR_OK) && (i < slots); i++) {
+		rc = vendor->SC_GetSlotStatistics(slotlist[i], &stats);
+		printf("SC_GetSlotStatistics (Slot=%ld) - %s : %s\n", slotlist[i], id2name(p11CKRName, rc, 0, namebuf), verdict(rc == CKR_OK));
+
+		if (rc == CKR_OK) {
+			printf("Commands %lu, busy %lu ms, idle %lu ms, utilisation %.1lf%%, max queue %lu\n",
+					stats.ulCommands, stats.ulBusyTime, stats.ulIdleTime,
+					stats.ulBusyTime + stats.ulIdleTime ? 100.0 * stats.ulBusyTime / (stats.ulBusyTime + stats.ulIdleTime) : 0.0,
+					stats.ulMaxQueueLength);
+		}
+	}
+
+	free(slotlist);
+}
+
+
+
 void testRSADecryption(CK_FUNCTION_LIST_PTR p11, CK_SESSION_HANDLE session)
 {
 	CK_OBJECT_CLASS class = CKO_PRIVATE_KEY;
@@ -972,8 +1607,10 @@ void testRSADecryption(CK_FUNCTION_LIST_PTR p11, CK_SESSION_HANDLE session)
 	char *p15_cryptogram = "\x0A\x01\x74\xAD\x63\xD4\xB1\x34\x65\x9D\xEE\xC9\x14\x0A\x1D\xE9\x2E\x27\x38\xE4\x41\x75\x90\x59\xD2\x4F\xC7\xA5\x15\xB3\x69\xB7\x44\x14\xD7\xA0\xDA\xD7\xEE\xBB\xDC\x6B\x9F\x3D\x91\x1D\x15\xA9\xCF\x48\xFC\x11\x78\x89\x8D\xFA\x8C\x63\x1D\xD4\xFF\xD5\x71\xBB\x81\x4C\xA4\xB3\x06\x14\x5E\x34\xF7\xE8\x73\x39\x86\xB9\x31\x31\xE1\xC7\xAB\xCF\xEB\x1C\xA8\x2E\x1B\x3D\x05\x60\x0F\x32\xEF\x1C\x89\x30\x50\x4A\xC9\x90\x83\x6A\xAA\x12\x8A\x2B\xF6\x39\x2C\xF1\xEC\x4F\x01\x20\x50\xF0\x36\x49\x25\x11\x04\xB0\x94\xAA\xEF\x7D\xFE\xAA\x60\x34\x32\x6E\x65\x30\x66\x26\x6D\x8F\xB6\xE6\xF7\xED\x7A\xC9\xE8\x77\xD8\x5E\x84\x7B\x06\xE5\x0D\xC2\xA1\xC6\x46\x0B\x90\xCF\xF2\x9D\xA6\xC3\xEA\x29\xB0\xE2\xDE\x15\x1B\x72\x63\x01\x23\x85\xB3\x25\xAD\x43\x50\x7F\x1E\x7F\xBF\x6E\x22\x4A\x13\x33\x55\x55\xAA\xE1\x87\xDD\xE5\x16\x0F\x2A\x29\x34\xBB\xFA\x27\xD2\x03\x17\xAB\xF2\x91\x97\xE2\x3B\xCA\x74\x2E\xEA\xA6\x82\x10\x74\xDD\x7A\x99\x52\xA0\x44\x36\xB7\x85\xB4\x88\xE0\xD9\x00\x75\xC5\xD9\xBF\x5D\x5B\x32\xFD\xBD\xD6\x8F\x9B\x3D\x12\xD6\x5E\x15\x32";
 	char *oaep_cryptogram = "\x96\x1B\x87\x4A\x68\xD0\x17\xDC\x74\x3E\x22\x6B\xB0\x97\x36\x35\xE1\x05\xCB\xA8\x23\x97\xEF\xCB\x58\xE7\x70\x04\x6B\x85\x7B\x30\x8E\x7D\x23\x7F\x66\x3F\x5D\x80\xC3\x93\x0F\x30\xA2\x01\x34\x7C\x85\x8D\x94\x22\xE7\xBE\x3A\x59\x33\xD7\xCB\x69\xA5\xAB\xA4\x02\xAB\x33\xE6\x41\xF0\x5D\x85\xF0\x09\x7E\x9D\x88\xDD\x59\x63\xDB\xF3\x89\x8D\x1F\x8B\xE6\x22\x7D\xC1\x31\x42\xAE\x67\x68\xBA\x2A\x10\x51\x09\xF7\x4F\x2E\x0E\xF7\xB4\xF2\xE3\x53\x68\x97\x27\xD8\xAD\x6F\x8B\x40\x96\x69\x84\x08\x55\x43\xC7\xA0\xD8\x89\x7B\x72\x87\xDE\xC7\xDC\xD1\x22\x7B\x75\xA5\xBC\xEB\x73\x56\x97\xBE\xA1\xD1\x7B\x98\xF2\x5B\x84\x1D\x6E\xBA\x47\xEE\x96\x95\x81\xC8\xCC\x00\xB1\x43\xBA\xF7\xB7\x29\x79\x7A\x1D\x1E\x57\x05\xAF\xF5\x96\x2E\x8C\xC6\xC7\x51\x26\x74\x73\x4D\x06\xB7\xB3\xC1\x74\xA4\xC8\x8E\xC2\x8F\x1A\x6B\x80\x9D\xF7\x99\xD4\x05\x54\x38\x5D\xA3\x45\xE2\x4A\x4D\x3B\x53\xC3\xAE\x83\xF0\xDB\x90\xA6\xA4\xDD\x18\xF3\xD8\x36\x2C\x5C\x82\x04\xB2\x78\x32\x3A\x78\x58\x9B\x29\x2D\x45\x85\x4E\x4A\x08\xED\xDF\x36\x73\xFA\xD9\xB9\x4E\x0D\x8F\xCC\x50";
 
-	CK_BYTE plain[256];
-	CK_ULONG len;
+	char *secret = "Session key to be wrapped";
+	CK_OBJECT_HANDLE pubhnd;
+	CK_BYTE plain[256], cryptogram[512];
+	CK_ULONG len, clen;
 	char scr[1024];
 	int rc;
 
@@ -1043,6 +1680,33 @@ void testRSADecryption(CK_FUNCTION_LIST_PTR p11, CK_SESSION_HANDLE session)
 	bin2str(scr, sizeof(scr), plain, len);
 	printf("Plain:\n%s\n", scr);
 
+	// Encrypt with the public key in the host and decrypt with the private key on the token
+	class = CKO_PUBLIC_KEY;
+	rc = findObject(p11, session, (CK_ATTRIBUTE_PTR)&template, sizeof(template) / sizeof(CK_ATTRIBUTE), 0, &pubhnd);
+
+	if (rc != CKR_OK) {
+		printf("Public key %s not found\n", label);
+		return;
+	}
+
+	printf("Calling C_EncryptInit()");
+	rc = p11->C_EncryptInit(session, &mech_p15, pubhnd);
+	printf("- %s : %s\n", id2name(p11CKRName, rc, 0, namebuf), verdict(rc == CKR_OK));
+
+	printf("Calling C_Encrypt()");
+	len = sizeof(cryptogram);
+	rc = p11->C_Encrypt(session, (CK_BYTE_PTR)secret, strlen(secret), cryptogram, &len);
+	printf("- %s : %s\n", id2name(p11CKRName, rc, 0, namebuf), verdict(rc == CKR_OK));
+
+	printf("Calling C_DecryptInit()");
+	rc = p11->C_DecryptInit(session, &mech_p15, hnd);
+	printf("- %s : %s\n", id2name(p11CKRName, rc, 0, namebuf), verdict(rc == CKR_OK));
+
+	printf("Calling C_Decrypt()");
+	clen = len;
+	len = sizeof(plain);
+	rc = p11->C_Decrypt(session, cryptogram, clen, plain, &len);
+	printf("- %s : %s\n", id2name(p11CKRName, rc, 0, namebuf), verdict((rc == CKR_OK) && (len == strlen(secret)) && !memcmp(plain, secret, len)));
 }
 
 
@@ -1669,6 +2333,8 @@ int main(int argc, char *argv[])
 	CK_FUNCTION_LIST_PTR p11;
 	LIB_HANDLE dlhandle;
 	CK_RV (*C_GetFunctionList)(CK_FUNCTION_LIST_PTR_PTR);
+	SC_GetVendorFunctionList_t SC_GetVendorFunctionList;
+	SC_VENDOR_FUNCTION_LIST_PTR vendor = NULL;
 	CK_C_INITIALIZE_ARGS initArgs;
 
 	decodeArgs(argc, argv);
@@ -1688,6 +2354,12 @@ int main(int argc, char *argv[])
 
 	(*C_GetFunctionList)(&p11);
 
+	SC_GetVendorFunctionList = (SC_GetVendorFunctionList_t)dlsym(dlhandle, "SC_GetVendorFunctionList");
+
+	if (SC_GetVendorFunctionList) {
+		(*SC_GetVendorFunctionList)(&vendor);
+	}
+
 	memset(&initArgs, 0, sizeof(initArgs));
 	initArgs.flags = CKF_OS_LOCKING_OK;
 
@@ -1730,6 +2402,11 @@ int main(int argc, char *argv[])
 			exit(1);
 		}
 
+#ifndef WIN32
+		// Must run before any other test loads the objects of a token
+		testOpenSessionMultiThreading(p11);
+#endif
+
 		i = 0;
 
 		while (i < slots) {
@@ -1819,8 +2496,15 @@ int main(int argc, char *argv[])
 				memset(attr, 0, sizeof(attr));
 				listObjects(p11, session, attr, 0);
 
+				testDigest(p11, session);
+
+				testRandom(p11, session);
+
 				testRSASigning(p11, slotid, 0);
 
+				if (vendor)
+					testSignBatch(p11, vendor, slotid);
+
 				//	Test requires valid crypto matching card used for testing
 				if (optTestRSADecryption)
 					testRSADecryption(p11, session);
@@ -1835,9 +2519,14 @@ int main(int argc, char *argv[])
 		free(slotlist);
 
 #ifndef WIN32
-		if (!optNoMultiThreadingTests)
+		if (!optNoMultiThreadingTests) {
 			testSigningMultiThreading(p11);
+			testDecryptSigningMultiThreading(p11);
+		}
 #endif
+
+		if (vendor && (vendor->version.minor >= 1))
+			printSlotStatistics(p11, vendor);
 	}
 
 	printf("Calling C_Finalize ");
@@ -0,0 +1,406 @@
+/**
+ * SmartCard-HSM PKCS#11 Module
+ *
+ * Copyright (c) 2013, CardContact Systems GmbH, Minden, Germany
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of CardContact Systems GmbH nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CardContact Systems GmbH BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file verify-bench.c
+ * @brief Throughput benchmark for signature verification in the host
+ *
+ * The program verifies a SHA-256 signature for each embedded test key and
+ * measures the number of verifications per second with one thread and with
+ * the given number of threads running in parallel.
+ *
+ * Usage: verify-bench [seconds] [threads]
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <pthread.h>
+
+#include <pkcs11/digest.h>
+#include <pkcs11/rsa.h>
+#include <pkcs11/ecc.h>
+
+
+
+static const char *message = "verify-bench";
+
+/*
+ * Public keys with a SHA-256 signature over the message. For RSA keys the values are
+ * the modulus and public exponent, for EC keys the curve OID and the uncompressed point.
+ */
+struct testKey {
+	char *name;
+	CK_KEY_TYPE keyType;
+	char *value1;
+	char *value2;
+	char *signature;
+};
+
+static struct testKey testKeys[] = {
+	{ "RSA-1024", CKK_RSA,
+		  "b6be52f397719faf21c0e0ead81ea1cb46175ba506e5c8aaf144b0253eee0d000efd94a9d1d8a792a7b0815e8e3c3ab4"
+		  "125778bbf89b4d2ca55a3106258baef08823fec40b124ffebf4a488a9192343f81b3273a6e35f74d2e564bb5635cd045"
+		  "d4d02501db492294d62cb6cbaf35c38c261d56634d29c8a33bd9c90e3e8947c5",
+		  "010001",
+		  "1f94cece23c0ae0df402f4ea9ad207187a2cc19748879524da4877e6ec7d1655386cb8ce2b8dc670e95c83da0d8e73f9"
+		  "97b263a33a1ec4983b653dfff6580cb2d1692004596ef7444a6c364b47c34ba2c766a674d52050c2dd5c177a34320c99"
+		  "1957b9777767d6344b2f5dee64e2c7e7e56b0afde8b973435f785b483f404c35" },
+	{ "RSA-2048", CKK_RSA,
+		  "a648ad59c9aab772b9fc7877017046b879cb95742725914293d74da9e4bdd19584943cba69938a3ee94b09d7661801b6"
+		  "271d962524126c192a680349d79edfdffd86edc461325f6cb2742fa3def08f584f7e8351b18d1f01b958fe1e6d608ee9"
+		  "690f2a279108fd308e2fca1bf217d096ad5108da3be73b57256e581528222d8efbaa4254e3d2f14b8f8f2c9d6163c9ea"
+		  "100a59e9e82fdb27e991dbad038e30ce63d935da444c0eb816bd269a3433ef8a459715b031f578020dd1de5e06c0d483"
+		  "f898cf544ff4064fc97f2deff6349ecdcfcdde2cdf70be4566b6e78b9eab3c9c9d2d710fad1f6ad38d1a6009e01ebf43"
+		  "7c0ed22f7ae79d935dfc2c7d7e38eefb",
+		  "010001",
+		  "05d9f9fc002022c1fe4074608216ca33ac3c9e85f1e7dee6b371724eab82650ee5eeec714f51494e05337375040096c0"
+		  "d4b11284ffdba275490622290415aa669652f449b9304701f98dc716bf2dac03419989b6c179f8550fd64f6b20f59fe5"
+		  "6a502fb9c62f0d8b7dced25ec502e391d222eeebc6ef4da42feb2f440d7dc6c900daf876a6e415b4238716bc28e050fe"
+		  "499870cfdec9d8079c376cbbb3a2cfcee3fde22f296a607997d1fd7bb86dfe6d48654eadeac4466fe650f5a2db2ad108"
+		  "bbf8e3e0f644cc69c0cc2ce05224d0954a9266dfd397a6c1518f5b266ba6b5a5da02b0b254c463645cdcaafeb81bdf67"
+		  "656f2bda7e0cbaa37a02299cd39842b3" },
+	{ "RSA-3072", CKK_RSA,
+		  "a63853c119ef19c7d902807fbbd2e7fd12bdc48441decb74316a3a6b74a2007e2e40bffa2b94d8d145a5d6b5ed35f361"
+		  "1ca71ee779a28bd895dda75677dad8a92dd8959725034e7bb599889fd73691c1a620cb09d18e136795c04decb407a8a2"
+		  "e58d2aa3014f342a999807e01957b9b875f968f8f93c4b31abc615cade11ea7880729d6a2997fed02e28fc97807c96df"
+		  "f923975847b50341a0a73f34b7fc06bc46f7cc853c439df6c5e3b2feab031482ff66703d9ba70899a0534255c0ac896f"
+		  "55caf19dfe779fe535578b402d65d50bb01b18f46aa52baa6dc3e2541b293f7f7a9585bebe981cc67601164600e9c5a7"
+		  "3189675bec43377c3c0217c8ddb65fd7fa59b5d4461a1de5ce6387cfd2b5bb505420c65ce4f8569fd51c0aa2ee5aa7ef"
+		  "daaa71ff89254d525879c8c889ed8eaec267bb7cc1f9e7cd877fca53a8c4123de6c5855af95910f32f66fc49454bcd58"
+		  "70972d4e5f1cdec72cca170261c650d8c7a63b7f3d74493f3c186a97d09fa60e3d2378a89a4672c30f0703d0591c02f1",
+		  "010001",
+		  "754e75863a804837a6e219ec31a770c178825ec572caae58b2e91e42a836d6577339c2c390eda3e86f2b6c8647c0a12a"
+		  "30904baa570ccd09e048404b8dd4a058c76dc428dd6cc085be01f6ae168e6fca36969d0eb1e14525fa26eadf2f4895fe"
+		  "74be7458652bebcb1707638fa183200c3105bc27c3515b1fae7ea3afb277ea02c9c7542b29cda165547163f454979f61"
+		  "54df50d86a1047cd922e2bb55c0b237b8eeb3b7679ba2860426d2403b7081627938496296287059b0c927423c5115561"
+		  "6ed1f29eaa18cadeddfb30da08958c0d08c88c050325d75f4bce5608ca6460d5afa19cc0088072a604bccb50e5164a27"
+		  "bac833b56a6cab8fafd37c8062e1e668a3d33d40db08ec28823cbb0a2879cae89177b0a36c263ac1cd0573c4e097c743"
+		  "322179c48c5180302a976bcbee72c9abce659bcfdfcbd9ee868e49b1c07e07a1080bbf92971abe6d5b3e5bcc79addeea"
+		  "2de2b1219440085af60fa8962d0692914f6f8108f580e8f4a088842b9d6ece4a5bb6cf3f9e90f7eb75390540b486cde5" },
+	{ "RSA-4096", CKK_RSA,
+		  "cba759c12d1bbf329f273dd68d6bfa59e2abf5e956f8c3ccd43f4018dbb722d640e895d13e9700b7512a209a62a25008"
+		  "8d04b1a2a17c64231d4e43f34e71e999092fc918a71a407ee370be1d86a7000287cb5a0a7985e3008859c28e2cb7180a"
+		  "9b4ecbe7ebde558b98d3a8ee69e37ae79a1a248c5f715a2aa53db070618d97a9c561117b73533fae95e0118ed108a461"
+		  "8339036c48afd7994d19b1cd918e52efab74d5c6cd3e5e127261ae9f7bc04ddd938c56fa405687d733a78c14ef2a853d"
+		  "e792c421b821977e76e4cf516e82aaaf6a2adadd6815ed2c0f0a75fefbb43bd82d22ad1ce4470d68387157d839836186"
+		  "0e3dec577b5b021618aedde0b25d55d70c0c3c5084f759c800aa24b9bfac398a099374454164f71bb6a1946f2af6b1a4"
+		  "0a1929b0e44057a231c5fa40276a95b81899f604f500f968db0b2f9d0d439e0401d9ab74bcfba0df1f576b1377730868"
+		  "e4519132d271ea3ec4d58dbe1281a9f87967a7228698f8479a8e66808586c659d4e17a0382514e48bc9eca4401a2fbdd"
+		  "12a360f9f4b8c899f3e31d1c3b2c9263db14de4bafb303ec7c33433cdafc8b7b31bbcb2a59697e5a4581b9e377534684"
+		  "aa645cc65d16d956accf0f681147ba8705674f5c732b293c62c41103522df7a1c35b7ddc03bef06d87e4c1e35a83cb49"
+		  "2a7722dd54e68122319265f78f30aa1a6277929121082f2d539d6090dac665df",
+		  "010001",
+		  "631fef272c91a04e44df35a45a6c092820c707298cfb524054068c4926fb5e05409a3c57f01e5eb378df7440e88dedee"
+		  "085d3a2abce6b2531ac4433a839e98c0d892a86343864df4a140d5ee4c5ad782d13ea6029bb305196f19e04b97257847"
+		  "c21d2c3b92f023a40e0932b21b56b6c28d441b342967d51412cf10c1da39ec679248292ff8c4bd530821a50997993990"
+		  "e2d2c3548e15f7280512117549ba56299f8642bbdd9ce4f34588bdf5b792111f898da850d57ca6567ce12d02709b3b6a"
+		  "0d045514b290963dadfa8df0c028ddfd475f1c9de0edabb55cdecff8d9381555cc287ec3cac9203256ce146ecb9b2189"
+		  "709583c94cc44e790897c4b6ce3784f802a50c6a5c92485b5231406f8e25f54f7796b4b708487346edf671f8fcc61ae5"
+		  "9fb62ad5978b94d34310c1d90f85a266b0d9ddee1efd6ccc592a599836f19db7af96dc6a7595bdedb7e89ce9b72a6de3"
+		  "b9c38183c9bb47d41afba69ecdcae06db6399dfcc69205696e9e6dff9ccc393ff8e77bbca7a700accab87a726bc44e8d"
+		  "50c8d644b617a7812f8e26e3c0a5168283903f8620fb1ffb0a606d501f01e7ab86fe48c0a47fcae9336b9e67acfcfd7a"
+		  "f5e7537dac69bad284e1566ee931a5b7a81a36088aa1c33745c49362d511a201cb65c420e9054b122d0d7405418fa4b8"
+		  "551c242cadeacd174a2bed579cf5bb094cecc8ab9c1d3939aa52a2ee6ce40dd8" },
+	{ "secp256r1", CKK_EC,
+		  "06082a8648ce3d030107",
+		  "045dac2ad549d61b357ac6b17307700ee1f8d6a427068995982e313d4c556acd5c6f76fe13f34d961aef199cab860ad9"
+		  "1c51f87e2d562fbbadc5bc8fd04a936cf7",
+		  "deb3fa5b2a4b6951992702d6601921fd4c23bf533264adedab467df6def605f3aee62c7a1e564c7174fbd03d9af2f616"
+		  "cb945181e33b3a6a2690589f4d307490" },
+	{ "secp384r1", CKK_EC,
+		  "06052b81040022",
+		  "0411fa1a2dfb528ecc79b241a84da9ef55d9299ca68ce21bcd0c73bc5de4052f698d93d5458232a99682fdcd34059574"
+		  "db5714810536c0f07a7de449070f7922649540e292998b65ade9090bd1ee84b9ed0bc28123a614a7fd4f17b589d6f034"
+		  "be",
+		  "a37ae6675537e500c9ad99fd1d39d58618375c594b38884088e70ce645570b4e204c04d97b07981a631c2abf6365c426"
+		  "59994e491905c36e061b7efcdc260166fe63788007f6bd729f224180cde140c727cc96701574566b605a640ce8687fb2" },
+	{ "secp521r1", CKK_EC,
+		  "06052b81040023",
+		  "04018ec0070a331d8ad285ff831856b7357c1806279bf48914e4be472d5db9d585836647fefe9113dbbd14c0a7db090a"
+		  "fd3e5beb245575bd740cc36eb245d1dec55634008601d36f09ba2900df395e0a939ae3b6029b0e04ffd8260f9e0212a0"
+		  "4c86a4a58825afdd9dde75543bbe25d129a6c7079588b9c4de5907ade0cd6325305c0e232e",
+		  "0008bceb4909dd52295dac97c648ffa8c1ee08b88c8a6580b2cdb1e6d1fb7a74543e7b9acfbe64aff4dd7f919df7b278"
+		  "140f3dd2a1e7dae62ad0a1d4c3a99a158f3201b74ca2f81826be47f8070d5a71df51f836a49ca2154328a21b96a6fae5"
+		  "eb03f90599ad7e341dab3d321e4895a36fa5cbb85f673e3698708bafd6cd98984be4881a" },
+	{ "brainpoolP256r1", CKK_EC,
+		  "06092b2403030208010107",
+		  "04262ef5df72c0cb4ac5aa1db1d5c08c815cba7e8c80bf53f68be4d33945d5d82d6694116fa34d93bb324fac5ac5c924"
+		  "e03defe7f699b4c7f1b24bfc4f236344b0",
+		  "94d6fa7e31d8a7001a8b91fb928e21f3e9f753d1ddc9245b3387b4e595907c2c44ff89afd40b40e877153604ec2e3279"
+		  "9537393e917aa88c5e4d983a144da309" },
+	{ "brainpoolP384r1", CKK_EC,
+		  "06092b240303020801010b",
+		  "04542e3bbb775f4837112b7f701636523127fa0d2f50b8f531962cc9f7241e76210d842b6c5e0bc6889f1e4f2d8e2bf4"
+		  "e876adba4cd5dd0edc2e1108815c71fe1299077179e43e5661fb2b407a65cb3f7b2d6c52e1c50cfe4d4be418d04b6e4e"
+		  "e4",
+		  "2541c1176c095bedf37bc1138b5ad49d21a15fac52e555895890789875630e4983fc39a536d9442d9f7b0886da682e2d"
+		  "6061fbc633f7f1918c00be6b2ae21ebb0f8be3a5a3ff8fbafb6d66425b2d973f9a636d61187f14e35cfc1ac20c7dfcd4" },
+	{ "brainpoolP512r1", CKK_EC,
+		  "06092b240303020801010d",
+		  "04553653a9cc1f04c5a5c070e0d8dfd544a52fd26cdefca2243e69db8a5e08c66d6f0b6f486e3f918287328f3516e114"
+		  "53fbe9b2dca328d2c920de20b6d2a4b95d8bf56911acca866ae59e9653fabad69faf905cc51366577952b0e0c9a7ed53"
+		  "0a11be0610c31ac118682fb1b467dba9710a7426df54303ebdbe01af693be34ce5",
+		  "0e6c86793e2df1c6124bffb6ad7bb4bad36ddbc9c12915cf05748d1a86f2d2e87472206a3069d67864c1bcc9b6d94efb"
+		  "5ebdd7ea4dabf35f9ecb7953f38ed45d9b636f1bec2e0472bcb6cd6b9707909005a6d5cbe5491c2a0728ad0d9065fe51"
+		  "5bf3fd0d4d881b6c473c895f0854f28e3e3a1c57d93b1afa64227fecd7193fbd" },
+};
+
+#define NUMBER_OF_KEYS	(sizeof(testKeys) / sizeof(*testKeys))
+
+
+
+/**
+ * Key prepared for verification
+ */
+struct benchKey {
+	struct testKey *test;
+	union {
+		struct rsaPublicKey rsa;
+		struct {
+			struct ecCurve curve;
+			struct ecPoint q;
+		} ec;
+	} key;
+	unsigned char signature[RSA_MAX_BYTES];
+	size_t signatureLen;
+};
+
+struct benchThread {
+	pthread_t thread;
+	struct benchKey *key;
+	double seconds;
+	long count;
+	int failed;
+};
+
+
+
+static double now() {
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+
+
+static size_t decodeHex(const char *hex, unsigned char *buf)
+{
+	size_t len = 0;
+	unsigned int v;
+
+	while (*hex && (sscanf(hex, "%2x", &v) == 1)) {
+		buf[len++] = (unsigned char)v;
+		hex += 2;
+	}
+	return len;
+}
+
+
+
+static int prepareKey(struct testKey *test, struct benchKey *bk)
+{
+	unsigned char v1[RSA_MAX_BYTES], v2[RSA_MAX_BYTES];
+	size_t l1, l2;
+
+	bk->test = test;
+	l1 = decodeHex(test->value1, v1);
+	l2 = decodeHex(test->value2, v2);
+	bk->signatureLen = decodeHex(test->signature, bk->signature);
+
+	if (test->keyType == CKK_RSA) {
+		return rsaInitPublicKey(&bk->key.rsa, v1, l1, v2, l2);
+	}
+
+	if (ecDecodeParams(&bk->key.ec.curve, v1, l1) < 0) {
+		return -1;
+	}
+
+	return ecDecodePoint(&bk->key.ec.curve, &bk->key.ec.q, v2, l2);
+}
+
+
+
+/*
+ * Verify the signature like C_Verify with CKM_SHA256_RSA_PKCS or CKM_ECDSA_SHA256
+ */
+static int verify(struct benchKey *bk)
+{
+	unsigned char hash[DIGEST_MAX_SIZE], em[RSA_MAX_BYTES];
+	const unsigned char *prefix, *t;
+	size_t hashLen, tLen;
+	int prefixLen;
+
+	hashLen = digest(CKM_SHA256, (unsigned char *)message, strlen(message), hash);
+
+	if (bk->test->keyType == CKK_EC) {
+		return ecdsaVerify(&bk->key.ec.curve, &bk->key.ec.q, hash, hashLen, bk->signature, bk->signatureLen);
+	}
+
+	if ((bk->signatureLen != (size_t)bk->key.rsa.size) ||
+		(rsaPublic(&bk->key.rsa, bk->signature, bk->signatureLen, em) < 0) ||
+		(pkcs1V15RemoveSignaturePadding(em, bk->signatureLen, &t, &tLen) < 0)) {
+		return -1;
+	}
+
+	prefix = getDigestInfoPrefix(CKM_SHA256, &prefixLen);
+
+	if ((tLen != prefixLen + hashLen) || memcmp(t, prefix, prefixLen) || memcmp(t + prefixLen, hash, hashLen)) {
+		return -1;
+	}
+	return 0;
+}
+
+
+
+static void *benchThreadMain(void *arg)
+{
+	struct benchThread *bt = (struct benchThread *)arg;
+	double end;
+	int i;
+
+	end = now() + bt->seconds;
+
+	do	{
+		for (i = 0; i < 16; i++) {
+			if (verify(bt->key) < 0) {
+				bt->failed = 1;
+			}
+		}
+		bt->count += 16;
+	} while (now() < end);
+
+	return NULL;
+}
+
+
+
+/*
+ * Run verifications in parallel threads and return the total number per second
+ */
+static double measure(struct benchKey *bk, int threads, double seconds)
+{
+	struct benchThread *bt;
+	double start, elapsed;
+	long count;
+	int i, failed;
+
+	bt = calloc(threads, sizeof(struct benchThread));
+
+	if (bt == NULL) {
+		return -1;
+	}
+
+	start = now();
+
+	for (i = 0; i < threads; i++) {
+		bt[i].key = bk;
+		bt[i].seconds = seconds;
+		pthread_create(&bt[i].thread, NULL, benchThreadMain, &bt[i]);
+	}
+
+	count = 0;
+	failed = 0;
+
+	for (i = 0; i < threads; i++) {
+		pthread_join(bt[i].thread, NULL);
+		count += bt[i].count;
+		failed |= bt[i].failed;
+	}
+
+	elapsed = now() - start;
+	free(bt);
+
+	return failed ? -1 : count / elapsed;
+}
+
+
+
+int main(int argc, char **argv)
+{
+	struct benchKey *bk;
+	unsigned char *sig;
+	double seconds, single, parallel;
+	int threads, i;
+
+	seconds = argc > 1 ? atof(argv[1]) : 1.0;
+	threads = argc > 2 ? atoi(argv[2]) : 4;
+
+	if ((seconds <= 0) || (threads <= 0)) {
+		printf("Usage: verify-bench [seconds] [threads]\n");
+		return 1;
+	}
+
+	initDigestEngine();
+
+	bk = calloc(1, sizeof(struct benchKey));
+
+	if (bk == NULL) {
+		printf("Out of memory\n");
+		return 1;
+	}
+
+	printf("%-18s %12s %12s %8s\n", "Key", "1 thread/s", "threads/s", "Scale");
+
+	for (i = 0; i < NUMBER_OF_KEYS; i++) {
+		if (prepareKey(&testKeys[i], bk) < 0) {
+			printf("%s key not supported\n", testKeys[i].name);
+			return 1;
+		}
+
+		if (verify(bk) < 0) {
+			printf("%s signature not verified\n", testKeys[i].name);
+			return 1;
+		}
+
+		// A modified signature must be rejected
+		sig = bk->signature + bk->signatureLen / 2;
+		*sig ^= 0x01;
+
+		if (verify(bk) == 0) {
+			printf("%s modified signature verified\n", testKeys[i].name);
+			return 1;
+		}
+
+		*sig ^= 0x01;
+
+		single = measure(bk, 1, seconds);
+		parallel = measure(bk, threads, seconds);
+
+		if ((single < 0) || (parallel < 0)) {
+			printf("%s verification failed during benchmark\n", testKeys[i].name);
+			return 1;
+		}
+
+		printf("%-18s %12.0f %12.0f %7.2fx\n", testKeys[i].name, single, parallel, parallel / single);
+	}
+
+	free(bk);
+	return 0;
+}